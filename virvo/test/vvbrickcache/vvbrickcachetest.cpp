@@ -0,0 +1,195 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "vvbrickcache.h"
+#include "vvfileio.h"
+#include "vvtoolshed.h"
+#include "vvvoldesc.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+static const char* filename = "vvbrickcachetest.bricks";
+
+// Sizes that are no multiple of the brick size, 16 bit voxel (x,y,z) is its index
+static vvVolDesc* makeVolume()
+{
+  vvVolDesc* vd = new vvVolDesc(filename, 10, 7, 5, 1, 2, 1, NULL);
+  vd->dist = vvVector3(1.0f, 2.0f, 3.0f);
+  uint8_t* raw = new uint8_t[vd->getFrameBytes()];
+  for (size_t i=0; i<vd->getFrameVoxels(); ++i)
+  {
+    raw[i * 2] = uint8_t(i >> 8);
+    raw[i * 2 + 1] = uint8_t(i);
+  }
+  vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+  return vd;
+}
+
+static size_t brickBytes(const virvo::BrickCache* cache, size_t index)
+{
+  const virvo::BrickCache::Brick& b = cache->getBrick(index);
+  return b.stored[0] * b.stored[1] * b.stored[2] * cache->getBytesPerVoxel();
+}
+
+// Compares the voxels of a brick, including the shared upper layer, with the volume
+static bool checkBrick(const virvo::BrickCache* cache, size_t index, const uint8_t* data, const vvVolDesc* vd)
+{
+  if (data == NULL)
+    return false;
+
+  const virvo::BrickCache::Brick& b = cache->getBrick(index);
+  const size_t bpv = vd->getBPV();
+  const size_t rowBytes = b.stored[0] * bpv;
+  for (size_t z=0; z<b.stored[2]; ++z)
+  {
+    for (size_t y=0; y<b.stored[1]; ++y)
+    {
+      const size_t src = (((b.first[2] + z) * vd->vox[1] + b.first[1] + y) * vd->vox[0] + b.first[0]) * bpv;
+      if (memcmp(data, vd->getRaw() + src, rowBytes) != 0)
+        return false;
+      data += rowBytes;
+    }
+  }
+  return true;
+}
+
+// Waits until the loader threads have read count bricks
+static bool waitForLoads(const virvo::BrickCache* cache, size_t count)
+{
+  for (int i=0; i<1000 && cache->getNumLoads() < count; ++i)
+    vvToolshed::sleep(10);
+  return cache->getNumLoads() == count;
+}
+
+// Writes a bricked volume file and reads it back as a whole and brick by
+// brick, with a budget that holds only a few bricks
+int main()
+{
+  vvVolDesc* vd = makeVolume();
+  CHECK(virvo::BrickCache::write(vd, filename, 4));
+
+  // attributes only, as for out-of-core rendering
+  vvVolDesc* header = new vvVolDesc(filename);
+  vvFileIO fio;
+  CHECK(fio.loadVolumeData(header, vvFileIO::LoadType(vvFileIO::ALL_DATA & ~vvFileIO::RAW_DATA)) == vvFileIO::OK);
+  CHECK(header->frames == 0);
+  CHECK(header->vox == vd->vox);
+  CHECK(header->bpc == vd->bpc && header->chan == vd->chan);
+  CHECK(header->dist == vd->dist);
+  delete header;
+
+  // the whole volume
+  vvVolDesc* loaded = new vvVolDesc(filename);
+  CHECK(fio.loadVolumeData(loaded) == vvFileIO::OK);
+  CHECK(loaded->frames == 1);
+  CHECK(loaded->vox == vd->vox);
+  CHECK(memcmp(loaded->getRaw(), vd->getRaw(), vd->getFrameBytes()) == 0);
+  delete loaded;
+
+  // users of the same file share the cache
+  virvo::BrickCache* cache = virvo::BrickCache::open(filename);
+  CHECK(cache != NULL);
+  CHECK(virvo::BrickCache::open(filename) == cache);
+  virvo::BrickCache::close(cache);
+
+  CHECK(cache->getVolumeSize() == vd->vox);
+  CHECK(cache->getBytesPerVoxel() == 2);
+  CHECK(cache->getGridSize() == vvsize3(3, 2, 2));
+  CHECK(cache->getNumBricks() == 12);
+
+  size_t maxBytes = 0;
+  for (size_t i=0; i<cache->getNumBricks(); ++i)
+    maxBytes = std::max(maxBytes, brickBytes(cache, i));
+
+  // released bricks are evicted, least recently used first
+  const int client = 0;
+  const size_t budget = 2 * maxBytes;
+  cache->setBudget(budget);
+  for (size_t i=0; i<cache->getNumBricks(); ++i)
+  {
+    CHECK(checkBrick(cache, i, cache->acquire(&client, i), vd));
+    cache->release(i);
+    CHECK(cache->getUsage() <= budget);
+  }
+  CHECK(cache->getNumLoads() == 12);
+  CHECK(cache->getNumStalls() == 12);
+
+  CHECK(checkBrick(cache, 11, cache->acquire(&client, 11), vd));
+  cache->release(11);
+  CHECK(cache->getNumLoads() == 12);
+  CHECK(checkBrick(cache, 0, cache->acquire(&client, 0), vd));
+  cache->release(0);
+  CHECK(cache->getNumLoads() == 13);
+
+  // bricks in use stay in memory, even beyond the budget
+  const uint8_t* brick0 = cache->acquire(&client, 0);
+  const uint8_t* brick1 = cache->acquire(&client, 1);
+  const uint8_t* brick4 = cache->acquire(&client, 4);
+  CHECK(cache->getUsage() == brickBytes(cache, 0) + brickBytes(cache, 1) + brickBytes(cache, 4));
+  CHECK(cache->getUsage() > budget);
+  CHECK(checkBrick(cache, 0, brick0, vd));
+  CHECK(checkBrick(cache, 1, brick1, vd));
+  CHECK(checkBrick(cache, 4, brick4, vd));
+  cache->release(0);
+  cache->release(1);
+  cache->release(4);
+  CHECK(cache->getUsage() <= budget);
+
+  // prefetched bricks stay in memory until they are acquired
+  cache->setBudget(0);
+  CHECK(cache->getUsage() == 0);
+  cache->setBudget(budget);
+  const size_t loads = cache->getNumLoads();
+  const size_t stalls = cache->getNumStalls();
+  vector<size_t> order;
+  order.push_back(3);
+  order.push_back(6);
+  cache->prefetch(&client, order);
+  CHECK(waitForLoads(cache, loads + 2));
+  cache->setBudget(0);
+  CHECK(cache->getUsage() == brickBytes(cache, 3) + brickBytes(cache, 6));
+
+  CHECK(checkBrick(cache, 3, cache->acquire(&client, 3), vd));
+  CHECK(cache->getNumStalls() == stalls);
+  cache->release(3);
+  CHECK(cache->getUsage() == brickBytes(cache, 6));
+
+  // a new prefetch order releases the bricks of the old one
+  cache->prefetch(&client, vector<size_t>());
+  cache->setBudget(0);
+  CHECK(cache->getUsage() == 0);
+
+  virvo::BrickCache::close(cache);
+  delete vd;
+  remove(filename);
+
+  cerr << "BrickCache passed" << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
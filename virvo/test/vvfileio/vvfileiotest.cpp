@@ -0,0 +1,695 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "vvfileio.h"
+#include "vvvoldesc.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+// DICOM slice series
+//----------------------------------------------------------------------------
+
+static const size_t DicomWidth = 4;
+static const size_t DicomHeight = 3;
+
+static void put16(vector<uint8_t>& out, size_t value)
+{
+  out.push_back(uint8_t(value));
+  out.push_back(uint8_t(value >> 8));
+}
+
+static void put32(vector<uint8_t>& out, size_t value)
+{
+  put16(out, value & 0xFFFF);
+  put16(out, value >> 16);
+}
+
+// Append a data element in explicit VR little endian
+static void putElement(vector<uint8_t>& out, size_t group, size_t element, const char* vr, const void* data, size_t size)
+{
+  put16(out, group);
+  put16(out, element);
+  out.push_back(uint8_t(vr[0]));
+  out.push_back(uint8_t(vr[1]));
+  if (strcmp(vr, "OB") == 0 || strcmp(vr, "OW") == 0)
+  {
+    put16(out, 0);
+    put32(out, size);
+  }
+  else
+  {
+    put16(out, size);
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+// Strings are padded to an even length, UIDs with 0 and text with spaces
+static void putString(vector<uint8_t>& out, size_t group, size_t element, const char* vr, string value)
+{
+  if (value.size() % 2 != 0)
+    value += strcmp(vr, "UI") == 0 ? '\0' : ' ';
+  putElement(out, group, element, vr, value.data(), value.size());
+}
+
+static void putUS(vector<uint8_t>& out, size_t group, size_t element, size_t value)
+{
+  vector<uint8_t> data;
+  put16(data, value);
+  putElement(out, group, element, "US", &data[0], data.size());
+}
+
+static string toString(float value)
+{
+  ostringstream str;
+  str << value;
+  return str.str();
+}
+
+// Writes a secondary capture image with all pixels set to value. A negative
+// location leaves out the slice location.
+static bool writeDicomFile(const string& filename, int instance, float location, uint8_t value)
+{
+  const char* sopClass = "1.2.840.10008.5.1.4.1.1.7";
+  const string sopInstance = "1.2.826.0.1.3680043.2.1125.1." + toString(float(instance));
+
+  vector<uint8_t> meta;
+  const uint8_t version[2] = { 0, 1 };
+  putElement(meta, 0x0002, 0x0001, "OB", version, 2);
+  putString(meta, 0x0002, 0x0002, "UI", sopClass);
+  putString(meta, 0x0002, 0x0003, "UI", sopInstance);
+  putString(meta, 0x0002, 0x0010, "UI", "1.2.840.10008.1.2.1");
+
+  vector<uint8_t> data(128, 0);
+  data.push_back('D');
+  data.push_back('I');
+  data.push_back('C');
+  data.push_back('M');
+  vector<uint8_t> length;
+  put32(length, meta.size());
+  putElement(data, 0x0002, 0x0000, "UL", &length[0], length.size());
+  data.insert(data.end(), meta.begin(), meta.end());
+
+  putString(data, 0x0008, 0x0016, "UI", sopClass);
+  putString(data, 0x0008, 0x0018, "UI", sopInstance);
+  putString(data, 0x0008, 0x0060, "CS", "OT");
+  putString(data, 0x0020, 0x0011, "IS", "1");
+  putString(data, 0x0020, 0x0013, "IS", toString(float(instance)));
+  if (location >= 0.0f)
+    putString(data, 0x0020, 0x1041, "DS", toString(location));
+  putUS(data, 0x0028, 0x0002, 1);
+  putString(data, 0x0028, 0x0004, "CS", "MONOCHROME2");
+  putUS(data, 0x0028, 0x0010, DicomHeight);
+  putUS(data, 0x0028, 0x0011, DicomWidth);
+  putString(data, 0x0028, 0x0030, "DS", "0.5\\0.5");
+  putUS(data, 0x0028, 0x0100, 8);
+  putUS(data, 0x0028, 0x0101, 8);
+  putUS(data, 0x0028, 0x0102, 7);
+  putUS(data, 0x0028, 0x0103, 0);
+  const vector<uint8_t> pixels(DicomWidth * DicomHeight, value);
+  putElement(data, 0x7FE0, 0x0010, "OB", &pixels[0], pixels.size());
+
+  FILE* fp = fopen(filename.c_str(), "wb");
+  if (fp == NULL)
+    return false;
+  const bool ok = fwrite(&data[0], 1, data.size(), fp) == data.size();
+  return fclose(fp) == 0 && ok;
+}
+
+static string seriesFilename(const char* prefix, size_t index)
+{
+  ostringstream str;
+  str << prefix << (index < 9 ? "0" : "") << index + 1 << ".dcm";
+  return str.str();
+}
+
+// Writes the files of a series, merges them and checks that slice z has value z+1
+static int checkSeries(const char* prefix, const int* instances, const float* locations, const uint8_t* values, size_t count)
+{
+  for (size_t i=0; i<count; ++i)
+    CHECK(writeDicomFile(seriesFilename(prefix, i), instances[i], locations[i], values[i]));
+
+  vvVolDesc* vd = new vvVolDesc(seriesFilename(prefix, 0).c_str());
+  vvFileIO fio;
+  CHECK(fio.mergeFiles(vd, 0, 1, vvVolDesc::VV_MERGE_SLABS2VOL) == vvFileIO::OK);
+  CHECK(vd->frames == 1);
+  CHECK(vd->vox == vvsize3(DicomWidth, DicomHeight, count));
+  CHECK(vd->bpc == 1 && vd->chan == 1);
+  CHECK(vd->dist[0] == 0.5f && vd->dist[1] == 0.5f);
+  for (size_t z=0; z<count; ++z)
+  {
+    const uint8_t* slice = vd->getRaw() + z * vd->getSliceBytes();
+    for (size_t i=0; i<vd->getSliceBytes(); ++i)
+      CHECK(slice[i] == z + 1);
+  }
+  delete vd;
+
+  for (size_t i=0; i<count; ++i)
+    remove(seriesFilename(prefix, i).c_str());
+  return 0;
+}
+
+// The files of a series are merged by slice location, by image number if
+// the locations are not unique, and in file order if neither is
+static int testDicomSeries()
+{
+  const float locations[] = { 30.0f, 10.0f, 50.0f, 20.0f, 40.0f };
+  const int instances[] = { 2, 5, 1, 4, 3 };
+  const uint8_t byLocation[] = { 3, 1, 5, 2, 4 };
+  CHECK(checkSeries("vvfileiolocation", instances, locations, byLocation, 5) == 0);
+
+  const float noLocations[] = { -1.0f, -1.0f, -1.0f, -1.0f, -1.0f };
+  const uint8_t byInstance[] = { 2, 5, 1, 4, 3 };
+  CHECK(checkSeries("vvfileioinstance", instances, noLocations, byInstance, 5) == 0);
+
+  const int sameInstances[] = { 1, 1, 1, 1, 1 };
+  const uint8_t byFile[] = { 1, 2, 3, 4, 5 };
+  CHECK(checkSeries("vvfileiofile", sameInstances, noLocations, byFile, 5) == 0);
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// Slice series errors
+//----------------------------------------------------------------------------
+
+static string sliceFilename(size_t index)
+{
+  ostringstream str;
+  str << "vvfileioslices-" << index << ".tif";
+  return str.str();
+}
+
+// Writes 5 TIFF slices, slice z has value z+1
+static bool writeSlices()
+{
+  vvVolDesc* vd = new vvVolDesc("vvfileioslices.tif", 4, 3, 5, 1, 1, 1, NULL);
+  uint8_t* raw = new uint8_t[vd->getFrameBytes()];
+  for (size_t i=0; i<vd->getFrameBytes(); ++i)
+    raw[i] = uint8_t(i / vd->getSliceBytes() + 1);
+  vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+  vvFileIO fio;
+  const bool ok = fio.saveVolumeData(vd, true) == vvFileIO::OK;
+  delete vd;
+  return ok;
+}
+
+static int mergeSlices(int numFiles, vvVolDesc*& vd)
+{
+  vd = new vvVolDesc(sliceFilename(0).c_str());
+  vvFileIO fio;
+  return fio.mergeFiles(vd, numFiles, 1, vvVolDesc::VV_MERGE_SLABS2VOL);
+}
+
+// A series with a file that cannot be loaded is not merged. A missing
+// file ends the series, which is an error only if more files are expected.
+static int testSeriesErrors()
+{
+  vvVolDesc* vd;
+
+  for (size_t corrupt=0; corrupt<5; corrupt+=2)
+  {
+    CHECK(writeSlices());
+    FILE* fp = fopen(sliceFilename(corrupt).c_str(), "wb");
+    CHECK(fp != NULL);
+    fputs("not a TIFF file", fp);
+    fclose(fp);
+
+    const int err = mergeSlices(0, vd);
+    CHECK(err != vvFileIO::OK && err != vvFileIO::FILE_NOT_FOUND);
+    CHECK(vd->frames == 0);
+    delete vd;
+  }
+
+  CHECK(writeSlices());
+  CHECK(mergeSlices(0, vd) == vvFileIO::OK);
+  CHECK(vd->frames == 1 && vd->vox == vvsize3(4, 3, 5));
+  for (size_t z=0; z<5; ++z)
+    CHECK(vd->getRaw()[z * vd->getSliceBytes()] == z + 1);
+  delete vd;
+
+  remove(sliceFilename(2).c_str());
+  CHECK(mergeSlices(0, vd) == vvFileIO::OK);
+  CHECK(vd->frames == 1 && vd->vox[2] == 2);
+  delete vd;
+
+  CHECK(mergeSlices(5, vd) == vvFileIO::FILE_NOT_FOUND);
+  CHECK(vd->frames == 1 && vd->vox[2] == 2);
+  delete vd;
+
+  for (size_t i=0; i<5; ++i)
+    remove(sliceFilename(i).c_str());
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// AVF voxel parser
+//----------------------------------------------------------------------------
+
+// Number notations found in AVF files, all of which atof() accepts
+static string formatNumber(size_t i, unsigned& seed, bool integer)
+{
+  seed = seed * 1103515245u + 12345u;
+  const unsigned r = (seed >> 8) & 0xFFFF;
+  char str[64];
+  if (integer)
+  {
+    switch (i % 6)
+    {
+      case 0:  sprintf(str, "%u", r); break;
+      case 1:  sprintf(str, "%05u", r % 1000); break;
+      case 2:  sprintf(str, "%u.%u", r / 10, r % 10); break;
+      case 3:  sprintf(str, "+%u", r); break;
+      case 4:  sprintf(str, "%ue1", r / 10); break;
+      default: sprintf(str, "%.1f", double(r) / 2.0); break;
+    }
+    return str;
+  }
+
+  const double value = (double(r) - 32768.0) / double(1 + (seed >> 26));
+  switch (i % 10)
+  {
+    case 0:  sprintf(str, "%.9g", value); break;
+    case 1:  sprintf(str, "%.17g", value); break;
+    case 2:  sprintf(str, "%e", value); break;
+    case 3:  sprintf(str, "%.3f", value); break;
+    case 4:  sprintf(str, "%dE%d", int(value), int(r % 60) - 30); break;
+    case 5:  sprintf(str, "%.20f", value / 1e6); break;
+    case 6:  sprintf(str, "%d", int(value)); break;
+    case 7:  sprintf(str, ".%u", r); break;
+    case 8:  sprintf(str, "%u.", r); break;
+    default: sprintf(str, "%.6fe+%d", value, int(r % 40)); break;
+  }
+  return str;
+}
+
+// Writes an AVF file with the header and voxel text. A token longer than the
+// parser handles after the voxels makes the loader read them with the
+// tokenizer instead, which never gets to that token.
+static bool writeAVFFile(const char* filename, const string& header, const string& voxels, bool tokenizer)
+{
+  FILE* fp = fopen(filename, "wb");
+  if (fp == NULL)
+    return false;
+  fputs(header.c_str(), fp);
+  fputs(voxels.c_str(), fp);
+  if (tokenizer)
+    fprintf(fp, "\n%s\n", string(1100, '7').c_str());
+  return fclose(fp) == 0;
+}
+
+static vvVolDesc* loadAVFFile(const char* filename)
+{
+  vvVolDesc* vd = new vvVolDesc(filename);
+  vvFileIO fio;
+  if (fio.loadVolumeData(vd) != vvFileIO::OK)
+  {
+    delete vd;
+    return NULL;
+  }
+  return vd;
+}
+
+// Loads the voxels with the parallel parser and with the tokenizer and
+// checks that both give the same bytes
+static int checkAVF(const string& header, const string& voxels, size_t frames, size_t frameBytes)
+{
+  const char* parsed = "vvfileioparsed.avf";
+  const char* tokenized = "vvfileiotokenized.avf";
+  CHECK(writeAVFFile(parsed, header, voxels, false));
+  CHECK(writeAVFFile(tokenized, header, voxels, true));
+
+  vvVolDesc* a = loadAVFFile(parsed);
+  vvVolDesc* b = loadAVFFile(tokenized);
+  CHECK(a != NULL && b != NULL);
+  CHECK(a->frames == frames && b->frames == frames);
+  CHECK(a->getFrameBytes() == frameBytes && b->getFrameBytes() == frameBytes);
+  for (size_t f=0; f<frames; ++f)
+    CHECK(memcmp(a->getRaw(f), b->getRaw(f), frameBytes) == 0);
+  delete a;
+  delete b;
+
+  remove(parsed);
+  remove(tokenized);
+  return 0;
+}
+
+// The parallel AVF parser gives the same voxels as the tokenizer it replaced
+static int testAVFParser()
+{
+  unsigned seed = 1;
+
+  // float voxels in several chunks, rounded like atof()
+  {
+    const size_t w = 64, h = 64, d = 64;
+    string voxels;
+    vector<float> expected;
+    for (size_t i=0; i<w*h*d; ++i)
+    {
+      const string number = formatNumber(i, seed, false);
+      expected.push_back((float)atof(number.c_str()));
+      voxels += number;
+      voxels += (i % w == w - 1) ? "\n" : " ";
+    }
+    CHECK(voxels.size() > 2 * 1024 * 1024);
+
+    ostringstream header;
+    header << "WIDTH " << w << "\nHEIGHT " << h << "\nSLICES " << d
+           << "\nFRAMES 1\nMIN -1\nMAX 1\nBPC 4\nCHANNELS 1\n";
+    CHECK(checkAVF(header.str(), voxels, 1, w * h * d * 4) == 0);
+
+    CHECK(writeAVFFile("vvfileioatof.avf", header.str(), voxels, false));
+    vvVolDesc* vd = loadAVFFile("vvfileioatof.avf");
+    CHECK(vd != NULL);
+    CHECK(memcmp(vd->getRaw(), &expected[0], expected.size() * 4) == 0);
+    delete vd;
+    remove("vvfileioatof.avf");
+  }
+
+  // 16 bit voxels of two channels and frames, with comments, '=' and CRLF
+  {
+    string voxels = "# voxels\r\n";
+    for (size_t i=0; i<2*5*4*3*2; ++i)
+    {
+      voxels += formatNumber(i, seed, true);
+      voxels += (i % 7 == 6) ? " # comment\r\n" : " \t";
+    }
+    const string header = "# header\r\nWIDTH=5\r\nHEIGHT = 4\r\nSLICES=3\r\nFRAMES=2\r\n"
+                          "MIN=0 MAX=1\r\nXDIST=0.5\r\nBPC=2\r\nCHANNELS=2\r\n";
+    CHECK(checkAVF(header, voxels, 2, 5 * 4 * 3 * 2 * 2) == 0);
+  }
+
+  // old format: normalized 8 bit values
+  {
+    string voxels;
+    for (size_t i=0; i<6*6*6; ++i)
+    {
+      char str[32];
+      sprintf(str, "%.*f ", int(i % 5) + 1, double(int(i % 23) - 3) / 17.0);
+      voxels += str;
+    }
+    const string header = "WIDTH 6\nHEIGHT 6\nSLICES 6\nFRAMES 1\nFORMAT SCALAR8\nDATA\n";
+    CHECK(checkAVF(header, voxels, 1, 6 * 6 * 6) == 0);
+  }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// XVF delta encoding
+//----------------------------------------------------------------------------
+
+enum FrameEncoding
+{
+  Unencoded,
+  RLE,
+  Delta
+};
+
+static size_t read32(FILE* fp)
+{
+  uint8_t buf[4];
+  if (fread(buf, 1, 4, fp) != 4)
+    return 0;
+  return (size_t(buf[0]) << 24) | (size_t(buf[1]) << 16) | (size_t(buf[2]) << 8) | size_t(buf[3]);
+}
+
+// Returns how the frames of an XVF file starting at offset are stored
+static vector<FrameEncoding> readFrameEncodings(const char* filename, size_t offset, size_t frames, size_t frameBytes)
+{
+  vector<FrameEncoding> encodings;
+  FILE* fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return encodings;
+  fseek(fp, long(offset), SEEK_SET);
+  for (size_t f=0; f<frames && !feof(fp); ++f)
+  {
+    const size_t length = read32(fp);
+    const size_t size = length & 0x7FFFFFFF;
+    encodings.push_back(length == 0 ? Unencoded : size != length ? Delta : RLE);
+    fseek(fp, long(length == 0 ? frameBytes : size), SEEK_CUR);
+  }
+  fclose(fp);
+  return encodings;
+}
+
+// Frames that do and do not profit from delta encoding: noise, a small
+// change, a constant frame, noise again, a copy, half of the voxels changed
+static vvVolDesc* makeDeltaVolume(size_t bpc, size_t chan)
+{
+  vvVolDesc* vd = new vvVolDesc("vvfileiodelta.xvf", 32, 24, 10, 6, bpc, chan, NULL);
+  const size_t bytes = vd->getFrameBytes();
+  const size_t bpv = vd->getBPV();
+  unsigned seed = 7;
+  uint8_t* previous = NULL;
+  for (size_t f=0; f<vd->frames; ++f)
+  {
+    uint8_t* raw = new uint8_t[bytes];
+    for (size_t i=0; i<bytes; ++i)
+    {
+      seed = seed * 1103515245u + 12345u;
+      const uint8_t noise = uint8_t(seed >> 16);
+      switch (f)
+      {
+        case 1:  raw[i] = (i / bpv) % 97 == 5 ? noise : previous[i]; break;
+        case 2:  raw[i] = 42; break;
+        case 4:  raw[i] = previous[i]; break;
+        case 5:  raw[i] = (i / bpv) % 2 == 0 ? noise : previous[i]; break;
+        default: raw[i] = noise; break;
+      }
+    }
+    vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+    previous = raw;
+  }
+  return vd;
+}
+
+// Saves multi-frame volumes with delta encoding and checks how the frames
+// are stored and that they load unchanged
+static int testXVFDelta()
+{
+  FrameEncoding expected[] = { Unencoded, Delta, RLE, Unencoded, Delta, Unencoded };
+
+  for (size_t i=0; i<3; ++i)
+  {
+    const size_t bpc = (i == 1) ? 2 : 1;
+    const size_t chan = (i == 2) ? 3 : 1;
+    vvVolDesc* vd = makeDeltaVolume(bpc, chan);
+    const size_t bytes = vd->getFrameBytes();
+
+    for (int delta=0; delta<2; ++delta)
+    {
+      vvFileIO fio;
+      fio.setDeltaEncoding(delta != 0);
+      CHECK(fio.saveVolumeData(vd, true) == vvFileIO::OK);
+
+      vvVolDesc* loaded = new vvVolDesc("vvfileiodelta.xvf");
+      CHECK(fio.loadVolumeData(loaded) == vvFileIO::OK);
+      CHECK(loaded->frames == vd->frames);
+      CHECK(loaded->vox == vd->vox && loaded->bpc == bpc && loaded->chan == chan);
+      for (size_t f=0; f<vd->frames; ++f)
+        CHECK(memcmp(loaded->getRaw(f), vd->getRaw(f), bytes) == 0);
+      delete loaded;
+
+      const vector<FrameEncoding> encodings = readFrameEncodings("vvfileiodelta.xvf", fio.getDataOffset(), vd->frames, bytes);
+      CHECK(encodings.size() == vd->frames);
+      for (size_t f=0; f<vd->frames; ++f)
+      {
+        // without delta encoding the noisy frames stay unencoded
+        const FrameEncoding e = (!delta && expected[f] == Delta) ? Unencoded : expected[f];
+        CHECK(encodings[f] == e);
+      }
+    }
+    delete vd;
+  }
+  remove("vvfileiodelta.xvf");
+  return 0;
+}
+
+static bool readFile(const char* filename, string& data)
+{
+  FILE* fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return false;
+  char buf[4096];
+  size_t n;
+  data.clear();
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    data.append(buf, n);
+  fclose(fp);
+  return true;
+}
+
+static bool writeFile(const char* filename, const string& data)
+{
+  FILE* fp = fopen(filename, "wb");
+  if (fp == NULL)
+    return false;
+  const bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+  return fclose(fp) == 0 && ok;
+}
+
+// The delta bit is only defined for version 2.1 files. In a version 2.0
+// file the length of an RLE frame with that bit set is too large.
+static int testXVFVersion()
+{
+  vvVolDesc* vd = makeDeltaVolume(1, 1);
+  const size_t bytes = vd->getFrameBytes();
+  vvFileIO fio;
+  fio.setDeltaEncoding(false);
+  CHECK(fio.saveVolumeData(vd, true) == vvFileIO::OK);
+  vvVolDesc* loaded = new vvVolDesc("vvfileiodelta.xvf");
+  CHECK(fio.loadVolumeData(loaded, vvFileIO::HEADER) == vvFileIO::OK);
+  delete loaded;
+  CHECK(readFrameEncodings("vvfileiodelta.xvf", fio.getDataOffset(), 3, bytes)[2] == RLE);
+
+  // set the bit in the length of frame 2, frames 0 and 1 are unencoded
+  string data;
+  CHECK(readFile("vvfileiodelta.xvf", data));
+  const size_t pos = fio.getDataOffset() + 2 * (4 + bytes);
+  CHECK(data.find("VERSION 2.0") != string::npos);
+  data[pos] = char(data[pos] | 0x80);
+  CHECK(writeFile("vvfileiodelta.xvf", data));
+
+  loaded = new vvVolDesc("vvfileiodelta.xvf");
+  CHECK(fio.loadVolumeData(loaded) == vvFileIO::DATA_ERROR);
+  delete loaded;
+
+  // the same frame in a version 2.1 file is the delta to frame 1
+  data.replace(data.find("VERSION 2.0"), 11, "VERSION 2.1");
+  CHECK(writeFile("vvfileiodelta.xvf", data));
+
+  loaded = new vvVolDesc("vvfileiodelta.xvf");
+  CHECK(fio.loadVolumeData(loaded) == vvFileIO::OK);
+  for (size_t i=0; i<bytes; ++i)
+    CHECK(loaded->getRaw(size_t(2))[i] == (vd->getRaw(size_t(1))[i] ^ 42));
+  delete loaded;
+
+  delete vd;
+  remove("vvfileiodelta.xvf");
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// Merged files
+//----------------------------------------------------------------------------
+
+static string mergeFilename(size_t index)
+{
+  ostringstream str;
+  str << "vvfileiomerge" << index + 1 << ".xvf";
+  return str.str();
+}
+
+// Writes single frame volumes with all voxels set to index+1
+static bool writeMergeFiles(size_t count)
+{
+  for (size_t i=0; i<count; ++i)
+  {
+    vvVolDesc* vd = new vvVolDesc(mergeFilename(i).c_str(), 8, 8, 8, 1, 1, 1, NULL);
+    uint8_t* raw = new uint8_t[vd->getFrameBytes()];
+    memset(raw, int(i + 1), vd->getFrameBytes());
+    vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+    vvFileIO fio;
+    const bool ok = fio.saveVolumeData(vd, true) == vvFileIO::OK;
+    delete vd;
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+static int mergeAnimation(int numFiles, int numThreads, vvVolDesc*& vd)
+{
+  vd = new vvVolDesc(mergeFilename(0).c_str());
+  vvFileIO fio;
+  fio.setMergeThreads(numThreads);
+  return fio.mergeFiles(vd, numFiles, 1, vvVolDesc::VV_MERGE_VOL2ANIM);
+}
+
+// Files are merged in order with any number of threads. The error of a
+// file that cannot be loaded is returned, FILE_NOT_FOUND only if the
+// series is shorter than expected.
+static int testMergeFiles()
+{
+  const size_t count = 6;
+  vvVolDesc* vd;
+  CHECK(writeMergeFiles(count));
+
+  const int threads[] = { 1, 2, 0 };
+  for (size_t t=0; t<3; ++t)
+  {
+    CHECK(mergeAnimation(0, threads[t], vd) == vvFileIO::OK);
+    CHECK(vd->frames == count);
+    for (size_t f=0; f<count; ++f)
+      CHECK(vd->getRaw(f)[0] == f + 1 && vd->getRaw(f)[vd->getFrameBytes() - 1] == f + 1);
+    delete vd;
+  }
+
+  // a frame length beyond the frame size in file 3
+  vvVolDesc* corrupt = new vvVolDesc(mergeFilename(3).c_str());
+  vvFileIO fio;
+  CHECK(fio.loadVolumeData(corrupt, vvFileIO::HEADER) == vvFileIO::OK);
+  delete corrupt;
+  string data;
+  CHECK(readFile(mergeFilename(3).c_str(), data));
+  data[fio.getDataOffset()] = 0x7F;
+  CHECK(writeFile(mergeFilename(3).c_str(), data));
+  CHECK(mergeAnimation(0, 2, vd) == vvFileIO::DATA_ERROR);
+  CHECK(vd->frames == 3);
+  delete vd;
+
+  CHECK(writeMergeFiles(count));
+  remove(mergeFilename(3).c_str());
+  CHECK(mergeAnimation(0, 2, vd) == vvFileIO::OK);
+  CHECK(vd->frames == 3);
+  delete vd;
+  CHECK(mergeAnimation(int(count), 2, vd) == vvFileIO::FILE_NOT_FOUND);
+  CHECK(vd->frames == 3);
+  delete vd;
+
+  for (size_t i=0; i<count; ++i)
+    remove(mergeFilename(i).c_str());
+  return 0;
+}
+
+int main()
+{
+  CHECK(testDicomSeries() == 0);
+  CHECK(testSeriesErrors() == 0);
+  CHECK(testMergeFiles() == 0);
+  CHECK(testAVFParser() == 0);
+  CHECK(testXVFDelta() == 0);
+  CHECK(testXVFVersion() == 0);
+
+  cerr << "vvFileIO passed" << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
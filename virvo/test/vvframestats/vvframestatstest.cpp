@@ -0,0 +1,60 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <iostream>
+
+#include "vvframestats.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+// Adds more frames than the window holds and checks the percentiles of
+// the frames kept
+int main()
+{
+  virvo::FrameStats stats(100);
+  CHECK(stats.getNumFrames() == 0);
+  CHECK(stats.percentile(virvo::FrameStats::Total, 0.5) == 0.0);
+
+  for (int i=1; i<=200; ++i)
+  {
+    double times[virvo::FrameStats::NumStages] = { 0.0 };
+    times[virvo::FrameStats::Network] = 0.001;
+    times[virvo::FrameStats::Total] = double(i);
+    stats.add(times);
+  }
+
+  // frames 101..200 are left
+  CHECK(stats.getNumFrames() == 100);
+  CHECK(stats.percentile(virvo::FrameStats::Total, 0.0) == 101.0);
+  CHECK(stats.percentile(virvo::FrameStats::Total, 1.0) == 200.0);
+  CHECK(stats.percentile(virvo::FrameStats::Total, 0.5) == 150.0 || stats.percentile(virvo::FrameStats::Total, 0.5) == 151.0);
+  CHECK(stats.percentile(virvo::FrameStats::Total, 0.99) >= 199.0);
+  CHECK(stats.percentile(virvo::FrameStats::Network, 0.9) == 0.001);
+
+  stats.print(cerr);
+
+  stats.clear();
+  CHECK(stats.getNumFrames() == 0);
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,158 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <vector>
+
+#include "vvimage.h"
+#include "vvsocketio.h"
+#include "vvtcpserver.h"
+#include "vvtcpsocket.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+static const ushort Port = 31064;
+static const short Width = 300;
+static const short Height = 200;
+
+struct Frame
+{
+  vvTcpSocket* sock;
+  vvImage* image;
+};
+
+static void* sendImage(void* param)
+{
+  Frame* f = static_cast<Frame*>(param);
+  vvSocketIO(f->sock).putImage(f->image);
+  return NULL;
+}
+
+// Fill a rectangle with a pattern that depends on seed
+static void fill(vector<uchar>& pixels, int x0, int y0, int w, int h, unsigned seed)
+{
+  for (int y=y0; y<y0+h; ++y)
+    for (int x=x0; x<x0+w; ++x)
+      for (int c=0; c<4; ++c)
+        pixels[(y*Width + x)*4 + c] = uchar(((x/8 + y/8 + c) * 2654435761U + seed * 0x9e3779b9U) >> 24);
+}
+
+// Encodes a sequence of images with VV_TILES like vvImageServer, sends
+// them over a loopback connection and compares the decoded images and
+// their frame timing
+int main()
+{
+  vvTcpServer server(Port);
+  if (!server.initStatus())
+  {
+    cerr << "Cannot listen on port " << Port << endl;
+    return 1;
+  }
+
+  vvTcpSocket client;
+  CHECK(client.connectToHost("localhost", Port) == vvSocket::VV_OK);
+  vvTcpSocket* sock = server.nextConnection(5.0);
+  CHECK(sock != NULL);
+
+  const size_t rawSize = size_t(Width) * Height * 4;
+  vector<uchar> pixels(rawSize, 0);
+  vector<uchar> sent(rawSize, 0);
+  vector<uchar> reference(rawSize, 0);
+  bool hasReference = false;
+
+  vvImage image(Height, Width, &pixels[0]);
+  vvImage received;
+  vvSocketIO io(&client);
+
+  for (int frame=0; frame<6; ++frame)
+  {
+    switch (frame)
+    {
+    case 0: // small object
+      fill(pixels, 40, 30, 50, 40, 1);
+      break;
+    case 1: // part of the object changed
+      fill(pixels, 50, 35, 10, 10, 2);
+      break;
+    case 2: // nothing changed
+      break;
+    case 3: // object moved
+      fill(pixels, 40, 30, 50, 40, 0);
+      memset(&pixels[0], 0, rawSize);
+      fill(pixels, 200, 150, 100, 50, 3);
+      break;
+    case 4: // noise everywhere, cannot be compressed
+      for (size_t i=0; i<rawSize; ++i)
+        pixels[i] = uchar((i * 2654435761U) >> 13);
+      break;
+    case 5: // empty
+      memset(&pixels[0], 0, rawSize);
+      break;
+    }
+
+    sent = pixels;
+    image.setNewImagePtr(&pixels[0]);
+    image.setReferenceImage(hasReference ? &reference[0] : NULL);
+    image.setFrameId(frame);
+    image.setStageTime(vvImage::VV_RENDERED, 0.001f * float(frame + 1));
+    int size = image.encode(vvImage::VV_TILES);
+    CHECK(size >= 0);
+
+    Frame f = { sock, &image };
+    pthread_t thread;
+    pthread_create(&thread, NULL, sendImage, &f);
+    CHECK(io.getImage(&received) == vvSocket::VV_OK);
+    pthread_join(thread, NULL);
+    CHECK(received.decode() == 0);
+    CHECK(received.getWidth() == Width && received.getHeight() == Height);
+    CHECK(memcmp(received.getImagePtr(), &sent[0], rawSize) == 0);
+    CHECK(received.getFrameId() == frame);
+    CHECK(fabs(received.getStageTime(vvImage::VV_RENDERED) - 0.001f * float(frame + 1)) < 1e-5f);
+
+    switch (frame)
+    {
+    case 0:
+      CHECK(size_t(size) < rawSize / 20);
+      break;
+    case 1:
+    case 2:
+      CHECK(size_t(size) < rawSize / 100);
+      break;
+    case 4:
+      CHECK(image.getCodeType() == vvImage::VV_RAW);
+      break;
+    }
+    cerr << "frame " << frame << ": " << size << " bytes" << endl;
+
+    hasReference = image.getCodeType() == vvImage::VV_TILES;
+    if (hasReference)
+      reference = sent;
+  }
+
+  delete sock;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,114 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvclock.h"
+#include "vvmulticast.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <pthread.h>
+
+using namespace std;
+
+// Sends data to several receivers in this process via VV_RELIABLE
+// multicast over the loopback interface, with simulated packet loss
+
+static const int NumReceivers = 3;
+static const size_t DataSize = 4*1024*1024 + 123;
+static const char* Group = "224.1.2.4";
+static const ushort Port = 50097;
+
+struct Receiver
+{
+  vvMulticast* mc;
+  vector<uchar> data;
+  ssize_t result;
+};
+
+static void* receive(void* param)
+{
+  Receiver* r = static_cast<Receiver*>(param);
+  r->result = r->mc->read(&r->data[0], r->data.size(), 30.0);
+  return NULL;
+}
+
+static bool transfer(const vector<uchar>& data, double loss, size_t fecGroupSize, size_t numReceivers)
+{
+  cerr << "Loss " << loss << ", FEC group size " << fecGroupSize
+       << ", wait for " << numReceivers << " ACKs... ";
+
+  vvMulticast sender(vvMulticast::VV_SENDER, vvMulticast::VV_RELIABLE, Group, Port);
+  sender.setLossRate(loss);
+  sender.setFecGroupSize(fecGroupSize);
+  sender.setNumReceivers(numReceivers);
+
+  Receiver receivers[NumReceivers];
+  pthread_t threads[NumReceivers];
+  for (int i=0; i<NumReceivers; ++i)
+  {
+    receivers[i].mc = new vvMulticast(vvMulticast::VV_RECEIVER, vvMulticast::VV_RELIABLE, Group, Port);
+    receivers[i].mc->setLossRate(loss / 2.0);
+    receivers[i].data.assign(data.size(), 0);
+    receivers[i].result = -1;
+    pthread_create(&threads[i], NULL, receive, &receivers[i]);
+  }
+
+  const double start = vvClock::getTime();
+  const ssize_t written = sender.write(&data[0], data.size(), 30.0);
+  const double time = vvClock::getTime() - start;
+
+  bool ok = (written == ssize_t(data.size()));
+  for (int i=0; i<NumReceivers; ++i)
+  {
+    pthread_join(threads[i], NULL);
+    if (receivers[i].result != ssize_t(data.size()) || receivers[i].data != data)
+    {
+      ok = false;
+    }
+    delete receivers[i].mc;
+  }
+
+  if (ok)
+    cerr << "ok (" << time << " s)" << endl;
+  else
+    cerr << "failed" << endl;
+  return ok;
+}
+
+int main()
+{
+  vector<uchar> data(DataSize);
+  srand(123456);
+  for (size_t i=0; i<data.size(); ++i)
+  {
+    data[i] = uchar(rand() % 256);
+  }
+
+  bool ok = true;
+  ok &= transfer(data, 0.0, 0, NumReceivers);
+  ok &= transfer(data, 0.05, 0, NumReceivers);
+  ok &= transfer(data, 0.05, 8, NumReceivers);
+  ok &= transfer(data, 0.2, 4, 0);
+  return ok ? 0 : 1;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,85 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include <iostream>
+
+#include "vvimage.h"
+#include "vvremotequality.h"
+
+using namespace std;
+
+typedef virvo::RemoteQuality::Settings Settings;
+
+static const size_t Pixels = 1000 * 1000;
+
+// Simulates a renderer that takes 0.2s for a full viewport, so a target
+// of 0.05s can only be met with smaller images
+static Settings renderFrames(virvo::RemoteQuality& quality, bool moving, int frames)
+{
+  Settings s;
+  for (int i=0; i<frames; ++i)
+  {
+    s = quality.select(moving, Pixels);
+    const double px = double(Pixels) * s.scale * s.scale;
+    quality.update(px * 2e-7, 0.0, size_t(px * 4.0));
+    quality.sent();
+  }
+  return s;
+}
+
+int main()
+{
+  virvo::RemoteQuality quality;
+  quality.setPreferred(Settings(vvImage::VV_RAW, 1.0f, 0));
+  quality.setScalable(true);
+
+  // No target: always the preferred settings
+  Settings s = renderFrames(quality, true, 5);
+  if (s.scale != 1.0f || s.codec != vvImage::VV_RAW)
+  {
+    cerr << "Settings changed without a target frame time" << endl;
+    return 1;
+  }
+
+  quality.setTargetFrameTime(0.05);
+  s = renderFrames(quality, true, 10);
+  if (s.scale >= 1.0f)
+  {
+    cerr << "Image scale not reduced while moving" << endl;
+    return 1;
+  }
+  if (quality.predict(s, Pixels) > quality.getTargetFrameTime())
+  {
+    cerr << "Predicted frame time " << quality.predict(s, Pixels) << "s exceeds the target" << endl;
+    return 1;
+  }
+
+  // Preferred settings again when the view stops changing
+  s = renderFrames(quality, false, 1);
+  if (s.scale != 1.0f)
+  {
+    cerr << "Image scale not restored: " << s.scale << endl;
+    return 1;
+  }
+
+  cerr << "Image scale while moving adapted to the target frame time" << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,164 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <iostream>
+
+#include "vvrenderer.h"
+#include "vvremoteserver.h"
+#include "vvsocketio.h"
+#include "vvtcpserver.h"
+#include "vvtcpsocket.h"
+#include "vvvoldesc.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+static const ushort Port = 31063;
+
+// Records the frame requests instead of rendering them
+class TestServer : public vvRemoteServer
+{
+public:
+  int numRendered;
+  int numRepeated;
+  size_t frame;
+  float quality;
+
+  TestServer(vvSocket* socket)
+    : vvRemoteServer(socket)
+    , numRendered(0)
+    , numRepeated(0)
+    , frame(0)
+    , quality(0.0f)
+  {
+  }
+
+private:
+  void renderImage(const vvMatrix&, const vvMatrix&, vvRenderer* renderer)
+  {
+    ++numRendered;
+    frame = renderer->getCurrentFrame();
+    quality = renderer->getParameter(vvRenderState::VV_QUALITY);
+  }
+
+  void repeatImage(const vvMatrix&, const vvMatrix&, vvRenderer*)
+  {
+    ++numRepeated;
+  }
+};
+
+static void putQuality(const vvSocketIO& io, float quality)
+{
+  io.putEvent(virvo::Parameter1F);
+  io.putInt32(vvRenderState::VV_QUALITY);
+  io.putFloat(quality);
+}
+
+static void putFrame(const vvSocketIO& io, int frame)
+{
+  io.putEvent(virvo::CurrentFrame);
+  io.putInt32(frame);
+}
+
+static void putCamera(const vvSocketIO& io)
+{
+  vvMatrix m;
+  m.identity();
+  io.putEvent(virvo::CameraMatrix);
+  io.putMatrix(&m);
+  io.putMatrix(&m);
+}
+
+// Handles the events like vserver: as long as more are waiting
+static int drain(const vvSocketIO& io, TestServer& server, vvRenderer* renderer)
+{
+  int count = 0;
+  do
+  {
+    virvo::RemoteEvent event;
+    if (io.getEvent(event) != vvSocket::VV_OK)
+      return -1;
+    server.processEvent(event, renderer);
+    ++count;
+  }
+  while (io.hasPendingData());
+  return count;
+}
+
+// Sends bursts of events over a loopback connection and checks that the
+// server renders once per burst with the latest state
+int main()
+{
+  vvTcpServer tcpServer(Port);
+  if (!tcpServer.initStatus())
+  {
+    cerr << "Cannot listen on port " << Port << endl;
+    return 1;
+  }
+
+  vvTcpSocket client;
+  CHECK(client.connectToHost("localhost", Port) == vvSocket::VV_OK);
+  vvTcpSocket* sock = tcpServer.nextConnection(5.0);
+  CHECK(sock != NULL);
+
+  vvVolDesc vd("events", 2, 2, 2, 3, 1, 1, NULL);
+  for (size_t f=0; f<vd.frames; ++f)
+    vd.addFrame(new uint8_t[vd.getFrameBytes()](), vvVolDesc::ARRAY_DELETE);
+  vvRenderer renderer(&vd, vvRenderState());
+
+  vvSocketIO clientIO(&client);
+  vvSocketIO serverIO(sock);
+  TestServer server(sock);
+
+  // one request is answered right away
+  putQuality(clientIO, 0.5f);
+  putCamera(clientIO);
+  CHECK(drain(serverIO, server, &renderer) == 2);
+  CHECK(server.numRendered == 1);
+  CHECK(server.quality == 0.5f);
+
+  // a burst is rendered once, with the latest state
+  for (int i=1; i<=5; ++i)
+    putQuality(clientIO, float(i));
+  putFrame(clientIO, 1);
+  putCamera(clientIO);
+  putCamera(clientIO);
+  putFrame(clientIO, 2);
+  putCamera(clientIO);
+  CHECK(drain(serverIO, server, &renderer) == 10);
+  CHECK(server.numRendered == 2);
+  CHECK(server.numRepeated == 2);
+  CHECK(server.frame == 2);
+  CHECK(server.quality == 5.0f);
+
+  // updates without a request are applied when the burst ends
+  putQuality(clientIO, 2.0f);
+  putFrame(clientIO, 0);
+  CHECK(drain(serverIO, server, &renderer) == 2);
+  CHECK(renderer.getCurrentFrame() == 0);
+  CHECK(server.numRendered == 2);
+
+  delete sock;
+  cerr << server.numRendered << " frames rendered, " << server.numRepeated << " repeated" << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,198 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <cstdio>
+#include <iostream>
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include "private/vvshmchannel.h"
+#include "vvsocketio.h"
+#include "vvsocketmonitor.h"
+#include "vvtcpserver.h"
+#include "vvtcpsocket.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+static const ushort Port = 31065;
+
+// larger than the ring buffers, so both sides have to wait for space
+static const size_t LargeSize = 40 * 1024 * 1024;
+
+static vector<unsigned char> makeData(size_t size)
+{
+  vector<unsigned char> data(size);
+  for (size_t i=0; i<size; ++i)
+    data[i] = (unsigned char)(i * 7 + i / 251);
+  return data;
+}
+
+static int runClient(vvTcpSocket* sock)
+{
+  vvSocketIO io(sock);
+
+  CHECK(io.requestSharedMemory() == vvSocket::VV_OK);
+  CHECK(sock->getChannel() != NULL);
+
+  CHECK(io.putStdVector(makeData(LargeSize)) == vvSocket::VV_OK);
+  CHECK(io.putInt32(7) == vvSocket::VV_OK);
+
+  vector<unsigned char> data;
+  CHECK(io.getStdVector(data) == vvSocket::VV_OK);
+  CHECK(data == makeData(LargeSize / 2));
+
+  // the server waits on its socket monitor for this one
+  usleep(200 * 1000);
+  CHECK(io.putInt32(99) == vvSocket::VV_OK);
+
+  sock->disconnectFromHost();
+  return 0;
+}
+
+static void* client(void* param)
+{
+  static int result = runClient(static_cast<vvTcpSocket*>(param));
+  return &result;
+}
+
+#ifdef __linux__
+// attach() opens handles named by the peer, it must not block on a FIFO or
+// map files that are not a segment of the announced size
+static int testAttachChecks()
+{
+  const char* fifo = "vvshmchannel.fifo";
+  unlink(fifo);
+  CHECK(mkfifo(fifo, 0600) == 0);
+  int handle = open(fifo, O_RDONLY | O_NONBLOCK);
+  CHECK(handle >= 0);
+  CHECK(virvo::ShmChannel::attach(-1, int(getpid()), handle, 0, virvo::ShmChannel::DefaultRingSize) == NULL);
+  close(handle);
+  unlink(fifo);
+
+  const char* file = "vvshmchannel.tmp";
+  FILE* fp = fopen(file, "wb");
+  CHECK(fp != NULL);
+  fputs("not a segment", fp);
+  fclose(fp);
+  handle = open(file, O_RDWR);
+  CHECK(handle >= 0);
+  CHECK(virvo::ShmChannel::attach(-1, int(getpid()), handle, 0, virvo::ShmChannel::DefaultRingSize) == NULL);
+  close(handle);
+  unlink(file);
+
+  // a real segment with the wrong ring size or cookie
+  virvo::ShmChannel* channel = virvo::ShmChannel::create(-1, 4096);
+  CHECK(channel != NULL && channel->getRingSize() == 4096);
+  CHECK(virvo::ShmChannel::attach(-1, channel->getPid(), channel->getHandle(), channel->getCookie(), 8192) == NULL);
+  CHECK(virvo::ShmChannel::attach(-1, channel->getPid(), channel->getHandle(), channel->getCookie(), 4000) == NULL);
+  CHECK(virvo::ShmChannel::attach(-1, channel->getPid(), channel->getHandle(), channel->getCookie() + 1, 4096) == NULL);
+  virvo::ShmChannel* peer = virvo::ShmChannel::attach(-1, channel->getPid(), channel->getHandle(), channel->getCookie(), 4096);
+  CHECK(peer != NULL);
+  delete peer;
+  delete channel;
+  return 0;
+}
+#endif
+
+// Switches a loopback connection to shared memory, sends payloads larger
+// than the ring buffers in both directions, and checks that socket monitors
+// and peer shutdown still work
+int main()
+{
+#ifndef __linux__
+  cerr << "Shared memory is only available on Linux, skipped" << endl;
+  return 0;
+#else
+  CHECK(testAttachChecks() == 0);
+#endif
+
+  vvTcpServer server(Port);
+  if (!server.initStatus())
+  {
+    cerr << "Cannot listen on port " << Port << endl;
+    return 1;
+  }
+
+  vvTcpSocket clientSock;
+  if (clientSock.connectToHost("localhost", Port) != vvSocket::VV_OK)
+  {
+    cerr << "Cannot connect" << endl;
+    return 1;
+  }
+
+  vvTcpSocket* sock = server.nextConnection(5.0);
+  if (sock == NULL)
+  {
+    cerr << "No incoming connection" << endl;
+    return 1;
+  }
+  CHECK(sock->isLocalPeer());
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, client, &clientSock);
+
+  vvSocketIO io(sock);
+
+  virvo::RemoteEvent event;
+  CHECK(io.getEvent(event) == vvSocket::VV_OK && event == virvo::SharedMemory);
+  CHECK(io.acceptSharedMemory() == vvSocket::VV_OK);
+  CHECK(sock->getChannel() != NULL);
+
+  vector<unsigned char> data;
+  CHECK(io.getStdVector(data) == vvSocket::VV_OK);
+  CHECK(data == makeData(LargeSize));
+
+  int i = 0;
+  CHECK(io.getInt32(i) == vvSocket::VV_OK && i == 7);
+
+  CHECK(io.putStdVector(makeData(LargeSize / 2)) == vvSocket::VV_OK);
+  CHECK(!io.hasPendingData());
+
+  vvSocketMonitor monitor;
+  monitor.add(sock, vvSocketMonitor::VV_READABLE);
+  vector<vvSocketMonitor::Event> events;
+  double timeout = 5.0;
+  CHECK(monitor.wait(events, &timeout) == vvSocketMonitor::VV_OK && events.size() == 1);
+  CHECK(io.hasPendingData());
+  CHECK(io.getInt32(i) == vvSocket::VV_OK && i == 99);
+  monitor.remove(sock);
+
+  CHECK(io.getInt32(i) == vvSocket::VV_PEER_SHUTDOWN);
+
+  void* result = NULL;
+  pthread_join(thread, &result);
+  delete sock;
+
+  if (*static_cast<int*>(result) != 0)
+    return 1;
+
+  cerr << "Shared memory transport works" << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,182 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "vvclock.h"
+#include "vvslicer.h"
+#include "vvvoldesc.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+// voxel (x,y,z) is x+y+z, which trilinear interpolation reproduces exactly
+static vvVolDesc* makeVolume(size_t bpc, size_t w, size_t h, size_t s)
+{
+  vvVolDesc* vd = new vvVolDesc("vvslicertest.xvf", w, h, s, 1, bpc, 1, NULL);
+  uint8_t* raw = new uint8_t[vd->getFrameBytes()];
+  vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+  for (size_t z=0; z<s; ++z)
+    for (size_t y=0; y<h; ++y)
+      for (size_t x=0; x<w; ++x)
+      {
+        uint8_t* voxel = &raw[((z * h + y) * w + x) * bpc];
+        const size_t value = (x + y + z) % 256;
+        if (bpc == 1)
+          voxel[0] = uint8_t(value);
+        else if (bpc == 2)
+        {
+          voxel[0] = uint8_t(value >> 8);
+          voxel[1] = uint8_t(value);
+        }
+        else
+          *reinterpret_cast<float*>(voxel) = float(value);
+      }
+  return vd;
+}
+
+static int testBpc(size_t bpc)
+{
+  vvVolDesc* vd = makeVolume(bpc, 33, 20, 9);
+  virvo::Slicer slicer;
+
+  // output = data value
+  slicer.setWindow(127.5f, 255.0f);
+
+  // axis aligned slices
+  vector<uint8_t> img(33 * 20);
+  slicer.sample(vd, 0, 0, virvo::Slicer::axisPlane(vd, vvVecmath::Z_AXIS, 4), 33, 20, &img[0]);
+  for (size_t j=0; j<20; ++j)
+    for (size_t i=0; i<33; ++i)
+      CHECK(img[j * 33 + i] == i + j + 4);
+
+  if (bpc == 1)
+  {
+    // same orientation as vvVolDesc::extractSliceData()
+    for (int axis=0; axis<3; ++axis)
+    {
+      size_t width, height, slices;
+      vd->getVolumeSize(vvVecmath::AxisType(axis), width, height, slices);
+      vector<uint8_t> ref(width * height);
+      vector<uint8_t> out(width * height);
+      vd->extractSliceData(0, vvVecmath::AxisType(axis), 2, &ref[0]);
+      slicer.sample(vd, 0, 0, virvo::Slicer::axisPlane(vd, vvVecmath::AxisType(axis), 2), width, height, &out[0]);
+      CHECK(out == ref);
+    }
+  }
+
+  // oblique plane, partly outside of the volume
+  virvo::Slicer::Plane plane;
+  plane.origin = vvVector3(1.0f, 1.0f, 1.0f);
+  plane.u = vvVector3(0.6f, 0.3f, 0.0f);
+  plane.v = vvVector3(0.0f, 0.2f, 0.5f);
+  vector<uint8_t> oblique(64 * 32);
+  slicer.sample(vd, 0, 0, plane, 64, 32, &oblique[0]);
+  for (size_t j=0; j<32; ++j)
+    for (size_t i=0; i<64; ++i)
+    {
+      float x = 1.0f + 0.6f * i;
+      float y = 1.0f + 0.3f * i + 0.2f * j;
+      float z = 1.0f + 0.5f * j;
+      int v = oblique[j * 64 + i];
+      if (x > 32.0f || y > 19.0f || z > 8.0f)
+      {
+        CHECK(v == 0);
+      }
+      else
+      {
+        CHECK(abs(v - int(x + y + z + 0.5f)) <= 1);
+      }
+    }
+
+  // thick slabs along z
+  slicer.setSlab(virvo::Slicer::MaxIntensity, 3);
+  slicer.sample(vd, 0, 0, virvo::Slicer::axisPlane(vd, vvVecmath::Z_AXIS, 4), 33, 20, &img[0]);
+  CHECK(img[5 * 33 + 7] == 7 + 5 + 5);
+  slicer.setSlab(virvo::Slicer::Average, 3);
+  slicer.sample(vd, 0, 0, virvo::Slicer::axisPlane(vd, vvVecmath::Z_AXIS, 4), 33, 20, &img[0]);
+  CHECK(img[5 * 33 + 7] == 7 + 5 + 4);
+
+  // window/level
+  slicer.setSlab(virvo::Slicer::Single, 1);
+  slicer.setWindow(20.0f, 10.0f);
+  slicer.sample(vd, 0, 0, virvo::Slicer::axisPlane(vd, vvVecmath::Z_AXIS, 0), 33, 20, &img[0]);
+  CHECK(img[0] == 0);
+  CHECK(img[20] == 128);
+  CHECK(img[30] == 255);
+
+  // a gray color table gives 3 equal channels
+  std::vector<uint8_t> gray(256 * 3);
+  for (size_t i=0; i<gray.size(); ++i)
+    gray[i] = uint8_t(i / 3);
+  slicer.setColors(gray);
+  CHECK(slicer.getBytesPerPixel() == 3);
+  vector<uint8_t> rgb(33 * 20 * 3);
+  slicer.sample(vd, 0, 0, virvo::Slicer::axisPlane(vd, vvVecmath::Z_AXIS, 0), 33, 20, &rgb[0]);
+  for (size_t i=0; i<img.size(); ++i)
+    CHECK(rgb[i * 3] == img[i] && rgb[i * 3 + 1] == img[i] && rgb[i * 3 + 2] == img[i]);
+
+  delete vd;
+  return 0;
+}
+
+// Samples axis aligned, oblique and slab planes through a linear ramp and
+// compares with the expected values for 1, 2 and 4 byte voxels. Then checks
+// that threads do not change the result and times a large oblique slice.
+int main()
+{
+  CHECK(testBpc(1) == 0);
+  CHECK(testBpc(2) == 0);
+  CHECK(testBpc(4) == 0);
+
+  vvVolDesc* vd = makeVolume(2, 256, 256, 256);
+  virvo::Slicer::Plane plane;
+  plane.origin = vvVector3(0.0f, 20.0f, 10.0f);
+  plane.u = vvVector3(0.1f, 0.02f, 0.05f);
+  plane.v = vvVector3(-0.02f, 0.1f, 0.03f);
+
+  const size_t size = 2048;
+  vector<uint8_t> single(size * size);
+  vector<uint8_t> parallel(size * size);
+
+  virvo::Slicer slicer1(1);
+  slicer1.setWindow(vd, 0.0f, 0.01f);
+  double t0 = vvClock::getTime();
+  slicer1.sample(vd, 0, 0, plane, size, size, &single[0]);
+  double t1 = vvClock::getTime();
+
+  virvo::Slicer slicer;
+  slicer.setWindow(vd, 0.0f, 0.01f);
+  slicer.sample(vd, 0, 0, plane, size, size, &parallel[0]);
+  double t2 = vvClock::getTime();
+
+  CHECK(single == parallel);
+
+  cerr << "2048^2 oblique slice: " << (t1 - t0) * 1000.0 << " ms on one thread, "
+       << (t2 - t1) * 1000.0 << " ms on all threads" << endl;
+
+  delete vd;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,158 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <iostream>
+#include <pthread.h>
+#include <vector>
+
+#include "vvsocketio.h"
+#include "vvtcpserver.h"
+#include "vvtcpsocket.h"
+#include "vvtoolshed.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+static const ushort Port = 31061;
+static const size_t LargeSize = 10 * 1024 * 1024;
+
+static vvMatrix makeMatrix(float offset)
+{
+  vvMatrix m;
+  for (int i=0; i<4; ++i)
+    for (int j=0; j<4; ++j)
+      m(i, j) = offset + float(i * 4 + j);
+  return m;
+}
+
+static vector<unsigned char> makeData(size_t size)
+{
+  vector<unsigned char> data(size);
+  for (size_t i=0; i<size; ++i)
+    data[i] = (unsigned char)(i * 7 + i / 251);
+  return data;
+}
+
+static void* sender(void* param)
+{
+  vvSocketIO io(static_cast<vvTcpSocket*>(param));
+  vvMatrix pr = makeMatrix(0.0f);
+  vvMatrix mv = makeMatrix(100.0f);
+
+  // a frame request: one message, one frame
+  io.beginMessage();
+  io.putEvent(virvo::CameraMatrix);
+  io.putMatrix(&pr);
+  io.putMatrix(&mv);
+  io.endMessage();
+
+  // single puts, each in its own frame
+  io.putInt32(42);
+  io.putFloat(0.5f);
+
+  // small puts around a large payload, nested messages
+  io.beginMessage();
+  io.putBool(true);
+  io.beginMessage();
+  io.putStdVector(makeData(LargeSize));
+  io.endMessage();
+  io.putVector3(vvVector3(1.0f, 2.0f, 3.0f));
+  io.putFileName("volume.rvf");
+  io.endMessage();
+
+  return NULL;
+}
+
+// Sends messages over a loopback connection and checks their framing
+// and contents
+int main()
+{
+  vvTcpServer server(Port);
+  if (!server.initStatus())
+  {
+    cerr << "Cannot listen on port " << Port << endl;
+    return 1;
+  }
+
+  vvTcpSocket client;
+  if (client.connectToHost("localhost", Port) != vvSocket::VV_OK)
+  {
+    cerr << "Cannot connect" << endl;
+    return 1;
+  }
+
+  vvTcpSocket* sock = server.nextConnection(5.0);
+  if (sock == NULL)
+  {
+    cerr << "No incoming connection" << endl;
+    return 1;
+  }
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, sender, &client);
+
+  // the frame request arrives as a single frame:
+  // event + 2 * (size + 16 floats)
+  uchar header[4];
+  CHECK(sock->readData(header, 4) == vvSocket::VV_OK);
+  CHECK(vvToolshed::read32(header) == 4 + 2 * (4 + 64));
+
+  std::vector<uchar> frame(4 + 2 * (4 + 64));
+  CHECK(sock->readData(&frame[0], frame.size()) == vvSocket::VV_OK);
+  CHECK(int(vvToolshed::read32(&frame[0])) == int(virvo::CameraMatrix));
+
+  vvSocketIO io(sock);
+
+  int i = 0;
+  CHECK(io.getInt32(i) == vvSocket::VV_OK && i == 42);
+
+  float f = 0.0f;
+  CHECK(io.getFloat(f) == vvSocket::VV_OK && f == 0.5f);
+
+  bool b = false;
+  CHECK(io.getBool(b) == vvSocket::VV_OK && b);
+
+  std::vector<unsigned char> data;
+  CHECK(io.getStdVector(data) == vvSocket::VV_OK);
+  CHECK(data == makeData(LargeSize));
+
+  vvVector3 v;
+  CHECK(io.getVector3(v) == vvSocket::VV_OK && v == vvVector3(1.0f, 2.0f, 3.0f));
+
+  std::string fn;
+  CHECK(io.getFileName(fn) == vvSocket::VV_OK && fn == "volume.rvf");
+  CHECK(!io.hasBufferedData());
+
+  pthread_join(thread, NULL);
+
+  // a read that gets part of its data and then nothing more gives up
+  const uchar partial[3] = { 1, 2, 3 };
+  CHECK(client.writeData(partial, sizeof(partial)) == vvSocket::VV_OK);
+  CHECK(sock->setParameter(vvSocket::VV_RECV_TIMEOUT, 0.2f) == vvSocket::VV_OK);
+  uchar buffer[8];
+  CHECK(sock->readData(buffer, sizeof(buffer)) == vvSocket::VV_READ_ERROR);
+  delete sock;
+
+  cerr << "All messages received" << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
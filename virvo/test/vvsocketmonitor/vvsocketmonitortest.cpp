@@ -0,0 +1,192 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <iostream>
+#include <vector>
+
+#include "vvpthread.h"
+#include "vvsocketmonitor.h"
+#include "vvtcpserver.h"
+#include "vvtcpsocket.h"
+#include "vvworkerpool.h"
+
+using namespace std;
+
+static const ushort Port = 31060;
+static const int NumClients = 200;
+static const int NumRounds = 10;
+
+struct Connection
+{
+  vvSocketMonitor* monitor;
+  vvTcpSocket* sock;
+  virvo::Mutex* mutex;
+  int* received;
+};
+
+// Echo one byte back to the client and re-arm the connection
+static void echo(void* param)
+{
+  Connection* conn = static_cast<Connection*>(param);
+
+  uchar c;
+  if (conn->sock->readData(&c, 1) != vvSocket::VV_OK
+   || conn->sock->writeData(&c, 1) != vvSocket::VV_OK)
+  {
+    return;
+  }
+
+  {
+    virvo::ScopedLock lock(conn->mutex);
+    ++*conn->received;
+  }
+
+  conn->monitor->modify(conn->sock, vvSocketMonitor::VV_READABLE | vvSocketMonitor::VV_ONESHOT, conn);
+}
+
+// Connects many clients to a server that handles all of them with one
+// monitor and a small worker pool
+int main()
+{
+  vvTcpServer server(Port);
+  if (!server.initStatus())
+  {
+    cerr << "Cannot listen on port " << Port << endl;
+    return 1;
+  }
+
+  vvSocketMonitor monitor;
+  monitor.add(server.getSocket(), vvSocketMonitor::VV_READABLE);
+
+  virvo::Mutex mutex;
+  int received = 0;
+
+  vector<vvTcpSocket*> clients;
+  vector<Connection*> connections;
+
+  for (int i=0; i<NumClients; ++i)
+  {
+    vvTcpSocket* client = new vvTcpSocket;
+    if (client->connectToHost("localhost", Port) != vvSocket::VV_OK)
+    {
+      cerr << "Cannot connect client " << i << endl;
+      return 1;
+    }
+    clients.push_back(client);
+  }
+
+  // accept all clients
+  vector<vvSocketMonitor::Event> events;
+  while (int(connections.size()) < NumClients)
+  {
+    double timeout = 5.0;
+    if (monitor.wait(events, &timeout) != vvSocketMonitor::VV_OK)
+    {
+      cerr << "No incoming connections" << endl;
+      return 1;
+    }
+
+    vvTcpSocket* sock = NULL;
+    while ((sock = server.acceptConnection()) != NULL)
+    {
+      Connection* conn = new Connection;
+      conn->monitor = &monitor;
+      conn->sock = sock;
+      conn->mutex = &mutex;
+      conn->received = &received;
+      connections.push_back(conn);
+      monitor.add(sock, vvSocketMonitor::VV_READABLE | vvSocketMonitor::VV_ONESHOT, conn);
+    }
+  }
+
+  {
+    virvo::WorkerPool workers(4, "echo");
+
+    for (int round=0; round<NumRounds; ++round)
+    {
+      for (int i=0; i<NumClients; ++i)
+      {
+        uchar c = uchar(i);
+        clients[i]->writeData(&c, 1);
+      }
+
+      // dispatch until every message was handled
+      for (;;)
+      {
+        {
+          virvo::ScopedLock lock(&mutex);
+          if (received == NumClients * (round + 1))
+            break;
+        }
+
+        double timeout = vvSocketMonitor::concurrentUpdates() ? 5.0 : 0.01;
+        vvSocketMonitor::ErrorType err = monitor.wait(events, &timeout);
+        if (err == vvSocketMonitor::VV_ERROR)
+        {
+          cerr << "Waiting for events failed" << endl;
+          return 1;
+        }
+        else if (err == vvSocketMonitor::VV_TIMEOUT && vvSocketMonitor::concurrentUpdates())
+        {
+          cerr << "Timeout in round " << round << endl;
+          return 1;
+        }
+
+        for (size_t e=0; e<events.size(); ++e)
+        {
+          if (events[e].userData != NULL)
+            workers.submit(echo, events[e].userData);
+        }
+
+        workers.wait();
+      }
+
+      for (int i=0; i<NumClients; ++i)
+      {
+        uchar c = 0;
+        clients[i]->readData(&c, 1);
+        if (c != uchar(i))
+        {
+          cerr << "Wrong echo for client " << i << endl;
+          return 1;
+        }
+      }
+    }
+  }
+
+  if (received != NumClients * NumRounds)
+  {
+    cerr << "Wrong number of messages: " << received << endl;
+    return 1;
+  }
+
+  for (int i=0; i<NumClients; ++i)
+  {
+    monitor.remove(connections[i]->sock);
+    delete connections[i]->sock;
+    delete connections[i];
+    delete clients[i];
+  }
+
+  cerr << NumClients << " clients, " << received << " messages" << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,32 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef VV_TESTCHECK_H
+#define VV_TESTCHECK_H
+
+#include <iostream>
+
+// Prints the failed condition and returns 1 from the calling function.
+// Test helpers return 0 on success, so that callers can CHECK(helper() == 0).
+#define CHECK(x) \
+  do { if (!(x)) { std::cerr << "Check failed: " #x << std::endl; return 1; } } while (0)
+
+#endif
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,83 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include <iostream>
+#include <pthread.h>
+
+#include "vvtrace.h"
+
+using namespace std;
+
+static const int NumThreads = 4;
+static const int NumZones = 1000;
+
+static void* worker(void*)
+{
+  virvo::trace::setThreadName("worker");
+
+  for (int i=0; i<NumZones; ++i)
+  {
+    VV_TRACE_ZONE("zone");
+    virvo::trace::samplesTaken.add(1);
+  }
+
+  return NULL;
+}
+
+static void runWorkers()
+{
+  pthread_t threads[NumThreads];
+  for (int i=0; i<NumThreads; ++i)
+    pthread_create(&threads[i], NULL, worker, NULL);
+  for (int i=0; i<NumThreads; ++i)
+    pthread_join(threads[i], NULL);
+}
+
+// Records zones and counters on several threads and writes the trace
+// to the file given on the command line (default: vvtrace.json)
+int main(int argc, char** argv)
+{
+  const char* filename = (argc > 1) ? argv[1] : "vvtrace.json";
+
+  // Disabled: nothing is recorded
+  virvo::trace::setEnabled(false);
+  runWorkers();
+  if (virvo::trace::samplesTaken.value() != 0)
+  {
+    cerr << "Counter changed while tracing was disabled" << endl;
+    return 1;
+  }
+
+  virvo::trace::setEnabled(true);
+  runWorkers();
+  if (virvo::trace::samplesTaken.value() != NumThreads * NumZones)
+  {
+    cerr << "Wrong counter value: " << virvo::trace::samplesTaken.value() << endl;
+    return 1;
+  }
+  virvo::trace::sampleCounters();
+
+  if (!virvo::trace::dump(filename))
+    return 1;
+
+  cerr << "Trace written to " << filename << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
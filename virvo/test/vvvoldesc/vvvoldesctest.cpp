@@ -0,0 +1,292 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <set>
+
+#include "vvfileio.h"
+#include "vvvoldesc.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+// 2 frames with odd sizes, voxel (x,y,z) of frame f is x+y+z+f
+static vvVolDesc* makeVolume(size_t bpc)
+{
+  vvVolDesc* vd = new vvVolDesc("vvvoldesctest.xvf", 33, 20, 9, 2, bpc, 1, NULL);
+  for (size_t f=0; f<vd->frames; ++f)
+  {
+    uint8_t* raw = new uint8_t[vd->getFrameBytes()];
+    vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+    for (size_t z=0; z<vd->vox[2]; ++z)
+      for (size_t y=0; y<vd->vox[1]; ++y)
+        for (size_t x=0; x<vd->vox[0]; ++x)
+        {
+          uint8_t* voxel = &raw[((z * vd->vox[1] + y) * vd->vox[0] + x) * bpc];
+          const size_t value = x + y + z + f;
+          if (bpc == 1)
+            voxel[0] = uint8_t(value);
+          else if (bpc == 2)
+          {
+            voxel[0] = uint8_t(value >> 8);
+            voxel[1] = uint8_t(value);
+          }
+          else
+            *reinterpret_cast<float*>(voxel) = float(value);
+        }
+  }
+  return vd;
+}
+
+// Voxel (x,y,z) of a level is the average over the voxels of the volume it
+// covers, clamped at the borders
+static float expected(const vvVolDesc* vd, size_t level, size_t x, size_t y, size_t z, size_t f)
+{
+  const size_t n = size_t(1) << level;
+  const size_t pos[3] = { x, y, z };
+  float sum = 0.0f;
+  for (size_t i=0; i<3; ++i)
+  {
+    float axis = 0.0f;
+    for (size_t j=0; j<n; ++j)
+    {
+      // clamping happens per level
+      size_t p = pos[i];
+      for (size_t l=level; l>0; --l)
+      {
+        const size_t bit = (j >> (l - 1)) & 1;
+        p = std::min(2 * p + bit, vd->getLevelSize(l - 1)[i] - 1);
+      }
+      axis += float(p);
+    }
+    sum += axis / float(n);
+  }
+  return sum + float(f);
+}
+
+static bool checkLevels(const vvVolDesc* vd, float tolerance)
+{
+  for (size_t l=1; l<vd->getNumLevels(); ++l)
+  {
+    const vvsize3 size = vd->getLevelSize(l);
+    for (size_t f=0; f<vd->frames; ++f)
+    {
+      const uint8_t* raw = vd->getLevelRaw(l, int(f));
+      if (raw == NULL)
+        return false;
+      for (size_t z=0; z<size[2]; ++z)
+        for (size_t y=0; y<size[1]; ++y)
+          for (size_t x=0; x<size[0]; ++x)
+          {
+            const uint8_t* voxel = &raw[((z * size[1] + y) * size[0] + x) * vd->bpc];
+            float value;
+            if (vd->bpc == 1)
+              value = voxel[0];
+            else if (vd->bpc == 2)
+              value = float(voxel[0] * 256 + voxel[1]);
+            else
+              value = *reinterpret_cast<const float*>(voxel);
+            if (fabsf(value - expected(vd, l, x, y, z, f)) > tolerance)
+            {
+              cerr << "Level " << l << " frame " << f << " voxel " << x << " " << y << " " << z
+                   << ": " << value << " instead of " << expected(vd, l, x, y, z, f) << endl;
+              return false;
+            }
+          }
+    }
+  }
+  return true;
+}
+
+static float voxelValue(const vvVolDesc* vd, size_t f, size_t i)
+{
+  const uint8_t* voxel = vd->getRaw(f) + i * vd->bpc;
+  if (vd->bpc == 1)
+    return voxel[0];
+  else if (vd->bpc == 2)
+    return float(voxel[0] * 256 + voxel[1]);
+  else
+    return *reinterpret_cast<const float*>(voxel);
+}
+
+// Compares the statistics with values computed voxel by voxel
+static bool checkStatistics(vvVolDesc* vd)
+{
+  const size_t brickSize = vvVolDesc::Statistics::BrickSize;
+  for (size_t f=0; f<vd->frames; ++f)
+  {
+    const vvVolDesc::Statistics& s = vd->getStatistics(f);
+    float min = FLT_MAX;
+    float max = -FLT_MAX;
+    double sum = 0.0;
+    std::vector<float> brickMin(s.brickMin.size(), FLT_MAX);
+    std::vector<float> brickMax(s.brickMax.size(), -FLT_MAX);
+    for (size_t z=0; z<vd->vox[2]; ++z)
+      for (size_t y=0; y<vd->vox[1]; ++y)
+        for (size_t x=0; x<vd->vox[0]; ++x)
+        {
+          const float value = voxelValue(vd, f, (z * vd->vox[1] + y) * vd->vox[0] + x);
+          const size_t b = ((z / brickSize) * s.bricks[1] + y / brickSize) * s.bricks[0] + x / brickSize;
+          min = std::min(min, value);
+          max = std::max(max, value);
+          sum += value;
+          brickMin[b] = std::min(brickMin[b], value);
+          brickMax[b] = std::max(brickMax[b], value);
+          if (vd->bpc != 4 && s.histogram[size_t(value)] == 0)
+          {
+            cerr << "Value " << value << " missing in histogram of frame " << f << endl;
+            return false;
+          }
+        }
+    const float mean = float(sum / double(vd->getFrameVoxels()));
+    if (s.min != min || s.max != max || fabsf(s.mean - mean) > 1e-4f || s.getNumVoxels() != vd->getFrameVoxels()
+     || brickMin != s.brickMin || brickMax != s.brickMax)
+    {
+      cerr << "Wrong statistics of frame " << f << ": " << s.min << " " << s.max << " " << s.mean
+           << " instead of " << min << " " << max << " " << mean << endl;
+      return false;
+    }
+    if (s.getPercentile(0.0f) != min || s.getPercentile(1.0f) != max
+     || s.getPercentile(0.5f) < min || s.getPercentile(0.5f) > max)
+    {
+      cerr << "Wrong percentiles of frame " << f << endl;
+      return false;
+    }
+  }
+
+  if (vd->bpc != 4)
+  {
+    // histograms and value counts are derived from the statistics
+    int buckets[1] = { 32 };
+    int count[32];
+    int expected[32] = { 0 };
+    std::set<float> used;
+    for (size_t f=0; f<vd->frames; ++f)
+      for (size_t i=0; i<vd->getFrameVoxels(); ++i)
+      {
+        const float value = voxelValue(vd, f, i);
+        ++expected[std::min(int(value / (vd->getValueRange() / 32.0f)), 31)];
+        used.insert(value);
+      }
+    vd->makeHistogram(-1, 0, 1, buckets, count, vd->real[0], vd->real[1]);
+    if (memcmp(count, expected, sizeof(count)) != 0 || vd->findNumUsed(0) != int(used.size()))
+    {
+      cerr << "Wrong histogram" << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool equalStatistics(const vvVolDesc::Statistics& a, const vvVolDesc::Statistics& b)
+{
+  return a.min == b.min && a.max == b.max && a.mean == b.mean && a.variance == b.variance
+      && a.histogram == b.histogram && a.brickMin == b.brickMin && a.brickMax == b.brickMax;
+}
+
+// Builds levels of detail and statistics for all data types and stores
+// them in XVF files
+int main()
+{
+  const size_t bpcs[3] = { 1, 2, 4 };
+  for (size_t i=0; i<3; ++i)
+  {
+    vvVolDesc* vd = makeVolume(bpcs[i]);
+    CHECK(vd->getNumLevels() == 1);
+    CHECK(vd->getLevelRaw(0) == vd->getRaw());
+
+    vd->makeLevels(3);
+    CHECK(vd->getNumLevels() == 3);
+    CHECK(vd->getLevelSize(1)[0] == 17 && vd->getLevelSize(1)[1] == 10 && vd->getLevelSize(1)[2] == 5);
+    CHECK(vd->getLevelSize(2)[0] == 9 && vd->getLevelSize(2)[1] == 5 && vd->getLevelSize(2)[2] == 3);
+    CHECK(vd->getLevelRaw(3) == NULL);
+
+    // integer levels are rounded at each level
+    const float tolerance = bpcs[i] == 4 ? 1e-4f : 1.0f;
+    CHECK(checkLevels(vd, tolerance));
+
+    vd->makeLevels();
+    CHECK(vd->getNumLevels() == 7);
+    CHECK(vd->getLevelSize(6)[0] == 1 && vd->getLevelSize(6)[1] == 1 && vd->getLevelSize(6)[2] == 1);
+    CHECK(checkLevels(vd, tolerance));
+
+    // copies keep the levels
+    vvVolDesc* copy = new vvVolDesc(vd);
+    CHECK(copy->getNumLevels() == 7);
+    CHECK(memcmp(copy->getLevelRaw(2, 1), vd->getLevelRaw(2, 1), vd->getLevelSize(2)[0] * vd->getLevelSize(2)[1] * vd->getLevelSize(2)[2] * vd->bpc) == 0);
+
+    // changes of the data delete the levels, also if the size stays the same
+    copy->flip(vvVecmath::X_AXIS);
+    CHECK(copy->getNumLevels() == 1);
+    copy->makeLevels();
+    copy->toggleSign();
+    CHECK(copy->getNumLevels() == 1);
+    copy->makeLevels();
+    copy->crop(0, 0, 0, copy->vox[0], copy->vox[1], copy->vox[2] - 2);
+    CHECK(copy->getNumLevels() == 1);
+    delete copy;
+
+    // statistics are computed when first needed and then kept
+    CHECK(!vd->hasStatistics());
+    CHECK(checkStatistics(vd));
+    CHECK(vd->hasStatistics());
+
+    // XVF files store the levels and the statistics
+    vvFileIO fio;
+    CHECK(fio.saveVolumeData(vd, true) == vvFileIO::OK);
+    vvVolDesc* loaded = new vvVolDesc("vvvoldesctest.xvf");
+    CHECK(fio.loadVolumeData(loaded) == vvFileIO::OK);
+    CHECK(loaded->getNumLevels() == 7);
+    for (size_t l=0; l<7; ++l)
+    {
+      const vvsize3 size = vd->getLevelSize(l);
+      for (size_t f=0; f<vd->frames; ++f)
+        CHECK(memcmp(loaded->getLevelRaw(l, int(f)), vd->getLevelRaw(l, int(f)), size[0] * size[1] * size[2] * vd->bpc) == 0);
+    }
+    CHECK(loaded->hasStatistics());
+    for (size_t f=0; f<vd->frames; ++f)
+      CHECK(equalStatistics(loaded->getStatistics(f), vd->getStatistics(f)));
+    delete loaded;
+    remove("vvvoldesctest.xvf");
+
+    // levels that don't match the data any more are dropped
+    vd->convertBPC(bpcs[i] == 1 ? 2 : 1);
+    CHECK(vd->getNumLevels() == 1);
+
+    // so are statistics after changes of the data
+    CHECK(!vd->hasStatistics());
+    CHECK(checkStatistics(vd));
+    vd->invert();
+    CHECK(!vd->hasStatistics());
+    CHECK(checkStatistics(vd));
+    vd->removeSequence();
+    CHECK(vd->getNumLevels() == 1);
+    delete vd;
+  }
+
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
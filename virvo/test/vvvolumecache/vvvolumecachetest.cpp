@@ -0,0 +1,144 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "vvfileio.h"
+#include "vvvoldesc.h"
+#include "vvvolumecache.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+static const char* file1 = "vvvolumecachetest1.xvf";
+static const char* file2 = "vvvolumecachetest2.xvf";
+
+// Saves 2 frames, voxel i of frame f is i+f+seed
+static bool saveVolume(const char* filename, size_t slices, size_t seed)
+{
+  vvVolDesc* vd = new vvVolDesc(filename, 16, 16, slices, 2, 1, 1, NULL);
+  for (size_t f=0; f<vd->frames; ++f)
+  {
+    uint8_t* raw = new uint8_t[vd->getFrameBytes()];
+    for (size_t i=0; i<vd->getFrameBytes(); ++i)
+      raw[i] = uint8_t(i + f + seed);
+    vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+  }
+  vvFileIO fio;
+  const bool ok = fio.saveVolumeData(vd, true) == vvFileIO::OK;
+  delete vd;
+  return ok;
+}
+
+static bool checkVolume(const vvVolDesc* vd, size_t slices, size_t seed)
+{
+  if (vd == NULL || vd->frames != 2 || vd->vox[2] != slices)
+    return false;
+
+  for (size_t f=0; f<vd->frames; ++f)
+  {
+    const uint8_t* raw = vd->getRaw(f);
+    for (size_t i=0; i<vd->getFrameBytes(); ++i)
+      if (raw[i] != uint8_t(i + f + seed))
+        return false;
+  }
+  return true;
+}
+
+// Acquires and releases volumes and checks which ones are shared, kept and evicted
+int main()
+{
+  CHECK(saveVolume(file1, 8, 0));
+  CHECK(saveVolume(file2, 8, 1));
+  const size_t bytes = 16 * 16 * 8 * 2;
+
+  vvVolumeCache cache;
+  CHECK(cache.getBudget() == 0);
+
+  // sessions using the same file share its frames, not the volume description
+  vvVolDesc* a = cache.acquire(file1);
+  vvVolDesc* b = cache.acquire(file1);
+  CHECK(a != NULL && b != NULL && a != b);
+  CHECK(checkVolume(a, 8, 0));
+  CHECK(checkVolume(b, 8, 0));
+  CHECK(a->getRaw(0) == b->getRaw(0) && a->getRaw(1) == b->getRaw(1));
+  CHECK(cache.getNumMisses() == 1 && cache.getNumHits() == 1);
+  CHECK(cache.getUsage() == bytes);
+
+  a->setCurrentFrame(1);
+  a->tf.setDefaultColors(0, 0.0, 1.0);
+  CHECK(b->getCurrentFrame() == 0);
+  CHECK(b->tf.isEmpty());
+
+  // volumes in use are kept, unused ones beyond the budget are not
+  cache.release(a);
+  CHECK(cache.getUsage() == bytes);
+  CHECK(checkVolume(b, 8, 0));
+  cache.release(b);
+  CHECK(cache.getUsage() == 0);
+  CHECK(cache.getNumEvictions() == 1);
+
+  // unused volumes within the budget are found again
+  cache.setBudget(2 * bytes);
+  cache.release(cache.acquire(file1));
+  CHECK(cache.getUsage() == bytes);
+  CHECK(cache.getNumMisses() == 2);
+  a = cache.acquire(file1);
+  CHECK(checkVolume(a, 8, 0));
+  CHECK(cache.getNumMisses() == 2 && cache.getNumHits() == 2);
+  cache.release(a);
+
+  // the least recently used volume is evicted first
+  cache.release(cache.acquire(file2));
+  CHECK(cache.getUsage() == 2 * bytes);
+  cache.setBudget(bytes);
+  CHECK(cache.getUsage() == bytes);
+  CHECK(cache.getNumEvictions() == 2);
+  b = cache.acquire(file2);
+  CHECK(checkVolume(b, 8, 1));
+  CHECK(cache.getNumMisses() == 3);
+  a = cache.acquire(file1);
+  CHECK(checkVolume(a, 8, 0));
+  CHECK(cache.getNumMisses() == 4);
+  CHECK(cache.getUsage() == 2 * bytes);
+  cache.release(a);
+  cache.release(b);
+  CHECK(cache.getUsage() == bytes);
+
+  // changed files are loaded again
+  CHECK(saveVolume(file2, 4, 2));
+  b = cache.acquire(file2);
+  CHECK(checkVolume(b, 4, 2));
+  CHECK(cache.getNumMisses() == 5);
+  cache.release(b);
+
+  CHECK(cache.acquire("vvvolumecachetest-missing.xvf") == NULL);
+
+  remove(file1);
+  remove(file2);
+
+  cerr << "vvVolumeCache passed" << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
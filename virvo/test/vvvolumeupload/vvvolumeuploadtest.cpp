@@ -0,0 +1,215 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+
+#include "vvsocketio.h"
+#include "vvtcpserver.h"
+#include "vvtcpsocket.h"
+#include "vvvoldesc.h"
+#include "vvvolumeupload.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+static const ushort Port = 31062;
+
+// 3 frames of 2.5 chunks each, the first half of each chunk compresses well,
+// the noise in the second half is the same in all frames
+static vvVolDesc* makeVolume()
+{
+  vvVolDesc* vd = new vvVolDesc("upload", 256, 256, 40, 3, 1, 1, NULL);
+  const size_t frameBytes = vd->getFrameBytes();
+  for (size_t f=0; f<vd->frames; ++f)
+  {
+    uint8_t* raw = new uint8_t[frameBytes];
+    for (size_t i=0; i<frameBytes; ++i)
+    {
+      bool noise = (i % virvo::VolumeUpload::ChunkSize) > virvo::VolumeUpload::ChunkSize / 2;
+      raw[i] = noise ? uint8_t((i * 2654435761U) >> 24) : uint8_t(f);
+    }
+    vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+  }
+  return vd;
+}
+
+static bool equalData(const vvVolDesc* a, const vvVolDesc* b)
+{
+  if (a->frames != b->frames || a->getFrameBytes() != b->getFrameBytes())
+    return false;
+  for (size_t f=0; f<a->frames; ++f)
+    if (memcmp(a->getRaw(f), b->getRaw(f), a->getFrameBytes()) != 0)
+      return false;
+  return true;
+}
+
+struct Transfer
+{
+  vvTcpSocket* sock;
+  const vvVolDesc* vd;
+  size_t first;
+  size_t count;
+};
+
+static void* sendVolume(void* param)
+{
+  Transfer* t = static_cast<Transfer*>(param);
+  vvSocketIO io(t->sock);
+  if (t->count == 0)
+    io.putVolume(t->vd);
+  else
+    io.putVolumeChunks(t->vd, t->first, t->count);
+  return NULL;
+}
+
+// Transfers a volume at once and in two parts over a loopback connection
+int main()
+{
+  vvTcpServer server(Port);
+  if (!server.initStatus())
+  {
+    cerr << "Cannot listen on port " << Port << endl;
+    return 1;
+  }
+
+  vvVolDesc* vd = makeVolume();
+  const size_t numChunks = virvo::VolumeUpload::getNumChunks(vd);
+  CHECK(virvo::VolumeUpload::getChunksPerFrame(vd) == 3);
+  CHECK(numChunks == 9);
+
+  vvVolDesc* other = makeVolume();
+  CHECK(virvo::VolumeUpload::computeId(vd) == virvo::VolumeUpload::computeId(other));
+  other->getRaw(1)[virvo::VolumeUpload::ChunkSize] ^= 1;
+  CHECK(virvo::VolumeUpload::computeId(vd) != virvo::VolumeUpload::computeId(other));
+  other->getRaw(1)[virvo::VolumeUpload::ChunkSize] ^= 1;
+  // inside a chunk and in the last bytes of a frame
+  other->getRaw(2)[virvo::VolumeUpload::ChunkSize + 5000] ^= 1;
+  CHECK(virvo::VolumeUpload::computeId(vd) != virvo::VolumeUpload::computeId(other));
+  other->getRaw(2)[virvo::VolumeUpload::ChunkSize + 5000] ^= 1;
+  other->getRaw(0)[vd->getFrameBytes() - 1] ^= 1;
+  CHECK(virvo::VolumeUpload::computeId(vd) != virvo::VolumeUpload::computeId(other));
+  delete other;
+
+  // whole volume
+  {
+    vvTcpSocket client;
+    CHECK(client.connectToHost("localhost", Port) == vvSocket::VV_OK);
+    vvTcpSocket* sock = server.nextConnection(5.0);
+    CHECK(sock != NULL);
+
+    Transfer t = { &client, vd, 0, 0 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, sendVolume, &t);
+
+    vvVolDesc* received = new vvVolDesc;
+    CHECK(vvSocketIO(sock).getVolume(received) == vvSocket::VV_OK);
+    CHECK(equalData(vd, received));
+
+    pthread_join(thread, NULL);
+    delete received;
+    delete sock;
+  }
+
+  // interrupted after 4 chunks, resumed on a new connection
+  vvVolDesc* attributes = new vvVolDesc("upload", 256, 256, 40, 3, 1, 1, NULL);
+  virvo::VolumeUpload upload(attributes, virvo::VolumeUpload::computeId(vd));
+  CHECK(upload.initStatus());
+
+  const size_t parts[2][2] = { { 0, 4 }, { 4, numChunks - 4 } };
+  for (int p=0; p<2; ++p)
+  {
+    vvTcpSocket client;
+    CHECK(client.connectToHost("localhost", Port) == vvSocket::VV_OK);
+    vvTcpSocket* sock = server.nextConnection(5.0);
+    CHECK(sock != NULL);
+
+    CHECK(upload.getNumReceived() == parts[p][0]);
+    Transfer t = { &client, vd, parts[p][0], parts[p][1] };
+    pthread_t thread;
+    pthread_create(&thread, NULL, sendVolume, &t);
+
+    vvSocketIO io(sock);
+    for (size_t i=0; i<parts[p][1]; ++i)
+      CHECK(io.getVolumeChunk(upload) == vvSocket::VV_OK);
+    CHECK(upload.wait());
+
+    pthread_join(thread, NULL);
+    delete sock;
+
+    CHECK(upload.isFrameComplete(0));
+    CHECK(upload.isFrameComplete(2) == (p == 1));
+  }
+
+  CHECK(upload.isComplete());
+  CHECK(equalData(vd, upload.getVolDesc()));
+
+  // chunks out of order are rejected
+  std::vector<uchar> data(virvo::VolumeUpload::ChunkSize);
+  CHECK(!upload.addChunk(0, 0, data, data.size()));
+
+  // a chunk that cannot be decompressed restarts the upload
+  {
+    virvo::VolumeUpload broken(new vvVolDesc("upload", 256, 256, 40, 3, 1, 1, NULL));
+    std::vector<uchar> chunk(vd->getRaw(0), vd->getRaw(0) + virvo::VolumeUpload::ChunkSize);
+    CHECK(broken.addChunk(0, 0, chunk, virvo::VolumeUpload::ChunkSize));
+    std::vector<uchar> garbage(1000, 0xAB);
+    CHECK(broken.addChunk(0, 1, garbage, virvo::VolumeUpload::ChunkSize));
+    CHECK(!broken.wait());
+    CHECK(broken.getNumReceived() == 0);
+    chunk.assign(vd->getRaw(0), vd->getRaw(0) + virvo::VolumeUpload::ChunkSize);
+    CHECK(broken.addChunk(0, 0, chunk, virvo::VolumeUpload::ChunkSize));
+    CHECK(broken.wait());
+    CHECK(broken.getNumReceived() == 1);
+  }
+
+  // chunk headers with oversized sizes are rejected before the data is read
+  const int sizes[3][2] = {
+    { 0x7FFFFFFF, 0x7FFFFFFF },
+    { int(virvo::VolumeUpload::ChunkSize), 0x7FFFFFFF },
+    { int(virvo::VolumeUpload::ChunkSize) + 1, int(virvo::VolumeUpload::ChunkSize) + 1 }
+  };
+  for (int i=0; i<3; ++i)
+  {
+    vvTcpSocket* client = new vvTcpSocket;
+    CHECK(client->connectToHost("localhost", Port) == vvSocket::VV_OK);
+    vvTcpSocket* sock = server.nextConnection(5.0);
+    CHECK(sock != NULL);
+
+    vvSocketIO out(client);
+    const int header[5] = { 0, 0, sizes[i][0], sizes[i][1], 0 };
+    for (int j=0; j<5; ++j)
+      CHECK(out.putInt32(header[j]) == vvSocket::VV_OK);
+    delete client;
+
+    virvo::VolumeUpload oversized(new vvVolDesc("upload", 256, 256, 40, 3, 1, 1, NULL));
+    CHECK(vvSocketIO(sock).getVolumeChunk(oversized) == vvSocket::VV_DATA_ERROR);
+    CHECK(oversized.getNumReceived() == 0);
+    delete sock;
+  }
+
+  delete vd;
+  cerr << numChunks << " chunks transferred" << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
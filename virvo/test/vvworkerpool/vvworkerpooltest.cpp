@@ -0,0 +1,111 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include <iostream>
+#include <vector>
+
+#include "vvpthread.h"
+#include "vvworkerpool.h"
+
+#include "vvtestcheck.h"
+
+using namespace std;
+
+struct Items
+{
+  virvo::Mutex mutex;
+  size_t stopAt;                // consume returns false for this item
+  vector<size_t> results;       // index + 1 once processed
+  vector<size_t> order;         // items in consumed order
+  size_t inFlight;              // processed, not yet consumed
+  size_t maxInFlight;
+};
+
+static void process(void* context, size_t index)
+{
+  Items* items = static_cast<Items*>(context);
+
+  // Uneven work, so that the items finish out of order
+  volatile size_t sum = 0;
+  for (size_t i=0; i<((index * 7919) % 13) * 10000; ++i)
+    sum += i;
+
+  virvo::ScopedLock lock(&items->mutex);
+  items->results[index] = index + 1;
+  ++items->inFlight;
+  if (items->inFlight > items->maxInFlight)
+    items->maxInFlight = items->inFlight;
+}
+
+static bool consume(void* context, size_t index)
+{
+  Items* items = static_cast<Items*>(context);
+
+  virvo::ScopedLock lock(&items->mutex);
+  if (index == items->stopAt)
+    return false;
+  items->order.push_back(items->results[index] - 1);
+  --items->inFlight;
+  return true;
+}
+
+static int run(size_t count, int numThreads, size_t window, size_t stopAt)
+{
+  Items items;
+  items.stopAt = stopAt;
+  items.results.resize(count, 0);
+  items.inFlight = 0;
+  items.maxInFlight = 0;
+
+  const size_t consumed = virvo::processOrdered(count, numThreads, window, process, consume, &items);
+
+  const size_t expected = (stopAt < count) ? stopAt : count;
+  CHECK(consumed == expected);
+  CHECK(items.order.size() == expected);
+  for (size_t i=0; i<items.order.size(); ++i)
+    CHECK(items.order[i] == i);
+  if (numThreads > 0)
+    CHECK(items.maxInFlight <= (window > 0 ? window : 2 * size_t(numThreads)));
+  return 0;
+}
+
+// Processes items on several threads and checks that they are consumed in
+// order, that no more than window items are ahead of the consumer, and that
+// consume can stop early
+int main()
+{
+  const size_t none = size_t(-1);
+
+  CHECK(run(0, 4, 0, none) == 0);
+  CHECK(run(1000, 1, 0, none) == 0);
+  CHECK(run(1000, 4, 0, none) == 0);
+  CHECK(run(1000, 4, 3, none) == 0);
+  CHECK(run(1000, 8, 1, none) == 0);
+  CHECK(run(1000, 0, 0, none) == 0);
+  CHECK(run(3, 16, 0, none) == 0);
+  CHECK(run(1000, 1, 0, 500) == 0);
+  CHECK(run(1000, 4, 0, 500) == 0);
+  CHECK(run(1000, 4, 0, 0) == 0);
+
+  cerr << "processOrdered passed" << endl;
+  return 0;
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
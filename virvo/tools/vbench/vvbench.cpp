@@ -0,0 +1,787 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifdef HAVE_CONFIG_H
+#include "vvconfig.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "vvbench.h"
+#include "vvclock.h"
+#include "vvdebugmsg.h"
+#include "vvfileio.h"
+#include "vvsoftpar.h"
+#include "vvsoftper.h"
+#include "vvsoftrayrend.h"
+#include "vvtoolshed.h"
+#include "vvtrace.h"
+#include "vvvoldesc.h"
+
+using namespace std;
+
+namespace
+{
+
+/// Split a comma separated list
+vector<string> splitList(const char* str)
+{
+  vector<string> result;
+  istringstream in(str);
+  string item;
+  while (getline(in, item, ','))
+  {
+    if (!item.empty())
+      result.push_back(item);
+  }
+  return result;
+}
+
+/// Split a comma separated list of integers
+vector<int> splitIntList(const char* str)
+{
+  vector<string> items = splitList(str);
+  vector<int> result;
+  for (size_t i=0; i<items.size(); ++i)
+    result.push_back(atoi(items[i].c_str()));
+  return result;
+}
+
+/// Map sparsity names to vvVolDesc::computeVolume() algorithms
+int getAlgorithm(const string& sparsity)
+{
+  if (sparsity == "dense")   return 0;
+  if (sparsity == "blocks")  return 1;
+  if (sparsity == "checker") return 3;
+  return -1;
+}
+
+/// Fraction of non-zero voxels in the current frame
+float getOccupancy(vvVolDesc* vd)
+{
+  const uint8_t* raw = vd->getRaw(0);
+  const size_t bytes = vd->getFrameBytes();
+  const size_t bpv = vd->getBPV();
+  size_t used = 0;
+  for (size_t i=0; i<bytes; i+=bpv)
+  {
+    for (size_t b=0; b<bpv; ++b)
+    {
+      if (raw[i+b] != 0)
+      {
+        ++used;
+        break;
+      }
+    }
+  }
+  return bytes > 0 ? float(used) / float(bytes / bpv) : 0.0f;
+}
+
+/// Peak resident set size of the process [KB], -1 if not available
+long getPeakRSS()
+{
+#ifndef _WIN32
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+#ifdef __APPLE__
+  return long(usage.ru_maxrss / 1024);
+#else
+  return long(usage.ru_maxrss);
+#endif
+#else
+  return -1;
+#endif
+}
+
+double getMean(const vector<double>& values)
+{
+  double sum = 0.0;
+  for (size_t i=0; i<values.size(); ++i)
+    sum += values[i];
+  return values.empty() ? 0.0 : sum / double(values.size());
+}
+
+double getMin(const vector<double>& values)
+{
+  return values.empty() ? 0.0 : *min_element(values.begin(), values.end());
+}
+
+/// Escape a string for JSON output
+string quote(const string& str)
+{
+  string result = "\"";
+  for (size_t i=0; i<str.size(); ++i)
+  {
+    if (str[i] == '"' || str[i] == '\\')
+      result += '\\';
+    result += str[i];
+  }
+  return result + "\"";
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+/// Constructor
+vvBench::vvBench()
+{
+  sizes.push_back(64);
+  sizes.push_back(128);
+  bpcs.push_back(1);
+  bpcs.push_back(2);
+  sparsities.push_back("dense");
+  sparsities.push_back("blocks");
+  sparsities.push_back("checker");
+  synthFile = NULL;
+  outFile   = NULL;
+  traceFile = NULL;
+  json      = false;
+  showHelp  = false;
+  frames    = 8;
+  width     = 256;
+  height    = 256;
+}
+
+//----------------------------------------------------------------------------
+/// Destructor
+vvBench::~vvBench()
+{
+}
+
+//----------------------------------------------------------------------------
+/// Display command usage help on the command line.
+void vvBench::displayHelpInfo()
+{
+  cerr << "VBench is a command line utility to benchmark the CPU volume renderers" << endl;
+  cerr << "and volume processing kernels of Virvo without a GPU or a window." << endl;
+  cerr << endl;
+  cerr << "Syntax:" << endl;
+  cerr << endl;
+  cerr << "vbench [<options>]" << endl;
+  cerr << endl;
+  cerr << "Available options:" << endl;
+  cerr << endl;
+  cerr << "-sizes <n1,n2,...>" << endl;
+  cerr << " Edge lengths of the synthetic volumes [voxels]. Default: 64,128" << endl;
+  cerr << endl;
+  cerr << "-bpc <b1,b2,...>" << endl;
+  cerr << " Bytes per channel to test (1, 2 or 4). Default: 1,2" << endl;
+  cerr << " The renderers only support 1 byte per channel, the other values" << endl;
+  cerr << " are used for the kernels only." << endl;
+  cerr << endl;
+  cerr << "-sparsity <s1,s2,...>" << endl;
+  cerr << " Synthetic datasets: dense, blocks, checker. Default: all" << endl;
+  cerr << endl;
+  cerr << "-synth <file.synth>" << endl;
+  cerr << " Use the volume from a synthetic data file instead of generated volumes." << endl;
+  cerr << endl;
+  cerr << "-tests <t1,t2,...>" << endl;
+  cerr << " Tests to run: rayrend, softpar, softper, kernels. Default: all" << endl;
+  cerr << endl;
+  cerr << "-frames <n>" << endl;
+  cerr << " Number of frames of the camera orbit, also used as the number" << endl;
+  cerr << " of kernel runs. Default: 8" << endl;
+  cerr << endl;
+  cerr << "-size <width> <height>" << endl;
+  cerr << " Image size [pixels]. Default: 256 256" << endl;
+  cerr << endl;
+  cerr << "-json" << endl;
+  cerr << " Write results as JSON. Default is CSV." << endl;
+  cerr << endl;
+  cerr << "-o <file>" << endl;
+  cerr << " Write results to a file instead of stdout." << endl;
+  cerr << endl;
+  cerr << "-trace <file>" << endl;
+  cerr << " Write a Chrome trace-event file of the whole run." << endl;
+  cerr << endl;
+  cerr << "-help" << endl;
+  cerr << " Display this help information." << endl;
+  cerr << endl;
+  cerr << "Examples:" << endl;
+  cerr << "vbench -sizes 128,256 -bpc 1 -tests rayrend -json -o bench.json" << endl;
+  cerr << "vbench -synth sphere.synth -tests kernels" << endl;
+  cerr << endl;
+}
+
+//----------------------------------------------------------------------------
+/** Parse command line arguments.
+  @return true if parsing was successful
+*/
+bool vvBench::parseCommandLine(int argc, char** argv)
+{
+  for (int arg=1; arg<argc; ++arg)
+  {
+    if (vvToolshed::strCompare(argv[arg], "-help")==0 ||
+        vvToolshed::strCompare(argv[arg], "-h")==0 ||
+        vvToolshed::strCompare(argv[arg], "-?")==0 ||
+        vvToolshed::strCompare(argv[arg], "/?")==0)
+    {
+      showHelp = true;
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-sizes")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Volume sizes missing." << endl;
+        return false;
+      }
+      sizes = splitIntList(argv[arg]);
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-bpc")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Bytes per channel missing." << endl;
+        return false;
+      }
+      bpcs = splitIntList(argv[arg]);
+      for (size_t i=0; i<bpcs.size(); ++i)
+      {
+        if (bpcs[i]!=1 && bpcs[i]!=2 && bpcs[i]!=4)
+        {
+          cerr << "Invalid number of bytes per channel: " << bpcs[i] << endl;
+          return false;
+        }
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-sparsity")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Sparsity levels missing." << endl;
+        return false;
+      }
+      sparsities = splitList(argv[arg]);
+      for (size_t i=0; i<sparsities.size(); ++i)
+      {
+        if (getAlgorithm(sparsities[i]) < 0)
+        {
+          cerr << "Invalid sparsity level: " << sparsities[i] << endl;
+          return false;
+        }
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-synth")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Synthetic data file name missing." << endl;
+        return false;
+      }
+      synthFile = argv[arg];
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-tests")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Test names missing." << endl;
+        return false;
+      }
+      tests = splitList(argv[arg]);
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-frames")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Number of frames missing." << endl;
+        return false;
+      }
+      frames = atoi(argv[arg]);
+      if (frames < 1)
+      {
+        cerr << "Invalid number of frames." << endl;
+        return false;
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-size")==0)
+    {
+      if (arg+2>=argc)
+      {
+        cerr << "Image size missing." << endl;
+        return false;
+      }
+      width  = atoi(argv[++arg]);
+      height = atoi(argv[++arg]);
+      if (width < 1 || height < 1)
+      {
+        cerr << "Invalid image size." << endl;
+        return false;
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-json")==0)
+    {
+      json = true;
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-o")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Output file name missing." << endl;
+        return false;
+      }
+      outFile = argv[arg];
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-trace")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Trace file name missing." << endl;
+        return false;
+      }
+      traceFile = argv[arg];
+    }
+    else
+    {
+      cerr << "Unknown option/parameter: \"" << argv[arg] << "\", use -help for instructions." << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/// @return true if the given test was selected on the command line
+bool vvBench::wants(const string& test) const
+{
+  return tests.empty() || find(tests.begin(), tests.end(), test) != tests.end();
+}
+
+//----------------------------------------------------------------------------
+/** Compute the camera for one frame of the orbit about the volume's y axis.
+  @param frame  frame index
+  @param vd     volume
+  @param ortho  true = parallel projection, false = perspective projection
+  @param mv     returns the modelview matrix
+  @param pr     returns the projection matrix
+*/
+void vvBench::getCamera(int frame, const vvVolDesc* vd, bool ortho, vvMatrix& mv, vvMatrix& pr) const
+{
+  const float radius = vd->getSize().length() * 0.5f;
+  const float dist = 3.0f * radius;
+  const float aspect = float(width) / float(height);
+
+  mv.identity();
+  mv.rotate(2.0f * float(VV_PI) * float(frame) / float(frames), 0.0f, 1.0f, 0.0f);
+  mv.translate(0.0f, 0.0f, -dist);
+
+  if (ortho)
+  {
+    pr.setProjOrtho(-radius * aspect, radius * aspect, -radius, radius, 0.0f, 2.0f * dist);
+  }
+  else
+  {
+    const float znear = dist - radius;
+    pr.setProjPersp(-radius * aspect, radius * aspect, -radius, radius, znear, dist + radius);
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Store the timings of one test.
+  @param base     dataset description
+  @param test     renderer or kernel name
+  @param variant  renderer settings
+  @param times    time per frame/run [s]
+  @param voxels   voxels processed per frame/run
+  @param pixels   pixels produced per frame/run
+  @param samples  volume samples taken in all frames/runs
+*/
+void vvBench::addResult(const Result& base, const string& test, const string& variant,
+                        const vector<double>& times, double voxels, double pixels, double samples)
+{
+  Result r = base;
+  r.test = test;
+  r.variant = variant;
+  r.iterations = int(times.size());
+  const double mean = getMean(times);
+  r.msMean = mean * 1000.0;
+  r.msMin = getMin(times) * 1000.0;
+  r.voxelsPerSec = mean > 0.0 ? voxels / mean : 0.0;
+  r.pixelsPerSec = mean > 0.0 ? pixels / mean : 0.0;
+  r.samplesPerSec = mean > 0.0 ? samples / (mean * double(times.size())) : 0.0;
+  r.peakRSS = getPeakRSS();
+  results.push_back(r);
+
+  cerr << r.dataset << " " << r.size[0] << " bpc=" << r.bpc << " " << test;
+  if (!variant.empty()) cerr << " [" << variant << "]";
+  cerr << ": " << r.msMean << " ms" << endl;
+}
+
+//----------------------------------------------------------------------------
+/** Render all frames of the camera orbit.
+  @param vd       volume
+  @param base     dataset description
+  @param name     renderer name
+  @param renderer renderer, deleted after the test
+  @param variant  renderer settings
+*/
+void vvBench::benchmarkRenderer(vvVolDesc* vd, const Result& base, const string& name,
+                                vvRenderer* renderer, const string& variant)
+{
+  vvSoftRayRend* rayRend = dynamic_cast<vvSoftRayRend*>(renderer);
+  vvSoftVR* softVR = dynamic_cast<vvSoftVR*>(renderer);
+  const bool ortho = (name == "softpar");
+
+  vector<double> times;
+  vvStopwatch sw;
+  vvMatrix mv;
+  vvMatrix pr;
+
+  long samples = 0;
+
+  // One untimed frame to allocate buffers and start the worker threads
+  for (int f=-1; f<frames; ++f)
+  {
+    if (f == 0)
+      samples = virvo::trace::samplesTaken.value();
+    getCamera(f < 0 ? 0 : f, vd, ortho, mv, pr);
+    sw.start();
+    if (rayRend != NULL)
+      rayRend->renderVolume(mv, pr, width, height);
+    else if (softVR != NULL)
+      softVR->renderVolume(mv, pr, width, height);
+    if (f >= 0)
+      times.push_back(sw.getTime());
+    virvo::trace::sampleCounters();
+  }
+  samples = virvo::trace::samplesTaken.value() - samples;
+
+  delete renderer;
+
+  addResult(base, name, variant, times,
+            double(vd->getFrameVoxels()), double(width) * double(height), double(samples));
+}
+
+//----------------------------------------------------------------------------
+/** Run the vvVolDesc kernels on copies of the volume.
+  @param vd    volume
+  @param base  dataset description
+*/
+void vvBench::benchmarkKernels(vvVolDesc* vd, const Result& base)
+{
+  const double voxels = double(vd->getFrameVoxels());
+  vvStopwatch sw;
+  vector<double> times;
+  float fmin, fmax;
+  float mean, variance, stdev;
+
+  times.clear();
+  for (int i=0; i<frames; ++i)
+  {
+    vd->invalidateStatistics();
+    sw.start();
+    vd->computeStatistics();
+    times.push_back(sw.getTime());
+  }
+  addResult(base, "computeStatistics", "", times, voxels * double(vd->frames), 0.0);
+
+  // The following kernels use the statistics computed above
+  times.clear();
+  for (int i=0; i<frames; ++i)
+  {
+    sw.start();
+    vd->findMinMax(0, fmin, fmax);
+    times.push_back(sw.getTime());
+  }
+  addResult(base, "findMinMax", "", times, voxels, 0.0);
+
+  int buckets[1] = { 256 };
+  vector<int> hist(buckets[0]);
+  times.clear();
+  for (int i=0; i<frames; ++i)
+  {
+    sw.start();
+    vd->makeHistogram(0, 0, 1, buckets, &hist[0], vd->real[0], vd->real[1]);
+    times.push_back(sw.getTime());
+  }
+  addResult(base, "makeHistogram", "", times, voxels, 0.0);
+
+  times.clear();
+  for (int i=0; i<frames; ++i)
+  {
+    sw.start();
+    vd->calculateDistribution(0, 0, mean, variance, stdev);
+    times.push_back(sw.getTime());
+  }
+  addResult(base, "calculateDistribution", "", times, voxels, 0.0);
+
+  times.clear();
+  for (int i=0; i<frames; ++i)
+  {
+    sw.start();
+    vd->findClampValue(0, 0, 0.95f);
+    times.push_back(sw.getTime());
+  }
+  addResult(base, "findClampValue", "", times, voxels, 0.0);
+
+  // The following kernels modify the data, so they work on copies
+  times.clear();
+  for (int i=0; i<frames; ++i)
+  {
+    vvVolDesc copy(vd, 0);
+    sw.start();
+    copy.flip(vvVecmath::Y_AXIS);
+    times.push_back(sw.getTime());
+  }
+  addResult(base, "flip", "", times, voxels, 0.0);
+
+  times.clear();
+  for (int i=0; i<frames; ++i)
+  {
+    vvVolDesc copy(vd, 0);
+    sw.start();
+    copy.resize(vd->vox[0] / 2, vd->vox[1] / 2, vd->vox[2] / 2, vvVolDesc::TRILINEAR);
+    times.push_back(sw.getTime());
+  }
+  addResult(base, "resize", "trilinear", times, voxels, 0.0);
+
+  times.clear();
+  const size_t newBPC = (vd->bpc == 1) ? 2 : 1;
+  for (int i=0; i<frames; ++i)
+  {
+    vvVolDesc copy(vd, 0);
+    sw.start();
+    copy.convertBPC(newBPC);
+    times.push_back(sw.getTime());
+  }
+  ostringstream variant;
+  variant << "to" << newBPC;
+  addResult(base, "convertBPC", variant.str(), times, voxels, 0.0);
+}
+
+//----------------------------------------------------------------------------
+/** Run all selected tests on one volume.
+  @param vd    volume with one time step
+  @param name  dataset name
+*/
+void vvBench::benchmarkVolume(vvVolDesc* vd, const string& name)
+{
+  Result base;
+  base.dataset = name;
+  for (size_t i=0; i<3; ++i)
+    base.size[i] = int(vd->vox[i]);
+  base.bpc = int(vd->bpc);
+  base.occupancy = getOccupancy(vd);
+  base.dataBytes = vd->getFrameBytes();
+
+  vd->tf.setDefaultColors(0, vd->real[0], vd->real[1]);
+  vd->tf.setDefaultAlpha(0, vd->real[0], vd->real[1]);
+
+  // The CPU renderers only support 8 bit scalar volumes
+  if (vd->getBPV() == 1)
+  {
+    if (wants("rayrend"))
+    {
+      for (int i=0; i<8; ++i)
+      {
+        const bool interpolation = (i & 4) != 0;
+        const bool opCorr = (i & 2) != 0;
+        const bool earlyRayTermination = (i & 1) != 0;
+
+        vvSoftRayRend* renderer = new vvSoftRayRend(vd, vvRenderState());
+        renderer->setParameter(vvRenderer::VV_SLICEINT, interpolation);
+        renderer->setParameter(vvRenderer::VV_OPCORR, opCorr);
+        renderer->setParameter(vvRenderer::VV_TERMINATEEARLY, earlyRayTermination);
+
+        ostringstream variant;
+        variant << "interp=" << interpolation
+                << " opcorr=" << opCorr
+                << " ert=" << earlyRayTermination;
+        benchmarkRenderer(vd, base, "rayrend", renderer, variant.str());
+      }
+    }
+
+    for (int type=0; type<2; ++type)
+    {
+      const string name = (type == 0) ? "softpar" : "softper";
+      if (!wants(name))
+        continue;
+
+      for (int interpolation=0; interpolation<2; ++interpolation)
+      {
+        vvSoftVR* renderer = (type == 0)
+          ? static_cast<vvSoftVR*>(new vvSoftPar(vd, vvRenderState()))
+          : static_cast<vvSoftVR*>(new vvSoftPer(vd, vvRenderState()));
+        renderer->setParameter(vvRenderer::VV_SLICEINT, interpolation != 0);
+
+        ostringstream variant;
+        variant << "interp=" << interpolation;
+        benchmarkRenderer(vd, base, name, renderer, variant.str());
+      }
+    }
+  }
+
+  if (wants("kernels"))
+    benchmarkKernels(vd, base);
+}
+
+//----------------------------------------------------------------------------
+/// Write results as comma separated values.
+void vvBench::writeCSV(ostream& out) const
+{
+  out << "dataset,width,height,slices,bpc,occupancy,test,variant,iterations,"
+      << "ms_mean,ms_min,voxels_per_s,pixels_per_s,samples_per_s,data_bytes,peak_rss_kb" << endl;
+  for (size_t i=0; i<results.size(); ++i)
+  {
+    const Result& r = results[i];
+    out << r.dataset << ","
+        << r.size[0] << "," << r.size[1] << "," << r.size[2] << ","
+        << r.bpc << "," << r.occupancy << ","
+        << r.test << "," << r.variant << "," << r.iterations << ","
+        << r.msMean << "," << r.msMin << ","
+        << r.voxelsPerSec << "," << r.pixelsPerSec << "," << r.samplesPerSec << ","
+        << r.dataBytes << "," << r.peakRSS << endl;
+  }
+}
+
+//----------------------------------------------------------------------------
+/// Write results as a JSON array of objects.
+void vvBench::writeJSON(ostream& out) const
+{
+  out << "[" << endl;
+  for (size_t i=0; i<results.size(); ++i)
+  {
+    const Result& r = results[i];
+    out << "  { \"dataset\": " << quote(r.dataset)
+        << ", \"size\": [" << r.size[0] << ", " << r.size[1] << ", " << r.size[2] << "]"
+        << ", \"bpc\": " << r.bpc
+        << ", \"occupancy\": " << r.occupancy
+        << ", \"test\": " << quote(r.test)
+        << ", \"variant\": " << quote(r.variant)
+        << ", \"iterations\": " << r.iterations
+        << ", \"ms_mean\": " << r.msMean
+        << ", \"ms_min\": " << r.msMin
+        << ", \"voxels_per_s\": " << r.voxelsPerSec
+        << ", \"pixels_per_s\": " << r.pixelsPerSec
+        << ", \"samples_per_s\": " << r.samplesPerSec
+        << ", \"data_bytes\": " << r.dataBytes
+        << ", \"peak_rss_kb\": " << r.peakRSS
+        << " }" << (i+1 < results.size() ? "," : "") << endl;
+  }
+  out << "]" << endl;
+}
+
+//----------------------------------------------------------------------------
+/** Main routine.
+  @param argc,argv command line arguments
+  @return 0 if the program finished ok, 1 if an error occurred
+*/
+int vvBench::run(int argc, char** argv)
+{
+  if (!parseCommandLine(argc, argv))
+    return 1;
+
+  if (showHelp)
+  {
+    displayHelpInfo();
+    return 0;
+  }
+
+  // The sample counters are only updated while tracing is enabled
+  virvo::trace::setEnabled(true);
+  virvo::trace::setThreadName("vbench");
+
+  if (synthFile != NULL)
+  {
+    vvVolDesc* vd = new vvVolDesc(synthFile);
+    vvFileIO* fio = new vvFileIO();
+    if (fio->loadVolumeData(vd) != vvFileIO::OK)
+    {
+      cerr << "Cannot load synthetic data file: " << synthFile << endl;
+      delete fio;
+      delete vd;
+      return 1;
+    }
+    delete fio;
+    vd->cropTimesteps(0, 1);
+    for (size_t b=0; b<bpcs.size(); ++b)
+    {
+      vvVolDesc copy(vd, 0);
+      copy.convertBPC(bpcs[b]);
+      benchmarkVolume(&copy, vvToolshed::extractFilename(synthFile));
+    }
+    delete vd;
+  }
+  else
+  {
+    for (size_t s=0; s<sparsities.size(); ++s)
+    {
+      for (size_t i=0; i<sizes.size(); ++i)
+      {
+        vvVolDesc* vd = new vvVolDesc();
+        vd->computeVolume(getAlgorithm(sparsities[s]), sizes[i], sizes[i], sizes[i]);
+        vd->cropTimesteps(0, 1);
+        for (size_t b=0; b<bpcs.size(); ++b)
+        {
+          vvVolDesc copy(vd, 0);
+          copy.convertBPC(bpcs[b]);
+          benchmarkVolume(&copy, sparsities[s]);
+        }
+        delete vd;
+      }
+    }
+  }
+
+  if (traceFile != NULL && !virvo::trace::dump(traceFile))
+    return 1;
+
+  if (outFile != NULL)
+  {
+    ofstream out(outFile);
+    if (!out)
+    {
+      cerr << "Cannot write to file: " << outFile << endl;
+      return 1;
+    }
+    if (json) writeJSON(out);
+    else writeCSV(out);
+  }
+  else
+  {
+    if (json) writeJSON(cout);
+    else writeCSV(cout);
+  }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+/// Main function for the benchmark
+int main(int argc, char* argv[])
+{
+  vvBench* vbench = new vvBench();
+  int error = vbench->run(argc, argv);
+  delete vbench;
+  return error;
+}
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,99 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef _VVBENCH_H_
+#define _VVBENCH_H_
+
+#include "vvvecmath.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class vvRenderer;
+class vvVolDesc;
+
+/** Headless benchmark for the CPU renderers and the vvVolDesc kernels.
+  Synthetic volumes are generated with vvVolDesc::computeVolume() (or read
+  from a .synth file) at several sizes, data types and sparsity levels,
+  then vvSoftRayRend, vvSoftPar, vvSoftPer and a set of vvVolDesc kernels
+  are timed along a fixed camera orbit. Results are written as CSV or JSON.
+  No OpenGL context is created, so the tool runs on machines without a GPU.
+  Usage: type 'vbench -help' to get a list of command line parameters.
+*/
+class vvBench
+{
+  public:
+    struct Result
+    {
+      std::string dataset;  ///< dataset name (synthetic algorithm or file name)
+      int   size[3];        ///< volume size [voxels]
+      int   bpc;            ///< bytes per channel
+      float occupancy;      ///< fraction of non-zero voxels [0..1]
+      std::string test;     ///< renderer or kernel name
+      std::string variant;  ///< renderer settings, empty for kernels
+      int   iterations;     ///< number of frames or kernel runs
+      double msMean;        ///< mean time per frame/run [ms]
+      double msMin;         ///< minimum time per frame/run [ms]
+      double voxelsPerSec;  ///< dataset voxels processed per second
+      double pixelsPerSec;  ///< image pixels produced per second (renderers only)
+      double samplesPerSec; ///< volume samples taken per second (renderers only)
+      size_t dataBytes;     ///< size of one volume frame [bytes]
+      long  peakRSS;        ///< peak resident set size after the test [KB], -1 if unknown
+    };
+
+  private:
+    std::vector<int> sizes;       ///< volume edge lengths [voxels]
+    std::vector<int> bpcs;        ///< bytes per channel to test
+    std::vector<std::string> sparsities; ///< synthetic datasets (dense|blocks|checker)
+    std::vector<std::string> tests; ///< renderers and kernels to run
+    char* synthFile;              ///< .synth file to use instead of synthetic volumes
+    char* outFile;                ///< output file name, NULL for stdout
+    char* traceFile;              ///< Chrome trace-event file name, NULL for no trace
+    bool  json;                   ///< true = JSON output, false = CSV output
+    bool  showHelp;               ///< display help information
+    int   frames;                 ///< number of frames of the camera orbit
+    int   width;                  ///< image width [pixels]
+    int   height;                 ///< image height [pixels]
+    std::vector<Result> results;  ///< measurements
+
+    bool parseCommandLine(int, char**);
+    void displayHelpInfo();
+    bool wants(const std::string&) const;
+    void benchmarkVolume(vvVolDesc*, const std::string&);
+    void benchmarkRenderer(vvVolDesc*, const Result&, const std::string&, vvRenderer*, const std::string&);
+    void benchmarkKernels(vvVolDesc*, const Result&);
+    void addResult(const Result&, const std::string&, const std::string&,
+                   const std::vector<double>&, double, double, double = 0.0);
+    void getCamera(int, const vvVolDesc*, bool, vvMatrix&, vvMatrix&) const;
+    void writeCSV(std::ostream&) const;
+    void writeJSON(std::ostream&) const;
+
+  public:
+    vvBench();
+    ~vvBench();
+    int run(int, char**);
+};
+
+#endif
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -25,12 +25,14 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <algorithm>
 #include "vvvirvo.h"
 #include "vvconv.h"
 #include "vvfileio.h"
 #include "vvdebugmsg.h"
 #include "vvtokenizer.h"
 #include "vvtoolshed.h"
+#include "vvworkerpool.h"
 #include <sstream>
 
 using namespace std;
@@ -92,6 +94,7 @@ vvConv::vvConv()
   dicomRename   = false;
   leicaRename   = false;
   compression   = true;
+  deltaEncoding = false;
   animTime      = 0.0f;
   deinterlace   = false;
   zoomData      = false;
@@ -115,6 +118,8 @@ vvConv::vvConv()
   makeIcon      = false;
   makeVolume    = -1;
   makeIconSize  = 0;
+  levels        = -1;
+  storeStats    = false;
   getIcon       = false;
 	swapChannels  = false;
   extractChannel = false;
@@ -122,6 +127,8 @@ vvConv::vvConv()
   addFile       = NULL;
   autoRealRange = false;
   invertVoxelOrder = false;
+  streamMB      = 0;
+  numThreads    = 1;
   lineAverage = 0;
   sections = 0;
   pinhole = 0;
@@ -164,6 +171,16 @@ vvConv::~vvConv()
   delete vd;
 }
 
+//----------------------------------------------------------------------------
+/// Source files of readVolumeData(), shared by the threads loading them
+struct vvConv::Sources
+{
+  vvConv* conv;
+  std::vector<std::string> names;
+  std::vector<vvVolDesc*> vds;    ///< loaded files, NULL while loading, on errors, and once merged
+  bool verbose;                   ///< true = print the modifications of each file
+};
+
 //----------------------------------------------------------------------------
 /** Reads one or more volume files, processes conversion options, and
  combines data.
@@ -172,11 +189,9 @@ vvConv::~vvConv()
 bool vvConv::readVolumeData()
 {
   vvFileIO*  fio;
-  vvVolDesc* newVD;
   char* filename;             // currently processed file name
   int   file  = 0;            // index of current file
   bool  done = false;
-  vvFileIO::ErrorType error;
   int i;
 
   vvDebugMsg::msg(1, "vvConv::readVolumeData()");
@@ -544,60 +559,13 @@ bool vvConv::readVolumeData()
     
     return true;
   }
+  delete fio;
+
+  // Find the files:
+  Sources sources;
   while (!done)
   {
-    // Load current file:
-    cerr << "Loading file " << (file+1) << ": " << filename << endl;
-    newVD = new vvVolDesc(filename);
-    if (loadRaw)
-    {
-      error = fio->loadRawFile(newVD, rawWidth, rawHeight, rawSlices, rawBPC, rawCh, rawSkip);
-    }
-    else if (loadXB7)
-    {
-      error = fio->loadXB7File(newVD, xb7Size, xb7Param, xb7Global);
-    }
-    else if (loadCPT)
-    {
-      error = fio->loadCPTFile(newVD, cptSize, cptParam, cptGlobal);
-    }
-    else if (makeVolume>-1)
-    {
-      newVD->computeVolume(makeVolume, makeVolumeSize[0], makeVolumeSize[1], makeVolumeSize[2]);
-      error = vvFileIO::OK;
-    }
-    else error = fio->loadVolumeData(newVD);
-    
-    if (error != vvFileIO::OK)
-    {
-      cerr << "Cannot load file: " << filename << endl;
-      delete fio;
-      delete newVD;
-      delete[] filename;
-      return false;
-    }
-
-    newVD->printInfoLine("Loaded: ");
-
-    // Make data modifications for each input file:
-    modifyInputFile(newVD);
-
-    // Merge new data to previous data:
-    if (newVD->vox[2] == 1)
-    {
-      if (mergeType==2)
-      {
-        vd->merge(newVD, vvVolDesc::VV_MERGE_VOL2ANIM);
-      }
-      else vd->merge(newVD, vvVolDesc::VV_MERGE_SLABS2VOL);
-    }
-    else
-    {
-      if (mergeType==1) cerr << "Cannot merge volumes to another volume." << endl;
-      else vd->merge(newVD, vvVolDesc::VV_MERGE_VOL2ANIM);
-    }
-
-    delete newVD;       // now the new VD can be released
+    sources.names.push_back(filename);
 
     // Find the next file:
     ++file;
@@ -621,104 +589,222 @@ bool vvConv::readVolumeData()
     else done = true;
   }
   delete[] filename;
-  delete fio;
+
+  // Load the files and make the modifications for each of them. With
+  // several threads, the files are loaded ahead, at most two per thread,
+  // and merged in order:
+  const size_t numFiles = sources.names.size();
+  sources.conv = this;
+  sources.vds.resize(numFiles, NULL);
+  sources.verbose = (numThreads==1);
+  if (!sources.verbose) cerr << "Loading " << numFiles << " files" << endl;
+  const size_t merged = virvo::processOrdered(numFiles, numThreads, 0, loadSourceFile, mergeSourceFile,
+                                              &sources, "vconv load");
+  for (size_t f=0; f<numFiles; ++f)
+  {
+    delete sources.vds[f];
+  }
+  if (merged < numFiles) return false;
 
   // Import transfer functions:
-  if (importTF)
+  if (importTF && !importTransferFunctions(vd)) return false;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/** Loads a source file and makes the modifications for each input file.
+  Runs on the threads of readVolumeData().
+  @param context source files (Sources)
+  @param index   index of the file to load
+*/
+void vvConv::loadSourceFile(void* context, size_t index)
+{
+  Sources* sources = static_cast<Sources*>(context);
+  const vvConv* conv = sources->conv;
+  const char* filename = sources->names[index].c_str();
+  vvFileIO::ErrorType error;
+
+  if (sources->verbose) cerr << "Loading file " << (index+1) << ": " << filename << endl;
+  vvVolDesc* newVD = new vvVolDesc(filename);
+  vvFileIO* fio = new vvFileIO();
+  if (conv->loadRaw)
+  {
+    error = fio->loadRawFile(newVD, conv->rawWidth, conv->rawHeight, conv->rawSlices,
+                             conv->rawBPC, conv->rawCh, conv->rawSkip);
+  }
+  else if (conv->loadXB7)
   {
-    bool error=false;
-    vvVolDesc* vdTF;    // VD for the transfer functions
+    error = fio->loadXB7File(newVD, conv->xb7Size, conv->xb7Param, conv->xb7Global);
+  }
+  else if (conv->loadCPT)
+  {
+    error = fio->loadCPTFile(newVD, conv->cptSize, conv->cptParam, conv->cptGlobal);
+  }
+  else if (conv->makeVolume>-1)
+  {
+    newVD->computeVolume(conv->makeVolume, conv->makeVolumeSize[0], conv->makeVolumeSize[1], conv->makeVolumeSize[2]);
+    error = vvFileIO::OK;
+  }
+  else error = fio->loadVolumeData(newVD);
+  delete fio;
 
-    vdTF = new vvVolDesc(importFile);
-    fio = new vvFileIO();
-    switch (fio->loadVolumeData(vdTF, vvFileIO::TRANSFER))
+  if (error != vvFileIO::OK)
+  {
+    delete newVD;
+    newVD = NULL;
+  }
+  else
+  {
+    if (sources->verbose) newVD->printInfoLine("Loaded: ");
+
+    // Make data modifications for each input file:
+    sources->conv->modifyInputFile(newVD, sources->verbose);
+  }
+  sources->vds[index] = newVD;
+}
+
+//----------------------------------------------------------------------------
+/** Merges a loaded source file to the volume, in the order of the files.
+  @param context source files (Sources)
+  @param index   index of the file to merge
+  @return true if ok, false if the file could not be loaded
+*/
+bool vvConv::mergeSourceFile(void* context, size_t index)
+{
+  Sources* sources = static_cast<Sources*>(context);
+  vvConv* conv = sources->conv;
+  vvVolDesc* newVD = sources->vds[index];
+  sources->vds[index] = NULL;
+
+  if (newVD==NULL)
+  {
+    cerr << "Cannot load file: " << sources->names[index] << endl;
+    return false;
+  }
+  if (!sources->verbose) cerr << "Loaded file " << (index+1) << ": " << sources->names[index] << endl;
+
+  // Merge new data to previous data:
+  if (newVD->vox[2] == 1)
+  {
+    if (conv->mergeType==2)
     {
-      case vvFileIO::OK:
-        vd->tf.copy(&vd->tf._widgets, &vdTF->tf._widgets);
-        cerr << "Transfer function imported from: " << importFile << endl;
-        break;
-      case vvFileIO::FILE_NOT_FOUND:
-        cerr << "Transfer functions file not found: " << importFile << endl;
-        error = true;
-        break;
-      default:
-        cerr << "Cannot load transfer functions file: " << importFile << endl;
-        error = true;
-        break;
+      conv->vd->merge(newVD, vvVolDesc::VV_MERGE_VOL2ANIM);
     }
-    delete fio;
-    if (error) return false;
+    else conv->vd->merge(newVD, vvVolDesc::VV_MERGE_SLABS2VOL);
+  }
+  else
+  {
+    if (conv->mergeType==1) cerr << "Cannot merge volumes to another volume." << endl;
+    else conv->vd->merge(newVD, vvVolDesc::VV_MERGE_VOL2ANIM);
   }
+
+  delete newVD;       // now the new VD can be released
   return true;
 }
 
+//----------------------------------------------------------------------------
+/** Replaces the transfer functions of a volume by those of the file
+  passed with -transfunc.
+  @param v volume description to receive the transfer functions
+  @return true if ok, false on error
+*/
+bool vvConv::importTransferFunctions(vvVolDesc* v)
+{
+  bool error=false;
+  vvVolDesc* vdTF;    // VD for the transfer functions
+  vvFileIO* fio;
+
+  vdTF = new vvVolDesc(importFile);
+  fio = new vvFileIO();
+  switch (fio->loadVolumeData(vdTF, vvFileIO::TRANSFER))
+  {
+    case vvFileIO::OK:
+      v->tf.copy(&v->tf._widgets, &vdTF->tf._widgets);
+      cerr << "Transfer function imported from: " << importFile << endl;
+      break;
+    case vvFileIO::FILE_NOT_FOUND:
+      cerr << "Transfer functions file not found: " << importFile << endl;
+      error = true;
+      break;
+    default:
+      cerr << "Cannot load transfer functions file: " << importFile << endl;
+      error = true;
+      break;
+  }
+  delete fio;
+  delete vdTF;
+  return !error;
+}
+
 //----------------------------------------------------------------------------
 /** Make data modifications for each input file.
   This covers mostly the modifications which could considerably
   change the volume data size and thus should be done as early
   as possible in the conversion process.
-  @param v volume description to which to apply the modifications
+  @param v       volume description to which to apply the modifications
+  @param verbose true = print the modifications and show progress
 */
-void vvConv::modifyInputFile(vvVolDesc* v)
+void vvConv::modifyInputFile(vvVolDesc* v, bool verbose)
 {
   if (setRange)
   {
-    cerr << "Setting physical data value range." << endl;
+    if (verbose) cerr << "Setting physical data value range." << endl;
     v->real[0] = newRange[0];
     v->real[1] = newRange[1];
   }
   if (autoRealRange)
   {
     float scalarMin, scalarMax;
-    cerr << "Automatically setting physical data value range." << endl;
+    if (verbose) cerr << "Automatically setting physical data value range." << endl;
     v->findMinMax(0, scalarMin, scalarMax);
     v->real[0] = scalarMin;
     v->real[1] = scalarMax;
   }
   if (swap)
   {
-    cerr << "Swapping bytes." << endl;
+    if (verbose) cerr << "Swapping bytes." << endl;
     v->toggleEndianness();
   }
   if (sign)
   {
-    cerr << "Toggle sign." << endl;
+    if (verbose) cerr << "Toggle sign." << endl;
     v->toggleSign();
   }
   if (crop)
   {
-    cerr << "Cropping data." << endl;
+    if (verbose) cerr << "Cropping data." << endl;
     v->crop(cropPos[0], cropPos[1], cropPos[2], cropSize[0], cropSize[1], cropSize[2]);
   }
   if (resize)
   {
-    cerr << "Resizing data: ";
+    int size[3] = { newSize[0], newSize[1], newSize[2] };
+    if (verbose) cerr << "Resizing data: ";
     if (resizeFactor>0.0f)    // scaling or resizing?
     {
-      newSize[0] = (int)(resizeFactor * (float)v->vox[0]);
-      newSize[1] = (int)(resizeFactor * (float)v->vox[1]);
-      newSize[2] = (int)(resizeFactor * (float)v->vox[2]);
+      size[0] = (int)(resizeFactor * (float)v->vox[0]);
+      size[1] = (int)(resizeFactor * (float)v->vox[1]);
+      size[2] = (int)(resizeFactor * (float)v->vox[2]);
     }
-    v->resize(newSize[0], newSize[1], newSize[2], ipt, true);
-    cerr << endl;
+    v->resize(size[0], size[1], size[2], ipt, verbose);
+    if (verbose) cerr << endl;
   }
   if (bpchan>-1)
   {
-    cerr << "Converting bytes per channel: ";
-    v->convertBPC(bpchan, true);
-    cerr << endl;
+    if (verbose) cerr << "Converting bytes per channel: ";
+    v->convertBPC(bpchan, verbose);
+    if (verbose) cerr << endl;
   }
   if (channels>-1)
   {
-    cerr << "Changing number of channels: ";
-    v->convertChannels(channels, true);
-    cerr << endl;
+    if (verbose) cerr << "Changing number of channels: ";
+    v->convertChannels(channels, -1, verbose);
+    if (verbose) cerr << endl;
   }
   if (extractChannel)
   {
-    cerr << "Extracting 4th channel: ";
-    v->extractChannel(extract, true);
-    cerr << endl;
+    if (verbose) cerr << "Extracting 4th channel: ";
+    v->extractChannel(extract, verbose);
+    if (verbose) cerr << endl;
   }
 }
 
@@ -783,7 +869,7 @@ void vvConv::modifyOutputFile(vvVolDesc* v)
   if (bitshift)
   {
     cerr << "Bit shifting data by " << bshiftDist << " bits: ";
-    v->bitShiftData(bshiftDist, true);
+    v->bitShiftData(bshiftDist, -1, true);
     cerr << endl;
   }
   if (drawBox)
@@ -897,6 +983,16 @@ void vvConv::modifyOutputFile(vvVolDesc* v)
     delete fio;
     delete addVD;
   }
+  if (levels>=0)  // last, the levels must match the final data
+  {
+    cerr << "Making levels of detail" << endl;
+    vd->makeLevels(size_t(levels));
+  }
+  if (storeStats)
+  {
+    cerr << "Computing statistics" << endl;
+    vd->computeStatistics();
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -1060,6 +1156,7 @@ bool vvConv::writeVolumeData()
   vd->printInfoLine("Writing: ");
   fio = new vvFileIO();
   fio->setCompression(compression);
+  fio->setDeltaEncoding(deltaEncoding);
   switch (fio->saveVolumeData(vd, overwrite))
   {
     case vvFileIO::OK:
@@ -1082,6 +1179,488 @@ bool vvConv::writeVolumeData()
   return ok;
 }
 
+namespace
+{
+
+/** Returns the source slice of a destination slice when resizing along z
+  like vvVolDesc::resize(). Trilinear interpolation needs the following
+  source slice as well.
+  @param z         destination slice
+  @param srcSlices number of source slices
+  @param dstSlices number of destination slices
+  @param ipt       interpolation type
+  @param pos       trilinear interpolation: receives the position between
+                   the returned slice and the next one [0..1]
+*/
+size_t sourceSlice(size_t z, size_t srcSlices, size_t dstSlices,
+                   vvVolDesc::InterpolationType ipt, float& pos)
+{
+  pos = 0.0f;
+  if (ipt==vvVolDesc::TRILINEAR)
+  {
+    // Same rounding as vvVolDesc::trilinearInterpolation():
+    float fz = (float)z / (float)(dstSlices-1) * (float)(srcSlices-1);
+    fz = ts_clamp(fz, 0.0f, (float)(srcSlices-1));
+    size_t iz = ts_min(size_t(fz), srcSlices-2);
+    pos = fz - (float)iz;
+    return iz;
+  }
+  size_t iz = (dstSlices>1) ? z * (srcSlices-1) / (dstSlices-1) : 0;
+  return ts_clamp(iz, size_t(0), srcSlices-1);
+}
+
+/// Crops a range of voxels along one axis like vvVolDesc::crop()
+void cropRange(size_t pos, size_t size, size_t vox, size_t& first, size_t& count)
+{
+  first = ts_min(pos, vox-1, pos + size - 1);
+  count = ts_min(vox-1, ts_max(pos, pos + size - 1)) - first + 1;
+}
+
+}
+
+//----------------------------------------------------------------------------
+/** Checks if the conversion can be done slab by slab (see -stream) and
+  reads the header of the source file.
+  @param hdr      receives the volume attributes of the source file, without data
+  @param framePos receives the file offsets of the voxel data of the frames
+  @return NULL if ok, otherwise the reason why the volume must be loaded as a whole
+*/
+const char* vvConv::prepareStreaming(vvVolDesc* hdr, std::vector<uint64_t>& framePos)
+{
+  if (files!=1 || leicaRename || makeVolume>-1 || loadXB7 || loadCPT)
+    return "only single source files can be streamed";
+  if (autoRealRange || extractChannel || invertVoxelOrder || sphere || heightField || rotate ||
+      shift || drawBox || drawLine || fillRange || zoomData || deinterlace || blend ||
+      makeIcon || setIcon || addChannel || levels>=0 || storeStats)
+    return "one of the options needs the whole volume";
+  if (!vvToolshed::isSuffix(dstFile, ".xvf") && !vvToolshed::isSuffix(dstFile, ".rvf") &&
+      !vvToolshed::isSuffix(dstFile, ".dat"))
+    return "the destination is not an xvf, rvf, or dat file";
+  if (vvToolshed::isSameFile(srcFile, dstFile))
+    return "the destination is the source file";
+  vvFileIO* fio = new vvFileIO();
+  uint64_t offset;
+  if (loadRaw)
+  {
+    if (rawBPC<1 || rawBPC>4)
+    {
+      delete fio;
+      return "invalid raw file format";
+    }
+    hdr->vox[0] = rawWidth;
+    hdr->vox[1] = rawHeight;
+    hdr->vox[2] = rawSlices;
+    hdr->bpc    = rawBPC;
+    hdr->chan   = rawCh;
+    hdr->frames = 1;
+    for (size_t i=0; i<hdr->chan; ++i) hdr->setChannelName(i, NULL);
+    offset = rawSkip;
+  }
+  else if (vvToolshed::isSuffix(srcFile, ".xvf") || vvToolshed::isSuffix(srcFile, ".rvf"))
+  {
+    if (fio->loadVolumeData(hdr, vvFileIO::HEADER) != vvFileIO::OK || fio->getDataOffset()==0)
+    {
+      delete fio;
+      return "cannot read the header of the source file";
+    }
+    if (vvToolshed::isSuffix(srcFile, ".rvf"))
+      for (size_t i=0; i<hdr->chan; ++i) hdr->setChannelName(i, NULL);
+    offset = fio->getDataOffset();
+  }
+  else
+  {
+    delete fio;
+    return "the source is not an xvf, rvf, or raw file";
+  }
+  delete fio;
+
+  // Locate the frames, each xvf frame is preceded by its encoded size:
+  FILE* fp = fopen(srcFile, "rb");
+  if (fp==NULL) return "cannot open the source file";
+  vvToolshed::seekFile(fp, 0, SEEK_END);
+  const uint64_t fileSize = uint64_t(vvToolshed::tellFile(fp));
+  const bool xvf = !loadRaw && vvToolshed::isSuffix(srcFile, ".xvf");
+  const size_t frameBytes = hdr->getFrameBytes();
+  const char* reason = NULL;
+  framePos.clear();
+  for (size_t f=0; f<hdr->frames && reason==NULL; ++f)
+  {
+    if (xvf)
+    {
+      vvToolshed::seekFile(fp, int64_t(offset));
+      if (vvToolshed::read32(fp) != 0) reason = "the source file has compressed frames";
+      offset += 4;
+    }
+    if (offset + frameBytes > fileSize) reason = "the source file is too short";
+    framePos.push_back(offset);
+    offset += frameBytes;
+  }
+  fclose(fp);
+  hdr->frames = 0;    // header only
+
+  // Trilinear interpolation needs two voxels in each direction:
+  if (reason==NULL && resize && ipt==vvVolDesc::TRILINEAR)
+  {
+    for (size_t i=0; i<3; ++i)
+    {
+      size_t first, count;
+      cropRange(size_t(cropPos[i]), size_t(cropSize[i]), hdr->vox[i], first, count);
+      if (!crop) count = hdr->vox[i];
+      const int size = (resizeFactor>0.0f) ? int(resizeFactor * float(count)) : newSize[i];
+      if (count<2 || size<2) reason = "the volume is too thin for trilinear resampling";
+    }
+  }
+  return reason;
+}
+
+
+//----------------------------------------------------------------------------
+/// State of a slab by slab conversion, shared by the threads converting the slabs
+struct vvConv::Stream
+{
+  vvConv* conv;
+  const vvVolDesc* hdr;           ///< attributes of the destination volume
+  const std::vector<uint64_t>* framePos;
+  size_t srcVox[3];               ///< source volume size
+  size_t srcBPC;
+  size_t srcChan;
+  size_t srcSliceBytes;
+  size_t cropFirst[3];            ///< first source voxel after cropping
+  size_t cropCount[3];            ///< source voxels after cropping
+  size_t dstSize[3];              ///< volume size after resizing
+  bool resample;                  ///< true = resize the volume
+  bool rvf;                       ///< true = destination is an rvf file
+  bool xvf;                       ///< true = destination is an xvf file
+  size_t firstFrame;
+  std::vector<std::pair<size_t, size_t> > slabs;  ///< first destination slice and number of slices, in file order
+  std::vector<vvVolDesc*> results;  ///< converted slabs, NULL while converting, on errors, and once written
+  FILE* dst;
+  size_t done;                    ///< destination slices written
+};
+
+//----------------------------------------------------------------------------
+/** Converts the volume slab by slab, so that only a few slices have to
+  be in memory at a time. The slabs are read from the source file, passed
+  through the same operations as in readVolumeData() and modifyOutputFile(),
+  and appended to the destination file. With several threads, the slabs
+  of all frames are converted in parallel, at most two per thread, and
+  written in order.
+  @param hdr      volume attributes of the source file (see prepareStreaming())
+  @param framePos file offsets of the voxel data of the frames
+  @return true if ok, false on error
+*/
+bool vvConv::streamVolumeData(vvVolDesc* hdr, const std::vector<uint64_t>& framePos)
+{
+  Stream stream;
+  stream.conv = this;
+  stream.hdr = hdr;
+  stream.framePos = &framePos;
+
+  // Source slices after cropping:
+  for (size_t i=0; i<3; ++i)
+  {
+    stream.srcVox[i] = hdr->vox[i];
+    stream.cropFirst[i] = 0;
+    stream.cropCount[i] = hdr->vox[i];
+    if (crop)
+      cropRange(size_t(cropPos[i]), size_t(cropSize[i]), hdr->vox[i], stream.cropFirst[i], stream.cropCount[i]);
+  }
+  stream.srcBPC = hdr->bpc;
+  stream.srcChan = hdr->chan;
+  stream.srcSliceBytes = hdr->getSliceBytes();
+  const size_t* cropCount = stream.cropCount;
+
+  // Apply all operations to the header to get the destination attributes:
+  modifyInputFile(hdr);
+  if (importTF && !importTransferFunctions(hdr)) return false;
+  modifyOutputFile(hdr);
+
+  // Resizing is skipped if the size does not change, see vvVolDesc::resize():
+  int size[3] = { newSize[0], newSize[1], newSize[2] };
+  if (resizeFactor>0.0f)
+  {
+    for (size_t i=0; i<3; ++i) size[i] = int(resizeFactor * float(cropCount[i]));
+  }
+  stream.resample = resize && size[0]>0 && size[1]>0 && size[2]>0 &&
+    (size_t(size[0])!=cropCount[0] || size_t(size[1])!=cropCount[1] || size_t(size[2])!=cropCount[2]);
+  for (size_t i=0; i<3; ++i)
+  {
+    stream.dstSize[i] = stream.resample ? size_t(size[i]) : cropCount[i];
+  }
+  const size_t dstSlices = hdr->vox[2];
+  const bool flipZ = flip && flipAxis==vvVecmath::Z_AXIS;
+
+  // Frames to convert:
+  size_t firstFrame = 0;
+  size_t numFrames = framePos.size();
+  if (croptime)
+  {
+    firstFrame = ts_min(size_t(cropSteps[0]), numFrames);
+    numFrames = ts_min(size_t(cropSteps[1]), numFrames - firstFrame);
+  }
+  if (numFrames==0)
+  {
+    cerr << "Cannot save file: Destination volume is empty." << endl;
+    return false;
+  }
+  stream.firstFrame = firstFrame;
+
+  // Open the destination file and write its header:
+  stream.xvf = vvToolshed::isSuffix(dstFile, ".xvf");
+  stream.rvf = vvToolshed::isSuffix(dstFile, ".rvf");
+  if (!stream.xvf) numFrames = 1;    // rvf and dat files store one frame
+  if (stream.rvf && (hdr->bpc!=1 || hdr->chan!=1))
+  {
+    cerr << "Converting data to 1 bpc and 1 channel" << endl;
+  }
+  if (!vvToolshed::isFile(srcFile))
+  {
+    cerr << "Cannot open source file: " << srcFile << endl;
+    return false;
+  }
+  stream.dst = fopen(dstFile, "wb");
+  if (stream.dst==NULL)
+  {
+    cerr << "Cannot open destination file: " << dstFile << endl;
+    return false;
+  }
+  bool ok = true;
+  if (stream.xvf)
+  {
+    vvFileIO* fio = new vvFileIO();
+    fio->setCompression(false);
+    hdr->makeIcon(0, NULL);
+    hdr->frames = numFrames;
+    ok = (fio->saveXVFHeader(hdr, stream.dst) == vvFileIO::OK);
+    hdr->frames = 0;
+    delete fio;
+  }
+  else if (stream.rvf)
+  {
+    vvToolshed::write16(stream.dst, uint16_t(hdr->vox[0]));
+    vvToolshed::write16(stream.dst, uint16_t(hdr->vox[1]));
+    vvToolshed::write16(stream.dst, uint16_t(hdr->vox[2]));
+  }
+
+  // Slab size: the source slices, their cropped copies, the repeated source
+  // slices for resizing, and the destination slices in up to two formats are
+  // in memory at the same time. The memory is shared by the slabs in flight.
+  const int threads = (numThreads>0) ? numThreads : vvToolshed::getNumProcessors();
+  const size_t window = (threads>1) ? 2 * size_t(threads) : 1;
+  const size_t budget = size_t(streamMB) * 1024 * 1024 / window;
+  const size_t srcSliceBytes = stream.srcSliceBytes;
+  const size_t cropSliceBytes = cropCount[0] * cropCount[1] * stream.srcBPC * stream.srcChan;
+  const size_t dstSliceBytes = cropSliceBytes + 2 * hdr->vox[0] * hdr->vox[1] *
+    ts_max(stream.srcBPC * stream.srcChan, stream.srcBPC * hdr->chan, hdr->bpc * hdr->chan);
+
+  // Slabs are made of the destination slices before flipping, flipping
+  // along z reverses their order:
+  for (size_t z=0; z<dstSlices; )
+  {
+    size_t n = 0;
+    size_t sources = 0;
+    size_t next = 0;        // first source slice not counted yet
+    while (z+n < dstSlices)
+    {
+      float pos;
+      size_t s = stream.resample ? sourceSlice(z+n, cropCount[2], dstSlices, ipt, pos) : z+n;
+      size_t e = (stream.resample && ipt==vvVolDesc::TRILINEAR) ? s+2 : s+1;
+      size_t newSources = sources + e - ts_max(s, ts_min(next, e));
+      if (n==0) newSources = e - s;
+      size_t bytes = newSources * (srcSliceBytes + cropSliceBytes) + (n+1) * dstSliceBytes;
+      if (n>0 && bytes>budget) break;
+      sources = newSources;
+      next = e;
+      ++n;
+    }
+    stream.slabs.push_back(std::make_pair(z, n));
+    z += n;
+  }
+  if (flipZ) std::reverse(stream.slabs.begin(), stream.slabs.end());
+
+  // Convert the slabs of all frames:
+  const size_t numSlabs = ok ? numFrames * stream.slabs.size() : 0;
+  stream.results.resize(numSlabs, NULL);
+  stream.done = 0;
+  vvToolshed::initProgress(int(numFrames * dstSlices));
+  if (virvo::processOrdered(numSlabs, numThreads, window, convertSlab, writeSlab, &stream, "vconv stream") < numSlabs)
+  {
+    ok = false;
+  }
+  for (size_t i=0; i<numSlabs; ++i)
+  {
+    delete stream.results[i];
+  }
+  cerr << endl;
+
+  if (fclose(stream.dst) != 0) ok = false;
+  if (ok) cerr << "Volume saved successfully." << endl;
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+/** Reads a slab from the source file and converts it, see streamVolumeData().
+  Runs on the threads of streamVolumeData().
+  @param context state of the conversion (Stream)
+  @param index   index of the slab, counting the slabs of all frames in file order
+*/
+void vvConv::convertSlab(void* context, size_t index)
+{
+  Stream* stream = static_cast<Stream*>(context);
+  const vvConv* conv = stream->conv;
+  const size_t frame = stream->firstFrame + index / stream->slabs.size();
+  const size_t first = stream->slabs[index % stream->slabs.size()].first;
+  const size_t count = stream->slabs[index % stream->slabs.size()].second;
+  const size_t dstSlices = stream->hdr->vox[2];
+  const size_t srcSliceBytes = stream->srcSliceBytes;
+  const vvVolDesc::InterpolationType ipt = conv->ipt;
+
+  // Read the source slices, each only once:
+  const bool trilinear = stream->resample && ipt==vvVolDesc::TRILINEAR;
+  std::vector<size_t> sources;
+  std::vector<size_t> srcIndex;    // index into sources for each destination slice
+  std::vector<float> pos;        // trilinear interpolation: position between slices
+  for (size_t z=first; z<first+count; ++z)
+  {
+    float p;
+    size_t s = stream->resample ? sourceSlice(z, stream->cropCount[2], dstSlices, ipt, p) : z;
+    if (sources.empty() || sources.back()<s) sources.push_back(s);
+    if (trilinear && sources.back()<s+1) sources.push_back(s+1);
+    srcIndex.push_back(sources.size() - (trilinear ? 2 : 1));
+    pos.push_back(p);
+  }
+  FILE* src = fopen(conv->srcFile, "rb");
+  bool ok = (src!=NULL);
+  uint8_t* data = new uint8_t[sources.size() * srcSliceBytes];
+  for (size_t j=0; j<sources.size() && ok; ++j)
+  {
+    if (j==0 || sources[j]!=sources[j-1]+1)
+      ok = vvToolshed::seekFile(src, int64_t((*stream->framePos)[frame] + uint64_t(stream->cropFirst[2] + sources[j]) * srcSliceBytes));
+    ok = ok && (fread(data + j * srcSliceBytes, 1, srcSliceBytes, src) == srcSliceBytes);
+  }
+  if (src!=NULL) fclose(src);
+  if (!ok)
+  {
+    delete[] data;
+    return;
+  }
+
+  vvVolDesc* slab = new vvVolDesc();
+  slab->vox[0] = stream->srcVox[0];
+  slab->vox[1] = stream->srcVox[1];
+  slab->vox[2] = sources.size();
+  slab->bpc = stream->srcBPC;
+  slab->chan = stream->srcChan;
+  slab->real[0] = stream->hdr->real[0];
+  slab->real[1] = stream->hdr->real[1];
+  slab->addFrame(data, vvVolDesc::ARRAY_DELETE);
+  slab->frames = 1;
+
+  // Operations of modifyInputFile():
+  if (conv->swap) slab->toggleEndianness();
+  if (conv->sign) slab->toggleSign();
+  if (conv->crop) slab->crop(stream->cropFirst[0], stream->cropFirst[1], 0,
+                             stream->cropCount[0], stream->cropCount[1], slab->vox[2]);
+  if (trilinear)
+  {
+    // Interpolate each destination slice between two source slices:
+    const size_t w = stream->dstSize[0];
+    const size_t h = stream->dstSize[1];
+    const size_t bpv = slab->getBPV();
+    const size_t sliceBytes = slab->getSliceBytes();
+    uint8_t* resized = new uint8_t[count * w * h * bpv];
+    uint8_t* out = resized;
+    vvVolDesc* pair = new vvVolDesc();
+    pair->vox[0] = slab->vox[0];
+    pair->vox[1] = slab->vox[1];
+    pair->vox[2] = 2;
+    pair->bpc = slab->bpc;
+    pair->chan = slab->chan;
+    pair->addFrame(slab->getRaw(), vvVolDesc::NO_DELETE);
+    pair->frames = 1;
+    for (size_t z=0; z<count; ++z)
+    {
+      pair->updateFrame(0, slab->getRaw() + srcIndex[z] * sliceBytes, vvVolDesc::NO_DELETE);
+      for (size_t y=0; y<h; ++y)
+        for (size_t x=0; x<w; ++x)
+      {
+        float fx = (float)x / (float)(w-1) * (float)(pair->vox[0]-1);
+        float fy = (float)y / (float)(h-1) * (float)(pair->vox[1]-1);
+        pair->trilinearInterpolation(0, fx, fy, pos[z], out);
+        out += bpv;
+      }
+    }
+    delete pair;
+    slab->vox[0] = w;
+    slab->vox[1] = h;
+    slab->vox[2] = count;
+    slab->updateFrame(0, resized, vvVolDesc::ARRAY_DELETE);
+  }
+  else if (stream->resample)
+  {
+    // Repeat the source slices so that only the width and height remain
+    // to be resized:
+    const size_t sliceBytes = slab->getSliceBytes();
+    uint8_t* repeated = new uint8_t[count * sliceBytes];
+    for (size_t z=0; z<count; ++z)
+      memcpy(repeated + z * sliceBytes, slab->getRaw() + srcIndex[z] * sliceBytes, sliceBytes);
+    slab->vox[2] = count;
+    slab->updateFrame(0, repeated, vvVolDesc::ARRAY_DELETE);
+    slab->resize(stream->dstSize[0], stream->dstSize[1], count, vvVolDesc::NEAREST);
+  }
+  if (conv->bpchan>-1) slab->convertBPC(conv->bpchan);
+  if (conv->channels>-1) slab->convertChannels(conv->channels);
+
+  // Operations of modifyOutputFile():
+  if (conv->swapChannels) slab->swapChannels(conv->swapChan[0], conv->swapChan[1]);
+  if (conv->flip) slab->flip(conv->flipAxis);
+  if (conv->bitshift) slab->bitShiftData(conv->bshiftDist);
+
+  // Format conversion of saveRVFFile():
+  if (stream->rvf)
+  {
+    slab->convertBPC(1);
+    slab->convertChannels(1);
+  }
+
+  stream->results[index] = slab;
+}
+
+//----------------------------------------------------------------------------
+/** Appends a converted slab to the destination file, in file order.
+  @param context state of the conversion (Stream)
+  @param index   index of the slab, counting the slabs of all frames in file order
+  @return true if ok, false on error
+*/
+bool vvConv::writeSlab(void* context, size_t index)
+{
+  Stream* stream = static_cast<Stream*>(context);
+  vvVolDesc* slab = stream->results[index];
+  stream->results[index] = NULL;
+
+  if (slab==NULL)
+  {
+    cerr << "Cannot read source file: " << stream->conv->srcFile << endl;
+    return false;
+  }
+
+  bool ok = true;
+  if (stream->xvf && index % stream->slabs.size() == 0)
+  {
+    ok = (vvToolshed::write32(stream->dst, 0) == 4);    // frame is not encoded
+  }
+  const size_t bytes = slab->getFrameBytes();
+  if (!ok || fwrite(slab->getRaw(), 1, bytes, stream->dst) != bytes)
+  {
+    cerr << "Cannot write destination file: " << stream->conv->dstFile << endl;
+    ok = false;
+  }
+  stream->done += slab->vox[2];
+  vvToolshed::printProgress(int(stream->done));
+  delete slab;
+  return ok;
+}
+
 //----------------------------------------------------------------------------
 /** Parse command line arguments.
   @param argc,argv command line arguments
@@ -1111,6 +1690,41 @@ bool vvConv::parseCommandLine(int argc, char** argv)
       statistics = true;
     }
 
+    else if (vvToolshed::strCompare(argv[arg], "-storestats")==0)
+    {
+      storeStats = true;
+    }
+
+    else if (vvToolshed::strCompare(argv[arg], "-stream")==0)
+    {
+      if ((++arg)>=argc) 
+      {
+        cerr << "Memory size missing." << endl;
+        return false;
+      }
+      streamMB = atoi(argv[arg]);
+      if (streamMB<1)
+      {
+        cerr << "Invalid memory size." << endl;
+        return false;
+      }
+    }
+
+    else if (vvToolshed::strCompare(argv[arg], "-threads")==0)
+    {
+      if ((++arg)>=argc) 
+      {
+        cerr << "Number of threads missing." << endl;
+        return false;
+      }
+      numThreads = atoi(argv[arg]);
+      if (numThreads<0)
+      {
+        cerr << "Invalid number of threads." << endl;
+        return false;
+      }
+    }
+
     else if (vvToolshed::strCompare(argv[arg], "-hist")==0)
     {
       histogram = true;
@@ -1153,6 +1767,11 @@ bool vvConv::parseCommandLine(int argc, char** argv)
       deinterlace = true;
     }
 
+    else if (vvToolshed::strCompare(argv[arg], "-delta")==0)
+    {
+      deltaEncoding = true;
+    }
+
     else if (vvToolshed::strCompare(argv[arg], "-nocompress")==0)
     {
       compression = false;
@@ -1886,6 +2505,21 @@ bool vvConv::parseCommandLine(int argc, char** argv)
       }
     }
 
+    else if (vvToolshed::strCompare(argv[arg], "-levels")==0)
+    {
+      if ((++arg)>=argc) 
+      {
+        cerr << "Number of levels missing." << endl;
+        return false;
+      }
+      levels = atoi(argv[arg]);
+      if (levels<0)
+      {
+        cerr << "Invalid number of levels." << endl;
+        return false;
+      }
+    }
+
     else if (vvToolshed::strCompare(argv[arg], "-makeicon")==0)
     {
       makeIcon = true;
@@ -2004,6 +2638,7 @@ void vvConv::displayHelpInfo()
   cerr << "ximg               = General Electric scanner format" << endl;
   cerr << "vis04              = IEEE Visualization 2004 contest format" << endl;
   cerr << "dds                = Microsoft DirectDraw Surface file format " << endl;
+  cerr << "bricks             = Bricked volume file for out-of-core rendering" << endl;
   cerr << endl;
   cerr << "<destination_file.ext>" << endl;
   cerr << "Destination file name. The extension determines the destination data format." << endl;
@@ -2015,6 +2650,7 @@ void vvConv::displayHelpInfo()
   cerr << "tif                = 2D TIF File" << endl;
   cerr << "pgm/ppm            = Density or RGB images (depending on volume data type)" << endl;
   cerr << "nrd                = Gordon Kindlmann's teem volume file" << endl;
+  cerr << "bricks             = Bricked volume file for out-of-core rendering" << endl;
   cerr << endl;
   cerr << "<options>" << endl;
   cerr << "The following command line options are accepted in any order." << endl;
@@ -2074,6 +2710,10 @@ void vvConv::displayHelpInfo()
   cerr << " Corrects a dataset with interlaced slices. The first slice will remain the" << endl;
   cerr << " first slice, the second slice will be taken from halfway into the dataset." << endl;
   cerr << endl;
+  cerr << "-delta" << endl;
+  cerr << " Store each time step as the difference to the previous one when writing" << endl;
+  cerr << " xvf files, if that is smaller. Older versions of Virvo cannot read such files." << endl;
+  cerr << endl;
   cerr << "-dicomrename" << endl;
   cerr << " Rename DICOM files to reflect sequence number and slice location." << endl;
   cerr << " The source files must be named in ascending order, e.g., 'file001.dcm'," << endl;
@@ -2163,6 +2803,11 @@ void vvConv::displayHelpInfo()
   cerr << "-invertorder" << endl;
   cerr << " Invert voxel order: order of voxels and slices will be inverted.";
   cerr << endl;
+  cerr << "-levels <n>" << endl;
+  cerr << " Store <n> levels of detail in xvf files, including the volume itself. Each" << endl;
+  cerr << " level halves the size of the one before. <n> = 0 makes levels down to a" << endl;
+  cerr << " single voxel. Renderers use them where voxels are smaller than pixels." << endl;
+  cerr << endl;
   cerr << "-loadraw <width> <height> <slices> <bpc> <ch> <skip>" << endl;
   cerr << " Load a non-virvo raw volume data file. The parameters are:" << endl;
   cerr << " <width> <height> <slices> = volume size [voxels]" << endl;
@@ -2256,6 +2901,23 @@ void vvConv::displayHelpInfo()
   cerr << "-stat" << endl;
   cerr << " Displays the same as '-info', plus some statistics about the volume data." << endl;
   cerr << endl;
+  cerr << "-storestats" << endl;
+  cerr << " Store the statistics of all frames in xvf files: value ranges, histograms," << endl;
+  cerr << " and value ranges of bricks. Histograms and value ranges are then available" << endl;
+  cerr << " without scanning the data when the file is loaded." << endl;
+  cerr << endl;
+  cerr << "-stream <megabytes>" << endl;
+  cerr << " Convert the volume slab by slab instead of loading it as a whole, using" << endl;
+  cerr << " about <megabytes> of memory. Volumes larger than the main memory can be" << endl;
+  cerr << " converted this way. The source must be an xvf file with uncompressed" << endl;
+  cerr << " frames, an rvf file, or a raw file (see -loadraw). The destination must" << endl;
+  cerr << " be an xvf, rvf, or dat file. xvf files are written without compression" << endl;
+  cerr << " and without icon. Supported options are -bitshift, -bpc, -channels," << endl;
+  cerr << " -crop, -croptime, -dist, -flip, -pos, -realrange, -removetf, -resize," << endl;
+  cerr << " -scale, -sign, -swap, -swapchannels, -time, and -transfunc. With other" << endl;
+  cerr << " options the whole volume is loaded." << endl;
+  cerr << " Example: -loadraw 2048 2048 2048 2 1 0 -crop 0 0 0 1024 1024 2048 -stream 256" << endl;
+  cerr << endl;
   cerr << "-swap" << endl;
   cerr << " Swap endianness of data bytes. The result depends on the data format:" << endl;
   cerr << " 8 bit scalar values are not affected, for 16 bit voxels high and low byte" << endl;
@@ -2266,6 +2928,15 @@ void vvConv::displayHelpInfo()
   cerr << " [1..num_channels]. This command does not work on data sets with only" << endl;
   cerr << " one channel." << endl;
   cerr << endl;
+  cerr << "-threads <n>" << endl;
+  cerr << " Use <n> threads, 0 for one per processor. Default: 1" << endl;
+  cerr << " The files of -files are loaded and modified in parallel and merged in" << endl;
+  cerr << " order, at most two files per thread are in memory at a time. With -stream," << endl;
+  cerr << " the slabs of all frames are converted in parallel and the memory is shared" << endl;
+  cerr << " by the slabs in flight. Other operations on the merged volume are done" << endl;
+  cerr << " one frame at a time." << endl;
+  cerr << " Example: vconv step0001.rvf anim.xvf -files 0 -scale 0.5 -threads 0" << endl;
+  cerr << endl;
   cerr << "-time <sec>" << endl;
   cerr << " Set the time [seconds] that each animation frame takes to display." << endl;
   cerr << endl;
@@ -2325,6 +2996,7 @@ int vvConv::run(int argc, char** argv)
     cerr << "-crop <x> <y> <z> <w> <h> <s>      crop volume" << endl;
     cerr << "-croptime <first_step> <num_steps> crop a sequence of time steps" << endl;
     cerr << "-deinterlace                       corrects interlaced slices" << endl;
+    cerr << "-delta                             delta encode time steps" << endl;
     cerr << "-dicomrename                       automatically rename dicom files" << endl;
     cerr << "-leicarename                       automatically rename Leica files" << endl;
     cerr << "-dist <dx> <dy> <dz>               set voxel sampling distance" << endl;
@@ -2342,6 +3014,7 @@ int vvConv::run(int argc, char** argv)
     cerr << "-info                              display information about volume" << endl;
     cerr << "-interpolation <n|t>               set interpolation type" << endl;
     cerr << "-invertorder                       invert voxel order" << endl;
+    cerr << "-levels <n>                        store levels of detail" << endl;
     cerr << "-loadraw <w> <h> <s> <bc> <c> <sk> load raw volume data from file" << endl;
     cerr << "-loadcpt <size> <param> <minmax>   load checkpoint particles file" << endl;
     cerr << "-loadxb7 <size> <param> <minmax>   load XB7 particles file" << endl;
@@ -2360,9 +3033,12 @@ int vvConv::run(int argc, char** argv)
     cerr << "-seticon <filename>                set the icon image" << endl;
     cerr << "-shift <x> <y> <z>                 shift parallel to a coordinate axis" << endl;
     cerr << "-stat                              display volume data statistics" << endl;
+    cerr << "-storestats                        store statistics in xvf files" << endl;
+    cerr << "-stream <megabytes>                convert slab by slab" << endl;
     cerr << "-sign                              toggle sign" << endl;
     cerr << "-swap                              swap endianness of voxel data bytes" << endl;
 		cerr << "-swapchannels <ch1> <ch2>          swap two channels in each voxel" << endl;
+    cerr << "-threads <n>                       load files and convert slabs in parallel" << endl;
     cerr << "-time <dt>                         set animation time per frame" << endl;
     cerr << "-transfunc <filename.xvf>          import transfer functions from file" << endl;
     cerr << "-zoomdata <channel> <low> <high>   zoom data range" << endl;
@@ -2603,6 +3279,24 @@ int vvConv::run(int argc, char** argv)
     return 1;
   }
 
+  if (streamMB>0)
+  {
+    vvVolDesc* hdr = new vvVolDesc(srcFile);
+    std::vector<uint64_t> framePos;
+    const char* reason = prepareStreaming(hdr, framePos);
+    if (reason==NULL)
+    {
+      cerr << "Converting slab by slab: " << srcFile << " -> " << dstFile << endl;
+      bool ok = streamVolumeData(hdr, framePos);
+      delete hdr;
+      if (!ok) return 1;
+      cerr << "Done." << endl;
+      return 0;
+    }
+    delete hdr;
+    cerr << "Cannot convert slab by slab: " << reason << "." << endl;
+  }
+
   cerr << "Reading volume data." << endl;
   if (!readVolumeData()) return 1;
 
@@ -23,6 +23,8 @@
 
 #include "vvvoldesc.h"
 
+#include <vector>
+
 /** Command line volume file format converter.
   Usage: Type 'vconv' to get a list of command line parameters, or
   view the main() function in vvconv.cpp.<BR>
@@ -95,6 +97,7 @@ class vvConv
     bool  dicomRename;  ///< true = rename DICOM files
     bool  leicaRename;  ///< true = rename Leica files
     bool  compression;  ///< true = compress data if allowed by file format
+    bool  deltaEncoding; ///< true = store time steps as differences if allowed by file format
     float animTime;     ///< time that each animation frame is to be displayed [seconds], 0=no change
     bool  deinterlace;  ///< true = deinterlace slices
     bool  zoomData;     ///< true = zoom data range
@@ -120,6 +123,8 @@ class vvConv
     char* iconFile;     ///< icon image file
     bool  makeIcon;     ///< true = make icon from slices
     int   makeIconSize; ///< new icon size [pixels]
+    int   levels;       ///< number of levels of detail to make (-1 if not used, 0 = all)
+    bool  storeStats;   ///< true = compute statistics of all frames to store them in the file
     bool  getIcon;      ///< true = extract icon to file
     char* getIconFile;  ///< file to write icon to
     bool  swapChannels; ///< true = swap channels
@@ -132,6 +137,8 @@ class vvConv
     bool  addChannel;   ///< true = add a channel from file
     bool  autoRealRange;
     bool  invertVoxelOrder; ///< true = invert innermost and outermost voxel loops
+    int   streamMB;     ///< memory for slab by slab conversion [MB], 0 = convert the whole volume at once
+    int   numThreads;   ///< threads for loading files and converting slabs, 0 = one per processor
     int lineAverage;
     int sections;
     int pinhole;
@@ -149,11 +156,21 @@ class vvConv
     int chan[3];
     int mergeType;    ///< 0=none specified, 1=volume, 2=animation
     
+    struct Sources;
+    struct Stream;
+
     bool readVolumeData();
+    static void loadSourceFile(void*, size_t);
+    static bool mergeSourceFile(void*, size_t);
     bool writeVolumeData();
+    bool importTransferFunctions(vvVolDesc*);
+    const char* prepareStreaming(vvVolDesc*, std::vector<uint64_t>&);
+    bool streamVolumeData(vvVolDesc*, const std::vector<uint64_t>&);
+    static void convertSlab(void*, size_t);
+    static bool writeSlab(void*, size_t);
     void displayHelpInfo();
     bool parseCommandLine(int, char**);
-    void modifyInputFile(vvVolDesc*);
+    void modifyInputFile(vvVolDesc*, bool verbose = true);
     void modifyOutputFile(vvVolDesc*);
     int  renameDicomFiles();
 
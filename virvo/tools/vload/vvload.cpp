@@ -0,0 +1,924 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifdef HAVE_CONFIG_H
+#include "vvconfig.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <pthread.h>
+
+#include "vvclock.h"
+#include "vvdebugmsg.h"
+#include "vvfileio.h"
+#include "vvibrimage.h"
+#include "vvimage.h"
+#include "vvload.h"
+#include "vvremoteevents.h"
+#include "vvsocketio.h"
+#include "vvtcpsocket.h"
+#include "vvtoolshed.h"
+#include "vvtransfunc.h"
+#include "vvvoldesc.h"
+#include "vvvolumeupload.h"
+
+using namespace std;
+
+namespace
+{
+
+/// Default port of vserver
+const int DefaultPort = 31050;
+
+/// Volume chunks sent per message
+const size_t ChunksPerMessage = 16;
+
+/// Bytes of the vvImage header
+const size_t ImageHeaderSize = 17 + 4 * vvImage::VV_NUM_SERVER_STAGES;
+
+/// Time stamp of the trace events without one [s]
+const double DefaultFrameTime = 1.0 / 30.0;
+
+/// Percentile of a stage time over some frames [s]
+double percentile(const vector<vvLoad::Frame>& frames, virvo::FrameStats::Stage stage, double p)
+{
+  virvo::FrameStats stats(max(frames.size(), size_t(1)));
+  for (size_t i=0; i<frames.size(); ++i)
+    stats.add(frames[i].times);
+  return stats.percentile(stage, p);
+}
+
+size_t getBytes(const vector<vvLoad::Frame>& frames)
+{
+  size_t bytes = 0;
+  for (size_t i=0; i<frames.size(); ++i)
+    bytes += frames[i].bytes;
+  return bytes;
+}
+
+/// Escape a string for JSON output
+string quote(const string& str)
+{
+  string result = "\"";
+  for (size_t i=0; i<str.size(); ++i)
+  {
+    if (str[i] == '"' || str[i] == '\\')
+      result += '\\';
+    result += str[i];
+  }
+  return result + "\"";
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+/// Constructor
+vvLoad::vvLoad()
+{
+  host        = "localhost";
+  port        = DefaultPort;
+  numSessions = 4;
+  numFrames   = 300;
+  rate        = 30.0f;
+  timeout     = 10.0f;
+  width       = 512;
+  height      = 512;
+  serverType  = vvRenderer::REMOTE_IMAGE;
+  codec       = -1;
+  tfEvery     = 0;
+  synthSize   = 64;
+  uploadFile  = NULL;
+  serverFile  = NULL;
+  traceFile   = NULL;
+  outFile     = NULL;
+  decode      = false;
+  json        = false;
+  showHelp    = false;
+  vd          = NULL;
+}
+
+//----------------------------------------------------------------------------
+/// Destructor
+vvLoad::~vvLoad()
+{
+  delete vd;
+}
+
+//----------------------------------------------------------------------------
+/// Display command usage help on the command line.
+void vvLoad::displayHelpInfo()
+{
+  cerr << "VLoad is a command line utility to measure how many concurrent remote" << endl;
+  cerr << "rendering sessions a vserver sustains. Each session replays a camera" << endl;
+  cerr << "trace at a target frame rate and waits for the images like a client." << endl;
+  cerr << endl;
+  cerr << "Syntax:" << endl;
+  cerr << endl;
+  cerr << "vload [<options>]" << endl;
+  cerr << endl;
+  cerr << "Available options:" << endl;
+  cerr << endl;
+  cerr << "-host <name>" << endl;
+  cerr << " Server host. Default: localhost" << endl;
+  cerr << endl;
+  cerr << "-port <n>" << endl;
+  cerr << " Server port. Default: " << DefaultPort << endl;
+  cerr << endl;
+  cerr << "-sessions <n>" << endl;
+  cerr << " Number of concurrent sessions. Default: 4" << endl;
+  cerr << endl;
+  cerr << "-frames <n>" << endl;
+  cerr << " Frames requested by each session. Default: 300" << endl;
+  cerr << endl;
+  cerr << "-rate <fps>" << endl;
+  cerr << " Frame requests per second and session, 0 replays the trace with its" << endl;
+  cerr << " recorded time stamps. A session never has more than one request" << endl;
+  cerr << " in flight, so slow servers lower the rate. Default: 30" << endl;
+  cerr << endl;
+  cerr << "-timeout <sec>" << endl;
+  cerr << " Time a read of an image may wait for data before the session is" << endl;
+  cerr << " aborted, also within an image. Default: 10" << endl;
+  cerr << endl;
+  cerr << "-size <width> <height>" << endl;
+  cerr << " Image size [pixels]. Default: 512 512" << endl;
+  cerr << endl;
+  cerr << "-ibr" << endl;
+  cerr << " Request images with depth (vvIbrServer) instead of plain images." << endl;
+  cerr << endl;
+  cerr << "-codec <n>" << endl;
+  cerr << " vvImage code type of the images. Default: server default" << endl;
+  cerr << endl;
+  cerr << "-synth <n>" << endl;
+  cerr << " Upload a generated volume of n^3 voxels. Default: 64" << endl;
+  cerr << endl;
+  cerr << "-upload <file>" << endl;
+  cerr << " Upload a volume file instead of a generated volume." << endl;
+  cerr << endl;
+  cerr << "-file <file>" << endl;
+  cerr << " Let the server load a volume file instead of uploading one." << endl;
+  cerr << endl;
+  cerr << "-trace <file>" << endl;
+  cerr << " Camera trace recorded with 'vview -rec' (motion.txt). A line" << endl;
+  cerr << " 'VIRVO_TF <min> <max>' sends a transfer function with an alpha ramp" << endl;
+  cerr << " from min to max before the next camera. Default: orbit about the volume" << endl;
+  cerr << endl;
+  cerr << "-tfevery <n>" << endl;
+  cerr << " Send a transfer function every n frames of the orbit. Default: 0 = never" << endl;
+  cerr << endl;
+  cerr << "-decode" << endl;
+  cerr << " Decode the images, the decode time is part of the latency." << endl;
+  cerr << endl;
+  cerr << "-json" << endl;
+  cerr << " Write results as JSON. Default is a table." << endl;
+  cerr << endl;
+  cerr << "-o <file>" << endl;
+  cerr << " Write results to a file instead of stdout." << endl;
+  cerr << endl;
+  cerr << "-help" << endl;
+  cerr << " Display this help information." << endl;
+  cerr << endl;
+  cerr << "Examples:" << endl;
+  cerr << "vload -sessions 8 -rate 20 -synth 128" << endl;
+  cerr << "vload -sessions 2 -file /data/head.xvf -trace motion.txt -rate 0 -json" << endl;
+  cerr << endl;
+}
+
+//----------------------------------------------------------------------------
+/** Parse command line arguments.
+  @return true if parsing was successful
+*/
+bool vvLoad::parseCommandLine(int argc, char** argv)
+{
+  for (int arg=1; arg<argc; ++arg)
+  {
+    if (vvToolshed::strCompare(argv[arg], "-help")==0 ||
+        vvToolshed::strCompare(argv[arg], "-h")==0 ||
+        vvToolshed::strCompare(argv[arg], "-?")==0 ||
+        vvToolshed::strCompare(argv[arg], "/?")==0)
+    {
+      showHelp = true;
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-host")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Host name missing." << endl;
+        return false;
+      }
+      host = argv[arg];
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-port")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Port missing." << endl;
+        return false;
+      }
+      port = atoi(argv[arg]);
+      if (port < 1 || port > 65535)
+      {
+        cerr << "Invalid port." << endl;
+        return false;
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-sessions")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Number of sessions missing." << endl;
+        return false;
+      }
+      numSessions = atoi(argv[arg]);
+      if (numSessions < 1)
+      {
+        cerr << "Invalid number of sessions." << endl;
+        return false;
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-frames")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Number of frames missing." << endl;
+        return false;
+      }
+      numFrames = atoi(argv[arg]);
+      if (numFrames < 1)
+      {
+        cerr << "Invalid number of frames." << endl;
+        return false;
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-rate")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Frame rate missing." << endl;
+        return false;
+      }
+      rate = (float)strtod(argv[arg], NULL);
+      if (rate < 0.0f)
+      {
+        cerr << "Invalid frame rate." << endl;
+        return false;
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-timeout")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Timeout missing." << endl;
+        return false;
+      }
+      timeout = (float)strtod(argv[arg], NULL);
+      if (timeout <= 0.0f)
+      {
+        cerr << "Invalid timeout." << endl;
+        return false;
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-size")==0)
+    {
+      if (arg+2>=argc)
+      {
+        cerr << "Image size missing." << endl;
+        return false;
+      }
+      width  = atoi(argv[++arg]);
+      height = atoi(argv[++arg]);
+      if (width < 1 || height < 1)
+      {
+        cerr << "Invalid image size." << endl;
+        return false;
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-ibr")==0)
+    {
+      serverType = vvRenderer::REMOTE_IBR;
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-codec")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Code type missing." << endl;
+        return false;
+      }
+      codec = atoi(argv[arg]);
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-synth")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Volume size missing." << endl;
+        return false;
+      }
+      synthSize = atoi(argv[arg]);
+      if (synthSize < 2)
+      {
+        cerr << "Invalid volume size." << endl;
+        return false;
+      }
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-upload")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Volume file name missing." << endl;
+        return false;
+      }
+      uploadFile = argv[arg];
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-file")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Volume file name missing." << endl;
+        return false;
+      }
+      serverFile = argv[arg];
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-trace")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Trace file name missing." << endl;
+        return false;
+      }
+      traceFile = argv[arg];
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-tfevery")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Number of frames missing." << endl;
+        return false;
+      }
+      tfEvery = atoi(argv[arg]);
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-decode")==0)
+    {
+      decode = true;
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-json")==0)
+    {
+      json = true;
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-o")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Output file name missing." << endl;
+        return false;
+      }
+      outFile = argv[arg];
+    }
+    else
+    {
+      cerr << "Unknown option/parameter: \"" << argv[arg] << "\", use -help for instructions." << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/** Load or generate the volume the sessions upload.
+  @return false if the volume file cannot be loaded
+*/
+bool vvLoad::loadVolume()
+{
+  delete vd;
+
+  if (uploadFile != NULL)
+  {
+    vd = new vvVolDesc(uploadFile);
+    vvFileIO* fio = new vvFileIO();
+    bool ok = fio->loadVolumeData(vd) == vvFileIO::OK;
+    delete fio;
+    if (!ok)
+    {
+      cerr << "Cannot load volume file: " << uploadFile << endl;
+      return false;
+    }
+  }
+  else
+  {
+    vd = new vvVolDesc();
+    vd->computeVolume(1, synthSize, synthSize, synthSize);
+    vd->cropTimesteps(0, 1);
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/** Read the camera trace. Cameras are written by vvObjView::saveMV(), the
+  comment after each camera holds its time stamp.
+  @return false if the file cannot be read or has no cameras
+*/
+bool vvLoad::loadTrace()
+{
+  ifstream in(traceFile);
+  if (!in)
+  {
+    cerr << "Cannot read trace file: " << traceFile << endl;
+    return false;
+  }
+
+  trace.clear();
+  bool tf = false;
+  float tfMin = 0.0f;
+  float tfMax = 1.0f;
+  string line;
+  while (getline(in, line))
+  {
+    istringstream words(line);
+    string word;
+    if (!(words >> word))
+      continue;
+
+    if (word == "VIRVO_CAMERA")
+    {
+      Event e;
+      e.time = trace.empty() ? 0.0 : trace.back().time + DefaultFrameTime;
+      e.tf = tf;
+      e.tfMin = tfMin;
+      e.tfMax = tfMax;
+      for (size_t i=0; i<4; ++i)
+        for (size_t j=0; j<4; ++j)
+          in >> e.mv(i, j);
+      if (!in)
+      {
+        cerr << "Invalid camera in trace file: " << traceFile << endl;
+        return false;
+      }
+      trace.push_back(e);
+      tf = false;
+    }
+    else if (word == "VIRVO_TF")
+    {
+      tf = bool(words >> tfMin >> tfMax);
+    }
+    else if (word == "#" && !trace.empty())
+    {
+      double t;
+      if (words >> t)
+        trace.back().time = t;
+    }
+  }
+
+  if (trace.empty())
+  {
+    cerr << "No cameras in trace file: " << traceFile << endl;
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/// Generate an orbit about the volume's y axis, like vview's default view
+void vvLoad::generateOrbit()
+{
+  const int steps = 180;
+
+  trace.clear();
+  for (int i=0; i<steps; ++i)
+  {
+    Event e;
+    e.time = double(i) * DefaultFrameTime;
+    e.mv.identity();
+    e.mv.translate(0.0f, 0.0f, -2.0f);
+    e.mv.rotate(2.0f * float(VV_PI) * float(i) / float(steps), 0.0f, 1.0f, 0.0f);
+    e.tf = tfEvery > 0 && i % tfEvery == 0 && i > 0;
+    e.tfMin = 0.1f * float(i % 5);
+    e.tfMax = 1.0f;
+    trace.push_back(e);
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Connect a session, configure the remote server and send the volume.
+  @return false on errors, they are added to the session
+*/
+bool vvLoad::setupSession(Session& s, vvSocketIO& io) const
+{
+  const double start = vvClock::getTime();
+
+  // vvRemoteClient and vview send these events the same way
+  io.beginMessage();
+  vvSocket::ErrorType err = io.putEvent(virvo::RemoteServerType);
+  if (err == vvSocket::VV_OK)
+    err = io.putRendererType(serverType);
+  if (err == vvSocket::VV_OK)
+    err = io.putEvent(virvo::WindowResize);
+  if (err == vvSocket::VV_OK)
+    err = io.putWinDims(width, height);
+  if (err == vvSocket::VV_OK && codec >= 0)
+  {
+    err = io.putEvent(virvo::Parameter1I);
+    if (err == vvSocket::VV_OK)
+      err = io.putInt32(vvRenderer::VV_CODEC);
+    if (err == vvSocket::VV_OK)
+      err = io.putInt32(codec);
+  }
+  if (io.endMessage() != vvSocket::VV_OK || err != vvSocket::VV_OK)
+  {
+    s.errors.push_back("cannot configure the remote server");
+    return false;
+  }
+
+  if (serverFile != NULL)
+  {
+    io.beginMessage();
+    err = io.putEvent(virvo::VolumeFile);
+    if (err == vvSocket::VV_OK)
+      err = io.putFileName(serverFile);
+    if (io.endMessage() != vvSocket::VV_OK || err != vvSocket::VV_OK)
+    {
+      s.errors.push_back("cannot send the volume file name");
+      return false;
+    }
+  }
+  else
+  {
+    const uint64_t id = virvo::VolumeUpload::computeId(vd);
+
+    io.beginMessage();
+    err = io.putEvent(virvo::VolumeHeader);
+    if (err == vvSocket::VV_OK)
+      err = io.putVolumeAttributes(vd);
+    if (err == vvSocket::VV_OK)
+      err = io.putInt32(int(id >> 32));
+    if (err == vvSocket::VV_OK)
+      err = io.putInt32(int(id & 0xFFFFFFFF));
+    if (io.endMessage() != vvSocket::VV_OK || err != vvSocket::VV_OK)
+    {
+      s.errors.push_back("cannot send the volume header");
+      return false;
+    }
+
+    int received = 0;
+    if (io.getInt32(received) != vvSocket::VV_OK || received < 0)
+    {
+      s.errors.push_back("server cannot accommodate the volume");
+      return false;
+    }
+
+    const size_t numChunks = virvo::VolumeUpload::getNumChunks(vd);
+    for (size_t next = size_t(received); next < numChunks; next += ChunksPerMessage)
+    {
+      const size_t count = min(ChunksPerMessage, numChunks - next);
+      io.beginMessage();
+      err = io.putEvent(virvo::VolumeChunks);
+      if (err == vvSocket::VV_OK)
+        err = io.putInt32(int(count));
+      if (err == vvSocket::VV_OK)
+        err = io.putVolumeChunks(vd, next, count);
+      if (io.endMessage() != vvSocket::VV_OK || err != vvSocket::VV_OK)
+      {
+        s.errors.push_back("cannot send the volume data");
+        return false;
+      }
+    }
+  }
+
+  s.setupTime = vvClock::getTime() - start;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/** Request the frames of a session and wait for each image.
+*/
+void vvLoad::replay(Session& s, vvSocketIO& io) const
+{
+  // every read waits at most timeout seconds, so a server that stops in the
+  // middle of an image does not block the session
+  io.getSocket()->setParameter(vvSocket::VV_RECV_TIMEOUT, timeout);
+
+  vvImage* image = (serverType == vvRenderer::REMOTE_IBR) ? new vvIbrImage : new vvImage;
+
+  // the trace is repeated as often as needed
+  const double traceLength = trace.back().time - trace.front().time + DefaultFrameTime;
+
+  // spread the sessions over a frame so they do not request in lockstep
+  const double offset = (rate > 0.0f) ? double(s.id) / (double(rate) * double(numSessions)) : 0.0;
+  const double start = vvClock::getTime() + offset;
+
+  for (int i=0; i<numFrames; ++i)
+  {
+    const Event& e = trace[size_t(i) % trace.size()];
+
+    double due = 0.0;
+    if (rate > 0.0f)
+      due = double(i) / double(rate);
+    else
+      due = double(i / trace.size()) * traceLength + e.time - trace.front().time;
+    const double wait = start + due - vvClock::getTime();
+    if (wait > 0.0)
+      vvToolshed::sleep(int(wait * 1000.0));
+
+    vvSocket::ErrorType err = vvSocket::VV_OK;
+    if (e.tf)
+    {
+      vvTransFunc tf;
+      tf.setDefaultColors(0, 0.0f, 1.0f);
+      tf.setDefaultAlpha(0, e.tfMin, e.tfMax);
+      io.beginMessage();
+      err = io.putEvent(virvo::TransFunc);
+      if (err == vvSocket::VV_OK)
+        err = io.putTransferFunction(tf);
+      io.endMessage();
+    }
+
+    const double requested = vvClock::getTime();
+    vvMatrix mv = e.mv;
+    vvMatrix p = pr;
+    io.beginMessage();
+    if (err == vvSocket::VV_OK)
+      err = io.putEvent(virvo::CameraMatrix);
+    if (err == vvSocket::VV_OK)
+      err = io.putMatrix(&p);
+    if (err == vvSocket::VV_OK)
+      err = io.putMatrix(&mv);
+    if (io.endMessage() != vvSocket::VV_OK || err != vvSocket::VV_OK)
+    {
+      s.errors.push_back("cannot send frame request");
+      break;
+    }
+
+    const double reading = vvClock::getTime();
+    Frame f;
+    if (serverType == vvRenderer::REMOTE_IBR)
+    {
+      vvIbrImage* ibr = static_cast<vvIbrImage*>(image);
+      err = io.getIbrImage(ibr);
+      f.bytes = ImageHeaderSize + size_t(ibr->getSize()) + size_t(ibr->getDepthSize());
+    }
+    else
+    {
+      err = io.getImage(image);
+      f.bytes = ImageHeaderSize + size_t(image->getSize());
+    }
+    if (err == vvSocket::VV_READ_ERROR && vvClock::getTime() - reading >= double(timeout))
+    {
+      // a read waited for the timeout, before or within the image
+      ++s.timeouts;
+      ostringstream msg;
+      msg << "image for frame " << i << " stalled for " << timeout << "s";
+      s.errors.push_back(msg.str());
+      break;
+    }
+    if (err != vvSocket::VV_OK)
+    {
+      s.errors.push_back(err == vvSocket::VV_PEER_SHUTDOWN ? "server closed the connection" : "cannot receive image");
+      break;
+    }
+    if (image->getCodeType() == vvImage::VV_VIDEO)
+      f.bytes += size_t(image->getVideoSize());
+
+    const double received = vvClock::getTime();
+    if (decode && image->getSize() > 0 && image->decode() != 0)
+      s.errors.push_back("cannot decode image");
+    const double decoded = vvClock::getTime();
+
+    double* t = f.times;
+    t[virvo::FrameStats::Queue] = image->getStageTime(vvImage::VV_QUEUED);
+    t[virvo::FrameStats::Render] = image->getStageTime(vvImage::VV_RENDERED);
+    t[virvo::FrameStats::Encode] = image->getStageTime(vvImage::VV_ENCODED);
+    const double server = t[virvo::FrameStats::Queue] + t[virvo::FrameStats::Render] + t[virvo::FrameStats::Encode];
+    t[virvo::FrameStats::Network] = max(received - requested - server, 0.0);
+    t[virvo::FrameStats::Decode] = decoded - received;
+    t[virvo::FrameStats::Display] = 0.0;
+    t[virvo::FrameStats::Total] = decoded - requested;
+    s.frames.push_back(f);
+  }
+  s.duration = vvClock::getTime() - start;
+
+  delete image;
+}
+
+//----------------------------------------------------------------------------
+/// Thread function of a session
+void* vvLoad::runSession(void* param)
+{
+  Session* s = static_cast<Session*>(param);
+
+  vvTcpSocket* sock = new vvTcpSocket;
+  if (sock->connectToHost(s->load->host, ushort(s->load->port)) != vvSocket::VV_OK)
+  {
+    s->errors.push_back("cannot connect to " + s->load->host);
+    delete sock;
+    return NULL;
+  }
+  sock->setParameter(vvSocket::VV_NO_NAGLE, true);
+
+  vvSocketIO io(sock);
+  if (s->load->setupSession(*s, io))
+  {
+    s->load->replay(*s, io);
+  }
+
+  io.putEvent(virvo::Disconnect);
+  sock->disconnectFromHost();
+  delete sock;
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+/// Write one line per session and one for all sessions
+void vvLoad::writeText(ostream& out) const
+{
+  // all sessions: frames per second of the longest session
+  vector<Frame> all;
+  double setup = 0.0;
+  double duration = 0.0;
+  int timeouts = 0;
+  size_t errors = 0;
+
+  out.setf(ios::fixed, ios::floatfield);
+  out.precision(2);
+  out << "session  frames     fps  setup s  p50 ms  p90 ms  p99 ms  render  network    MB/s  timeouts  errors" << endl;
+  for (size_t i=0; i<sessions.size()+1; ++i)
+  {
+    const bool total = i == sessions.size();
+    const vector<Frame>& frames = total ? all : sessions[i].frames;
+    const double d = total ? duration : sessions[i].duration;
+    const double fps = d > 0.0 ? double(frames.size()) / d : 0.0;
+
+    if (total)
+      out << "all    ";
+    else
+      out << setw(7) << sessions[i].id;
+    out << setw(8) << frames.size()
+        << setw(8) << fps
+        << setw(9) << (total ? setup : sessions[i].setupTime)
+        << setw(8) << percentile(frames, virvo::FrameStats::Total, 0.5) * 1000.0
+        << setw(8) << percentile(frames, virvo::FrameStats::Total, 0.9) * 1000.0
+        << setw(8) << percentile(frames, virvo::FrameStats::Total, 0.99) * 1000.0
+        << setw(8) << percentile(frames, virvo::FrameStats::Render, 0.5) * 1000.0
+        << setw(9) << percentile(frames, virvo::FrameStats::Network, 0.5) * 1000.0
+        << setw(8) << (d > 0.0 ? double(getBytes(frames)) / d / 1048576.0 : 0.0)
+        << setw(10) << (total ? timeouts : sessions[i].timeouts)
+        << setw(8) << (total ? errors : sessions[i].errors.size()) << endl;
+
+    if (!total)
+    {
+      all.insert(all.end(), sessions[i].frames.begin(), sessions[i].frames.end());
+      setup = max(setup, sessions[i].setupTime);
+      duration = max(duration, sessions[i].duration);
+      timeouts += sessions[i].timeouts;
+      errors += sessions[i].errors.size();
+    }
+  }
+
+  for (size_t i=0; i<sessions.size(); ++i)
+  {
+    for (size_t j=0; j<sessions[i].errors.size(); ++j)
+      out << "session " << sessions[i].id << ": " << sessions[i].errors[j] << endl;
+  }
+}
+
+//----------------------------------------------------------------------------
+/// Write the results as JSON
+void vvLoad::writeJSON(ostream& out) const
+{
+  out << "[" << endl;
+  for (size_t i=0; i<sessions.size(); ++i)
+  {
+    const Session& s = sessions[i];
+    out << "  { \"session\": " << s.id
+        << ", \"frames\": " << s.frames.size()
+        << ", \"fps\": " << (s.duration > 0.0 ? double(s.frames.size()) / s.duration : 0.0)
+        << ", \"setup_s\": " << s.setupTime
+        << ", \"bytes\": " << getBytes(s.frames)
+        << ", \"duration_s\": " << s.duration;
+    for (int st=0; st<virvo::FrameStats::NumStages; ++st)
+    {
+      const virvo::FrameStats::Stage stage = static_cast<virvo::FrameStats::Stage>(st);
+      out << ", " << quote(string(virvo::FrameStats::getName(stage)) + "_ms") << ": ["
+          << percentile(s.frames, stage, 0.5) * 1000.0 << ", "
+          << percentile(s.frames, stage, 0.9) * 1000.0 << ", "
+          << percentile(s.frames, stage, 0.99) * 1000.0 << "]";
+    }
+    out << ", \"timeouts\": " << s.timeouts
+        << ", \"errors\": [";
+    for (size_t j=0; j<s.errors.size(); ++j)
+      out << (j > 0 ? ", " : "") << quote(s.errors[j]);
+    out << "] }" << (i+1 < sessions.size() ? "," : "") << endl;
+  }
+  out << "]" << endl;
+}
+
+//----------------------------------------------------------------------------
+/** Main routine.
+  @param argc,argv command line arguments
+  @return 0 if the sessions ran without errors, 1 otherwise
+*/
+int vvLoad::run(int argc, char** argv)
+{
+  if (!parseCommandLine(argc, argv))
+    return 1;
+
+  if (showHelp)
+  {
+    displayHelpInfo();
+    return 0;
+  }
+
+  if (serverFile == NULL && !loadVolume())
+    return 1;
+
+  if (traceFile != NULL)
+  {
+    if (!loadTrace())
+      return 1;
+  }
+  else
+  {
+    generateOrbit();
+  }
+
+  // vview's perspective projection
+  const float aspect = float(width) / float(height);
+  const float zNear = 0.01f;
+  const float yHalf = zNear * tanf(45.0f * float(VV_PI) / 360.0f);
+  pr.setProjPersp(-yHalf * aspect, yHalf * aspect, -yHalf, yHalf, zNear, 100.0f);
+
+  sessions.resize(numSessions);
+  for (int i=0; i<numSessions; ++i)
+  {
+    sessions[i].load = this;
+    sessions[i].id = i;
+    sessions[i].setupTime = 0.0;
+    sessions[i].duration = 0.0;
+    sessions[i].timeouts = 0;
+  }
+
+  vector<pthread_t> threads(numSessions);
+  for (int i=0; i<numSessions; ++i)
+    pthread_create(&threads[i], NULL, runSession, &sessions[i]);
+  for (int i=0; i<numSessions; ++i)
+    pthread_join(threads[i], NULL);
+
+  if (outFile != NULL)
+  {
+    ofstream out(outFile);
+    if (!out)
+    {
+      cerr << "Cannot write to file: " << outFile << endl;
+      return 1;
+    }
+    if (json) writeJSON(out);
+    else writeText(out);
+  }
+  else
+  {
+    if (json) writeJSON(cout);
+    else writeText(cout);
+  }
+
+  for (int i=0; i<numSessions; ++i)
+  {
+    if (!sessions[i].errors.empty())
+      return 1;
+  }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+/// Main function for the load generator
+int main(int argc, char* argv[])
+{
+  vvLoad* vload = new vvLoad();
+  int error = vload->run(argc, argv);
+  delete vload;
+  return error;
+}
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
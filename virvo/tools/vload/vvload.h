@@ -0,0 +1,121 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef _VVLOAD_H_
+#define _VVLOAD_H_
+
+#include "vvframestats.h"
+#include "vvrenderer.h"
+#include "vvvecmath.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class vvSocketIO;
+class vvVolDesc;
+
+/** Synthetic load generator for vserver.
+  Opens a number of sessions against a server, each on its own thread and
+  through the same vvSocketIO protocol as vvRemoteClient. Every session
+  uploads a volume (or names a file on the server), then replays a camera
+  trace recorded with 'vview -rec' or a generated orbit at a target frame
+  rate, waiting for each image before it requests the next one. Frame
+  rates, latency percentiles, throughput and errors are reported for each
+  session and for all sessions together.
+  Usage: type 'vload -help' to get a list of command line parameters.
+*/
+class vvLoad
+{
+  public:
+    struct Event                  ///< one step of the trace
+    {
+      double time;                ///< time since the start of the trace [s]
+      vvMatrix mv;                ///< modelview matrix of the frame request
+      bool tf;                    ///< send a transfer function before the frame
+      float tfMin;                ///< alpha ramp of the transfer function [0..1]
+      float tfMax;
+    };
+
+    struct Frame                  ///< measurements of a frame
+    {
+      double times[virvo::FrameStats::NumStages];
+      size_t bytes;               ///< size of the image message
+    };
+
+    struct Session
+    {
+      const vvLoad* load;
+      int id;
+      std::vector<Frame> frames;
+      std::vector<std::string> errors;
+      double setupTime;           ///< connect and volume transfer [s]
+      double duration;            ///< time from the first frame request to the last image [s]
+      int timeouts;               ///< frames the server did not answer in time
+    };
+
+  private:
+    std::string host;             ///< server host name
+    int   port;                   ///< server port
+    int   numSessions;            ///< concurrent sessions
+    int   numFrames;              ///< frames per session
+    float rate;                   ///< frame requests per second and session, 0 = trace time stamps
+    float timeout;                ///< time a read of an image waits for data [s]
+    int   width;                  ///< image size [pixels]
+    int   height;
+    vvRenderer::RendererType serverType; ///< REMOTE_IMAGE or REMOTE_IBR
+    int   codec;                  ///< vvImage code type, -1 = server default
+    int   tfEvery;                ///< send a transfer function every n frames of an orbit, 0 = never
+    int   synthSize;              ///< edge length of the synthetic volume [voxels]
+    char* uploadFile;             ///< volume file to upload, NULL = synthetic volume
+    char* serverFile;             ///< volume file to load on the server
+    char* traceFile;              ///< camera trace recorded with 'vview -rec'
+    char* outFile;                ///< output file name, NULL for stdout
+    bool  decode;                 ///< decode the images like a client does
+    bool  json;                   ///< true = JSON output, false = text output
+    bool  showHelp;               ///< display help information
+    vvVolDesc* vd;                ///< volume to upload
+    std::vector<Event> trace;     ///< camera and transfer function events
+    vvMatrix pr;                  ///< projection matrix of all frames
+    std::vector<Session> sessions;
+
+    bool parseCommandLine(int, char**);
+    void displayHelpInfo();
+    bool loadVolume();
+    bool loadTrace();
+    void generateOrbit();
+    static void* runSession(void*);
+    bool setupSession(Session&, vvSocketIO&) const;
+    void replay(Session&, vvSocketIO&) const;
+    void writeText(std::ostream&) const;
+    void writeJSON(std::ostream&) const;
+
+  public:
+    vvLoad();
+    ~vvLoad();
+    int run(int, char**);
+};
+
+#endif
+
+//============================================================================
+// End of File
+//============================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -142,7 +142,8 @@ void vvResourceManager::handleNextConnection(vvTcpSocket *sock)
   switch(_sm)
   {
   case vvServer::SERVER:
-    _simpleServer->handleNextConnection(sock);
+    // events are handled by the simple server, but on this server's event loop
+    addSession(_simpleServer, sock);
     break;
   case vvServer::RM:
   case vvServer::RM_WITH_SERVER:
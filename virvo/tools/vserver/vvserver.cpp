@@ -25,6 +25,7 @@
 
 #include "vvresourcemanager.h"
 #include "vvserver.h"
+#include "vvvolumecache.h"
 
 #include <virvo/vvdebugmsg.h>
 #include <virvo/vvfileio.h>
@@ -32,11 +33,15 @@
 #include <virvo/vvimageserver.h>
 #include <virvo/vvremoteserver.h>
 #include <virvo/vvsocketio.h>
+#include <virvo/vvsocketmonitor.h>
 #include <virvo/vvtcpserver.h>
 #include <virvo/vvtcpsocket.h>
 #include <virvo/vvtoolshed.h>
+#include <virvo/vvtrace.h>
 #include <virvo/vvvirvo.h>
 #include <virvo/vvvoldesc.h>
+#include <virvo/vvvolumeupload.h>
+#include <virvo/vvworkerpool.h>
 
 #include <virvo/private/vvgltools.h>
 
@@ -53,6 +58,29 @@
 const int            vvServer::DEFAULTSIZE  = 512;
 const unsigned short vvServer::DEFAULT_PORT = 31050;
 
+namespace
+{
+  // Interrupted uploads kept for resuming, each holds a whole volume
+  const size_t MaxInterruptedUploads = 2;
+}
+
+struct vvServer::Session
+{
+  vvServer    *owner;     ///< server running the event loop
+  vvServer    *handler;   ///< server handling the events
+  vvTcpSocket *sock;
+  vvSocketIO   io;
+  ThreadData   tData;
+
+  Session(vvServer* owner, vvServer* handler, vvTcpSocket* sock)
+    : owner(owner)
+    , handler(handler)
+    , sock(sock)
+    , io(sock)
+  {
+  }
+};
+
 vvServer::ThreadData::ThreadData()
   : renderContext(NULL)
   , server(NULL)
@@ -61,6 +89,7 @@ vvServer::ThreadData::ThreadData()
   , renderer(NULL)
   , vd(NULL)
   , request(NULL)
+  , upload(NULL)
 {}
 
 vvServer::ThreadData::~ThreadData()
@@ -68,7 +97,12 @@ vvServer::ThreadData::~ThreadData()
   delete renderContext;
   delete server;
   delete renderer;
-  delete vd;
+  if (upload != NULL && vd == upload->getVolDesc())
+  {
+    vd = NULL;
+  }
+  delete upload;
+  vvVolumeCache::instance().release(vd);
 }
 
 vvServer::vvServer(bool useBonjour)
@@ -77,11 +111,19 @@ vvServer::vvServer(bool useBonjour)
   , _useBonjour(useBonjour)
   , _daemonize(false)
   , _daemonName("voxserver")
+  , _numWorkers(0)
+  , _monitor(NULL)
 {
 }
 
 vvServer::~vvServer()
-{}
+{
+  for (std::map<uint64_t, virvo::VolumeUpload*>::iterator it = _uploads.begin();
+       it != _uploads.end(); ++it)
+  {
+    delete it->second;
+  }
+}
 
 int vvServer::run(int argc, char** argv)
 {
@@ -191,6 +233,17 @@ void vvServer::displayHelpInfo()
   std::cerr << "-debug" << std::endl;
   std::cerr << " Set debug level" << std::endl;
   std::cerr << std::endl;
+  std::cerr << "-trace <file>" << std::endl;
+  std::cerr << " Record zones and counters and write them as Chrome trace-event" << std::endl;
+  std::cerr << " JSON to <file> after each session (view with chrome://tracing)" << std::endl;
+  std::cerr << std::endl;
+  std::cerr << "-cache <MB>" << std::endl;
+  std::cerr << " Memory for volume files no longer in use, kept for later sessions" << std::endl;
+  std::cerr << " (default: 0, files are only shared while in use)" << std::endl;
+  std::cerr << std::endl;
+  std::cerr << "-workers <n>" << std::endl;
+  std::cerr << " Number of threads handling client events (default: one per processor)" << std::endl;
+  std::cerr << std::endl;
 }
 
 bool vvServer::parseCommandLine(int argc, char** argv)
@@ -296,6 +349,45 @@ bool vvServer::parseCommandLine(int argc, char** argv)
         return false;
       }
     }
+    else if (vvToolshed::strCompare(argv[arg], "-trace")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        std::cerr << "Trace file name missing." << std::endl;
+        return false;
+      }
+      _traceFile = argv[arg];
+      virvo::trace::setEnabled(true);
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-cache")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        std::cerr << "Cache size missing." << std::endl;
+        return false;
+      }
+      const int mb = atoi(argv[arg]);
+      if (mb < 0)
+      {
+        std::cerr << "Invalid cache size." << std::endl;
+        return false;
+      }
+      vvVolumeCache::instance().setBudget(size_t(mb) << 20);
+    }
+    else if (vvToolshed::strCompare(argv[arg], "-workers")==0)
+    {
+      if ((++arg)>=argc)
+      {
+        std::cerr << "Number of workers missing." << std::endl;
+        return false;
+      }
+      _numWorkers = atoi(argv[arg]);
+      if (_numWorkers <= 0)
+      {
+        std::cerr << "Invalid number of workers." << std::endl;
+        return false;
+      }
+    }
     else
     {
       std::cerr << "Unknown option/parameter: \"" << argv[arg] << "\", use -help for instructions" << std::endl;
@@ -307,7 +399,7 @@ bool vvServer::parseCommandLine(int argc, char** argv)
 
 bool vvServer::serverLoop()
 {
-  vvTcpServer tcpServ = vvTcpServer(_port);
+  vvTcpServer tcpServ(_port);
 
   if(!tcpServ.initStatus())
   {
@@ -315,45 +407,136 @@ bool vvServer::serverLoop()
     return false;
   }
 
-  while (1)
-  {
-    std::cerr << "Listening on port " << _port << std::endl;
+  virvo::WorkerPool workers(_numWorkers, "vserver worker");
+
+  vvSocketMonitor monitor;
+  monitor.add(tcpServ.getSocket(), vvSocketMonitor::VV_READABLE);
+  _monitor = &monitor;
 
-    vvTcpSocket *sock = NULL;
+  std::cerr << "Listening on port " << _port << " (" << workers.size() << " workers)" << std::endl;
 
-    while((sock = tcpServ.nextConnection()) == NULL)
+  // Sessions re-armed by the workers are only seen when wait() returns
+  // if the monitor is built on select()
+  double timeout = vvSocketMonitor::concurrentUpdates() ? -1.0 : 0.01;
+
+  std::vector<vvSocketMonitor::Event> events;
+  while (1)
+  {
+    double to = timeout;
+    vvSocketMonitor::ErrorType err = monitor.wait(events, &to);
+    if (err == vvSocketMonitor::VV_ERROR)
     {
-      vvDebugMsg::msg(3, "vvServer::serverLoop() Listening socket busy, retry...");
+      vvDebugMsg::msg(2, "vvServer::serverLoop() waiting for events failed, retry...");
+      continue;
     }
 
-    if(sock == NULL)
+    for (std::vector<vvSocketMonitor::Event>::const_iterator it = events.begin(); it != events.end(); ++it)
     {
-      std::cerr << "vvServer::serverLoop() Failed to initialize server-socket on port " << _port << std::endl;
-      break;
+      if (it->userData == NULL)
+      {
+        // listening socket
+        vvTcpSocket *sock = NULL;
+        while ((sock = tcpServ.acceptConnection()) != NULL)
+        {
+          std::cerr << "Incoming connection..." << std::endl;
+          handleNextConnection(sock);
+        }
+      }
+      else
+      {
+        // the session stays disarmed until the worker has handled the event
+        workers.submit(processSession, it->userData);
+      }
     }
-    else
+  }
+
+  _monitor = NULL;
+  return true;
+}
+
+void vvServer::addSession(vvServer* handler, vvTcpSocket* sock)
+{
+  vvDebugMsg::msg(3, "vvServer::addSession()");
+
+  Session* session = new Session(this, handler, sock);
+  if (!_monitor->add(sock, vvSocketMonitor::VV_READABLE | vvSocketMonitor::VV_ONESHOT, session))
+  {
+    vvDebugMsg::msg(0, "vvServer::addSession() cannot watch client socket");
+    sock->disconnectFromHost();
+    delete sock;
+    delete session;
+  }
+}
+
+void vvServer::processSession(void* param)
+{
+  Session* session = static_cast<Session*>(param);
+  ThreadData* tData = &session->tData;
+
+  // the previous event may have been handled by another thread
+  if (tData->renderContext != NULL)
+  {
+    tData->renderContext->makeCurrent();
+  }
+
+  // drain the events the client has sent so far: events already received
+  // with a previous frame do not wake up the monitor, and the remote server
+  // coalesces the updates that arrive together
+  bool keep = false;
+  do
+  {
+    virvo::RemoteEvent event;
+    keep = session->io.getEvent(event) == vvSocket::VV_OK
+        && session->handler->handleEvent(tData, event, session->io);
+  }
+  while (keep && session->io.hasPendingData());
+
+  if (keep)
+  {
+    if (tData->renderContext != NULL)
     {
-      std::cerr << "Incoming connection..." << std::endl;
-      handleNextConnection(sock);
+      tData->renderContext->doneCurrent();
     }
+    session->owner->_monitor->modify(session->sock, vvSocketMonitor::VV_READABLE | vvSocketMonitor::VV_ONESHOT, session);
+    return;
   }
 
-  return true;
+  session->handler->handleEvent(tData, virvo::Disconnect, session->io);
+
+  vvServer* owner = session->owner;
+  vvTcpSocket* sock = session->sock;
+
+  owner->_monitor->remove(sock);
+  sock->disconnectFromHost();
+  delete session;
+  delete sock;
+
+  owner->writeTrace();
 }
 
 bool vvServer::handleEvent(ThreadData *tData, const virvo::RemoteEvent event, const vvSocketIO& io)
 {
+  // updates deferred by the remote server precede any other event
+  if (tData->server != NULL && tData->renderer != NULL
+      && event != virvo::Disconnect && !vvRemoteServer::isRenderEvent(event))
+  {
+    tData->server->flush(tData->renderer);
+  }
+
   switch (event)
   {
   case virvo::Volume:
-    delete tData->vd;
+    discardUpload(tData);
+    delete tData->renderer;
+    tData->renderer = NULL;
+    vvVolumeCache::instance().release(tData->vd);
     tData->vd = new vvVolDesc;
 
     switch (io.getVolume(tData->vd))
     {
     case vvSocket::VV_OK:
       vvDebugMsg::msg(1, "Volume transferred successfully");
-      return true;
+      break;
     case vvSocket::VV_ALLOC_ERROR:
       vvDebugMsg::msg(0, "Not enough memory to accomodate volume");
       delete tData->vd;
@@ -381,15 +564,16 @@ bool vvServer::handleEvent(ThreadData *tData, const virvo::RemoteEvent event, co
       std::string fn;
       io.getFileName(fn);
       vvDebugMsg::msg(1, "Load volume from file: ", fn.c_str());
-      delete tData->vd;
-      tData->vd = new vvVolDesc(fn.c_str());
-
-      vvFileIO fio;
-      if (fio.loadVolumeData(tData->vd) != vvFileIO::OK)
+      discardUpload(tData);
+      delete tData->renderer;
+      tData->renderer = NULL;
+      vvVolumeCache::instance().release(tData->vd);
+
+      // sessions opening the same file share its voxel data
+      tData->vd = vvVolumeCache::instance().acquire(fn);
+      if (tData->vd == NULL)
       {
         vvDebugMsg::msg(0, "Error loading volume file");
-        delete tData->vd;
-        tData->vd = NULL;
         return true;
       }
       else
@@ -413,18 +597,12 @@ bool vvServer::handleEvent(ThreadData *tData, const virvo::RemoteEvent event, co
           return true;
         }
       }
-
-      // if remote server is already created, create a new one
-      if (tData->server != NULL)
-      {
-        if (!createRemoteServer(tData, static_cast<vvTcpSocket*>(io.getSocket())))
-        {
-          vvDebugMsg::msg(0, "Couldn't create remote server");
-          return true;
-        }
-      }
     }
     return true;
+  case virvo::VolumeHeader:
+    return handleVolumeHeader(tData, io);
+  case virvo::VolumeChunks:
+    return handleVolumeChunks(tData, io);
   case virvo::CameraMatrix:
   case virvo::Parameter1B:
   case virvo::Parameter1I:
@@ -536,15 +714,23 @@ bool vvServer::handleEvent(ThreadData *tData, const virvo::RemoteEvent event, co
       tData->renderContext->resize(static_cast<uint>(w), static_cast<uint>(h));
     }
     return true;
+  case virvo::SharedMemory:
+    return io.acceptSharedMemory() == vvSocket::VV_OK;
   case virvo::Disconnect:
+    discardUpload(tData);
     delete tData->renderer;
-    delete tData->vd;
+    vvVolumeCache::instance().release(tData->vd);
     delete tData->server;
     delete tData->renderContext;
     tData->renderer = NULL;
     tData->vd = NULL;
     tData->server = NULL;
     tData->renderContext = NULL;
+    {
+      const vvVolumeCache& cache = vvVolumeCache::instance();
+      vvDebugMsg::msg(1, "Volume cache hits, misses, evictions, MB:", int(cache.getNumHits()),
+                      int(cache.getNumMisses()), int(cache.getNumEvictions()), int(cache.getUsage() >> 20));
+    }
     return true;
   default:
     assert(0 && "Event not handled");
@@ -552,6 +738,184 @@ bool vvServer::handleEvent(ThreadData *tData, const virvo::RemoteEvent event, co
   }
 }
 
+bool vvServer::handleVolumeHeader(ThreadData *tData, const vvSocketIO& io)
+{
+  vvVolDesc* vd = new vvVolDesc;
+
+  int hi = 0;
+  int lo = 0;
+  if (io.getVolumeAttributes(vd) != vvSocket::VV_OK
+   || io.getInt32(hi) != vvSocket::VV_OK
+   || io.getInt32(lo) != vvSocket::VV_OK)
+  {
+    vvDebugMsg::msg(0, "Cannot read volume header");
+    delete vd;
+    return false;
+  }
+
+  const uint64_t id = (uint64_t(uint32_t(hi)) << 32) | uint32_t(lo);
+
+  discardUpload(tData);
+
+  {
+    virvo::ScopedLock lock(&_uploadMutex);
+    std::map<uint64_t, virvo::VolumeUpload*>::iterator it = _uploads.find(id);
+    if (it != _uploads.end())
+    {
+      // the id is a hash, only resume if the attributes match as well
+      std::vector<uint8_t> kept(vd->serializeAttributes());
+      std::vector<uint8_t> sent(kept.size());
+      it->second->getVolDesc()->serializeAttributes(&kept[0]);
+      vd->serializeAttributes(&sent[0]);
+      if (kept == sent)
+      {
+        tData->upload = it->second;
+      }
+      else
+      {
+        vvDebugMsg::msg(1, "Volume attributes differ from the interrupted upload, starting over");
+        delete it->second;
+      }
+      _uploads.erase(it);
+    }
+  }
+
+  if (tData->upload != NULL)
+  {
+    vvDebugMsg::msg(1, "Resuming volume upload");
+    delete vd;
+  }
+  else
+  {
+    tData->upload = new virvo::VolumeUpload(vd, id);
+    if (!tData->upload->initStatus())
+    {
+      vvDebugMsg::msg(0, "Not enough memory to accomodate volume");
+      delete tData->upload;
+      tData->upload = NULL;
+      return io.putInt32(-1) == vvSocket::VV_OK;
+    }
+  }
+
+  // tell the client where to continue
+  if (io.putInt32(int(tData->upload->getNumReceived())) != vvSocket::VV_OK)
+  {
+    return false;
+  }
+
+  updateUpload(tData, static_cast<vvTcpSocket*>(io.getSocket()));
+  return true;
+}
+
+bool vvServer::handleVolumeChunks(ThreadData *tData, const vvSocketIO& io)
+{
+  int count = 0;
+  if (io.getInt32(count) != vvSocket::VV_OK || tData->upload == NULL)
+  {
+    vvDebugMsg::msg(0, "Unexpected volume data");
+    return false;
+  }
+
+  // chunks are decompressed while the next ones are read
+  for (int i=0; i<count; ++i)
+  {
+    if (io.getVolumeChunk(*tData->upload) != vvSocket::VV_OK)
+    {
+      vvDebugMsg::msg(0, "Error while reading volume data from socket");
+      return false;
+    }
+  }
+
+  if (!tData->upload->wait())
+  {
+    // the connection is closed and the upload discarded, a client that
+    // reconnects is told to send the volume from the start
+    vvDebugMsg::msg(0, "Cannot decompress volume data");
+    return false;
+  }
+
+  updateUpload(tData, static_cast<vvTcpSocket*>(io.getSocket()));
+  return true;
+}
+
+void vvServer::updateUpload(ThreadData *tData, vvTcpSocket* sock)
+{
+  virvo::VolumeUpload* upload = tData->upload;
+  bool created = false;
+
+  // render the first frame as soon as it is complete, later frames are
+  // empty until the upload is finished
+  if (tData->vd != upload->getVolDesc() && upload->isFrameComplete(0))
+  {
+    delete tData->renderer;
+    tData->renderer = NULL;
+    vvVolumeCache::instance().release(tData->vd);
+    tData->vd = upload->getVolDesc();
+
+    if (tData->server != NULL && !createRemoteServer(tData, sock))
+    {
+      vvDebugMsg::msg(0, "Couldn't create remote server");
+    }
+    created = true;
+  }
+
+  if (upload->isComplete())
+  {
+    vvDebugMsg::msg(1, "Volume transferred successfully");
+    upload->release();
+    delete upload;
+    tData->upload = NULL;
+
+    if (!created && tData->renderer != NULL)
+    {
+      tData->renderer->updateVolumeData();
+    }
+  }
+}
+
+void vvServer::discardUpload(ThreadData *tData)
+{
+  virvo::VolumeUpload* upload = tData->upload;
+  if (upload == NULL)
+  {
+    return;
+  }
+
+  tData->upload = NULL;
+
+  // the renderer may show the first frame already
+  if (tData->vd == upload->getVolDesc())
+  {
+    delete tData->renderer;
+    tData->renderer = NULL;
+    tData->vd = NULL;
+  }
+
+  if (!upload->wait() || upload->getNumReceived() == 0)
+  {
+    delete upload;
+    return;
+  }
+
+  // keep the chunks received so far, the client may reconnect
+  virvo::ScopedLock lock(&_uploadMutex);
+
+  std::map<uint64_t, virvo::VolumeUpload*>::iterator it = _uploads.find(upload->getId());
+  if (it != _uploads.end())
+  {
+    delete it->second;
+    _uploads.erase(it);
+  }
+
+  while (_uploads.size() >= MaxInterruptedUploads)
+  {
+    delete _uploads.begin()->second;
+    _uploads.erase(_uploads.begin());
+  }
+
+  _uploads[upload->getId()] = upload;
+}
+
 bool vvServer::createRenderContext(ThreadData *tData, const int w, const int h)
 {
   delete tData->renderContext;
@@ -626,6 +990,14 @@ bool vvServer::createRemoteServer(ThreadData *tData, vvTcpSocket* sock)
 
 //-------------------------------------------------------------------
 /// Handle signals a daemon receives.
+void vvServer::writeTrace()
+{
+  if (!_traceFile.empty())
+  {
+    virvo::trace::dump(_traceFile.c_str());
+  }
+}
+
 void vvServer::handleSignal(int sig)
 {
 #ifndef _WIN32
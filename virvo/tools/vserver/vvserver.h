@@ -21,29 +21,45 @@
 #ifndef _VV_SERVER_H_
 #define _VV_SERVER_H_
 
+#include <virvo/vvinttypes.h>
+#include <virvo/vvpthread.h>
 #include <virvo/vvremoteevents.h>
 #include <virvo/vvrendererfactory.h>
 #include <virvo/vvrendercontext.h>
 #include <virvo/vvrequestmanagement.h>
 
+#include <map>
 #include <string>
 
 class vvResourceManager;
 class vvRemoteServer;
 class vvSocketIO;
+class vvSocketMonitor;
 class vvTcpSocket;
 class vvVolDesc;
 
+namespace virvo
+{
+  class VolumeUpload;
+}
+
 /**
  * Virvo Server main class.
  *
  * Server unit for remote rendering.
  *
+ * A single thread waits for incoming connections and for events on all
+ * client sockets. Each event is handled by a thread from a fixed worker
+ * pool, so idle clients don't occupy a thread.
+ *
  * Options:
  *  -port:    set port, else default will be used.
  *  -mode:    choose server mode (default: server only)
  *  -bonjour: Use bonjour to broadcast this service (default: off)
- *  -debug:   set debug level, else default will be used.  *
+ *  -debug:   set debug level, else default will be used.
+ *  -trace:   record a trace and write it to a file after each session
+ *  -cache:   memory for volume files kept after their sessions ended
+ *  -workers: number of threads handling client events
  * @author Juergen Schulze (schulze@cs.brown.de)
  * @author Stavros Delisavas (stavros.delisavas@uni-koeln.de)
  */
@@ -92,13 +108,23 @@ protected:
     vvVolDesc         *vd;
     vvRequest         *request;
     vvRendererFactory::Options opt;
+    virvo::VolumeUpload *upload;     ///< volume being received, its first frame may already be tData->vd
   };
   void displayHelpInfo();                         ///< Display command usage help on the command line.
   bool parseCommandLine(int argc, char *argv[]);  ///< Parse command line arguments.
   virtual bool serverLoop();
   virtual void handleNextConnection(vvTcpSocket *sock) = 0;
   virtual bool handleEvent(ThreadData *tData, virvo::RemoteEvent, const vvSocketIO& io);
+  void writeTrace();                              ///< Write the trace file if tracing was requested
+
+  struct Session;
+  void addSession(vvServer* handler, vvTcpSocket* sock); ///< Handle events from sock with handler->handleEvent()
+  static void processSession(void* param);        ///< Handle one event of a session, run by the worker pool
 
+  bool handleVolumeHeader(ThreadData* tData, const vvSocketIO& io);
+  bool handleVolumeChunks(ThreadData* tData, const vvSocketIO& io);
+  void updateUpload(ThreadData* tData, vvTcpSocket* sock); ///< Show the first frame of the upload of tData, finish it when complete
+  void discardUpload(ThreadData* tData);          ///< Abort the upload of tData, keep it if it may be resumed
   bool createRenderContext(ThreadData* tData, const int w, const int h);
   virtual bool createRemoteServer(ThreadData* tData, vvTcpSocket* sock);
 
@@ -107,6 +133,11 @@ protected:
   bool             _useBonjour;   ///< indicating the use of bonjour
   bool             _daemonize;    ///< run in background as a unix daemon
   std::string      _daemonName;   ///< name of the daemon for reference in syslog
+  std::string      _traceFile;    ///< Chrome trace-event file, empty if tracing is off
+  int              _numWorkers;   ///< number of worker threads, 0 for one per processor
+  vvSocketMonitor *_monitor;      ///< watches the listening socket and all sessions while serverLoop() runs
+  virvo::Mutex     _uploadMutex;  ///< protects _uploads
+  std::map<uint64_t, virvo::VolumeUpload*> _uploads; ///< interrupted volume uploads by volume id
 
   static void handleSignal(int sig);               ///< Handle signals sent to a daemon
 };
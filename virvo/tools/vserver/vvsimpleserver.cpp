@@ -35,22 +35,10 @@
 #include <virvo/vvtcpsocket.h>
 
 #include <iostream>
-#include <pthread.h>
-
-namespace
-{
-  struct ThreadArgs
-  {
-    vvTcpSocket *_sock;
-  };
-}
-
-vvSimpleServer* vvSimpleServer::_instance = NULL;
 
 vvSimpleServer::vvSimpleServer(bool useBonjour)
   : vvServer(useBonjour)
 {
-  _instance = this;
   if (_useBonjour)
   {
     registerToBonjour();
@@ -89,43 +77,7 @@ void vvSimpleServer::handleNextConnection(vvTcpSocket *sock)
 {
   vvDebugMsg::msg(3, "vvSimpleServer::handleNextConnection()");
 
-  ThreadArgs *args = new ThreadArgs;
-  args->_sock = sock;
-
-  pthread_t pthread;
-  pthread_create(&pthread,  NULL, handleClientThread, args);
-  pthread_detach(pthread);
-}
-
-void * vvSimpleServer::handleClientThread(void *param)
-{
-  vvDebugMsg::msg(3, "vvSimpleServer::handleClientThread()");
-
-  ThreadData *tData = new ThreadData;
-  ThreadArgs *args = reinterpret_cast<ThreadArgs*>(param);
-
-  vvTcpSocket *sock = args->_sock;
-
-  vvSocketIO io(sock);
-  virvo::RemoteEvent event;
-  while (io.getEvent(event) == vvSocket::VV_OK)
-  {
-    if (!_instance->handleEvent(tData, event, io))
-    {
-      break;
-    }
-  }
-  _instance->handleEvent(tData, virvo::Disconnect, io);
-
-  sock->disconnectFromHost();
-  delete sock;
-  delete args;
-  delete tData;
-
-  pthread_exit(NULL);
-#ifdef _WIN32
-  return NULL;
-#endif
+  addSession(this, sock);
 }
 
 bool vvSimpleServer::registerToBonjour()
@@ -37,11 +37,8 @@ public:
 private:
   vvBonjourRegistrar _registrar;  ///< Bonjour registrar used by registerToBonjour() and unregisterFromBonjour()
 
-  static vvSimpleServer* _instance;
-
   void handleNextConnection(vvTcpSocket *sock);
   bool handleEvent(ThreadData *tData, virvo::RemoteEvent, const vvSocketIO& io);
-  static void * handleClientThread(void *param);
   bool registerToBonjour();
   void unregisterFromBonjour();
 
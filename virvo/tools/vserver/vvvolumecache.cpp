@@ -0,0 +1,307 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvvolumecache.h"
+
+#include <virvo/vvdebugmsg.h>
+#include <virvo/vvtrace.h>
+#include <virvo/vvvoldesc.h>
+
+#include <cassert>
+#include <new>
+#include <string>
+
+#include <sys/stat.h>
+
+namespace
+{
+  virvo::trace::Counter cacheHits("volume cache hits");
+  virvo::trace::Counter cacheMisses("volume cache misses");
+}
+
+bool vvVolumeCache::Key::operator<(const Key& rhs) const
+{
+  if (path != rhs.path) return path < rhs.path;
+  if (mtime != rhs.mtime) return mtime < rhs.mtime;
+  if (size != rhs.size) return size < rhs.size;
+  return loadType < rhs.loadType;
+}
+
+vvVolumeCache& vvVolumeCache::instance()
+{
+  static vvVolumeCache cache;
+  return cache;
+}
+
+vvVolumeCache::vvVolumeCache()
+  : _budget(0)
+  , _usage(0)
+  , _clock(0)
+  , _hits(0)
+  , _misses(0)
+  , _evictions(0)
+{
+}
+
+vvVolumeCache::~vvVolumeCache()
+{
+  for (Views::iterator it = _views.begin(); it != _views.end(); ++it)
+  {
+    delete it->first;
+  }
+  for (Entries::iterator it = _entries.begin(); it != _entries.end(); ++it)
+  {
+    delete it->second->master;
+    delete it->second;
+  }
+}
+
+vvVolDesc* vvVolumeCache::acquire(const std::string& filename, vvFileIO::LoadType loadType)
+{
+  vvDebugMsg::msg(3, "vvVolumeCache::acquire()");
+
+  struct stat buf;
+  if (stat(filename.c_str(), &buf) != 0)
+  {
+    vvDebugMsg::msg(0, "Cannot access volume file: ", filename.c_str());
+    return NULL;
+  }
+
+  Key key;
+  key.path = filename;
+  key.mtime = buf.st_mtime;
+  key.size = buf.st_size;
+  key.loadType = loadType;
+
+  _mutex.lock();
+
+  Entry* entry = NULL;
+  Entries::iterator it = _entries.find(key);
+  if (it != _entries.end())
+  {
+    // shared with other sessions, possibly still being loaded by one of them
+    entry = it->second;
+    ++entry->refs;
+    ++_hits;
+    cacheHits.add(1);
+    while (entry->loading)
+    {
+      _loaded.wait(&_mutex);
+    }
+  }
+  else
+  {
+    entry = new Entry;
+    entry->master = NULL;
+    entry->bytes = 0;
+    entry->refs = 1;
+    entry->lastUse = 0;
+    entry->loading = true;
+    _entries[key] = entry;
+    ++_misses;
+    cacheMisses.add(1);
+
+    // other sessions may use the cache while the file is read
+    _mutex.unlock();
+
+    vvVolDesc* vd = new vvVolDesc(filename.c_str());
+    vvFileIO fio;
+    if (fio.loadVolumeData(vd, loadType) != vvFileIO::OK)
+    {
+      vvDebugMsg::msg(0, "Error loading volume file");
+      delete vd;
+      vd = NULL;
+    }
+
+    _mutex.lock();
+
+    entry->master = vd;
+    entry->loading = false;
+    if (vd != NULL)
+    {
+      entry->bytes = vd->getMovieBytes();
+      _usage += entry->bytes;
+    }
+    else
+    {
+      // sessions waiting for the load drop the entry with their references
+      _entries.erase(key);
+    }
+    _loaded.broadcast();
+  }
+
+  vvVolDesc* view = NULL;
+  if (entry->master != NULL)
+  {
+    view = makeView(entry);
+  }
+  if (view == NULL)
+  {
+    unref(entry);
+  }
+  evict();
+
+  _mutex.unlock();
+  return view;
+}
+
+void vvVolumeCache::release(vvVolDesc* vd)
+{
+  vvDebugMsg::msg(3, "vvVolumeCache::release()");
+
+  if (vd == NULL)
+  {
+    return;
+  }
+
+  {
+    virvo::ScopedLock lock(&_mutex);
+    Views::iterator it = _views.find(vd);
+    if (it != _views.end())
+    {
+      Entry* entry = it->second;
+      _views.erase(it);
+      unref(entry);
+      evict();
+    }
+  }
+
+  // frames of a shared volume are not deleted
+  delete vd;
+}
+
+void vvVolumeCache::setBudget(size_t bytes)
+{
+  virvo::ScopedLock lock(&_mutex);
+  _budget = bytes;
+  evict();
+}
+
+size_t vvVolumeCache::getBudget() const
+{
+  virvo::ScopedLock lock(&_mutex);
+  return _budget;
+}
+
+size_t vvVolumeCache::getUsage() const
+{
+  virvo::ScopedLock lock(&_mutex);
+  return _usage;
+}
+
+size_t vvVolumeCache::getNumHits() const
+{
+  virvo::ScopedLock lock(&_mutex);
+  return _hits;
+}
+
+size_t vvVolumeCache::getNumMisses() const
+{
+  virvo::ScopedLock lock(&_mutex);
+  return _misses;
+}
+
+size_t vvVolumeCache::getNumEvictions() const
+{
+  virvo::ScopedLock lock(&_mutex);
+  return _evictions;
+}
+
+//----------------------------------------------------------------------------
+/** Create a volume description sharing the frames of the entry.
+  _mutex must be locked.
+  @return NULL if out of memory
+*/
+vvVolDesc* vvVolumeCache::makeView(Entry* entry)
+{
+  vvVolDesc* master = entry->master;
+  vvVolDesc* vd = new (std::nothrow) vvVolDesc(master, -2);
+  if (vd == NULL)
+  {
+    return NULL;
+  }
+
+  vd->_scale = master->_scale;
+  vd->pos = master->pos;
+  for (size_t f=0; f<master->getStoredFrames(); ++f)
+  {
+    vd->addFrame(master->getRaw(f), vvVolDesc::NO_DELETE);
+  }
+  vd->frames = master->frames;
+  for (size_t c=0; c<master->chan; ++c)
+  {
+    const char* name = master->getChannelName(c);
+    if (name != NULL) vd->setChannelName(c, name);
+  }
+
+  _views[vd] = entry;
+  return vd;
+}
+
+//----------------------------------------------------------------------------
+/** Drop a reference to the entry, _mutex must be locked.
+  Entries of failed loads are deleted with their last reference.
+*/
+void vvVolumeCache::unref(Entry* entry)
+{
+  assert(entry->refs > 0);
+  --entry->refs;
+  entry->lastUse = ++_clock;
+  if (entry->refs == 0 && entry->master == NULL)
+  {
+    delete entry;
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Delete least recently used volumes until the cache fits into the
+  budget or only volumes in use are left. _mutex must be locked.
+*/
+void vvVolumeCache::evict()
+{
+  while (_usage > _budget)
+  {
+    Entries::iterator lru = _entries.end();
+    for (Entries::iterator it = _entries.begin(); it != _entries.end(); ++it)
+    {
+      const Entry* entry = it->second;
+      if (entry->refs == 0 && !entry->loading
+       && (lru == _entries.end() || entry->lastUse < lru->second->lastUse))
+      {
+        lru = it;
+      }
+    }
+
+    if (lru == _entries.end())
+    {
+      return;
+    }
+
+    Entry* entry = lru->second;
+    vvDebugMsg::msg(2, "Evicting cached volume: ", lru->first.path.c_str());
+    _usage -= entry->bytes;
+    ++_evictions;
+    delete entry->master;
+    delete entry;
+    _entries.erase(lru);
+  }
+}
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
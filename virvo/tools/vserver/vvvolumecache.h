@@ -0,0 +1,124 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef _VV_VOLUMECACHE_H_
+#define _VV_VOLUMECACHE_H_
+
+#include <virvo/vvfileio.h>
+#include <virvo/vvpthread.h>
+
+#include <map>
+#include <string>
+
+#include <sys/types.h>
+#include <time.h>
+
+class vvVolDesc;
+
+/**
+ * Process-wide cache of volumes loaded from files.
+ *
+ * Sessions that open the same file share its voxel data. acquire() returns
+ * a volume description of its own for each caller, with its own transfer
+ * function and current frame, whose frames point to the cached data. The
+ * frames are read-only, sessions that receive new voxels replace the volume.
+ *
+ * Files are identified by path, modification time, size and load options,
+ * so a changed file is loaded again. Volumes no longer in use are kept
+ * until the memory budget is exceeded, then the least recently used ones
+ * are evicted. Volumes in use are never evicted.
+ */
+class vvVolumeCache
+{
+public:
+  /// Returns the cache shared by all sessions
+  static vvVolumeCache& instance();
+
+  vvVolumeCache();
+  ~vvVolumeCache();
+
+  /** Load a volume file or share it with other sessions.
+    @param filename volume file name
+    @param loadType parts of the file to load
+    @return volume to be passed to release(), NULL if the file cannot be loaded
+  */
+  vvVolDesc* acquire(const std::string& filename, vvFileIO::LoadType loadType = vvFileIO::ALL_DATA);
+
+  /// Release a volume returned by acquire(), other volumes are deleted
+  void release(vvVolDesc* vd);
+
+  /// Bytes of unused volumes kept in memory, 0 to keep only volumes in use
+  void setBudget(size_t bytes);
+  size_t getBudget() const;
+
+  size_t getUsage() const;      ///< bytes of voxel data cached
+  size_t getNumHits() const;    ///< volumes shared with other sessions or found in the cache
+  size_t getNumMisses() const;  ///< volumes loaded from files
+  size_t getNumEvictions() const; ///< unused volumes dropped to stay within the budget
+
+private:
+  struct Key
+  {
+    std::string path;
+    time_t mtime;
+    off_t size;
+    int loadType;
+
+    bool operator<(const Key& rhs) const;
+  };
+
+  struct Entry
+  {
+    vvVolDesc* master;  ///< owns the frames, NULL while loading or if loading failed
+    size_t bytes;
+    size_t refs;        ///< volumes handed out plus sessions waiting for the load
+    size_t lastUse;     ///< value of _clock when the last reference was dropped
+    bool loading;
+  };
+
+  typedef std::map<Key, Entry*> Entries;
+  typedef std::map<vvVolDesc*, Entry*> Views;
+
+  mutable virvo::Mutex _mutex;
+  virvo::Condition _loaded;     ///< signaled when a load finishes
+  Entries _entries;
+  Views _views;                 ///< volumes handed out and their cache entries
+  size_t _budget;
+  size_t _usage;
+  size_t _clock;
+  size_t _hits;
+  size_t _misses;
+  size_t _evictions;
+
+  // NOT copyable!
+  vvVolumeCache(vvVolumeCache const&);
+  vvVolumeCache& operator=(vvVolumeCache const&);
+
+  vvVolDesc* makeView(Entry* entry);
+  void unref(Entry* entry);
+  void evict();
+};
+
+#endif // _VV_VOLUMECACHE_H_
+
+//===================================================================
+// End of File
+//===================================================================
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -52,10 +52,12 @@ using std::ios;
 #endif
 
 #include <virvo/vvvirvo.h>
+#include <virvo/vvbrickcache.h>
 #include <virvo/vvrequestmanagement.h>
 #include <virvo/vvtoolshed.h>
 #include <virvo/vvoffscreenbuffer.h>
 #include <virvo/vvclock.h>
+#include <virvo/vvremoteclient.h>
 #include <virvo/vvrendererfactory.h>
 #include <virvo/vvsocketmap.h>
 #include <virvo/vvsocketio.h>
@@ -136,12 +138,14 @@ vvView::vvView()
   ibrMode               = vvRenderer::VV_GRADIENT;
   sync                  = false;
   codec                 = vvImage::VV_RLE;
+  remoteFps             = 0.0f;
   rrMode                = RR_NONE;
   clipBuffer            = NULL;
   framebufferDump       = NULL;
   benchmark             = false;
   testSuiteFileName     = NULL;
   showBricks            = false;
+  outOfCore             = false;
   recordMode            = false;
   playMode              = false;
   matrixFile            = NULL;
@@ -198,8 +202,23 @@ void vvView::mainLoop(int argc, char *argv[])
     cerr << "Using default volume" << endl;
   }
 
+  vvFileIO::LoadType sections = vvFileIO::ALL_DATA;
+  if (outOfCore)
+  {
+    if (filename != NULL && virvo::BrickCache::isBrickFile(filename))
+    {
+      // leave the voxels on disk, the software ray caster pages them in
+      sections = vvFileIO::LoadType(vvFileIO::ALL_DATA & ~vvFileIO::RAW_DATA);
+    }
+    else
+    {
+      cerr << "Out-of-core rendering needs a .bricks file, loading the whole volume" << endl;
+      outOfCore = false;
+    }
+  }
+
   vvFileIO fio;
-  if (fio.loadVolumeData(vd) != vvFileIO::OK)
+  if (fio.loadVolumeData(vd, sections) != vvFileIO::OK)
   {
     cerr << "Error loading volume file" << endl;
     delete vd;
@@ -548,6 +567,7 @@ void vvView::applyRendererParameters()
   renderer->setParameter(vvRenderer::VV_IMG_PRECISION, bufferPrecision);
   renderer->setParameter(vvRenderState::VV_SHOW_BRICKS, showBricks);
   renderer->setParameter(vvRenderState::VV_CODEC, codec);
+  renderer->setParameter(vvRenderer::VV_REMOTE_FRAME_TIME, (remoteFps > 0.0f) ? 1.0f / remoteFps : 0.0f);
 
   renderer->setParameter(vvRenderState::VV_IBR_SYNC, sync);
   renderer->setParameter(vvRenderer::VV_IBR_DEPTH_PREC, ibrPrecision);
@@ -569,6 +589,12 @@ void vvView::createRenderer(std::string type, const vvRendererFactory::Options &
 
   vvGLTools::enableGLErrorBacktrace(ds->showBt);
 
+  if (ds->outOfCore && type != "softrayrend")
+  {
+    cerr << "Only the software ray caster renders out-of-core volumes" << endl;
+    type = "softrayrend";
+  }
+
   if (rrMode == RR_NONE && servers.size() == 1)
   {
     rrMode = RR_IBR;
@@ -2050,6 +2076,10 @@ void vvView::printProfilingResult(vvStopwatch* totalTime, const int framesRender
   cerr << "Total profiling time [sec]........................" << totalTime->getTime() << endl;
   cerr << "Frames rendered..................................." << framesRendered << endl;
   cerr << "Average time per frame [sec]......................" << (float(totalTime->getTime()/framesRendered)) << endl;
+  if (vvRemoteClient* client = dynamic_cast<vvRemoteClient*>(ds->renderer))
+  {
+    client->getFrameStats().print(cerr);
+  }
   cerr << "*******************************************************************************" << endl;
 }
 
@@ -2472,6 +2502,10 @@ void vvView::displayHelpInfo()
   cerr << "-quality <value> (-q)" << endl;
   cerr << "Set the render quality (default: 1.0)" << endl;
   cerr << endl;
+  cerr << "-remotefps <value>" << endl;
+  cerr << " Frame rate for remote rendering. While the view changes, the server lowers" << endl;
+  cerr << " image resolution, depth precision or codec quality to reach it (default: 0 = off)" << endl;
+  cerr << endl;
   cerr << "-dsp <host:display.screen>" << endl;
   cerr << "  Add x-org display for additional rendering context" << endl;
   cerr << endl;
@@ -2540,6 +2574,10 @@ void vvView::displayHelpInfo()
   cerr << "-showbricks" << endl;
   cerr << " Show the brick outlines \\wo volume when brick renderer is used" << endl;
   cerr << endl;
+  cerr << "-outofcore" << endl;
+  cerr << " Keep the voxels of a .bricks file on disk and page them in while rendering" << endl;
+  cerr << " with the software ray caster. VV_BRICK_CACHE sets the cache size in MB" << endl;
+  cerr << endl;
   cerr << "-rec" << endl;
   cerr << " Record camera motion to file" << endl;
   cerr << endl;
@@ -2685,6 +2723,15 @@ bool vvView::parseCommandLine(int argc, char** argv)
       }
       ds->draftQuality = (float)strtod(argv[arg], NULL);
     }
+    else if (vvToolshed::strCompare(argv[arg], "-remotefps") == 0)
+    {
+      if ((++arg)>=argc)
+      {
+        cerr << "Frame rate missing." << endl;
+        return false;
+      }
+      ds->remoteFps = (float)strtod(argv[arg], NULL);
+    }
     else if (vvToolshed::strCompare(argv[arg], "-dsp")==0)
     {
       if ((++arg)>=argc)
@@ -2844,6 +2891,10 @@ bool vvView::parseCommandLine(int argc, char** argv)
     {
       showBricks = true;
     }
+    else if (vvToolshed::strCompare(argv[arg], "-outofcore")==0)
+    {
+      outOfCore = true;
+    }
     else if (vvToolshed::strCompare(argv[arg], "-rec")==0)
     {
       recordMode = true;
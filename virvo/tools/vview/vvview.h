@@ -146,6 +146,7 @@ class vvView
     vvRenderState::IbrMode          ibrMode;    ///< interruption mode for depth-calculation
     bool sync;                                  ///< synchronous ibr mode
     int codec;                                  ///< code type/codec for images sent over the network
+    float remoteFps;                            ///< frame rate the remote server adapts its images to, 0 = fixed quality
     vvOffscreenBuffer* clipBuffer;              ///< used for clipping test code
     GLfloat* framebufferDump;
     std::vector<std::string> servers;
@@ -156,6 +157,7 @@ class vvView
     std::vector<std::string> serverFileNames;   ///< a list with file names where remote servers can find the appropriate volume data
     const char* testSuiteFileName;
     bool showBricks;                            ///< show brick outlines when brick renderer is used
+    bool outOfCore;                             ///< render a .bricks file without loading its voxels
     bool recordMode;                            ///< mode where camera motion is saved to file
     bool playMode;                              ///< mode where camera motion is played from file
     FILE* matrixFile;                           ///< Modelview matrices recorded in record mode
@@ -29,6 +29,8 @@
 #include <snappy.h>
 #endif
 
+#include <cstring>
+
 
 bool virvo::compress(std::vector<unsigned char>& data)
 {
@@ -76,3 +78,78 @@ bool virvo::decompress(std::vector<unsigned char>& data)
 
   return true;
 }
+
+
+bool virvo::compress(unsigned char const* data, size_t size, std::vector<unsigned char>& compressed)
+{
+#ifdef HAVE_SNAPPY
+  compressed.resize(snappy::MaxCompressedLength(size));
+
+  size_t len = 0;
+
+  snappy::RawCompress((char const*)data, size, (char*)&compressed[0], &len);
+
+  compressed.resize(len);
+
+  return true;
+#else
+  static_cast<void>(data);
+  static_cast<void>(size);
+
+  compressed.clear();
+
+  return false;
+#endif
+}
+
+
+size_t virvo::maxCompressedSize(size_t size)
+{
+#ifdef HAVE_SNAPPY
+  return snappy::MaxCompressedLength(size);
+#else
+  return size;
+#endif
+}
+
+
+bool virvo::decompress(unsigned char const* data, size_t size, unsigned char* out, size_t outSize)
+{
+#ifdef HAVE_SNAPPY
+  size_t len = 0;
+
+  if (!snappy::GetUncompressedLength((char const*)data, size, &len) || len != outSize)
+    return false;
+
+  return snappy::RawUncompress((char const*)data, size, (char*)out);
+#else
+  static_cast<void>(data);
+  static_cast<void>(size);
+  static_cast<void>(out);
+  static_cast<void>(outSize);
+
+  return false;
+#endif
+}
+
+
+void virvo::xorDelta(unsigned char const* data, unsigned char const* previous, size_t size, unsigned char* out)
+{
+  size_t i = 0;
+
+  // word by word, memcpy keeps unaligned accesses legal
+  for (; i + sizeof(size_t) <= size; i += sizeof(size_t))
+  {
+    size_t a;
+    size_t b;
+    memcpy(&a, data + i, sizeof(size_t));
+    memcpy(&b, previous + i, sizeof(size_t));
+    a ^= b;
+    memcpy(out + i, &a, sizeof(size_t));
+  }
+
+  for (; i < size; ++i)
+  {
+    out[i] = data[i] ^ previous[i];
+  }
+}
@@ -25,6 +25,8 @@
 
 #include "vvexport.h"
 
+#include <stddef.h>
+
 #include <vector>
 
 
@@ -36,6 +38,23 @@ VVAPI bool compress(std::vector<unsigned char>& data);
 
 VVAPI bool decompress(std::vector<unsigned char>& data);
 
+// Compress size bytes from data into compressed.
+// Returns false if the data was not compressed, e.g. because no
+// compression library is available.
+VVAPI bool compress(unsigned char const* data, size_t size, std::vector<unsigned char>& compressed);
+
+// Returns the largest size that compress() produces for size bytes.
+VVAPI size_t maxCompressedSize(size_t size);
+
+// Decompress size bytes from data into exactly outSize bytes at out.
+// Returns false if the data is invalid or has a different length.
+VVAPI bool decompress(unsigned char const* data, size_t size, unsigned char* out, size_t outSize);
+
+// Delta coding of consecutive time steps: out = data ^ previous.
+// Bytes that did not change become zero, which compresses well. Applying
+// the delta to previous restores data. out may be data or previous.
+VVAPI void xorDelta(unsigned char const* data, unsigned char const* previous, size_t size, unsigned char* out);
+
 
 } // namespace virvo
 
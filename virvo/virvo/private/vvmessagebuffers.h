@@ -0,0 +1,77 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef VV_MESSAGEBUFFERS_H
+#define VV_MESSAGEBUFFERS_H
+
+
+#include "vvworkerpool.h"
+
+#include <stddef.h>
+
+#include <vector>
+
+
+namespace virvo
+{
+
+
+// Framing state of vvSocketIO.
+// Kept with the socket because several vvSocketIO objects may share one
+// connection.
+struct MessageBuffers
+{
+  // Data of the message being assembled
+  std::vector<unsigned char> sendBuffer;
+  // Nesting level of vvSocketIO::beginMessage()
+  int depth;
+  // Received frame data not consumed yet
+  std::vector<unsigned char> recvBuffer;
+  // Read position in recvBuffer
+  size_t recvPos;
+  // Bytes of the current frame not received yet
+  size_t frameLeft;
+  // Compresses volume chunks, created on first use
+  WorkerPool* compressionPool;
+
+  MessageBuffers()
+    : depth(0)
+    , recvPos(0)
+    , frameLeft(0)
+    , compressionPool(NULL)
+  {
+  }
+
+  ~MessageBuffers()
+  {
+    delete compressionPool;
+  }
+
+private:
+  // NOT copyable!
+  MessageBuffers(MessageBuffers const&);
+  MessageBuffers& operator=(MessageBuffers const&);
+};
+
+
+} // namespace virvo
+
+
+#endif
@@ -0,0 +1,623 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvshmchannel.h"
+
+#include "vvatomic.h"
+#include "vvdebugmsg.h"
+#include "vvpthread.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+#define VV_HAVE_MEMFD 1
+#endif
+
+
+using virvo::ShmChannel;
+
+
+const size_t ShmChannel::DefaultRingSize = 16 * 1024 * 1024;
+
+
+#ifdef VV_HAVE_MEMFD
+
+
+namespace
+{
+
+const uint32_t Magic = 0x76767368;  // "vvsh"
+const size_t HeaderSize = 4096;
+
+// Wake-up bytes sent over the connection
+enum Bell
+{
+  Data,   // the ring the receiver reads from has new data
+  Space,  // the ring the receiver writes to has free space
+  NumBells
+};
+
+const char BellBytes[NumBells] = { 'd', 's' };
+
+struct Ring
+{
+  long volatile head;           // bytes written so far
+  long volatile tail;           // bytes read so far
+  long volatile readerWaiting;  // set by the reader, cleared by the writer before it rings
+  long volatile writerWaiting;  // set by the writer, cleared by the reader before it rings
+};
+
+// Start of the segment, followed by the data of both rings at HeaderSize.
+// rings[0] is written by the creator, rings[1] by the peer.
+struct Header
+{
+  uint32_t magic;
+  uint32_t cookie;
+  uint32_t longSize;
+  uint32_t ringSize;
+  Ring rings[2];
+};
+
+long load(long volatile* p)
+{
+  return virvo::atomic::add(p, 0);
+}
+
+// Set a waiting flag
+void arm(long volatile* flag)
+{
+  virvo::atomic::compareExchange(flag, 0, 1);
+}
+
+// Clear a waiting flag, returns true if it was set
+bool takeFlag(long volatile* flag)
+{
+  return load(flag) != 0 && virvo::atomic::compareExchange(flag, 1, 0) == 1;
+}
+
+uint32_t makeCookie()
+{
+  uint32_t cookie = 0;
+  FILE* f = fopen("/dev/urandom", "rb");
+  if (f == NULL || fread(&cookie, sizeof(cookie), 1, f) != 1)
+  {
+    cookie = uint32_t(time(NULL)) ^ (uint32_t(getpid()) << 16);
+  }
+  if (f != NULL)
+  {
+    fclose(f);
+  }
+  return cookie;
+}
+
+} // namespace
+
+
+struct ShmChannel::Impl
+{
+  vvsock_t fd;
+  int pid;
+  int handle;
+  Header* header;
+  size_t mapSize;
+  size_t mask;
+
+  Ring* in;
+  char* inData;
+  Ring* out;
+  char* outData;
+
+  // flags set by this side, only touched by the reading resp. writing thread
+  bool readArmed;
+  bool writeArmed;
+
+  // reader and writer may wait for wake-ups at the same time, one of them
+  // receives from the connection and counts the bytes for both
+  virvo::Mutex mutex;
+  virvo::Condition received;
+  bool receiving;
+  bool closed;
+  int bells[NumBells];
+
+  Impl(vvsock_t fd, int pid, int handle, Header* header, size_t mapSize, bool creator)
+    : fd(fd)
+    , pid(pid)
+    , handle(handle)
+    , header(header)
+    , mapSize(mapSize)
+    , mask(header->ringSize - 1)
+    , readArmed(false)
+    , writeArmed(false)
+    , receiving(false)
+    , closed(false)
+  {
+    char* data = reinterpret_cast<char*>(header) + HeaderSize;
+    int w = creator ? 0 : 1;
+    out = &header->rings[w];
+    outData = data + w * header->ringSize;
+    in = &header->rings[1 - w];
+    inData = data + (1 - w) * header->ringSize;
+    bells[Data] = 0;
+    bells[Space] = 0;
+  }
+
+  ~Impl()
+  {
+    munmap(header, mapSize);
+    if (handle >= 0)
+    {
+      close(handle);
+    }
+  }
+
+  // Send a wake-up byte to the peer
+  bool ring(Bell bell)
+  {
+    for (;;)
+    {
+      ssize_t n = send(fd, &BellBytes[bell], 1, MSG_NOSIGNAL);
+      if (n == 1)
+      {
+        return true;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      {
+        pollfd p = { fd, POLLOUT, 0 };
+        poll(&p, 1, -1);
+      }
+      else if (n < 0 && errno != EINTR)
+      {
+        vvDebugMsg::msg(1, "ShmChannel: cannot wake up peer");
+        return false;
+      }
+    }
+  }
+
+  // Wait for a wake-up byte from the peer, returns false if the connection
+  // was closed
+  bool wait(Bell bell)
+  {
+    virvo::ScopedLock lock(&mutex);
+
+    while (bells[bell] == 0)
+    {
+      if (closed)
+      {
+        return false;
+      }
+
+      if (receiving)
+      {
+        received.wait(&mutex);
+        continue;
+      }
+
+      receiving = true;
+      mutex.unlock();
+
+      char buf[64];
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      bool retry = n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK);
+      if (retry && errno != EINTR)
+      {
+        pollfd p = { fd, POLLIN, 0 };
+        poll(&p, 1, -1);
+      }
+
+      mutex.lock();
+      receiving = false;
+
+      if (n == 0 || (n < 0 && !retry))
+      {
+        closed = true;
+      }
+      for (ssize_t i = 0; i < n; ++i)
+      {
+        ++bells[buf[i] == BellBytes[Data] ? Data : Space];
+      }
+      received.broadcast();
+    }
+
+    --bells[bell];
+    return true;
+  }
+
+  // Withdraw a waiting flag. If the peer cleared it first, it has rung or
+  // is about to, so the wake-up byte is consumed here.
+  bool disarm(long volatile* flag, bool& armed, Bell bell)
+  {
+    if (!armed)
+    {
+      return true;
+    }
+    armed = false;
+    return virvo::atomic::compareExchange(flag, 1, 0) == 1 || wait(bell);
+  }
+};
+
+
+bool ShmChannel::isEnabled()
+{
+  const char* env = getenv("VV_SHARED_MEMORY");
+  return env == NULL || atoi(env) != 0;
+}
+
+
+ShmChannel* ShmChannel::create(vvsock_t fd, size_t ringSize)
+{
+  vvDebugMsg::msg(3, "ShmChannel::create()");
+
+  size_t size = 4096;
+  while (size < ringSize)
+  {
+    size *= 2;
+  }
+
+  int handle = int(syscall(SYS_memfd_create, "virvo", 0));
+  if (handle < 0)
+  {
+    vvDebugMsg::msg(1, "ShmChannel::create(): memfd_create() failed");
+    return NULL;
+  }
+
+  size_t mapSize = HeaderSize + 2 * size;
+  void* p = MAP_FAILED;
+  if (ftruncate(handle, off_t(mapSize)) == 0)
+  {
+    p = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+  }
+  if (p == MAP_FAILED)
+  {
+    vvDebugMsg::msg(1, "ShmChannel::create(): cannot map shared memory");
+    close(handle);
+    return NULL;
+  }
+
+  Header* header = static_cast<Header*>(p);
+  memset(header, 0, sizeof(Header));
+  header->magic = Magic;
+  header->cookie = makeCookie();
+  header->longSize = sizeof(long);
+  header->ringSize = uint32_t(size);
+
+  return new ShmChannel(new Impl(fd, int(getpid()), handle, header, mapSize, true));
+}
+
+
+ShmChannel* ShmChannel::attach(vvsock_t fd, int pid, int handle, uint32_t cookie, size_t ringSize)
+{
+  vvDebugMsg::msg(3, "ShmChannel::attach()");
+
+  if (ringSize < 4096 || ringSize > (size_t(1) << 30) || (ringSize & (ringSize - 1)) != 0)
+  {
+    vvDebugMsg::msg(1, "ShmChannel::attach(): invalid ring size");
+    return NULL;
+  }
+  const size_t mapSize = HeaderSize + 2 * ringSize;
+
+  char path[64];
+  sprintf(path, "/proc/%d/fd/%d", pid, handle);
+
+  // The path comes from the peer: don't block on FIFOs or devices, and only
+  // map regular files that are large enough
+  int h = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (h < 0)
+  {
+    vvDebugMsg::msg(1, "ShmChannel::attach(): cannot open ", path);
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(h, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < off_t(mapSize))
+  {
+    vvDebugMsg::msg(1, "ShmChannel::attach(): not a shared memory segment: ", path);
+    close(h);
+    return NULL;
+  }
+
+  void* p = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, h, 0);
+  close(h);
+
+  if (p == MAP_FAILED)
+  {
+    vvDebugMsg::msg(1, "ShmChannel::attach(): cannot map shared memory");
+    return NULL;
+  }
+
+  Header* header = static_cast<Header*>(p);
+  if (header->magic != Magic || header->cookie != cookie || header->longSize != sizeof(long)
+   || header->ringSize != ringSize)
+  {
+    vvDebugMsg::msg(1, "ShmChannel::attach(): segment does not match");
+    munmap(p, mapSize);
+    return NULL;
+  }
+
+  return new ShmChannel(new Impl(fd, pid, -1, header, mapSize, false));
+}
+
+
+ShmChannel::ShmChannel(Impl* impl)
+  : impl(impl)
+{
+}
+
+
+ShmChannel::~ShmChannel()
+{
+  delete impl;
+}
+
+
+int ShmChannel::getPid() const
+{
+  return impl->pid;
+}
+
+
+int ShmChannel::getHandle() const
+{
+  return impl->handle;
+}
+
+
+uint32_t ShmChannel::getCookie() const
+{
+  return impl->header->cookie;
+}
+
+
+size_t ShmChannel::getRingSize() const
+{
+  return impl->header->ringSize;
+}
+
+
+void ShmChannel::closeHandle()
+{
+  if (impl->handle >= 0)
+  {
+    close(impl->handle);
+    impl->handle = -1;
+  }
+}
+
+
+size_t ShmChannel::available()
+{
+  Ring* r = impl->in;
+
+  size_t avail = size_t((unsigned long)load(&r->head) - (unsigned long)r->tail);
+  if (avail == 0 && !impl->readArmed)
+  {
+    arm(&r->readerWaiting);
+    impl->readArmed = true;
+    avail = size_t((unsigned long)load(&r->head) - (unsigned long)r->tail);
+  }
+  return avail;
+}
+
+
+ssize_t ShmChannel::read(char* buffer, size_t size)
+{
+  Ring* r = impl->in;
+  size_t ringSize = impl->mask + 1;
+  size_t done = 0;
+
+  while (done < size)
+  {
+    unsigned long tail = (unsigned long)r->tail;
+    size_t avail = size_t((unsigned long)load(&r->head) - tail);
+
+    if (avail == 0)
+    {
+      // announce the wait, then look again before sleeping
+      if (!impl->readArmed)
+      {
+        arm(&r->readerWaiting);
+        impl->readArmed = true;
+      }
+      else if (impl->wait(Data))
+      {
+        impl->readArmed = false;
+      }
+      else
+      {
+        break;
+      }
+      continue;
+    }
+
+    if (!impl->disarm(&r->readerWaiting, impl->readArmed, Data))
+    {
+      break;
+    }
+
+    size_t n = std::min(size - done, avail);
+    size_t pos = tail & impl->mask;
+    size_t first = std::min(n, ringSize - pos);
+    memcpy(buffer + done, impl->inData + pos, first);
+    memcpy(buffer + done + first, impl->inData, n - first);
+    virvo::atomic::add(&r->tail, long(n));
+    done += n;
+
+    if (takeFlag(&r->writerWaiting) && !impl->ring(Space))
+    {
+      break;
+    }
+  }
+
+  return ssize_t(done);
+}
+
+
+ssize_t ShmChannel::write(const char* buffer, size_t size)
+{
+  Ring* r = impl->out;
+  size_t ringSize = impl->mask + 1;
+  size_t done = 0;
+
+  while (done < size)
+  {
+    unsigned long head = (unsigned long)r->head;
+    size_t space = ringSize - size_t(head - (unsigned long)load(&r->tail));
+
+    if (space == 0)
+    {
+      if (!impl->writeArmed)
+      {
+        arm(&r->writerWaiting);
+        impl->writeArmed = true;
+      }
+      else if (impl->wait(Space))
+      {
+        impl->writeArmed = false;
+      }
+      else
+      {
+        return -1;
+      }
+      continue;
+    }
+
+    if (!impl->disarm(&r->writerWaiting, impl->writeArmed, Space))
+    {
+      return -1;
+    }
+
+    size_t n = std::min(size - done, space);
+    size_t pos = head & impl->mask;
+    size_t first = std::min(n, ringSize - pos);
+    memcpy(impl->outData + pos, buffer + done, first);
+    memcpy(impl->outData, buffer + done + first, n - first);
+    virvo::atomic::add(&r->head, long(n));
+    done += n;
+
+    if (takeFlag(&r->readerWaiting) && !impl->ring(Data))
+    {
+      return -1;
+    }
+  }
+
+  return ssize_t(size);
+}
+
+
+#else // VV_HAVE_MEMFD
+
+
+struct ShmChannel::Impl
+{
+};
+
+
+bool ShmChannel::isEnabled()
+{
+  return false;
+}
+
+
+ShmChannel* ShmChannel::create(vvsock_t, size_t)
+{
+  return NULL;
+}
+
+
+ShmChannel* ShmChannel::attach(vvsock_t, int, int, uint32_t, size_t)
+{
+  return NULL;
+}
+
+
+ShmChannel::ShmChannel(Impl* impl)
+  : impl(impl)
+{
+}
+
+
+ShmChannel::~ShmChannel()
+{
+  delete impl;
+}
+
+
+int ShmChannel::getPid() const
+{
+  return 0;
+}
+
+
+int ShmChannel::getHandle() const
+{
+  return -1;
+}
+
+
+uint32_t ShmChannel::getCookie() const
+{
+  return 0;
+}
+
+
+size_t ShmChannel::getRingSize() const
+{
+  return 0;
+}
+
+
+void ShmChannel::closeHandle()
+{
+}
+
+
+size_t ShmChannel::available()
+{
+  return 0;
+}
+
+
+ssize_t ShmChannel::read(char*, size_t)
+{
+  return -1;
+}
+
+
+ssize_t ShmChannel::write(const char*, size_t)
+{
+  return -1;
+}
+
+
+#endif // VV_HAVE_MEMFD
@@ -0,0 +1,103 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef VV_SHMCHANNEL_H
+#define VV_SHMCHANNEL_H
+
+
+#include "vvexport.h"
+#include "vvinttypes.h"
+#include "vvsocket.h"
+
+#include <stddef.h>
+
+
+namespace virvo
+{
+
+
+// Shared memory transport between two processes on the same host.
+//
+// A memfd segment holds one ring buffer per direction. The sender copies
+// data into the ring and the receiver copies it out, without system calls.
+// The TCP connection the channel was negotiated on stays open for wake-ups:
+// a side that runs out of data or space sets a flag in the segment, and the
+// peer answers with a single byte on the connection. Socket monitors thus
+// still see the connection become readable when data arrives, and a closed
+// connection still ends a blocked read or write.
+//
+// The peer opens the segment through /proc, so both processes must run on
+// Linux with the same user. create() and attach() return NULL otherwise.
+class VVAPI ShmChannel
+{
+public:
+  // Default size of each ring buffer [bytes]
+  static const size_t DefaultRingSize;
+
+  // Returns false if shared memory is not supported, or if it is disabled
+  // by setting the environment variable VV_SHARED_MEMORY to 0
+  static bool isEnabled();
+
+  // Create a segment for the connection fd. The peer attaches to it with
+  // getPid(), getHandle() and getCookie(). ringSize is rounded up to a
+  // power of two.
+  static ShmChannel* create(vvsock_t fd, size_t ringSize = DefaultRingSize);
+
+  // Attach to the segment created by process pid for the other end of the
+  // connection fd. ringSize is getRingSize() of the creator. Returns NULL if
+  // the handle is not a segment of that size or does not carry cookie.
+  static ShmChannel* attach(vvsock_t fd, int pid, int handle, uint32_t cookie, size_t ringSize);
+
+  ~ShmChannel();
+
+  int getPid() const;
+  int getHandle() const;
+  uint32_t getCookie() const;
+  size_t getRingSize() const;
+
+  // Close the handle of a created segment once the peer has attached
+  void closeHandle();
+
+  // Returns the number of bytes that can be read without waiting. If there
+  // are none, the peer is asked to wake up the connection on new data.
+  size_t available();
+
+  // Read size bytes. Returns less if the connection was closed.
+  ssize_t read(char* buffer, size_t size);
+
+  // Write size bytes. Returns -1 if the connection was closed.
+  ssize_t write(const char* buffer, size_t size);
+
+private:
+  struct Impl;
+  Impl* impl;
+
+  explicit ShmChannel(Impl* impl);
+
+  // NOT copyable!
+  ShmChannel(ShmChannel const&);
+  ShmChannel& operator=(ShmChannel const&);
+};
+
+
+} // namespace virvo
+
+
+#endif
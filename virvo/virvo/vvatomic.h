@@ -0,0 +1,155 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+
+#ifndef _VV_ATOMIC_H_
+#define _VV_ATOMIC_H_
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#pragma intrinsic(_InterlockedExchangeAdd, _InterlockedCompareExchange)
+#endif
+
+#include <cstddef>
+
+namespace virvo
+{
+namespace atomic
+{
+
+//------------------------------------------------------------------------------
+// Primitives
+//
+// All operations are sequentially consistent (full memory barrier).
+//
+
+// Atomically adds v to *p and returns the new value
+inline long add(long volatile* p, long v)
+{
+#ifdef _MSC_VER
+  return _InterlockedExchangeAdd(p, v) + v;
+#else
+  return __sync_add_and_fetch(p, v);
+#endif
+}
+
+// If *p == expected, atomically replace *p with desired.
+// Returns the value of *p before the operation.
+inline long compareExchange(long volatile* p, long expected, long desired)
+{
+#ifdef _MSC_VER
+  return _InterlockedCompareExchange(p, desired, expected);
+#else
+  return __sync_val_compare_and_swap(p, expected, desired);
+#endif
+}
+
+// If *p == expected, atomically replace *p with desired.
+// Returns the value of *p before the operation.
+inline void* compareExchange(void* volatile* p, void* expected, void* desired)
+{
+#ifdef _MSC_VER
+  return _InterlockedCompareExchangePointer(p, desired, expected);
+#else
+  return __sync_val_compare_and_swap(p, expected, desired);
+#endif
+}
+
+} // namespace atomic
+
+//------------------------------------------------------------------------------
+// AtomicCounter
+//
+class AtomicCounter
+{
+  long volatile value;
+
+  // NOT copyable!
+  AtomicCounter(AtomicCounter const&);
+  AtomicCounter& operator=(AtomicCounter const&);
+
+public:
+  AtomicCounter(long v = 0) : value(v) {}
+
+  // Returns the current value
+  long load() const { return atomic::add(const_cast<long volatile*>(&value), 0); }
+
+  // Sets a new value
+  void store(long v)
+  {
+    long old = load();
+    while (atomic::compareExchange(&value, old, v) != old)
+      old = load();
+  }
+
+  // Adds v and returns the new value
+  long add(long v) { return atomic::add(&value, v); }
+
+  // Returns the new value
+  long operator++() { return add(1); }
+
+  // Returns the new value
+  long operator--() { return add(-1); }
+};
+
+//------------------------------------------------------------------------------
+// AtomicPtr
+//
+template <class T>
+class AtomicPtr
+{
+  void* volatile ptr;
+
+  // NOT copyable!
+  AtomicPtr(AtomicPtr const&);
+  AtomicPtr& operator=(AtomicPtr const&);
+
+public:
+  AtomicPtr(T* p = NULL) : ptr(p) {}
+
+  // Returns the current pointer
+  T* load() const
+  {
+    void* volatile* p = const_cast<void* volatile*>(&ptr);
+    return static_cast<T*>(atomic::compareExchange(p, NULL, NULL));
+  }
+
+  // Sets a new pointer
+  void store(T* p) { exchange(p); }
+
+  // Sets a new pointer and returns the old one
+  T* exchange(T* p)
+  {
+    void* old = load();
+    for (;;)
+    {
+      void* prev = atomic::compareExchange(&ptr, old, p);
+      if (prev == old)
+        return static_cast<T*>(old);
+      old = prev;
+    }
+  }
+
+  // Replaces the pointer with desired if it equals expected.
+  // Returns true on success.
+  bool compareExchange(T* expected, T* desired)
+  {
+    return atomic::compareExchange(&ptr, expected, desired) == expected;
+  }
+};
+
+} // namespace virvo
+
+#endif
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,722 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include "vvbrickcache.h"
+#include "vvdebugmsg.h"
+#include "vvpthread.h"
+#include "vvtoolshed.h"
+#include "vvtrace.h"
+#include "vvvoldesc.h"
+#include "vvworkerpool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+
+namespace virvo
+{
+
+const size_t BrickCache::DefaultBrickSize = 64;
+const size_t BrickCache::DefaultBudget = size_t(1024) << 20;
+
+namespace
+{
+
+// File layout (all values big endian):
+//   "VIRVO-BRICKS"                 magic
+//   uint32 version, vox[3], bpc, chan, brick size
+//   float  dist[3], real[2]
+//   brick voxels, x fastest, bricks in x, y, z order
+const char Magic[] = "VIRVO-BRICKS";
+const size_t MagicLength = 12;
+const uint32_t Version = 1;
+const size_t HeaderSize = MagicLength + 7 * 4 + 5 * 4;
+
+// Threads reading bricks, several requests in flight keep SSDs and
+// parallel file systems busy
+const int NumLoaders = 4;
+
+virvo::trace::Counter bricksLoaded("bricks loaded");
+virvo::trace::Counter brickStalls("brick cache stalls");
+
+struct Header
+{
+  vvsize3 vox;
+  size_t bpc;
+  size_t chan;
+  size_t brickSize;
+  float dist[3];
+  float real[2];
+};
+
+bool readHeader(FILE* fp, Header* header)
+{
+  char magic[MagicLength];
+  if (fread(magic, 1, MagicLength, fp) != MagicLength || memcmp(magic, Magic, MagicLength) != 0)
+    return false;
+
+  if (vvToolshed::read32(fp) != Version)
+    return false;
+
+  for (size_t i=0; i<3; ++i)
+    header->vox[i] = vvToolshed::read32(fp);
+  header->bpc = vvToolshed::read32(fp);
+  header->chan = vvToolshed::read32(fp);
+  header->brickSize = vvToolshed::read32(fp);
+  for (size_t i=0; i<3; ++i)
+    header->dist[i] = vvToolshed::readFloat(fp);
+  for (size_t i=0; i<2; ++i)
+    header->real[i] = vvToolshed::readFloat(fp);
+
+  return !feof(fp) && !ferror(fp)
+      && header->vox[0] > 0 && header->vox[1] > 0 && header->vox[2] > 0
+      && header->bpc >= 1 && header->bpc <= 4
+      && header->chan >= 1
+      && header->brickSize >= 1;
+}
+
+// Brick geometry and file offsets, offsets has one more entry than bricks
+void layoutBricks(const vvsize3& vox, size_t bpv, size_t brickSize, vvsize3* grid,
+                  std::vector<BrickCache::Brick>* bricks, std::vector<uint64_t>* offsets)
+{
+  for (size_t i=0; i<3; ++i)
+    (*grid)[i] = (vox[i] + brickSize - 1) / brickSize;
+
+  bricks->clear();
+  offsets->clear();
+
+  uint64_t offset = HeaderSize;
+  for (size_t z=0; z<(*grid)[2]; ++z)
+  {
+    for (size_t y=0; y<(*grid)[1]; ++y)
+    {
+      for (size_t x=0; x<(*grid)[0]; ++x)
+      {
+        BrickCache::Brick b;
+        b.first = vvsize3(x * brickSize, y * brickSize, z * brickSize);
+        for (size_t i=0; i<3; ++i)
+        {
+          b.size[i] = std::min(brickSize, vox[i] - b.first[i]);
+          b.stored[i] = std::min(b.size[i] + 1, vox[i] - b.first[i]);
+        }
+        bricks->push_back(b);
+        offsets->push_back(offset);
+        offset += uint64_t(b.stored[0]) * b.stored[1] * b.stored[2] * bpv;
+      }
+    }
+  }
+  offsets->push_back(offset);
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+struct BrickCache::Impl
+{
+  enum State
+  {
+    Empty,
+    Loading,
+    Resident
+  };
+
+  struct Entry
+  {
+    Entry()
+      : state(Empty)
+      , refs(0)
+      , pinnedBy(NULL)
+    {
+    }
+
+    State state;
+    int refs;
+    const void* pinnedBy;                 // client that prefetched the brick
+    std::vector<uint8_t> data;
+    std::list<size_t>::iterator lruPos;   // valid if resident and refs == 0
+  };
+
+  struct Request
+  {
+    const void* client;
+    size_t brick;
+  };
+
+  std::string filename;
+  Header header;
+  size_t bpv;
+  vvsize3 grid;
+  std::vector<Brick> bricks;
+  std::vector<uint64_t> offsets;
+
+  Mutex mutex;
+  Condition loaded;
+  std::vector<Entry> entries;
+  std::list<size_t> lru;                  // unused resident bricks, least recently used first
+  std::deque<Request> queue;              // bricks to prefetch
+  std::vector<size_t> pinned;             // bricks that may be pinned
+  WorkerPool* pool;
+  int numLoaders;                         // loader jobs submitted and not finished
+  size_t budget;
+  size_t usage;
+  size_t numLoads;
+  size_t numStalls;
+
+  int refs;                               // open() calls
+
+  size_t getBytes(size_t index) const
+  {
+    return size_t(offsets[index + 1] - offsets[index]);
+  }
+
+  // Evict unused bricks until bytes fit into the budget
+  bool makeRoom(size_t bytes);
+
+  // Read brick data, called without the mutex held
+  bool readBrick(size_t index, std::vector<uint8_t>& data) const;
+
+  // Submit loader jobs for the queued requests
+  void startLoaders();
+
+  static void loadQueued(void* param);
+};
+
+bool BrickCache::Impl::makeRoom(size_t bytes)
+{
+  std::list<size_t>::iterator it = lru.begin();
+  while (usage + bytes > budget && it != lru.end())
+  {
+    Entry& e = entries[*it];
+    if (e.pinnedBy != NULL)
+    {
+      ++it;
+      continue;
+    }
+
+    usage -= e.data.size();
+    std::vector<uint8_t>().swap(e.data);
+    e.state = Empty;
+    it = lru.erase(it);
+  }
+  return usage + bytes <= budget;
+}
+
+bool BrickCache::Impl::readBrick(size_t index, std::vector<uint8_t>& data) const
+{
+  VV_TRACE_ZONE("read brick");
+
+  FILE* fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL)
+    return false;
+
+  bool ok = vvToolshed::seekFile(fp, int64_t(offsets[index])) && fread(&data[0], 1, data.size(), fp) == data.size();
+  fclose(fp);
+
+  if (ok)
+    bricksLoaded.add(1);
+  else
+    vvDebugMsg::msg(0, "BrickCache: cannot read brick from ", filename.c_str());
+  return ok;
+}
+
+void BrickCache::Impl::startLoaders()
+{
+  while (numLoaders < pool->size() && numLoaders < int(queue.size()))
+  {
+    ++numLoaders;
+    pool->submit(loadQueued, this);
+  }
+}
+
+void BrickCache::Impl::loadQueued(void* param)
+{
+  Impl* impl = static_cast<Impl*>(param);
+
+  ScopedLock lock(&impl->mutex);
+  while (!impl->queue.empty())
+  {
+    Request r = impl->queue.front();
+    Entry& e = impl->entries[r.brick];
+
+    if (e.state != Empty)
+    {
+      // keep resident bricks until the client acquires them
+      if (e.state == Resident && e.refs == 0 && e.pinnedBy == NULL)
+      {
+        e.pinnedBy = r.client;
+        impl->pinned.push_back(r.brick);
+      }
+      impl->queue.pop_front();
+      continue;
+    }
+
+    const size_t bytes = impl->getBytes(r.brick);
+    if (!impl->makeRoom(bytes))
+    {
+      // resumed by release() or prefetch()
+      break;
+    }
+    impl->queue.pop_front();
+
+    e.state = Loading;
+    e.pinnedBy = r.client;
+    impl->pinned.push_back(r.brick);
+    impl->usage += bytes;
+
+    impl->mutex.unlock();
+    std::vector<uint8_t> data(bytes);
+    bool ok = impl->readBrick(r.brick, data);
+    impl->mutex.lock();
+
+    if (ok)
+    {
+      e.data.swap(data);
+      e.state = Resident;
+      e.lruPos = impl->lru.insert(impl->lru.end(), r.brick);
+      ++impl->numLoads;
+    }
+    else
+    {
+      // acquire() tries again and reports the error
+      e.state = Empty;
+      e.pinnedBy = NULL;
+      impl->usage -= bytes;
+    }
+    impl->loaded.broadcast();
+  }
+  --impl->numLoaders;
+}
+
+//------------------------------------------------------------------------------
+namespace
+{
+  Mutex openMutex;
+  std::map<std::string, BrickCache*> openCaches;
+}
+
+bool BrickCache::isBrickFile(const char* filename)
+{
+  return filename != NULL && vvToolshed::isSuffix(filename, ".bricks");
+}
+
+bool BrickCache::write(const vvVolDesc* vd, const char* filename, size_t brickSize)
+{
+  vvDebugMsg::msg(1, "BrickCache::write()");
+
+  if (vd->frames == 0 || brickSize == 0)
+    return false;
+
+  const uint8_t* raw = vd->getRaw();
+  if (raw == NULL)
+    return false;
+
+  FILE* fp = fopen(filename, "wb");
+  if (fp == NULL)
+  {
+    vvDebugMsg::msg(1, "Error: Cannot open file for writing: ", filename);
+    return false;
+  }
+
+  fwrite(Magic, 1, MagicLength, fp);
+  vvToolshed::write32(fp, Version);
+  for (size_t i=0; i<3; ++i)
+    vvToolshed::write32(fp, uint32_t(vd->vox[i]));
+  vvToolshed::write32(fp, uint32_t(vd->bpc));
+  vvToolshed::write32(fp, uint32_t(vd->chan));
+  vvToolshed::write32(fp, uint32_t(brickSize));
+  for (size_t i=0; i<3; ++i)
+    vvToolshed::writeFloat(fp, vd->dist[i]);
+  for (size_t i=0; i<2; ++i)
+    vvToolshed::writeFloat(fp, vd->real[i]);
+
+  const size_t bpv = vd->getBPV();
+  vvsize3 grid;
+  std::vector<Brick> bricks;
+  std::vector<uint64_t> offsets;
+  layoutBricks(vd->vox, bpv, brickSize, &grid, &bricks, &offsets);
+
+  std::vector<uint8_t> data;
+  bool ok = !ferror(fp);
+  for (size_t i=0; i<bricks.size() && ok; ++i)
+  {
+    const Brick& b = bricks[i];
+    const size_t rowBytes = b.stored[0] * bpv;
+    data.resize(rowBytes * b.stored[1] * b.stored[2]);
+
+    uint8_t* dst = &data[0];
+    for (size_t z=0; z<b.stored[2]; ++z)
+    {
+      for (size_t y=0; y<b.stored[1]; ++y)
+      {
+        const size_t src = (((b.first[2] + z) * vd->vox[1] + b.first[1] + y) * vd->vox[0] + b.first[0]) * bpv;
+        memcpy(dst, raw + src, rowBytes);
+        dst += rowBytes;
+      }
+    }
+    ok = fwrite(&data[0], 1, data.size(), fp) == data.size();
+  }
+
+  ok = fclose(fp) == 0 && ok;
+  if (!ok)
+    vvDebugMsg::msg(1, "Error: Cannot write bricked volume file: ", filename);
+  return ok;
+}
+
+bool BrickCache::read(const char* filename, vvVolDesc* vd, bool withData)
+{
+  vvDebugMsg::msg(1, "BrickCache::read()");
+
+  FILE* fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return false;
+
+  Header header;
+  if (!readHeader(fp, &header))
+  {
+    vvDebugMsg::msg(1, "Error: Invalid bricked volume file: ", filename);
+    fclose(fp);
+    return false;
+  }
+
+  vd->vox = header.vox;
+  vd->bpc = header.bpc;
+  vd->chan = header.chan;
+  vd->dist = vvVector3(header.dist[0], header.dist[1], header.dist[2]);
+  vd->real[0] = header.real[0];
+  vd->real[1] = header.real[1];
+
+  if (!withData)
+  {
+    fclose(fp);
+    return true;
+  }
+
+  const size_t bpv = vd->getBPV();
+  vvsize3 grid;
+  std::vector<Brick> bricks;
+  std::vector<uint64_t> offsets;
+  layoutBricks(header.vox, bpv, header.brickSize, &grid, &bricks, &offsets);
+
+  uint8_t* raw = new (std::nothrow) uint8_t[vd->getFrameBytes()];
+  if (raw == NULL)
+  {
+    fclose(fp);
+    return false;
+  }
+
+  // the bricks are stored in file order, only skip the shared voxel layers
+  std::vector<uint8_t> data;
+  bool ok = true;
+  for (size_t i=0; i<bricks.size() && ok; ++i)
+  {
+    const Brick& b = bricks[i];
+    data.resize(size_t(offsets[i + 1] - offsets[i]));
+    ok = fread(&data[0], 1, data.size(), fp) == data.size();
+
+    const uint8_t* src = &data[0];
+    for (size_t z=0; z<b.size[2] && ok; ++z)
+    {
+      for (size_t y=0; y<b.size[1]; ++y)
+      {
+        const size_t dst = (((b.first[2] + z) * vd->vox[1] + b.first[1] + y) * vd->vox[0] + b.first[0]) * bpv;
+        memcpy(raw + dst, src + (z * b.stored[1] + y) * b.stored[0] * bpv, b.size[0] * bpv);
+      }
+    }
+  }
+  fclose(fp);
+
+  if (!ok)
+  {
+    vvDebugMsg::msg(1, "Error: Bricked volume file corrupt: ", filename);
+    delete[] raw;
+    return false;
+  }
+
+  vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+  ++vd->frames;
+  return true;
+}
+
+BrickCache* BrickCache::open(const char* filename)
+{
+  vvDebugMsg::msg(1, "BrickCache::open()");
+
+  ScopedLock lock(&openMutex);
+
+  std::map<std::string, BrickCache*>::iterator it = openCaches.find(filename);
+  if (it != openCaches.end())
+  {
+    ++it->second->impl->refs;
+    return it->second;
+  }
+
+  BrickCache* cache = new BrickCache(filename);
+  if (cache->impl->entries.empty())
+  {
+    delete cache;
+    return NULL;
+  }
+  openCaches[filename] = cache;
+  return cache;
+}
+
+void BrickCache::close(BrickCache* cache)
+{
+  vvDebugMsg::msg(1, "BrickCache::close()");
+
+  if (cache == NULL)
+    return;
+
+  ScopedLock lock(&openMutex);
+  if (--cache->impl->refs == 0)
+  {
+    openCaches.erase(cache->impl->filename);
+    delete cache;
+  }
+}
+
+BrickCache::BrickCache(const char* filename)
+  : impl(new Impl)
+{
+  impl->filename = filename;
+  impl->bpv = 0;
+  impl->pool = NULL;
+  impl->numLoaders = 0;
+  impl->budget = DefaultBudget;
+  impl->usage = 0;
+  impl->numLoads = 0;
+  impl->numStalls = 0;
+  impl->refs = 1;
+
+  char* envBudget = getenv("VV_BRICK_CACHE");
+  if (envBudget != NULL)
+  {
+    impl->budget = size_t(atoi(envBudget)) << 20;
+  }
+
+  FILE* fp = fopen(filename, "rb");
+  if (fp == NULL)
+  {
+    vvDebugMsg::msg(0, "BrickCache: cannot open ", filename);
+    return;
+  }
+  bool ok = readHeader(fp, &impl->header);
+  fclose(fp);
+  if (!ok)
+  {
+    vvDebugMsg::msg(0, "BrickCache: invalid bricked volume file ", filename);
+    return;
+  }
+
+  impl->bpv = impl->header.bpc * impl->header.chan;
+  layoutBricks(impl->header.vox, impl->bpv, impl->header.brickSize, &impl->grid, &impl->bricks, &impl->offsets);
+  impl->entries.resize(impl->bricks.size());
+  impl->pool = new WorkerPool(NumLoaders, "brick loader");
+}
+
+BrickCache::~BrickCache()
+{
+  {
+    ScopedLock lock(&impl->mutex);
+    impl->queue.clear();
+  }
+  delete impl->pool;
+  delete impl;
+}
+
+const vvsize3& BrickCache::getVolumeSize() const
+{
+  return impl->header.vox;
+}
+
+size_t BrickCache::getBytesPerVoxel() const
+{
+  return impl->bpv;
+}
+
+size_t BrickCache::getBrickSize() const
+{
+  return impl->header.brickSize;
+}
+
+const vvsize3& BrickCache::getGridSize() const
+{
+  return impl->grid;
+}
+
+size_t BrickCache::getNumBricks() const
+{
+  return impl->bricks.size();
+}
+
+const BrickCache::Brick& BrickCache::getBrick(size_t index) const
+{
+  return impl->bricks[index];
+}
+
+void BrickCache::setBudget(size_t bytes)
+{
+  ScopedLock lock(&impl->mutex);
+  impl->budget = bytes;
+  impl->makeRoom(0);
+  impl->startLoaders();
+}
+
+size_t BrickCache::getBudget() const
+{
+  ScopedLock lock(&impl->mutex);
+  return impl->budget;
+}
+
+size_t BrickCache::getUsage() const
+{
+  ScopedLock lock(&impl->mutex);
+  return impl->usage;
+}
+
+size_t BrickCache::getNumLoads() const
+{
+  ScopedLock lock(&impl->mutex);
+  return impl->numLoads;
+}
+
+size_t BrickCache::getNumStalls() const
+{
+  ScopedLock lock(&impl->mutex);
+  return impl->numStalls;
+}
+
+void BrickCache::prefetch(const void* client, const std::vector<size_t>& order)
+{
+  ScopedLock lock(&impl->mutex);
+
+  // forget what the client asked for before
+  std::vector<size_t> stillPinned;
+  for (std::vector<size_t>::const_iterator it = impl->pinned.begin(); it != impl->pinned.end(); ++it)
+  {
+    Impl::Entry& e = impl->entries[*it];
+    if (e.pinnedBy == client)
+      e.pinnedBy = NULL;
+    else if (e.pinnedBy != NULL)
+      stillPinned.push_back(*it);
+  }
+  impl->pinned.swap(stillPinned);
+
+  std::deque<Impl::Request> queue;
+  for (std::deque<Impl::Request>::const_iterator it = impl->queue.begin(); it != impl->queue.end(); ++it)
+  {
+    if (it->client != client)
+      queue.push_back(*it);
+  }
+
+  for (std::vector<size_t>::const_iterator it = order.begin(); it != order.end(); ++it)
+  {
+    if (*it >= impl->entries.size())
+      continue;
+
+    Impl::Request r = { client, *it };
+    queue.push_back(r);
+  }
+  impl->queue.swap(queue);
+
+  impl->startLoaders();
+}
+
+const uint8_t* BrickCache::acquire(const void* client, size_t index)
+{
+  if (index >= impl->entries.size())
+    return NULL;
+
+  ScopedLock lock(&impl->mutex);
+
+  Impl::Entry& e = impl->entries[index];
+  while (e.state == Impl::Loading)
+  {
+    impl->loaded.wait(&impl->mutex);
+  }
+
+  if (e.state == Impl::Empty)
+  {
+    VV_TRACE_ZONE("brick cache stall");
+
+    // not prefetched (yet), read it here even if that exceeds the budget
+    for (std::deque<Impl::Request>::iterator it = impl->queue.begin(); it != impl->queue.end(); ++it)
+    {
+      if (it->client == client && it->brick == index)
+      {
+        impl->queue.erase(it);
+        break;
+      }
+    }
+
+    const size_t bytes = impl->getBytes(index);
+    impl->makeRoom(bytes);
+    e.state = Impl::Loading;
+    impl->usage += bytes;
+    ++impl->numStalls;
+    brickStalls.add(1);
+
+    impl->mutex.unlock();
+    std::vector<uint8_t> data(bytes);
+    bool ok = impl->readBrick(index, data);
+    impl->mutex.lock();
+
+    impl->loaded.broadcast();
+    if (!ok)
+    {
+      e.state = Impl::Empty;
+      impl->usage -= bytes;
+      return NULL;
+    }
+
+    e.data.swap(data);
+    e.state = Impl::Resident;
+    ++impl->numLoads;
+  }
+  else if (e.refs == 0)
+  {
+    impl->lru.erase(e.lruPos);
+  }
+
+  e.pinnedBy = NULL;
+  ++e.refs;
+  return &e.data[0];
+}
+
+void BrickCache::release(size_t index)
+{
+  ScopedLock lock(&impl->mutex);
+
+  Impl::Entry& e = impl->entries[index];
+  if (--e.refs == 0)
+  {
+    e.lruPos = impl->lru.insert(impl->lru.end(), index);
+    impl->makeRoom(0);
+    impl->startLoaders();
+  }
+}
+
+} // namespace virvo
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,137 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef _VV_BRICKCACHE_H_
+#define _VV_BRICKCACHE_H_
+
+#include "vvexport.h"
+#include "vvinttypes.h"
+#include "vvvecmath.h"
+
+#include <stddef.h>
+#include <vector>
+
+class vvVolDesc;
+
+namespace virvo
+{
+
+//------------------------------------------------------------------------------
+// BrickCache
+//
+// Out-of-core access to bricked volume files (.bricks). The first frame of
+// a volume is split into cubic bricks which are stored one after another.
+// Each brick has an extra layer of voxels at its upper faces, so it can be
+// sampled with trilinear interpolation without its neighbors.
+//
+// Bricks in memory are kept in an LRU cache with a memory budget. A renderer
+// announces the bricks of a frame in visibility order with prefetch(), I/O
+// threads then load them in that order while the renderer works through
+// them with acquire() and release(). Prefetched bricks are not evicted
+// before they were acquired, so the I/O threads stall when the budget is
+// used up and resume as bricks are released.
+//
+//   virvo::BrickCache* cache = virvo::BrickCache::open("big.bricks");
+//   cache->prefetch(this, order);
+//   for (i in order)
+//   {
+//     const uint8_t* voxels = cache->acquire(this, i);
+//     ...
+//     cache->release(i);
+//   }
+//   virvo::BrickCache::close(cache);
+//
+class VVAPI BrickCache
+{
+public:
+  /// Default brick edge length [voxels]
+  static const size_t DefaultBrickSize;
+
+  /// Default memory budget [bytes], the environment variable VV_BRICK_CACHE
+  /// overrides it with a size in MB
+  static const size_t DefaultBudget;
+
+  struct Brick
+  {
+    vvsize3 first;    ///< first voxel of the brick
+    vvsize3 size;     ///< voxels owned by the brick
+    vvsize3 stored;   ///< voxels stored, including the layer shared with the upper neighbors
+  };
+
+  /// Returns true if filename has the extension of bricked volume files
+  static bool isBrickFile(const char* filename);
+
+  /// Write the current frame of vd as a bricked volume file
+  static bool write(const vvVolDesc* vd, const char* filename, size_t brickSize = DefaultBrickSize);
+
+  /// Read the volume attributes (size, data format, voxel distance) of a
+  /// bricked volume file into vd. If withData is true, the voxels are
+  /// assembled into a frame which is added to vd.
+  static bool read(const char* filename, vvVolDesc* vd, bool withData);
+
+  /// Returns the cache of filename, which is shared with the other users of
+  /// that file. Returns NULL if the file cannot be opened. Call close() when done.
+  static BrickCache* open(const char* filename);
+
+  /// Release a cache returned by open()
+  static void close(BrickCache* cache);
+
+  const vvsize3& getVolumeSize() const;   ///< volume size [voxels]
+  size_t getBytesPerVoxel() const;
+  size_t getBrickSize() const;            ///< brick edge length [voxels]
+  const vvsize3& getGridSize() const;     ///< number of bricks along each axis
+  size_t getNumBricks() const;
+  const Brick& getBrick(size_t index) const;
+
+  /// Memory for bricks [bytes]. Bricks in use are never evicted, so the
+  /// cache may exceed the budget temporarily.
+  void setBudget(size_t bytes);
+  size_t getBudget() const;
+  size_t getUsage() const;                ///< bytes of bricks in memory
+
+  size_t getNumLoads() const;             ///< bricks read from the file
+  size_t getNumStalls() const;            ///< acquire() calls that had to read the brick themselves
+
+  /// Queue the bricks a client will acquire next, in that order. Replaces
+  /// the bricks queued before by the same client.
+  void prefetch(const void* client, const std::vector<size_t>& order);
+
+  /// Returns the voxels of a brick, waiting until they are loaded. Returns
+  /// NULL on read errors. Call release() when done.
+  const uint8_t* acquire(const void* client, size_t index);
+
+  /// Release a brick returned by acquire()
+  void release(size_t index);
+
+private:
+  struct Impl;
+  Impl* impl;
+
+  explicit BrickCache(const char* filename);
+  ~BrickCache();
+
+  // NOT copyable!
+  BrickCache(BrickCache const&);
+  BrickCache& operator=(BrickCache const&);
+};
+
+} // namespace virvo
+
+#endif
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -41,6 +41,7 @@ public:
   ~vvCocoaGLContext();
 
   bool makeCurrent() const;
+  void doneCurrent() const;
   void swapBuffers() const;
   void resize(int w, int h);
 private:
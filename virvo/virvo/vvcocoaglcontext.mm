@@ -48,6 +48,11 @@ bool vvCocoaGLContext::makeCurrent() const
   }
 }
 
+void vvCocoaGLContext::doneCurrent() const
+{
+  [NSOpenGLContext clearCurrentContext];
+}
+
 void vvCocoaGLContext::swapBuffers() const
 {
   [_context flushBuffer];
@@ -35,6 +35,7 @@
 #include "gdcmMD5.h"
 #include "gdcmSystem.h"
 #include "gdcmDirectory.h"
+#include "gdcmAttribute.h"
 #endif
 
 #ifdef VV_DEBUG_MEMORY
@@ -42,17 +43,30 @@
 #define new new(_NORMAL_BLOCK,__FILE__, __LINE__)
 #endif
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <float.h>
 #include <math.h>
 #include <limits.h>
 #include <ctype.h>
 #include <cstring>
+#include <algorithm>
 
 #include "vvfileio.h"
+#include "vvbrickcache.h"
+#include "vvclock.h"
 #include "vvtoolshed.h"
 #include "vvdebugmsg.h"
 #include "vvtokenizer.h"
 #include "vvdicom.h"
 #include "vvarray.h"
+#include "vvworkerpool.h"
+#include "private/vvcompress.h"
 #include "private/vvlog.h"
 
 #ifdef __sun
@@ -61,6 +75,621 @@
 
 using namespace std;
 
+namespace
+{
+  // Marks delta encoded frames in the length that precedes XVF frames
+  const uint32_t XVF_DELTA_FRAME = 0x80000000u;
+
+  // Write voxels to an XVF file, preceded by their RLE encoded length
+  // or zero if they are stored unencoded
+  bool writeXVFVoxels(FILE* fp, uint8_t* data, size_t size, size_t bpv, bool compress, uint8_t* encoded)
+  {
+    size_t encodedSize;
+    if (compress && vvToolshed::encodeRLE(encoded, data, size, bpv, size, &encodedSize) == vvToolshed::VV_OK)
+    {
+      vvToolshed::write32(fp, static_cast<uint32_t>(encodedSize));
+      return fwrite(encoded, 1, encodedSize, fp) == encodedSize;
+    }
+    vvToolshed::write32(fp, 0);
+    return fwrite(data, 1, size, fp) == size;
+  }
+
+  // A file of a slice series, loaded by a worker thread
+  struct SeriesFile
+  {
+    std::string filename;
+    size_t index;                                 // position in the file list
+    bool dicom;
+    vvVolDesc* vd;
+    int instance;                                 // DICOM image number
+    float position;                               // DICOM slice location
+    vvFileIO::ErrorType err;
+    uint8_t** frames;                             // merged frames, NULL while loading
+    size_t slice;                                 // first merged slice of the file
+  };
+
+  void loadSeriesFile(void* param)
+  {
+    SeriesFile* file = static_cast<SeriesFile*>(param);
+    file->vd = new vvVolDesc(file->filename.c_str());
+    vvFileIO fio;
+    if (file->dicom)
+      file->err = fio.loadDicomFile(file->vd, NULL, &file->instance, &file->position);
+    else
+      file->err = fio.loadVolumeData(file->vd);
+  }
+
+  // Copy the slices of a file into the merged frames. The voxels of all
+  // but the first file are released right away.
+  void copySeriesFile(void* param)
+  {
+    SeriesFile* file = static_cast<SeriesFile*>(param);
+    const size_t bytes = file->vd->getFrameBytes();
+    for (size_t f=0; f<file->vd->frames; ++f)
+    {
+      memcpy(file->frames[f] + file->slice * file->vd->getSliceBytes(), file->vd->getRaw(f), bytes);
+    }
+    if (file->index > 0)
+    {
+      delete file->vd;
+      file->vd = NULL;
+    }
+  }
+
+  bool byPosition(const SeriesFile* a, const SeriesFile* b)
+  {
+    return a->position < b->position;
+  }
+
+  bool byInstance(const SeriesFile* a, const SeriesFile* b)
+  {
+    return a->instance < b->instance;
+  }
+
+  // Files merged in order by mergeFiles(), loaded ahead by worker threads
+  struct MergeFiles
+  {
+    const std::vector<std::string>* names;
+    std::vector<vvVolDesc*> vds;                  // loaded files, NULL while loading and once merged
+    std::vector<vvFileIO::ErrorType> errors;
+    vvVolDesc* vd;                                // volume to merge the files into
+    vvVolDesc::MergeType mergeType;
+  };
+
+  void loadMergeFile(void* context, size_t index)
+  {
+    MergeFiles* files = static_cast<MergeFiles*>(context);
+    vvVolDesc* vd = new vvVolDesc((*files->names)[index].c_str());
+    vvFileIO fio;
+    files->errors[index] = fio.loadVolumeData(vd);
+    files->vds[index] = vd;
+  }
+
+  bool mergeFile(void* context, size_t index)
+  {
+    MergeFiles* files = static_cast<MergeFiles*>(context);
+    vvVolDesc* vd = files->vds[index];
+    files->vds[index] = NULL;
+
+    const bool ok = files->errors[index] == vvFileIO::OK;
+    if (ok)
+    {
+      cerr << "Loaded file " << (index+1) << ": " << (*files->names)[index] << endl;
+      vd->printInfoLine("Loaded: ");
+      files->vd->merge(vd, files->mergeType);
+    }
+    else
+    {
+      cerr << "Cannot load file: " << (*files->names)[index] << endl;
+    }
+    delete vd;
+    return ok;
+  }
+
+  // Read voxels written by writeXVFVoxels()
+  bool readXVFVoxels(FILE* fp, uint8_t* data, size_t size, size_t bpv, uint8_t* encoded)
+  {
+    const size_t encodedSize = vvToolshed::read32(fp);
+    if (encodedSize == 0)
+    {
+      return fread(data, 1, size, fp) == size;
+    }
+    size_t outsize;
+    return encodedSize <= size
+        && fread(encoded, 1, encodedSize, fp) == encodedSize
+        && vvToolshed::decodeRLE(data, encoded, encodedSize, bpv, size, &outsize) == vvToolshed::VV_OK;
+  }
+
+  // Write the statistics of a channel of a frame, with the histogram
+  // trimmed to the range of non-empty buckets
+  bool writeXVFStatistics(FILE* fp, const vvVolDesc::Statistics& s)
+  {
+    size_t first = 0;
+    size_t last = s.histogram.size();
+    while (first < last && s.histogram[first] == 0) ++first;
+    while (last > first && s.histogram[last - 1] == 0) --last;
+
+    vvToolshed::writeFloat(fp, s.min);
+    vvToolshed::writeFloat(fp, s.max);
+    vvToolshed::writeFloat(fp, s.mean);
+    vvToolshed::writeFloat(fp, s.variance);
+    vvToolshed::write32(fp, static_cast<uint32_t>(s.histogram.size()));
+    vvToolshed::write32(fp, static_cast<uint32_t>(first));
+    vvToolshed::write32(fp, static_cast<uint32_t>(last - first));
+    for (size_t i=first; i<last; ++i)
+    {
+      vvToolshed::write32(fp, s.histogram[i]);
+    }
+    for (size_t i=0; i<3; ++i)
+    {
+      vvToolshed::write32(fp, static_cast<uint32_t>(s.bricks[i]));
+    }
+    for (size_t i=0; i<s.brickMin.size(); ++i)
+    {
+      vvToolshed::writeFloat(fp, s.brickMin[i]);
+      vvToolshed::writeFloat(fp, s.brickMax[i]);
+    }
+    return !ferror(fp);
+  }
+
+  // Read statistics written by writeXVFStatistics()
+  bool readXVFStatistics(FILE* fp, vvVolDesc::Statistics& s)
+  {
+    s.min = vvToolshed::readFloat(fp);
+    s.max = vvToolshed::readFloat(fp);
+    s.mean = vvToolshed::readFloat(fp);
+    s.variance = vvToolshed::readFloat(fp);
+    const size_t numBuckets = vvToolshed::read32(fp);
+    const size_t first = vvToolshed::read32(fp);
+    const size_t count = vvToolshed::read32(fp);
+    if (numBuckets > 65536 || first + count > numBuckets || feof(fp))
+    {
+      return false;
+    }
+    s.histogram.assign(numBuckets, 0);
+    for (size_t i=0; i<count; ++i)
+    {
+      s.histogram[first + i] = vvToolshed::read32(fp);
+    }
+    for (size_t i=0; i<3; ++i)
+    {
+      s.bricks[i] = vvToolshed::read32(fp);
+    }
+    const size_t numBricks = s.bricks[0] * s.bricks[1] * s.bricks[2];
+    if (feof(fp) || numBricks > 1024 * 1024 * 1024)
+    {
+      return false;
+    }
+    s.brickMin.resize(numBricks);
+    s.brickMax.resize(numBricks);
+    for (size_t i=0; i<numBricks; ++i)
+    {
+      s.brickMin[i] = vvToolshed::readFloat(fp);
+      s.brickMax[i] = vvToolshed::readFloat(fp);
+    }
+    return !feof(fp);
+  }
+
+  // A file in memory for parsing, mapped where the platform allows it
+  class TextFile
+  {
+  public:
+    TextFile() : data(NULL), size(0), mapped(false) {}
+    ~TextFile() { close(); }
+
+    bool open(const char* filename)
+    {
+      close();
+#ifndef _WIN32
+      int fd = ::open(filename, O_RDONLY);
+      if (fd < 0) return false;
+      struct stat st;
+      if (fstat(fd, &st) != 0)
+      {
+        ::close(fd);
+        return false;
+      }
+      size = static_cast<size_t>(st.st_size);
+      if (size > 0)
+      {
+        void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+          data = static_cast<const char*>(addr);
+          mapped = true;
+        }
+      }
+      ::close(fd);
+      if (mapped || size == 0) return true;
+#endif
+      // Not mappable: read the whole file
+      FILE* fp = fopen(filename, "rb");
+      if (fp == NULL) return false;
+      fseek(fp, 0, SEEK_END);
+      long length = ftell(fp);
+      fseek(fp, 0, SEEK_SET);
+      buffer.resize(length > 0 ? length : 0);
+      size = buffer.empty() ? 0 : fread(&buffer[0], 1, buffer.size(), fp);
+      data = buffer.empty() ? NULL : &buffer[0];
+      fclose(fp);
+      return size == buffer.size();
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+      if (mapped) munmap(const_cast<char*>(data), size);
+#endif
+      std::vector<char>().swap(buffer);
+      data = NULL;
+      size = 0;
+      mapped = false;
+    }
+
+    const char* data;
+    size_t size;
+
+  private:
+    bool mapped;
+    std::vector<char> buffer;
+  };
+
+  // Split text into ranges of whole lines of about chunkSize bytes
+  std::vector<std::pair<const char*, const char*> > splitLines(const char* begin, const char* end, size_t chunkSize)
+  {
+    std::vector<std::pair<const char*, const char*> > chunks;
+    while (begin < end)
+    {
+      const char* p = begin + std::min(chunkSize, size_t(end - begin));
+      while (p < end && p[-1] != '\n' && p[-1] != '\r')
+        ++p;
+      chunks.push_back(std::make_pair(begin, p));
+      begin = p;
+    }
+    return chunks;
+  }
+
+  const size_t TextChunkSize = 1024 * 1024;
+
+  // Longest token vvTokenizer reads at once (vvTokenizer::MAX_TOKEN_LEN)
+  const size_t MaxAVFToken = 1024;
+
+  // Character classes of the tokenizer settings in loadAVFFile()
+  inline bool isAVFSpace(unsigned char c)
+  {
+    return c < 33 || (c >= 127 && c < 192) || c == '=';
+  }
+
+  inline bool isAVFTokenChar(unsigned char c)
+  {
+    return !isAVFSpace(c) && c != '#';
+  }
+
+  // Find the next token in [p,end), skipping whitespace and comments
+  bool nextAVFToken(const char*& p, const char* end, const char*& token)
+  {
+    while (p < end)
+    {
+      if (*p == '#')
+      {
+        while (p < end && *p != '\n' && *p != '\r')
+          ++p;
+      }
+      else if (isAVFSpace(*p))
+      {
+        ++p;
+      }
+      else
+      {
+        token = p;
+        while (p < end && isAVFTokenChar(*p))
+          ++p;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Same test as vvTokenizer::isNumberToken()
+  bool isAVFNumber(const char* begin, const char* end)
+  {
+    for (const char* p=begin; p<end; ++p)
+    {
+      if ((*p<'0' || *p>'9') && *p!='.' && *p!='-' && *p!='+' && *p!='e' && *p!='E')
+        return false;
+    }
+    return true;
+  }
+
+  // Convert a number token to exactly the value (float)atof() returns.
+  // Decimals with up to 15 significant digits and a power of ten up to 22
+  // are exact doubles, so one multiplication or division rounds them the
+  // way atof() does. Everything else is left to atof().
+  float parseAVFNumber(const char* begin, const char* end)
+  {
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD == 0
+    static const double pow10[] =
+    {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+      negative = (*p == '-');
+      ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;                               // significant digits
+    int exponent = 0;
+    bool found = false;
+    bool point = false;
+    for (; p < end; ++p)
+    {
+      if (*p == '.' && !point)
+      {
+        point = true;
+        continue;
+      }
+      if (*p < '0' || *p > '9')
+        break;
+      found = true;
+      if (mantissa > 0 || *p != '0')
+        ++digits;
+      mantissa = mantissa * 10 + (*p - '0');
+      if (point)
+        --exponent;
+    }
+
+    if (found && digits <= 15 && p < end && (*p == 'e' || *p == 'E'))
+    {
+      ++p;
+      bool negExp = false;
+      if (p < end && (*p == '-' || *p == '+'))
+      {
+        negExp = (*p == '-');
+        ++p;
+      }
+      int e = 0;
+      int expDigits = 0;
+      for (; p < end && *p >= '0' && *p <= '9' && expDigits < 4; ++p, ++expDigits)
+        e = e * 10 + (*p - '0');
+      if (expDigits == 0)
+        found = false;
+      exponent += negExp ? -e : e;
+    }
+
+    if (found && digits <= 15 && p == end && exponent >= -22 && exponent <= 22)
+    {
+      double value = double(mantissa);
+      value = (exponent < 0) ? value / pow10[-exponent] : value * pow10[exponent];
+      return float(negative ? -value : value);
+    }
+#endif
+
+    char str[MaxAVFToken + 1];
+    const size_t len = std::min(size_t(end - begin), MaxAVFToken);
+    memcpy(str, begin, len);
+    str[len] = '\0';
+    return (float)atof(str);
+  }
+
+  // The voxels of an AVF file, parsed by chunks of lines
+  struct AVFVoxels
+  {
+    size_t bpc;
+    bool normalized;                              // old format: floats in [0..1]
+    size_t frameValues;                           // values per frame
+    size_t numValues;                             // values in all frames
+    std::vector<uint8_t*> frames;
+  };
+
+  struct AVFChunk
+  {
+    AVFVoxels* voxels;
+    const char* begin;
+    const char* end;
+    size_t first;                                 // index of the first token
+    size_t count;                                 // number of tokens
+    bool ok;
+  };
+
+  // First pass: count the tokens of a chunk
+  void countAVFTokens(void* param)
+  {
+    AVFChunk* chunk = static_cast<AVFChunk*>(param);
+    const char* p = chunk->begin;
+    const char* token;
+    while (nextAVFToken(p, chunk->end, token))
+    {
+      // The tokenizer would split longer tokens
+      if (size_t(p - token) > MaxAVFToken)
+        chunk->ok = false;
+      ++chunk->count;
+    }
+  }
+
+  // Second pass: convert the tokens of a chunk into voxels
+  void convertAVFTokens(void* param)
+  {
+    AVFChunk* chunk = static_cast<AVFChunk*>(param);
+    AVFVoxels* voxels = chunk->voxels;
+    size_t k = chunk->first;
+    if (k >= voxels->numValues)
+      return;
+
+    size_t f = k / voxels->frameValues;
+    size_t j = k % voxels->frameValues;
+    const char* p = chunk->begin;
+    const char* token;
+    while (k < voxels->numValues && nextAVFToken(p, chunk->end, token))
+    {
+      if (!isAVFNumber(token, p))
+      {
+        chunk->ok = false;
+        return;
+      }
+      const float value = parseAVFNumber(token, p);
+      uint8_t* raw = voxels->frames[f];
+      if (voxels->normalized)
+      {
+        raw[j] = uint8_t(ts_clamp(value, 0.f, 1.f) * 255.99f);
+      }
+      else if (voxels->bpc == 4)
+      {
+        *((float*)(raw + j * 4)) = value;
+      }
+      else
+      {
+        const int ival = int(value);
+        if (ival < 0 || (voxels->bpc==1 && ival>255) || (voxels->bpc==2 && ival>65535))
+        {
+          chunk->ok = false;
+          return;
+        }
+        if (voxels->bpc == 1)
+        {
+          raw[j] = uint8_t(ival);
+        }
+        else
+        {
+          raw[j * 2]     = uint8_t(ival >> 8);
+          raw[j * 2 + 1] = uint8_t(ival & 0xFF);
+        }
+      }
+      ++k;
+      if (++j == voxels->frameValues)
+      {
+        j = 0;
+        ++f;
+      }
+    }
+  }
+
+  // Parse the voxels of an AVF file, starting at offset, in parallel and add
+  // them to vd. Returns false without changing vd on anything the parser does
+  // not handle itself, so the caller can report it with the tokenizer.
+  bool parseAVFVoxels(vvVolDesc* vd, size_t offset, bool normalized)
+  {
+    if (normalized ? vd->bpc != 1 : (vd->bpc != 1 && vd->bpc != 2 && vd->bpc != 4))
+      return false;
+
+    TextFile file;
+    if (!file.open(vd->getFilename()) || offset > file.size)
+      return false;
+
+    AVFVoxels voxels;
+    voxels.bpc = vd->bpc;
+    voxels.normalized = normalized;
+    voxels.frameValues = vd->getFrameVoxels() * vd->chan;
+    voxels.numValues = voxels.frameValues * vd->frames;
+
+    std::vector<std::pair<const char*, const char*> > ranges
+        = splitLines(file.data + offset, file.data + file.size, TextChunkSize);
+    std::vector<AVFChunk> chunks(ranges.size());
+    virvo::WorkerPool pool(0, "vvFileIO AVF");
+    for (size_t i=0; i<chunks.size(); ++i)
+    {
+      chunks[i].voxels = &voxels;
+      chunks[i].begin = ranges[i].first;
+      chunks[i].end = ranges[i].second;
+      chunks[i].first = 0;
+      chunks[i].count = 0;
+      chunks[i].ok = true;
+      pool.submit(countAVFTokens, &chunks[i]);
+    }
+    pool.wait();
+
+    size_t numTokens = 0;
+    bool ok = true;
+    for (size_t i=0; i<chunks.size(); ++i)
+    {
+      chunks[i].first = numTokens;
+      numTokens += chunks[i].count;
+      ok = ok && chunks[i].ok;
+    }
+    if (!ok || numTokens < voxels.numValues)
+      return false;
+
+    for (size_t f=0; f<vd->frames; ++f)
+      voxels.frames.push_back(new uint8_t[vd->getFrameBytes()]);
+    for (size_t i=0; i<chunks.size(); ++i)
+      pool.submit(convertAVFTokens, &chunks[i]);
+    pool.wait();
+
+    for (size_t i=0; i<chunks.size(); ++i)
+      ok = ok && chunks[i].ok;
+    for (size_t f=0; f<voxels.frames.size(); ++f)
+    {
+      if (ok)
+        vd->addFrame(voxels.frames[f], vvVolDesc::ARRAY_DELETE);
+      else
+        delete[] voxels.frames[f];
+    }
+    return ok;
+  }
+
+  // The records of an ASC file ("x y z value"), parsed by chunks of lines
+  struct ASCChunk
+  {
+    const char* begin;
+    const char* end;
+    int32_t* values;                              // NULL while counting
+    size_t count;                                 // number of integers
+    bool ok;
+  };
+
+  // Read the next integer like fscanf("%d") does. Returns false at the end
+  // of the range, sets ok to false if something else follows.
+  bool nextASCInt(const char*& p, const char* end, int32_t& value, bool& ok)
+  {
+    while (p < end && isspace((unsigned char)*p))
+      ++p;
+    if (p == end)
+      return false;
+
+    bool negative = false;
+    if (*p == '-' || *p == '+')
+    {
+      negative = (*p == '-');
+      ++p;
+    }
+    if (p == end || *p < '0' || *p > '9')
+    {
+      ok = false;
+      return false;
+    }
+    int64_t v = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+    {
+      if (v <= INT_MAX)
+        v = v * 10 + (*p - '0');
+    }
+    // Out of range values fail the range checks of the caller
+    value = (v > INT_MAX) ? -1 : int32_t(negative ? -v : v);
+    return true;
+  }
+
+  // Count (first pass) or convert (second pass) the integers of a chunk
+  void parseASCChunk(void* param)
+  {
+    ASCChunk* chunk = static_cast<ASCChunk*>(param);
+    const char* p = chunk->begin;
+    int32_t value;
+    size_t i = 0;
+    while (nextASCInt(p, chunk->end, value, chunk->ok))
+    {
+      if (chunk->values != NULL)
+        chunk->values[i] = value;
+      ++i;
+    }
+    chunk->count = i;
+  }
+}
+
 //----------------------------------------------------------------------------
 /// Constructor
 vvFileIO::vvFileIO()
@@ -71,6 +700,9 @@ vvFileIO::vvFileIO()
   strcpy(_nrrdID, "NRRD0001");
   _sections = ALL_DATA;
   _compression = true;
+  _deltaEncoding = false;
+  _mergeThreads = 2;
+  _dataOffset = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -250,6 +882,8 @@ vvFileIO::ErrorType vvFileIO::loadASCFile(vvVolDesc* vd)
     vd->vox[1] = y;
     vd->vox[2] = z;
     vd->frames = 1;
+    vd->bpc    = 1;
+    vd->chan   = 1;
   }
   else                                            // invalid volume dimensions
   {
@@ -263,21 +897,68 @@ vvFileIO::ErrorType vvFileIO::loadASCFile(vvVolDesc* vd)
   for (size_t i=0; i<vd->getFrameBytes(); ++i)
     raw[i] = (uint8_t)0;                            // initialize with opacity 0
 
-  while (!feof(fp))
+  const long dataPos = ftell(fp);
+  fclose(fp);
+
+  // Parse the records in parallel, in chunks of lines
+  TextFile file;
+  if (dataPos < 0 || !file.open(vd->getFilename()) || size_t(dataPos) > file.size)
   {
-    retval=fscanf(fp, "%d %d %d %d", &tmpx, &tmpy, &tmpz, &op);
-    if (retval!=4)
-    {
-      vvDebugMsg::msg(1, "vvFileIO::loadASCFile: fscanf failed");
-      fclose(fp);
-      delete[] raw;
-      return FILE_ERROR;
-    }
+    vvDebugMsg::msg(1, "Error: Cannot read ASC file.");
+    delete[] raw;
+    return FILE_ERROR;
+  }
+  std::vector<std::pair<const char*, const char*> > ranges
+      = splitLines(file.data + dataPos, file.data + file.size, TextChunkSize);
+  std::vector<ASCChunk> chunks(ranges.size());
+  virvo::WorkerPool pool(0, "vvFileIO ASC");
+  for (size_t i=0; i<chunks.size(); ++i)
+  {
+    chunks[i].begin = ranges[i].first;
+    chunks[i].end = ranges[i].second;
+    chunks[i].values = NULL;
+    chunks[i].count = 0;
+    chunks[i].ok = true;
+    pool.submit(parseASCChunk, &chunks[i]);
+  }
+  pool.wait();
+
+  size_t numValues = 0;
+  bool ok = true;
+  for (size_t i=0; i<chunks.size(); ++i)
+  {
+    numValues += chunks[i].count;
+    ok = ok && chunks[i].ok;
+  }
+  if (!ok || numValues % 4 != 0)
+  {
+    vvDebugMsg::msg(1, "vvFileIO::loadASCFile: invalid record");
+    delete[] raw;
+    return FILE_ERROR;
+  }
+
+  std::vector<int32_t> values(numValues);
+  numValues = 0;
+  for (size_t i=0; i<chunks.size(); ++i)
+  {
+    chunks[i].values = values.empty() ? NULL : &values[numValues];
+    numValues += chunks[i].count;
+    if (chunks[i].count > 0)
+      pool.submit(parseASCChunk, &chunks[i]);
+  }
+  pool.wait();
+
+  // Later records overwrite earlier ones, so store them in file order
+  for (size_t i=0; i<values.size(); i+=4)
+  {
+    tmpx = values[i];
+    tmpy = values[i + 1];
+    tmpz = values[i + 2];
+    op   = values[i + 3];
     if (tmpx < 0 || size_t(tmpx)>vd->vox[0]-1 || tmpy < 0 || size_t(tmpy)>vd->vox[1]-1
-     || tmpy < 0 || size_t(tmpz)>vd->vox[2]-1 || op < 0 || op>255)
+     || tmpz < 0 || size_t(tmpz)>vd->vox[2]-1 || op < 0 || op>255)
     {
       vvDebugMsg::msg(1, "Error: Invalid value in ASC file.");
-      fclose(fp);
       delete[] raw;
       return FILE_ERROR;
     }
@@ -286,7 +967,6 @@ vvFileIO::ErrorType vvFileIO::loadASCFile(vvVolDesc* vd)
     z = static_cast<size_t>(tmpz);
     raw[x + y * vd->vox[0] + z * vd->vox[0] * vd->vox[1]] = (uint8_t)op;
   }
-  fclose(fp);
 
   vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
   return OK;
@@ -380,6 +1060,7 @@ vvFileIO::ErrorType vvFileIO::loadRVFFile(vvVolDesc* vd)
   vd->frames = 1;
   vd->bpc    = 1;
   vd->chan   = 1;
+  _dataOffset = 6;
 
   // Create new data space for volume data:
   if ((_sections & RAW_DATA) != 0)
@@ -756,6 +1437,20 @@ are stored successively and in big endian format.
 In RLE encoding mode, a 4 byte value precedes each frame,
 telling the number of RLE encoded bytes that will follow. If this
 value is zero, the frame is unencoded.
+Version 2.1 files may contain delta encoded frames, marked by the
+most significant bit of the 4 byte value. The RLE encoded bytes are
+then the XOR of the frame with the previous frame.
+Version 2.2 files may contain levels of detail (see vvVolDesc::makeLevels),
+announced by a LEVELS header entry with the number of levels including
+the volume itself. The frames of level 1, 2, ... follow the frames of
+the volume, stored like frames without delta encoding.
+Version 2.3 files may contain the statistics of all frames (see
+vvVolDesc::getStatistics), announced by a STATISTICS header entry. They
+follow the levels of detail, for each frame and channel: min, max, mean,
+variance (4 byte floats), the number of histogram buckets, the first
+non-empty bucket, the number of buckets stored, the bucket counts
+(4 bytes each), the number of bricks along x, y, z (4 bytes each), and
+min and max of each brick (4 byte floats).
 </PRE>
 */
 vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
@@ -782,12 +1477,163 @@ vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
     return FILE_ERROR;
   }
 
-  // Force icon to be present:
-  if (vd->iconSize==0) vd->makeIcon(vvVolDesc::DEFAULT_ICON_SIZE);
+  // Force icon to be present:
+  if (vd->iconSize==0) vd->makeIcon(vvVolDesc::DEFAULT_ICON_SIZE);
+
+  ErrorType err = saveXVFHeader(vd, fp);
+  if (err != OK)
+  {
+    fclose(fp);
+    return err;
+  }
+
+  // Write volume data frame by frame:
+  const bool delta = _compression && _deltaEncoding && frames > 1;
+  const size_t numLevels = vd->getNumLevels();
+  const bool statistics = vd->hasStatistics();
+  if (_compression==1) encoded = new uint8_t[frameSize];
+  uint8_t* deltaFrame = delta ? new uint8_t[frameSize] : NULL;
+  uint8_t* deltaEncoded = delta ? new uint8_t[frameSize] : NULL;
+
+  for (size_t f=0; f<frames; ++f)
+  {
+    raw = vd->getRaw(f);
+    if (raw==NULL)
+    {
+      VV_LOG(1) << "Error: no data available for frame" << std::endl;
+      fclose(fp);
+      delete[] encoded;
+      delete[] deltaFrame;
+      delete[] deltaEncoded;
+      return VD_ERROR;
+    }
+    if (_compression)
+    {
+      vvToolshed::ErrorType err = vvToolshed::encodeRLE(encoded, raw, frameSize, vd->bpc * vd->chan, frameSize, &encodedSize);
+      uint8_t* out = encoded;
+      uint32_t mark = 0;
+      if (delta && f>0)
+      {
+        // store the difference to the previous frame if it is smaller
+        size_t deltaSize;
+        virvo::xorDelta(raw, vd->getRaw(f-1), frameSize, deltaFrame);
+        if (vvToolshed::encodeRLE(deltaEncoded, deltaFrame, frameSize, vd->bpc * vd->chan,
+                                  err == vvToolshed::VV_OK ? encodedSize : frameSize, &deltaSize) == vvToolshed::VV_OK
+         && (err != vvToolshed::VV_OK || deltaSize < encodedSize))
+        {
+          err = vvToolshed::VV_OK;
+          encodedSize = deltaSize;
+          out = deltaEncoded;
+          mark = XVF_DELTA_FRAME;
+        }
+      }
+      if (err == vvToolshed::VV_OK)                         // compression possible?
+      {
+        vvToolshed::write32(fp, static_cast<uint32_t>(encodedSize) | mark);     // write length of encoded frame
+        if (fwrite(out, 1, encodedSize, fp) != encodedSize)
+        {
+          cerr << "Error: Cannot write compressed voxel data to file." << endl;
+          fclose(fp);
+          delete[] encoded;
+          delete[] deltaFrame;
+          delete[] deltaEncoded;
+          return FILE_ERROR;
+        }
+      }
+      else                                        // no compression possible -> store unencoded
+      {
+        vvToolshed::write32(fp, 0);               // write zero to mark as unencoded
+        if (fwrite(raw, 1, frameSize, fp) != frameSize)
+        {
+          cerr << "Error: Cannot write uncompressed voxel data to file." << endl;
+          fclose(fp);
+          delete[] encoded;
+          delete[] deltaFrame;
+          delete[] deltaEncoded;
+          return FILE_ERROR;
+        }
+      }
+    }
+    else                                          // no compression
+    {
+	  vvToolshed::write32(fp, 0);               // write zero to mark as unencoded
+      if (fwrite(raw, 1, frameSize, fp) != frameSize)
+      {
+        cerr << "Error: Cannot write voxel data to file." << endl;
+        fclose(fp);
+        delete[] encoded;
+        return FILE_ERROR;
+      }
+    }
+  }
+  delete[] deltaFrame;
+  delete[] deltaEncoded;
+  delete[] encoded;
+
+  // Write levels of detail:
+  if (numLevels > 1)
+  {
+    encoded = new uint8_t[frameSize];
+    for (size_t l=1; l<numLevels; ++l)
+    {
+      const vvsize3 size = vd->getLevelSize(l);
+      const size_t levelSize = size[0] * size[1] * size[2] * vd->getBPV();
+      for (size_t f=0; f<frames; ++f)
+      {
+        raw = vd->getLevelRaw(l, static_cast<int>(f));
+        if (raw==NULL || !writeXVFVoxels(fp, raw, levelSize, vd->getBPV(), _compression, encoded))
+        {
+          cerr << "Error: Cannot write level of detail to file." << endl;
+          fclose(fp);
+          delete[] encoded;
+          return FILE_ERROR;
+        }
+      }
+    }
+    delete[] encoded;
+  }
+
+  // Write statistics:
+  if (statistics)
+  {
+    for (size_t f=0; f<frames; ++f)
+    {
+      for (size_t c=0; c<vd->chan; ++c)
+      {
+        if (!writeXVFStatistics(fp, vd->getStatistics(f, c)))
+        {
+          cerr << "Error: Cannot write statistics to file." << endl;
+          fclose(fp);
+          return FILE_ERROR;
+        }
+      }
+    }
+  }
+
+  // Clean up:
+  fclose(fp);
+  return OK;
+}
+
+//----------------------------------------------------------------------------
+/** Write the header of a .XVF file, up to and including the VOXELDATA line.
+ The voxel data of the frames is expected to follow, each frame preceded by
+ its 4 byte size (see saveXVFFile).
+ @param vd volume description
+ @param fp file to write to
+*/
+vvFileIO::ErrorType vvFileIO::saveXVFHeader(vvVolDesc* vd, FILE* fp)
+{
+  size_t encodedSize;                             // number of bytes in encoded icon
+
+  vvDebugMsg::msg(1, "vvFileIO::saveXVFHeader()");
 
   // Write header:
+  const bool delta = _compression && _deltaEncoding && vd->frames > 1;
+  const size_t numLevels = vd->getNumLevels();
+  const bool statistics = vd->hasStatistics();
   fprintf(fp, "XVF\n");
-  fprintf(fp, "VERSION %2.1f\n", 2.0f);
+  fprintf(fp, "VERSION %2.1f\n", statistics ? 2.3f : numLevels > 1 ? 2.2f : delta ? 2.1f : 2.0f);
   fprintf(fp, "VOXELS %d %d %d\n", static_cast<int32_t>(vd->vox[0]), static_cast<int32_t>(vd->vox[1]), static_cast<int32_t>(vd->vox[2]));
   fprintf(fp, "TIMESTEPS %d\n", static_cast<int32_t>(vd->frames));
   fprintf(fp, "BPC %d\n", static_cast<int32_t>(vd->bpc));
@@ -797,6 +1643,8 @@ vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
   fprintf(fp, "DTIME %g\n", vd->dt);
   fprintf(fp, "MINMAX %g %g\n", vd->real[0], vd->real[1]);
   fprintf(fp, "POS %g %g %g\n", vd->pos[0], vd->pos[1], vd->pos[2]);
+  if (numLevels > 1) fprintf(fp, "LEVELS %d\n", static_cast<int32_t>(numLevels));
+  if (statistics) fprintf(fp, "STATISTICS 1\n");
 
   // Write channel names:
   fprintf(fp, "CHANNELNAMES");
@@ -826,7 +1674,6 @@ vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
       if (fwrite(encodedIcon, 1, encodedSize, fp) != encodedSize)
       {
         cerr << "Error: Cannot write compressed icon data to file." << endl;
-        fclose(fp);
         delete[] encodedIcon;
         return FILE_ERROR;
       }
@@ -837,7 +1684,6 @@ vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
       if (fwrite(vd->iconData, 1, iconBytes, fp) != iconBytes)
       {
         cerr << "Error: Cannot write uncompressed icon data to file." << endl;
-        fclose(fp);
         delete[] encodedIcon;
         return FILE_ERROR;
       }
@@ -845,62 +1691,7 @@ vvFileIO::ErrorType vvFileIO::saveXVFFile(vvVolDesc* vd)
     delete[] encodedIcon;
   }
 
-  // Write volume data frame by frame:
   fprintf(fp, "VOXELDATA\n");
-  if (_compression==1) encoded = new uint8_t[frameSize];
-
-  for (size_t f=0; f<frames; ++f)
-  {
-    raw = vd->getRaw(f);
-    if (raw==NULL)
-    {
-      VV_LOG(1) << "Error: no data available for frame" << std::endl;
-      fclose(fp);
-      delete[] encoded;
-      return VD_ERROR;
-    }
-    if (_compression)
-    {
-      vvToolshed::ErrorType err = vvToolshed::encodeRLE(encoded, raw, frameSize, vd->bpc * vd->chan, frameSize, &encodedSize);
-      if (err == vvToolshed::VV_OK)                         // compression possible?
-      {
-        vvToolshed::write32(fp, static_cast<uint32_t>(encodedSize));     // write length of encoded frame
-        if (fwrite(encoded, 1, encodedSize, fp) != encodedSize)
-        {
-          cerr << "Error: Cannot write compressed voxel data to file." << endl;
-          fclose(fp);
-          delete[] encoded;
-          return FILE_ERROR;
-        }
-      }
-      else                                        // no compression possible -> store unencoded
-      {
-        vvToolshed::write32(fp, 0);               // write zero to mark as unencoded
-        if (fwrite(raw, 1, frameSize, fp) != frameSize)
-        {
-          cerr << "Error: Cannot write uncompressed voxel data to file." << endl;
-          fclose(fp);
-          delete[] encoded;
-          return FILE_ERROR;
-        }
-      }
-    }
-    else                                          // no compression
-    {
-	  vvToolshed::write32(fp, 0);               // write zero to mark as unencoded
-      if (fwrite(raw, 1, frameSize, fp) != frameSize)
-      {
-        cerr << "Error: Cannot write voxel data to file." << endl;
-        fclose(fp);
-        delete[] encoded;
-        return FILE_ERROR;
-      }
-    }
-  }
-  delete[] encoded;
-
-  // Clean up:
-  fclose(fp);
   return OK;
 }
 
@@ -919,6 +1710,9 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
   uint8_t* encoded = NULL;                        // encoded volume data
   bool done;
   size_t encodedSize;                             // size of encoded data array
+  size_t numLevels = 1;                           // levels of detail in file
+  bool statistics = false;                        // statistics in file
+  bool deltaFrames = false;                       // version 2.1 or later, frames may be delta encoded
 
   vvDebugMsg::msg(1, "vvFileIO::loadXVFFile()");
 
@@ -973,6 +1767,7 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
         ttype = tok->nextToken();
         assert(ttype == vvTokenizer::VV_NUMBER);
         cerr << "Reading XVF file version " << tok->nval << endl;
+        deltaFrames = (tok->nval > 2.05f);        // versions have one decimal
       }
       else if (strcmp(tok->sval, "VOXELS")==0)
       {
@@ -1039,6 +1834,18 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
           vd->pos[i] = tok->nval;
         }
       }
+      else if (strcmp(tok->sval, "LEVELS")==0)
+      {
+        ttype = tok->nextToken();
+        assert(ttype == vvTokenizer::VV_NUMBER);
+        numLevels = static_cast<size_t>(tok->nval);
+      }
+      else if (strcmp(tok->sval, "STATISTICS")==0)
+      {
+        ttype = tok->nextToken();
+        assert(ttype == vvTokenizer::VV_NUMBER);
+        statistics = (tok->nval != 0.0f);
+      }
       else if (strcmp(tok->sval, "CHANNELNAMES")==0)
       {
         if (vd->chan<1) tok->nextLine();
@@ -1147,19 +1954,31 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
   }
 
   frameSize = vd->getFrameBytes();
+  _dataOffset = static_cast<size_t>(tok->getFilePos());
 
   // Load volume data:
   if ((_sections & RAW_DATA) != 0)
   {
     fseek(fp, tok->getFilePos(), SEEK_SET);
     encoded = new uint8_t[frameSize];
+    uint8_t* previous = NULL;
     for (size_t f=0; f<vd->frames; ++f)
     {
       raw = new uint8_t[frameSize];                 // create new data space for volume data
       encodedSize = vvToolshed::read32(fp);
+      const bool delta = deltaFrames && (encodedSize & XVF_DELTA_FRAME) != 0;
+      if (delta) encodedSize &= ~size_t(XVF_DELTA_FRAME);
+      if (delta && (previous == NULL || encodedSize == 0))
+      {
+        vvDebugMsg::msg(1, "Error: Delta encoded frame without predecessor.");
+        fclose(fp);
+        delete[] raw;
+        delete[] encoded;
+        return DATA_ERROR;
+      }
       if (encodedSize>0)
       {
-        if (fread(encoded, 1, encodedSize, fp) != encodedSize)
+        if (encodedSize > frameSize || fread(encoded, 1, encodedSize, fp) != encodedSize)
         {
           vvDebugMsg::msg(1, "Error: Insuffient voxel data in file.");
           fclose(fp);
@@ -1177,6 +1996,10 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
           delete[] encoded;
           return DATA_ERROR;
         }
+        if (delta)
+        {
+          virvo::xorDelta(raw, previous, frameSize, raw);
+        }
       }
       else                                        // no encoding
       {
@@ -1190,8 +2013,56 @@ vvFileIO::ErrorType vvFileIO::loadXVFFile(vvVolDesc* vd)
         }
       }
       vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+      previous = raw;
+    }
+
+    // Load levels of detail:
+    for (size_t l=1; l<numLevels; ++l)
+    {
+      const vvsize3 size = vd->getLevelSize(l);
+      const size_t levelSize = size[0] * size[1] * size[2] * vd->getBPV();
+      std::vector<uint8_t*> data;
+      for (size_t f=0; f<vd->frames; ++f)
+      {
+        data.push_back(new uint8_t[levelSize]);
+        if (!readXVFVoxels(fp, data.back(), levelSize, vd->getBPV(), encoded))
+        {
+          vvDebugMsg::msg(1, "Error: Insuffient level of detail data in file.");
+          for (size_t i=0; i<data.size(); ++i) delete[] data[i];
+          fclose(fp);
+          delete[] encoded;
+          return DATA_ERROR;
+        }
+      }
+      vd->addLevel(data);
     }
     delete[] encoded;
+
+    // Load statistics:
+    for (size_t f=0; statistics && f<vd->frames; ++f)
+    {
+      for (size_t c=0; c<vd->chan; ++c)
+      {
+        vvVolDesc::Statistics s;
+        if (!readXVFStatistics(fp, s))
+        {
+          vvDebugMsg::msg(1, "Error: Insuffient statistics data in file.");
+          fclose(fp);
+          return DATA_ERROR;
+        }
+        const size_t numBuckets = (vd->bpc==1) ? 256 : (vd->bpc==2) ? 65536 : vvVolDesc::Statistics::FloatBuckets;
+        const size_t brickSize = vvVolDesc::Statistics::BrickSize;
+        bool valid = s.histogram.size() == numBuckets;
+        for (size_t i=0; i<3; ++i)
+        {
+          valid = valid && s.bricks[i] == (vd->vox[i] + brickSize - 1) / brickSize;
+        }
+        if (valid)                                // else computed again when needed
+        {
+          vd->setStatistics(f, c, s);
+        }
+      }
+    }
   }
 
   // Clean up:
@@ -1453,6 +2324,7 @@ vvFileIO::ErrorType vvFileIO::loadAVFFile(vvVolDesc* vd)
   bool done;
   bool error;
   bool oldformat = false;
+  long dataPos = 0;                               // file position of the voxel data
 
   vvDebugMsg::msg(1, "vvFileIO::loadAVFFile()");
 
@@ -1482,6 +2354,7 @@ vvFileIO::ErrorType vvFileIO::loadAVFFile(vvVolDesc* vd)
   {
     int identifier = -1; // ID of string identifier in file header
     // Read identifier:
+    dataPos = tokenizer->getFilePos();
     ttype = tokenizer->nextToken();
     if (ttype != vvTokenizer::VV_WORD)
     {
@@ -1542,6 +2415,7 @@ vvFileIO::ErrorType vvFileIO::loadAVFFile(vvVolDesc* vd)
     else if (strcmp(tokenizer->sval, "DATA")==0)
     {
       // old format: starts raw data section
+      dataPos = tokenizer->getFilePos();
       done = true;
       continue;
     }
@@ -1602,8 +2476,9 @@ vvFileIO::ErrorType vvFileIO::loadAVFFile(vvVolDesc* vd)
 
   // Load voxel data:
   frameSize = vd->getFrameBytes();
-  if ((_sections & RAW_DATA) != 0)
+  if ((_sections & RAW_DATA) != 0 && !parseAVFVoxels(vd, size_t(dataPos), oldformat))
   {
+    // The tokenizer reports what the parallel parser could not handle
     for (size_t f=0; f<vd->frames; ++f)
     {
       raw = new uint8_t[frameSize];                 // create new data space for volume data
@@ -1654,7 +2529,7 @@ vvFileIO::ErrorType vvFileIO::loadAVFFile(vvVolDesc* vd)
                   break;
                 case 4:
                   *((float*)(raw+i)) = tokenizer->nval;
-                  i += 3;
+                  i += 4;
                   break;
               }
             }
@@ -2252,7 +3127,7 @@ vvFileIO::ErrorType vvFileIO::loadTIFFile(vvVolDesc* vd, bool addFrames)
     value     = vvToolshed::read32(fp, endian);
 
                                                   // 16 bit values are left aligned
-	if (endian==vvToolshed::VV_BIG_END && dataType==3 && tag!=0x102) value = value >> 16;
+	if (endian==vvToolshed::VV_BIG_END && dataType==3 && numValues==1) value = value >> 16;
 
     if (vvDebugMsg::isActive(2))
     {
@@ -3110,6 +3985,7 @@ vvFileIO::ErrorType vvFileIO::loadRawFile(vvVolDesc* vd, size_t w, size_t h, siz
   vd->chan   = c;
 
   fseek(fp, static_cast<long>(header), SEEK_SET);                    // skip header
+  _dataOffset = header;
   rawData = new uint8_t[vd->getFrameBytes()];
   read = fread(rawData, vd->getFrameBytes(), 1, fp);
   if (read != 1)
@@ -3288,10 +4164,29 @@ vvFileIO::ErrorType vvFileIO::loadDicomFile(vvVolDesc* vd, int* dcmSeq, int* dcm
     std::cout << "Encapsulated Stream was found to be: " << (lossy ? "lossy" : "lossless") << std::endl;
     
 
-  // Make sure variables are tested for NULL because they might be default:
-  /*if (dcmSeq   != NULL) *dcmSeq   = prop.sequence;
-  if (dcmSlice != NULL) *dcmSlice = prop.image;
-  if (dcmSPos  != NULL) *dcmSPos  = image.getSl;*/
+  // Make sure variables are tested for NULL because they might be default.
+  // Missing elements are 0 as with the built-in reader:
+  gdcm::Attribute<0x0020,0x0011> series;
+  gdcm::Attribute<0x0020,0x0013> instance;
+  gdcm::Attribute<0x0020,0x1041> location;
+  if (dcmSeq   != NULL) *dcmSeq   = 0;
+  if (dcmSlice != NULL) *dcmSlice = 0;
+  if (dcmSPos  != NULL) *dcmSPos  = 0.0f;
+  if (dcmSeq != NULL && ds.FindDataElement(series.GetTag()) && !ds.GetDataElement(series.GetTag()).IsEmpty())
+  {
+    series.SetFromDataSet(ds);
+    *dcmSeq = series.GetValue();
+  }
+  if (dcmSlice != NULL && ds.FindDataElement(instance.GetTag()) && !ds.GetDataElement(instance.GetTag()).IsEmpty())
+  {
+    instance.SetFromDataSet(ds);
+    *dcmSlice = instance.GetValue();
+  }
+  if (dcmSPos != NULL && ds.FindDataElement(location.GetTag()) && !ds.GetDataElement(location.GetTag()).IsEmpty())
+  {
+    location.SetFromDataSet(ds);
+    *dcmSPos = static_cast<float>(location.GetValue());
+  }
   const unsigned int *dim = image.GetDimensions();
   vd->vox[0] = dim[0];
   vd->vox[1] = dim[1];
@@ -4710,6 +5605,9 @@ vvFileIO::ErrorType vvFileIO::saveVolumeData(vvVolDesc* vd, bool overwrite, Load
   if (vvToolshed::isSuffix(vd->getFilename(), ".nrd"))
     return saveNrrdFile(vd);
 
+  if (virvo::BrickCache::isBrickFile(vd->getFilename()))
+    return virvo::BrickCache::write(vd, vd->getFilename()) ? OK : FILE_ERROR;
+
   if (vvToolshed::isSuffix(vd->getFilename(), ".tif"))
     return saveTIFSlices(vd, overwrite);
 
@@ -4748,6 +5646,7 @@ vvFileIO::ErrorType vvFileIO::loadVolumeData(vvVolDesc* vd, LoadType sec, bool a
   }
 
   _sections = sec;
+  _dataOffset = 0;
 
   char* suffix = new char[strlen(vd->getFilename())+1];
   vvToolshed::extractExtension(suffix, vd->getFilename());
@@ -4850,6 +5749,11 @@ vvFileIO::ErrorType vvFileIO::loadVolumeData(vvVolDesc* vd, LoadType sec, bool a
   else if (vvToolshed::strCompare(suffix, "synth") == 0)
     err = loadSynthFile(vd);
 
+                                                  // bricked volume, without RAW_DATA the voxels stay
+                                                  // on disk for out-of-core rendering
+  else if (vvToolshed::strCompare(suffix, "bricks") == 0)
+    err = virvo::BrickCache::read(vd->getFilename(), vd, (_sections & RAW_DATA) != 0) ? OK : FILE_ERROR;
+
   // Unknown extension error:
   else
   {
@@ -4861,6 +5765,229 @@ vvFileIO::ErrorType vvFileIO::loadVolumeData(vvVolDesc* vd, LoadType sec, bool a
   return err;
 }
 
+//----------------------------------------------------------------------------
+/** Find the files to merge, starting with the given file. Stops at the
+  first missing file, which is an error only if numFiles files are expected.
+  @param first     first file
+  @param numFiles  number of files to find, 0 = all
+  @param increment increment of the number in the file names, 0 = all
+                   files in the directory with the same extension, in
+                   alphabetical order
+  @param names     returns the file names
+*/
+vvFileIO::ErrorType vvFileIO::findFiles(const string& first, int numFiles, int increment, vector<string>& names)
+{
+  vvDebugMsg::msg(1, "vvFileIO::findFiles()");
+
+  string filename = first;
+  const string extension = vvToolshed::extractExtension(filename);
+  ErrorType ret = OK;
+
+  list<string> fileNames;
+  list<string> dirNames;
+  if (increment==0)
+  {
+    string currentDir = vvToolshed::extractDirname(filename);
+    vvToolshed::makeFileList(currentDir, fileNames, dirNames);
+  }
+  bool done = false;
+  while (!done)
+  {
+    names.push_back(filename);
+    if (numFiles > 0 && names.size() >= size_t(numFiles)) break;
+
+    if (increment==0)
+    {
+      string nextName="";
+      const string filePath = vvToolshed::extractDirname(filename);
+      string plainFilename = vvToolshed::extractFilename(filename);
+      while (!done && nextName=="")
+      {
+        if (vvToolshed::nextListString(fileNames, plainFilename, nextName))
+        {
+          if (vvToolshed::extractExtension(nextName) != extension)
+          {
+            plainFilename = nextName;
+            nextName="";
+          }
+        }
+        else done = true;
+      }
+      filename = filePath + nextName;
+    }
+    else
+    {
+      for (int j=0; j<increment && !done; ++j)
+      {
+        if (!vvToolshed::increaseFilename(filename))
+        {
+          cerr << "Cannot increase filename '" << filename << "'." << endl;
+          ret = FILE_ERROR;
+          done = true;
+        }
+      }
+    }
+
+    if (!done && !vvToolshed::isFile(filename.c_str()))
+    {
+      if (numFiles > 0)
+      {
+        cerr << "File '" << filename << "' expected but not found." << endl;
+        ret = FILE_NOT_FOUND;
+      }
+      done = true;
+    }
+  }
+
+  return ret;
+}
+
+//----------------------------------------------------------------------------
+/** Merge a series of DICOM or TIFF slice files to a volume. The files
+  are loaded by a pool of threads and then sorted: DICOM slices by slice
+  location, or by image number if the locations are not unique, other
+  files by name. The slices are copied into frames that are allocated
+  once for the whole volume.
+  The files are found with findFiles(), a file that cannot be loaded is
+  an error.
+  @param vd        volume description, the file name is the first file
+  @param numFiles  number of files to load, 0 = all
+  @param increment increment of the number in the file names, 0 = all
+                   files in the directory in alphabetical order
+*/
+vvFileIO::ErrorType vvFileIO::mergeSliceSeries(vvVolDesc* vd, int numFiles, int increment)
+{
+  vvDebugMsg::msg(1, "vvFileIO::mergeSliceSeries()");
+
+  const string filename = vd->getFilename();
+  const string extension = vvToolshed::extractExtension(filename);
+  const bool dicom = vvToolshed::strCompare(extension.c_str(), "dcm")==0 ||
+                     vvToolshed::strCompare(extension.c_str(), "dcom")==0;
+
+  // Find the files:
+  vector<string> names;
+  ErrorType ret = findFiles(filename, numFiles, increment, names);
+  if (ret != OK && ret != FILE_NOT_FOUND)
+  {
+    return ret;
+  }
+
+  // Load the files in parallel:
+  vvStopwatch stopwatch;
+  stopwatch.start();
+  cerr << "Loading " << names.size() << " files" << endl;
+  vector<SeriesFile> files(names.size());
+  virvo::WorkerPool pool(0, "vvFileIO series");
+  for (size_t i=0; i<files.size(); ++i)
+  {
+    files[i].filename = names[i];
+    files[i].index = i;
+    files[i].dicom = dicom;
+    files[i].vd = NULL;
+    files[i].instance = 0;
+    files[i].position = 0.0f;
+    files[i].err = OK;
+    files[i].frames = NULL;
+    files[i].slice = 0;
+    pool.submit(loadSeriesFile, &files[i]);
+  }
+  pool.wait();
+
+  // Check that all files loaded and that the slices fit together. Files
+  // that were found but cannot be loaded are a file error, FILE_NOT_FOUND
+  // only reports a series shorter than numFiles.
+  ErrorType err = OK;
+  vector<SeriesFile*> sorted;
+  const vvVolDesc* first = files[0].vd;
+  for (size_t i=0; i<files.size(); ++i)
+  {
+    const vvVolDesc* v = files[i].vd;
+    if (files[i].err != OK)
+    {
+      cerr << "Cannot load file: " << files[i].filename << endl;
+      if (err == OK) err = (files[i].err == FILE_NOT_FOUND) ? FILE_ERROR : files[i].err;
+    }
+    else if (files[0].err == OK &&
+             (v->vox[0] != first->vox[0] || v->vox[1] != first->vox[1] || v->bpc != first->bpc ||
+              v->chan != first->chan || v->frames != first->frames))
+    {
+      cerr << "Slices merge error: volume parameters do not match: " << files[i].filename << endl;
+      if (err == OK) err = DATA_ERROR;
+    }
+    sorted.push_back(&files[i]);
+  }
+  if (err == OK && first->frames == 0)
+  {
+    cerr << "Slices merge error: no voxel data in " << files[0].filename << endl;
+    err = DATA_ERROR;
+  }
+  if (err != OK)
+  {
+    for (size_t i=0; i<files.size(); ++i) delete files[i].vd;
+    return err;
+  }
+
+  // Sort the slices:
+  if (dicom)
+  {
+    stable_sort(sorted.begin(), sorted.end(), byPosition);
+    bool unique = true;
+    for (size_t i=1; i<sorted.size(); ++i) unique = unique && sorted[i-1]->position < sorted[i]->position;
+    if (!unique)
+    {
+      sort(sorted.begin(), sorted.end(), byInstance);
+      unique = true;
+      for (size_t i=1; i<sorted.size(); ++i) unique = unique && sorted[i-1]->instance < sorted[i]->instance;
+      if (!unique)
+      {
+        cerr << "DICOM slice locations and image numbers are not unique, keeping file order." << endl;
+        for (size_t i=0; i<files.size(); ++i) sorted[i] = &files[i];
+      }
+    }
+  }
+
+  // Copy the slices into the frames of the volume:
+  vvVolDesc* merged = files[0].vd;
+  size_t slices = 0;
+  for (size_t i=0; i<sorted.size(); ++i)
+  {
+    sorted[i]->slice = slices;
+    slices += sorted[i]->vd->vox[2];
+  }
+  long fileBytes = 0;
+  const size_t frameBytes = merged->getSliceBytes() * slices;
+  vector<uint8_t*> frames(merged->frames);
+  for (size_t f=0; f<frames.size(); ++f)
+  {
+    frames[f] = new uint8_t[frameBytes];
+  }
+  for (size_t i=0; i<files.size(); ++i)
+  {
+    fileBytes += vvToolshed::getFileSize(files[i].filename.c_str());
+    files[i].frames = &frames[0];
+    pool.submit(copySeriesFile, &files[i]);
+  }
+  pool.wait();
+
+  merged->vox[2] = slices;
+  for (size_t f=0; f<frames.size(); ++f)
+  {
+    merged->updateFrame(int(f), frames[f], vvVolDesc::ARRAY_DELETE);
+  }
+  if (vd->merge(merged, vvVolDesc::VV_MERGE_SLABS2VOL) != vvVolDesc::OK)
+  {
+    ret = DATA_ERROR;
+  }
+  delete merged;
+
+  const float seconds = std::max(stopwatch.getTime(), 1e-6f);
+  cerr << "Loaded " << files.size() << " files in " << seconds << " s: "
+       << files.size() / seconds << " files/s, "
+       << fileBytes / (1024.0f * 1024.0f) / seconds << " MB/s" << endl;
+
+  return ret;
+}
+
 //----------------------------------------------------------------------------
 /** Set compression mode for data compression in files.
   This parameter is only used if the file type supports it.
@@ -4871,6 +5998,41 @@ void vvFileIO::setCompression(bool newCompression)
   _compression = newCompression;
 }
 
+//----------------------------------------------------------------------------
+/** Set delta encoding of time steps in files.
+  Each time step is stored as the difference to its predecessor if this
+  is smaller, which saves space when only parts of the volume change.
+  This parameter is only used if compression is on and the file type
+  supports it.
+  @param newDeltaEncoding true = delta encoding on
+*/
+void vvFileIO::setDeltaEncoding(bool newDeltaEncoding)
+{
+  _deltaEncoding = newDeltaEncoding;
+}
+
+//----------------------------------------------------------------------------
+/** Set the number of threads that load files ahead in mergeFiles(). Each
+  thread holds at most one loaded file that is not merged yet, so memory
+  grows with the number of threads.
+  @param numThreads  number of threads, 1 = load the files one after
+                     another, <= 0 = one per processor (default: 2)
+*/
+void vvFileIO::setMergeThreads(int numThreads)
+{
+  _mergeThreads = numThreads;
+}
+
+//----------------------------------------------------------------------------
+/** Returns the offset of the voxel data of the first frame in the XVF, RVF
+  or raw file that was loaded last, so that it can be read in parts later.
+  Returns 0 for all other file types.
+*/
+size_t vvFileIO::getDataOffset() const
+{
+  return _dataOffset;
+}
+
 //----------------------------------------------------------------------------
 /** Parse a Leica confocal microscope type file name.
   Example: "Series006_z000_ch00.tif"
@@ -4958,6 +6120,9 @@ bool vvFileIO::changeLeicaFilename(string& fileName, int32_t slice, int32_t chan
   @param increment file index increment. default = 1; 
           if 0 then read files alphabetically, ignoring any numbers in the file names
   @param mergeType way to merge files
+  Except for Leica files, the files are loaded ahead by the threads set
+  with setMergeThreads(), at most one per thread, and merged in order.
+  Returns the error of the first file that cannot be loaded.
 */
 vvFileIO::ErrorType vvFileIO::mergeFiles(vvVolDesc* vd, int numFiles, int increment, vvVolDesc::MergeType mergeType)
 {
@@ -4966,19 +6131,14 @@ vvFileIO::ErrorType vvFileIO::mergeFiles(vvVolDesc* vd, int numFiles, int increm
   vvVolDesc* currentVD = NULL;                 // currently being composited file, might be multiple channels
   string filename;                             // currently processed file name
   string extension;
-  string plainFilename;
   string basename;
-  string filePath;
   ErrorType ret = OK;                             // this function's return value
   int file  = 0;                                  // index of current file
   bool done = false;
   bool isLeicaFormat;
   int numLeicaChannels = 1;
   int leicaSlice, leicaChannel;
-  int i, j;
-  list<string> fileNames;
-  list<string> dirNames;
-  string dir;
+  int i;
 
   assert(increment >= 0);
 
@@ -4988,24 +6148,52 @@ vvFileIO::ErrorType vvFileIO::mergeFiles(vvVolDesc* vd, int numFiles, int increm
   extension = vvToolshed::extractExtension(filename);
     
   isLeicaFormat = parseLeicaFilename(filename, leicaSlice, leicaChannel, basename);
-  if (isLeicaFormat)
+
+  // Slice stacks are loaded in parallel:
+  if (!isLeicaFormat && mergeType==vvVolDesc::VV_MERGE_SLABS2VOL &&
+      (vvToolshed::strCompare(extension.c_str(), "dcm")==0 || vvToolshed::strCompare(extension.c_str(), "dcom")==0 ||
+       vvToolshed::strCompare(extension.c_str(), "tif")==0 || vvToolshed::strCompare(extension.c_str(), "tiff")==0))
+  {
+    return mergeSliceSeries(vd, numFiles, increment);
+  }
+
+  // Other files are loaded ahead by a pool of threads and merged in order:
+  if (!isLeicaFormat)
   {
-    // Find out how many channels are available:
-    for (i=0; vvToolshed::isFile(filename.c_str()); ++i)
+    vector<string> names;
+    ret = findFiles(filename, numFiles, increment, names);
+
+    MergeFiles files;
+    files.names = &names;
+    files.vds.resize(names.size(), NULL);
+    files.errors.resize(names.size(), OK);
+    files.vd = vd;
+    files.mergeType = mergeType;
+    cerr << "Loading " << names.size() << " files" << endl;
+    const int numThreads = (_mergeThreads > 0) ? _mergeThreads : vvToolshed::getNumProcessors();
+    const size_t merged = virvo::processOrdered(names.size(), numThreads, size_t(numThreads),
+                                                loadMergeFile, mergeFile, &files, "vvFileIO merge");
+    if (merged < names.size())
+    {
+      ret = files.errors[merged];
+    }
+    for (size_t f=0; f<files.vds.size(); ++f)
     {
-      numLeicaChannels = i;
-      changeLeicaFilename(filename, -1, i);
-      filename = vd->getFilename();        // reset file name to what it was
+      delete files.vds[f];
     }
-    cerr << numLeicaChannels << " Leica channels found." << endl;
-    leicaChannel = 0;
-    numFiles *= numLeicaChannels;                 // need multiple files per slice
+    return ret;
   }
-  if (increment==0)   // read files alphabetically?
+
+  // Find out how many Leica channels are available:
+  for (i=0; vvToolshed::isFile(filename.c_str()); ++i)
   {
-    string currentDir = vvToolshed::extractDirname(filename);
-    vvToolshed::makeFileList(currentDir, fileNames, dirNames);
+    numLeicaChannels = i;
+    changeLeicaFilename(filename, -1, i);
+    filename = vd->getFilename();        // reset file name to what it was
   }
+  cerr << numLeicaChannels << " Leica channels found." << endl;
+  leicaChannel = 0;
+  numFiles *= numLeicaChannels;                 // need multiple files per slice
 
   fio = new vvFileIO();
   while (!done)
@@ -5025,23 +6213,19 @@ vvFileIO::ErrorType vvFileIO::mergeFiles(vvVolDesc* vd, int numFiles, int increm
       newVD->printInfoLine("Loaded: ");
 
       // Merge new data to previous data:
-      if (isLeicaFormat)
-      {
-        if (leicaChannel==0) currentVD = new vvVolDesc();
+      if (leicaChannel==0) currentVD = new vvVolDesc();
 
-        if(currentVD->merge(newVD, vvVolDesc::VV_MERGE_CHAN2VOL) == vvVolDesc::OK)  cerr << "OK" << endl;
+      if(currentVD->merge(newVD, vvVolDesc::VV_MERGE_CHAN2VOL) == vvVolDesc::OK)  cerr << "OK" << endl;
 
-        if (leicaChannel == numLeicaChannels-1)
-        {
-          vd->merge(currentVD, mergeType);
-          delete currentVD;
-          currentVD = NULL;
-          leicaChannel = 0;
-          leicaSlice += increment;
-        }
-        else ++leicaChannel;
+      if (leicaChannel == numLeicaChannels-1)
+      {
+        vd->merge(currentVD, mergeType);
+        delete currentVD;
+        currentVD = NULL;
+        leicaChannel = 0;
+        leicaSlice += increment;
       }
-      else vd->merge(newVD, mergeType);
+      else ++leicaChannel;
 
       delete newVD;                            // now the new VD can be released
       newVD = NULL;
@@ -5050,45 +6234,11 @@ vvFileIO::ErrorType vvFileIO::mergeFiles(vvVolDesc* vd, int numFiles, int increm
       ++file;
       if (file < numFiles || numFiles==0)
       {
-        if (isLeicaFormat)
-        {
-          if (!changeLeicaFilename(filename, leicaSlice, leicaChannel))
-          {
-            cerr << "Cannot change filename '" << filename << "'." << endl;
-            ret = FILE_ERROR;
-            done = true;
-          }
-        }
-        else if (increment==0)    // move to next file in ordered list?
+        if (!changeLeicaFilename(filename, leicaSlice, leicaChannel))
         {
-          string nextName="";
-          filePath = vvToolshed::extractDirname(filename);
-          plainFilename = vvToolshed::extractFilename(filename);
-          while (!done && nextName=="")
-          {
-            if (vvToolshed::nextListString(fileNames, plainFilename, nextName)) 
-            {
-              if (vvToolshed::extractExtension(nextName) != extension) 
-              {
-                plainFilename = nextName;
-                nextName="";
-              }
-            }
-            else done = true;
-          }
-          filename = filePath + nextName;
-        }
-        else
-        {
-          for (j=0; j<increment && !done; ++j)
-          {
-            if (!vvToolshed::increaseFilename(filename))
-            {
-              cerr << "Cannot increase filename '" << filename << "'." << endl;
-              ret = FILE_ERROR;
-              done = true;
-            }
-          }
+          cerr << "Cannot change filename '" << filename << "'." << endl;
+          ret = FILE_ERROR;
+          done = true;
         }
 
         if (!done)
@@ -5112,15 +6262,12 @@ vvFileIO::ErrorType vvFileIO::mergeFiles(vvVolDesc* vd, int numFiles, int increm
   delete currentVD;
 
   // Set file name to base name of Leica files:
-  if (isLeicaFormat)
+  filename = vd->getFilename();
+  if (parseLeicaFilename(filename, leicaSlice, leicaChannel, basename))
   {
-    filename = vd->getFilename();
-    if (parseLeicaFilename(filename, leicaSlice, leicaChannel, basename))
-    {
-      // add leica specific file convention code here
-      basename += ".xvf";
-      vd->setFilename(basename.c_str());
-    }
+    // add leica specific file convention code here
+    basename += ".xvf";
+    vd->setFilename(basename.c_str());
   }
 
   return ret;
@@ -27,7 +27,8 @@
 
 /** File load and save routines for volume data.
   The following file formats are supported:<BR>
-  RVF, XVF, VF, AVF, 3D TIFF, Visible Human, raw, RGB, TGA, PGM, PPM<BR>
+  RVF, XVF, VF, AVF, 3D TIFF, Visible Human, raw, RGB, TGA, PGM, PPM,
+  bricked volumes (see virvo::BrickCache)<BR>
   When a 2D image file is loaded, the loader looks for a numbered sequence
   automatically, for instance: file001.rvf, file002.rvf, ...
   @author Juergen Schulze (schulze@hlrs.de)
@@ -89,13 +90,20 @@ class VIRVOEXPORT vvFileIO
     ErrorType loadCPTFile(vvVolDesc*,int=128,int=8,bool=true);
     ErrorType mergeFiles(vvVolDesc*, int, int, vvVolDesc::MergeType);
     void      setCompression(bool);
+    void      setDeltaEncoding(bool);
+    void      setMergeThreads(int);
     ErrorType importTF(vvVolDesc*, const char*);
+    ErrorType saveXVFHeader(vvVolDesc*, FILE*);
+    size_t    getDataOffset() const;
 
   protected:
     char _xvfID[10];                               ///< XVF file ID
     char _nrrdID[9];                               ///< nrrd file ID
     int  _sections;                                ///< bit coded list of file sections to load
     bool _compression;                             ///< true = compression on (default)
+    bool _deltaEncoding;                           ///< true = encode time steps as differences to their predecessors
+    int  _mergeThreads;                            ///< threads loading files ahead in mergeFiles(), <= 0 = one per processor
+    size_t _dataOffset;                            ///< offset of the voxel data in the last loaded file [bytes]
 
     void setDefaultValues(vvVolDesc*);
     int  readASCIIint(FILE*);
@@ -133,6 +141,8 @@ class VIRVOEXPORT vvFileIO
     ErrorType loadGKentFile(vvVolDesc*);
     ErrorType loadSynthFile(vvVolDesc*);
     ErrorType savePXMSlices(vvVolDesc*, bool);
+    ErrorType findFiles(const std::string&, int, int, std::vector<std::string>&);
+    ErrorType mergeSliceSeries(vvVolDesc*, int, int);
 };
 #endif
 
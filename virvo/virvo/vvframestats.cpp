@@ -0,0 +1,117 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvframestats.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace virvo
+{
+
+FrameStats::FrameStats(size_t window)
+  : window(std::max(window, size_t(1)))
+  , next(0)
+{
+}
+
+const char* FrameStats::getName(Stage stage)
+{
+  static const char* names[NumStages] =
+  {
+    "queue", "render", "encode", "network", "decode", "display", "total"
+  };
+
+  return stage < NumStages ? names[stage] : "";
+}
+
+void FrameStats::add(const double t[NumStages])
+{
+  if (times[0].size() < window)
+  {
+    for (int s = 0; s < NumStages; ++s)
+    {
+      times[s].push_back(t[s]);
+    }
+  }
+  else
+  {
+    for (int s = 0; s < NumStages; ++s)
+    {
+      times[s][next] = t[s];
+    }
+    next = (next + 1) % window;
+  }
+}
+
+size_t FrameStats::getNumFrames() const
+{
+  return times[0].size();
+}
+
+double FrameStats::percentile(Stage stage, double p) const
+{
+  if (stage >= NumStages || times[stage].empty())
+  {
+    return 0.0;
+  }
+
+  std::vector<double> sorted(times[stage]);
+  p = std::min(std::max(p, 0.0), 1.0);
+  std::vector<double>::iterator nth = sorted.begin() + size_t(p * double(sorted.size() - 1) + 0.5);
+  std::nth_element(sorted.begin(), nth, sorted.end());
+  return *nth;
+}
+
+void FrameStats::print(std::ostream& out) const
+{
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+
+  out << "Frame latency [ms] of the last " << getNumFrames() << " frames" << std::endl;
+  out << "  " << std::left << std::setw(10) << "stage" << std::right
+      << std::setw(10) << "50%" << std::setw(10) << "90%" << std::setw(10) << "99%" << std::endl;
+  out.setf(std::ios::fixed, std::ios::floatfield);
+  out.precision(2);
+  for (int s = 0; s < NumStages; ++s)
+  {
+    const Stage stage = static_cast<Stage>(s);
+    out << "  " << std::left << std::setw(10) << getName(stage) << std::right
+        << std::setw(10) << percentile(stage, 0.5) * 1000.0
+        << std::setw(10) << percentile(stage, 0.9) * 1000.0
+        << std::setw(10) << percentile(stage, 0.99) * 1000.0 << std::endl;
+  }
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+void FrameStats::clear()
+{
+  for (int s = 0; s < NumStages; ++s)
+  {
+    times[s].clear();
+  }
+  next = 0;
+}
+
+} // namespace virvo
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,90 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef _VV_FRAMESTATS_H_
+#define _VV_FRAMESTATS_H_
+
+#include "vvexport.h"
+
+#include <stddef.h>
+#include <ostream>
+#include <vector>
+
+namespace virvo
+{
+
+//------------------------------------------------------------------------------
+// FrameStats
+//
+// Latencies of the last frames of a remote rendering client, split into
+// the stages a frame passes: waiting on the server, rendering, encoding,
+// network transfer, decoding and display. Total is the time from the frame
+// request, i.e. the camera change, until the frame was displayed.
+//
+// Percentiles are computed over a rolling window of frames:
+//
+//   const virvo::FrameStats& stats = client->getFrameStats();
+//   double median = stats.percentile(virvo::FrameStats::Total, 0.5);
+//
+class VVAPI FrameStats
+{
+public:
+  enum Stage
+  {
+    Queue,                    ///< server: request received until rendering started
+    Render,
+    Encode,
+    Network,                  ///< round trip minus the server stages
+    Decode,
+    Display,                  ///< decoded until drawn
+    Total,                    ///< requested until drawn
+    NumStages
+  };
+
+  /// Keep the stage times of the last window frames
+  explicit FrameStats(size_t window = 120);
+
+  static const char* getName(Stage stage);
+
+  /// Add the stage times of a frame [s]
+  void add(const double times[NumStages]);
+
+  /// Frames in the window
+  size_t getNumFrames() const;
+
+  /// Returns the p-th percentile (0 <= p <= 1) of a stage time [s] over
+  /// the window, 0 without frames
+  double percentile(Stage stage, double p) const;
+
+  /// Print the median, 90th and 99th percentile of each stage [ms]
+  void print(std::ostream& out) const;
+
+  void clear();
+
+private:
+  std::vector<double> times[NumStages];
+  size_t window;
+  size_t next;                ///< slot for the next frame once the window is full
+};
+
+} // namespace virvo
+
+#endif
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
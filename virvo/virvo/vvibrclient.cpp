@@ -20,6 +20,7 @@
 
 #include <GL/glew.h>
 
+#include "vvclock.h"
 #include "vvibr.h"
 #include "vvibrclient.h"
 #include "vvibrimage.h"
@@ -74,6 +75,7 @@ vvIbrClient::vvIbrClient(vvVolDesc *vd, vvRenderState renderState,
   , _haveFrame(false)
   , _synchronous(false)
   , _image(NULL)
+  , _imgFrameId(0)
   , _shader(NULL)
 {
   vvDebugMsg::msg(1, "vvIbrClient::vvIbrClient()");
@@ -158,7 +160,8 @@ vvRemoteClient::ErrorType vvIbrClient::render()
 
   vvMatrix currentMatrix = _currentPr * _currentMv;
 
-  if(newFrame && haveFrame)
+  bool displayFrame = newFrame && haveFrame;
+  if(displayFrame)
   {
     pthread_mutex_lock(&_thread->imageMutex);
     initIbrFrame();
@@ -201,6 +204,7 @@ vvRemoteClient::ErrorType vvIbrClient::render()
           pthread_mutex_lock(&_thread->imageMutex);
           initIbrFrame();
           pthread_mutex_unlock(&_thread->imageMutex);
+          displayFrame = true;
         }
       }
     }
@@ -299,6 +303,9 @@ vvRemoteClient::ErrorType vvIbrClient::render()
 
   _shader->disable();
 
+  if(displayFrame)
+    frameDisplayed(_imgFrameId);
+
   if(depthMask)
     glDepthMask(GL_TRUE);
   if(!pointSmooth)
@@ -316,6 +323,7 @@ void vvIbrClient::initIbrFrame()
 
   const int h = _image->getHeight();
   const int w = _image->getWidth();
+  _imgFrameId = _image->getFrameId();
   _imgMatrix = _image->getReprojectionMatrix();
   _imgPr = _image->getProjectionMatrix();
   _imgMv = _image->getModelViewMatrix();
@@ -414,7 +422,9 @@ void* vvIbrClient::getImageFromSocket(void* threadargs)
       pthread_mutex_unlock( &ibr->_thread->imageMutex );
       break;
     }
+    const double received = vvClock::getTime();
     img->decode();
+    ibr->frameReceived(img, received, vvClock::getTime());
     pthread_mutex_unlock( &ibr->_thread->imageMutex );
     //vvToolshed::sleep(1000);
 
@@ -63,6 +63,7 @@ private:
   vvMatrix _imgPr;                                        ///< Projection matrix of _ibrImg
   virvo::Viewport _imgVp;                                 ///< Viewport of _ibrImg
   float _imgDepthRange[2];                                ///< Depth range of _ibrImg
+  int _imgFrameId;                                        ///< Frame id of _ibrImg
   void initIbrFrame();                                    ///< initialize pixel-points in object space
 
   vvShaderProgram* _shader;
@@ -20,6 +20,7 @@
 
 #include <cmath>
 
+#include "vvclock.h"
 #include "vvibr.h"
 #include "vvibrrenderer.h"
 #include "vvibrserver.h"
@@ -28,6 +29,7 @@
 #include "vvibrimage.h"
 #include "vvsocketio.h"
 #include "vvtoolshed.h"
+#include "vvtrace.h"
 
 #include "private/vvgltools.h"
 
@@ -39,6 +41,7 @@ vvIbrServer::vvIbrServer(vvSocket *socket)
 : vvRemoteServer(socket)
 , _ibrMode(vvRenderer::VV_GRADIENT)
 , _image(NULL)
+, _encoded(false)
 {
   vvDebugMsg::msg(1, "vvIbrServer::vvIbrServer()");
 }
@@ -58,6 +61,8 @@ void vvIbrServer::renderImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer
 {
   vvDebugMsg::msg(3, "vvIbrServer::renderImage()");
 
+  VV_TRACE_ZONE("vvIbrServer::renderImage");
+
   // Render volume:
   float matrixGL[16];
 
@@ -85,7 +90,11 @@ void vvIbrServer::renderImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer
   renderer->setParameter(vvRenderer::VV_IBR_DEPTH_RANGE, vvVector2(drMin, drMax));
 
   int dp = renderer->getParameter(vvRenderer::VV_IBR_DEPTH_PREC);
-  ibrRenderer->compositeVolume();
+  const double renderStart = vvClock::getTime();
+  {
+    VV_TRACE_ZONE("render");
+    ibrRenderer->compositeVolume();
+  }
 
   // Fetch rendered image
   virvo::Viewport vp = vvGLTools::getViewport();
@@ -113,22 +122,41 @@ void vvIbrServer::renderImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer
   }
   _image->setNewDepthPtr(&_depth[0]);
 
-  uchar* p = &_pixels[0];
-  ibrRenderer->getColorBuffer(&p);
-  p = &_depth[0];
-  ibrRenderer->getDepthBuffer(&p);
+  {
+    VV_TRACE_ZONE("readback");
+    uchar* p = &_pixels[0];
+    ibrRenderer->getColorBuffer(&p);
+    p = &_depth[0];
+    ibrRenderer->getDepthBuffer(&p);
+  }
+
+  const double renderTime = vvClock::getTime() - renderStart;
+  const double encodeStart = vvClock::getTime();
 
   _image->setModelViewMatrix(mv);
   _image->setProjectionMatrix(pr);
   _image->setViewport(vp);
   _image->setDepthRange(drMin, drMax);
-  const int size = _image->encode(_codetype, 0, h-1, 0, w-1);
+  int size = 0;
+  {
+    VV_TRACE_ZONE("encode");
+    size = _image->encode(_codetype, 0, h-1, 0, w-1);
+  }
+  const double encodeTime = vvClock::getTime() - encodeStart;
+  _encoded = size > 0;
   if (size > 0)
   {
+    int bytes = size + _image->getVideoSize();
+    bytes += _image->getDepthCodetype() == vvImage::VV_RAW ? w*h*(dp/8) : _image->getDepthSize();
+    _quality.update(renderTime, encodeTime, size_t(bytes));
+    setFrameTimes(_image, renderStart, renderTime, encodeTime);
+
+    VV_TRACE_ZONE("send");
     if (_socketio->putIbrImage(_image) != vvSocket::VV_OK)
     {
       vvDebugMsg::msg(1, "Error sending image over socket...");
     }
+    _quality.sent();
   }
   else
   {
@@ -136,6 +164,28 @@ void vvIbrServer::renderImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer
   }
 }
 
+//----------------------------------------------------------------------------
+/** Send the last image again, video frames are rendered and encoded anew.
+*/
+void vvIbrServer::repeatImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer* renderer)
+{
+  vvDebugMsg::msg(3, "vvIbrServer::repeatImage()");
+
+  if (_image == NULL || _image->getCodeType() == vvImage::VV_VIDEO)
+  {
+    renderImage(pr, mv, renderer);
+  }
+  else if (_encoded)
+  {
+    setFrameTimes(_image, 0.0, 0.0, 0.0);
+    if (_socketio->putIbrImage(_image) != vvSocket::VV_OK)
+    {
+      vvDebugMsg::msg(1, "Error sending image over socket...");
+    }
+    _quality.sent();
+  }
+}
+
 void vvIbrServer::resize(const int w, const int h)
 {
   vvRemoteServer::resize(w, h);
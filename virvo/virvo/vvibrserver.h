@@ -39,10 +39,12 @@ private:
   vvRenderer::IbrMode         _ibrMode;
 
   void renderImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer* renderer);
+  void repeatImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer* renderer);
   void resize(int w, int h);
   vvIbrImage *_image;
   std::vector<uchar> _pixels;
   std::vector<uchar> _depth;
+  bool _encoded;                ///< true if the last image was encoded successfully
 };
 
 #endif
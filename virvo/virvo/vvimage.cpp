@@ -31,6 +31,7 @@
 #include "vvdebugmsg.h"
 #include "vvvideo.h"
 #include "vvtoolshed.h"
+#include "vvtrace.h"
 
 #ifdef HAVE_CONFIG_H
 #include <vvconfig.h>
@@ -40,8 +41,176 @@
 #include <snappy.h>
 #endif
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
 using namespace std;
 
+namespace
+{
+
+/// Edge length of the tiles compared by VV_TILES [pixels]
+const int TileSize = 32;
+
+/// VV_TILES flag: clear the image before applying the tiles
+const uchar TilesClear = 1;
+
+/// Size of the VV_TILES header and of the header of each rectangle [bytes]
+const int TilesHeaderSize = 3;
+const int TileRectHeaderSize = 12;
+
+struct TileRect
+{
+  int x, y, w, h;
+
+  TileRect(int x, int y, int w, int h) : x(x), y(y), w(w), h(h) {}
+
+  bool empty() const { return w <= 0 || h <= 0; }
+};
+
+bool isEmptyRow(const uint32_t* pixels, int n)
+{
+  int i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  while (i + 16 <= n)
+  {
+    __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+    acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i + 4)));
+    acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i + 8)));
+    acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i + 12)));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xFFFF)
+    {
+      return false;
+    }
+    i += 16;
+  }
+#endif
+  uint32_t acc = 0;
+  for (; i < n; ++i)
+  {
+    acc |= pixels[i];
+  }
+  return acc == 0;
+}
+
+/// Bounding rectangle of the pixels that are not 0,0,0,0
+TileRect nonEmptyRect(const uint32_t* pixels, int width, int height)
+{
+  int y0 = 0;
+  while (y0 < height && isEmptyRow(pixels + y0 * width, width))
+  {
+    ++y0;
+  }
+  if (y0 == height)
+  {
+    return TileRect(0, 0, 0, 0);
+  }
+
+  int y1 = height;
+  while (isEmptyRow(pixels + (y1 - 1) * width, width))
+  {
+    --y1;
+  }
+
+  int x0 = width;
+  int x1 = 0;
+  for (int y = y0; y < y1; ++y)
+  {
+    const uint32_t* row = pixels + y * width;
+    int x = 0;
+    while (x < x0 && row[x] == 0)
+    {
+      ++x;
+    }
+    x0 = x;
+    x = width;
+    while (x > x1 && row[x - 1] == 0)
+    {
+      --x;
+    }
+    x1 = x;
+  }
+  return TileRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+bool isDirty(const uint32_t* pixels, const uint32_t* reference, int width, const TileRect& r)
+{
+  for (int y = r.y; y < r.y + r.h; ++y)
+  {
+    size_t offset = size_t(y) * width + r.x;
+    if (memcmp(pixels + offset, reference + offset, r.w * sizeof(uint32_t)) != 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Rectangles covering the tiles within area that differ from reference.
+/// Adjacent dirty tiles of a row are combined, as are runs of equal extent
+/// in consecutive rows.
+void dirtyRects(const uint32_t* pixels, const uint32_t* reference, int width, const TileRect& area,
+    std::vector<TileRect>& rects)
+{
+  std::vector<size_t> active; // rectangles ending at the current row
+  std::vector<size_t> next;
+
+  for (int ty = area.y / TileSize * TileSize; ty < area.y + area.h; ty += TileSize)
+  {
+    const int y0 = std::max(ty, area.y);
+    const int y1 = std::min(ty + TileSize, area.y + area.h);
+
+    int runStart = -1;
+    for (int tx = area.x / TileSize * TileSize; ; tx += TileSize)
+    {
+      const int x0 = std::min(std::max(tx, area.x), area.x + area.w);
+      const int x1 = std::min(tx + TileSize, area.x + area.w);
+      bool dirty = x0 < x1 && isDirty(pixels, reference, width, TileRect(x0, y0, x1 - x0, y1 - y0));
+
+      if (dirty && runStart < 0)
+      {
+        runStart = x0;
+      }
+      else if (!dirty && runStart >= 0)
+      {
+        // extend a rectangle of the previous row with the same extent
+        size_t index = rects.size();
+        for (size_t i = 0; i < active.size(); ++i)
+        {
+          TileRect& r = rects[active[i]];
+          if (r.x == runStart && r.w == x0 - runStart)
+          {
+            r.h += y1 - y0;
+            index = active[i];
+            break;
+          }
+        }
+        if (index == rects.size())
+        {
+          rects.push_back(TileRect(runStart, y0, x0 - runStart, y1 - y0));
+        }
+        next.push_back(index);
+        runStart = -1;
+      }
+
+      if (x0 >= x1)
+      {
+        break;
+      }
+    }
+
+    active.swap(next);
+    next.clear();
+  }
+}
+
+} // namespace
+
 //----------------------------------------------------------------------------
 /** Constructor for initialization with an image
     @param h   picture height
@@ -52,6 +221,8 @@ vvImage::vvImage(short h, short w, uchar* image)
 : imageptr(image)
 , videoEncoder(NULL)
 , videoDecoder(NULL)
+, referenceimage(NULL)
+, frameid(0)
 , height(h)
 , width(w)
 {
@@ -66,6 +237,7 @@ vvImage::vvImage(short h, short w, uchar* image)
   t = VV_SERVER;
   videostyle = 0;
   videoquant = 1;
+  std::fill(stagetimes, stagetimes + VV_NUM_SERVER_STAGES, 0.0f);
 }
 
 //----------------------------------------------------------------------------
@@ -75,6 +247,8 @@ vvImage::vvImage()
 : imageptr(0)
 , videoEncoder(NULL)
 , videoDecoder(NULL)
+, referenceimage(NULL)
+, frameid(0)
 , height(0)
 , width(0)
 {
@@ -91,6 +265,7 @@ vvImage::vvImage()
   t = VV_CLIENT;
   videostyle = 0;
   videoquant = 1;
+  std::fill(stagetimes, stagetimes + VV_NUM_SERVER_STAGES, 0.0f);
 }
 
 //----------------------------------------------------------------------------
@@ -230,6 +405,17 @@ int vvImage::encode(short ct, short sw, short ew, short sh, short eh)
       }
       cr = (float)size / (height*width*4);
     }break;
+    case VV_TILES:
+    {
+      if (tilesEncode())
+      {
+        vvDebugMsg::msg(1, "No compression possible");
+        codetype = VV_RAW;
+      }
+      else
+        codetype = VV_TILES;
+      cr = (float)size / (height*width*4);
+    }break;
     case VV_SNAPPY:
     {
       if ( (size = snappyEncode(imageptr, codedimage, width*height*4, width*height*4*2, 4)) < 0)
@@ -275,6 +461,7 @@ int vvImage::encode(short ct, short sw, short ew, short sh, short eh)
   }
   vvDebugMsg::msg(2, "compression rate: ", cr);
   vvDebugMsg::msg(3, "image encoding succeeded");
+  virvo::trace::bytesEncoded.add(codetype == VV_VIDEO ? size + videosize : size);
   return size;
 }
 
@@ -300,6 +487,14 @@ int vvImage::decode()
       realwidth = vvToolshed::read16(&codedimage[4]);
       spec_RLC_decode(start, realwidth, 6);
     }break;
+    case VV_TILES:
+    {
+      if (tilesDecode())
+      {
+        vvDebugMsg::msg(1,"Error: tilesDecode()");
+        return -1;
+      }
+    }break;
     case VV_SNAPPY:
     {
       if (snappyDecode(codedimage, imageptr, size, width*height*4, 4))
@@ -340,6 +535,35 @@ int vvImage::decode()
   return 0;
 }
 
+//----------------------------------------------------------------------------
+/** Sets the image the receiver holds, VV_TILES only encodes the tiles that
+differ from it. The reference must have the size of this image, NULL
+encodes the whole image.
+ */
+void vvImage::setReferenceImage(const uchar* image)
+{
+  referenceimage = image;
+}
+
+//----------------------------------------------------------------------------
+/** Sets the number of the frame request the image answers, counted from 0
+for each connection.
+ */
+void vvImage::setFrameId(int id)
+{
+  frameid = id;
+}
+
+//----------------------------------------------------------------------------
+/** Sets the time a stage of the frame took on the server.
+ @param stage  server stage
+ @param t      duration [s]
+ */
+void vvImage::setStageTime(ServerStage stage, float t)
+{
+  stagetimes[stage] = t;
+}
+
 //----------------------------------------------------------------------------
 /** Sets the image height.
  */
@@ -458,6 +682,22 @@ int vvImage::getVideoSize() const
   return videosize;
 }
 
+//----------------------------------------------------------------------------
+/** Returns the number of the frame request the image answers
+ */
+int vvImage::getFrameId() const
+{
+  return frameid;
+}
+
+//----------------------------------------------------------------------------
+/** Returns the time a stage of the frame took on the server [s]
+ */
+float vvImage::getStageTime(ServerStage stage) const
+{
+  return stagetimes[stage];
+}
+
 //----------------------------------------------------------------------------
 /** Returns the pointer to the image
  */
@@ -517,6 +757,22 @@ void vvImage::put_diff(short& dP, int& d)
  * l >= 128 introduces a run of l-127 pixels of the same color, 4 color bytes follow
 */
 int vvImage::spec_RLC_encode(int start, short h, short w, int dest)
+{
+  dest = rect_RLC_encode(start, h, w, dest, size);
+  if (dest < 0)
+    return -1;
+
+  imageptr = codedimage;
+  size = dest;
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+/** Run Length Encoding of a cutout of an image, see spec_RLC_encode().
+@param limit   size of the coded image available
+@return position after the coded pixels, or -1 if they exceed limit
+*/
+int vvImage::rect_RLC_encode(int start, short h, short w, int dest, int limit)
 {
   short samePixel=1; // we include the leading pixel in the count
   short diffPixel=0;
@@ -546,7 +802,7 @@ int vvImage::spec_RLC_encode(int start, short h, short w, int dest)
           samePixel++;
           if(samePixel == 2)
           {
-            if ((dest+5) > size)
+            if ((dest+5) > limit)
               return -1;
             memcpy(&codedimage[dest+1], &imageptr[src], 4);
           }
@@ -558,7 +814,7 @@ int vvImage::spec_RLC_encode(int start, short h, short w, int dest)
           put_same(samePixel, dest);
         else
         {
-          if ((dest+5+4*diffPixel) > size)
+          if ((dest+5+4*diffPixel) > limit)
             return -1;
           memcpy(&codedimage[dest+1+diffPixel*4], &imageptr[src], 4);
           diffPixel++;
@@ -578,9 +834,7 @@ int vvImage::spec_RLC_encode(int start, short h, short w, int dest)
   else if (diffPixel > 0)
     put_diff(diffPixel, dest);
 
-  imageptr = codedimage;
-  size = dest;
-  return 0;
+  return dest;
 }
 
 //----------------------------------------------------------------------------
@@ -591,9 +845,20 @@ written
 @param src   start position of encoded pixels in coded image
 */
 int vvImage::spec_RLC_decode(int start, short w, int src)
+{
+  rect_RLC_decode(start, w, src, size);
+  size = height*width*4;
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+/** Run Length Decoding of a cutout of an image, see spec_RLC_decode().
+@param end   end of the encoded pixels in coded image
+*/
+int vvImage::rect_RLC_decode(int start, short w, int src, int end)
 {
   int dest = start;
-  while (src < size)
+  while (src < end)
   {
     int length = (int)codedimage[src];
     if (length > 127)
@@ -603,7 +868,7 @@ int vvImage::spec_RLC_decode(int start, short w, int src)
         if (((dest-start-4*w)% (4*width)) == 0 && dest != start)
           dest += (width-w)*4;
 		assert(dest <= (height*width*4)-4);
-		assert(src+1 <= size-4);
+		assert(src+1 <= end-4);
         memcpy(&imageptr[dest], &codedimage[src+1], 4);
         dest += 4;
       }
@@ -617,13 +882,119 @@ int vvImage::spec_RLC_decode(int start, short w, int src)
         if (((dest-start-4*w)% (4*width)) == 0 && dest != start)
           dest += (width-w)*4;
 		assert(dest <= (height*width*4)-4);
-		assert(src+1+i*4 <= size-4);
+		assert(src+1+i*4 <= end-4);
         memcpy(&imageptr[dest], &codedimage[src+1+i*4], 4);
         dest +=4;
       }
       src += 1+4*length;
     }
   }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+/** Encodes the tiles of the image that differ from the reference image, or
+the bounding rectangle of the non-empty pixels if there is no reference.
+ * header: 1 byte flags (TilesClear), 2 bytes number of rectangles,
+ * per rectangle: 2 bytes each x, y, width, height, 4 bytes size of the
+ * RLE coded pixels (see spec_RLC_encode()), followed by the pixels
+@return 0 on success, -1 if the coded image would exceed the raw image
+*/
+int vvImage::tilesEncode()
+{
+  const uint32_t* pixels = reinterpret_cast<const uint32_t*>(imageptr);
+  const int limit = height*width*4;
+
+  TileRect box = nonEmptyRect(pixels, width, height);
+
+  std::vector<TileRect> rects;
+  uchar flags = 0;
+  if (referenceimage == NULL)
+  {
+    flags = TilesClear;
+    if (!box.empty())
+      rects.push_back(box);
+  }
+  else
+  {
+    // pixels empty in both images are equal
+    const uint32_t* reference = reinterpret_cast<const uint32_t*>(referenceimage);
+    TileRect refBox = nonEmptyRect(reference, width, height);
+    if (box.empty())
+      box = refBox;
+    else if (!refBox.empty())
+    {
+      int x1 = std::max(box.x + box.w, refBox.x + refBox.w);
+      int y1 = std::max(box.y + box.h, refBox.y + refBox.h);
+      box.x = std::min(box.x, refBox.x);
+      box.y = std::min(box.y, refBox.y);
+      box.w = x1 - box.x;
+      box.h = y1 - box.y;
+    }
+    if (!box.empty())
+      dirtyRects(pixels, reference, width, box, rects);
+  }
+
+  if (rects.size() > 0xffff)
+    return -1;
+
+  int dest = TilesHeaderSize;
+  for (size_t i=0; i<rects.size(); ++i)
+  {
+    const TileRect& r = rects[i];
+    if (dest + TileRectHeaderSize > limit)
+      return -1;
+    int end = rect_RLC_encode((r.y*width + r.x)*4, short(r.h), short(r.w), dest + TileRectHeaderSize, limit);
+    if (end < 0)
+      return -1;
+    vvToolshed::write16(&codedimage[dest], ushort(r.x));
+    vvToolshed::write16(&codedimage[dest+2], ushort(r.y));
+    vvToolshed::write16(&codedimage[dest+4], ushort(r.w));
+    vvToolshed::write16(&codedimage[dest+6], ushort(r.h));
+    vvToolshed::write32(&codedimage[dest+8], ulong(end - dest - TileRectHeaderSize));
+    dest = end;
+  }
+  vvToolshed::write8(&codedimage[0], flags);
+  vvToolshed::write16(&codedimage[1], ushort(rects.size()));
+
+  vvDebugMsg::msg(3, "vvImage::tilesEncode() rectangles: ", (int)rects.size());
+
+  imageptr = codedimage;
+  size = dest;
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+/** Applies the tiles encoded by tilesEncode() to the image.
+@return 0 on success, -1 if the coded image is malformed
+*/
+int vvImage::tilesDecode()
+{
+  if (size < TilesHeaderSize)
+    return -1;
+
+  const uchar flags = vvToolshed::read8(&codedimage[0]);
+  const int count = vvToolshed::read16(&codedimage[1]);
+  if (flags & TilesClear)
+    memset(imageptr, 0, height*width*4);
+
+  int src = TilesHeaderSize;
+  for (int i=0; i<count; ++i)
+  {
+    if (src + TileRectHeaderSize > size)
+      return -1;
+    const int x = vvToolshed::read16(&codedimage[src]);
+    const int y = vvToolshed::read16(&codedimage[src+2]);
+    const int w = vvToolshed::read16(&codedimage[src+4]);
+    const int h = vvToolshed::read16(&codedimage[src+6]);
+    const int len = (int)vvToolshed::read32(&codedimage[src+8]);
+    src += TileRectHeaderSize;
+    if (w <= 0 || h <= 0 || x + w > width || y + h > height || len < 0 || src + len > size)
+      return -1;
+    rect_RLC_decode((y*width + x)*4, short(w), src, src + len);
+    src += len;
+  }
+
   size = height*width*4;
   return 0;
 }
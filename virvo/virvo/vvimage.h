@@ -36,6 +36,10 @@ Supported code types:
   Therefore start and end pixels for width an height must be specified.
   The rest of the image is interpreted as background and the pixels get the
   value 0,0,0,0. (picture width from 0 - width-1, picture height from 0 - height-1)
+- Run Length Encoding of the tiles that changed (code type VV_TILES). Without a
+  reference image, only the bounding rectangle of the non-empty pixels is encoded.
+  With the image the receiver already holds as reference (setReferenceImage()),
+  only the tiles that differ from it are encoded and applied to that image.
 - Video Encoding (code type VV_VIDEO). For this type the VV_FFMPEG/VV_XVID Flag must be set.<BR>
 
 Here is an example code fragment for encoding and decoding an image with
@@ -74,9 +78,19 @@ class VIRVOEXPORT vvImage
     VV_RLE,
     VV_RLE_RECT,
     VV_SNAPPY,
+    VV_TILES,
     VV_VIDEO // keep last, actual video codec value will be added to this
   };
 
+  /// Stages of a remote frame on the server, sent along with the image
+  enum ServerStage
+  {
+    VV_QUEUED,                // frame request received until rendering started
+    VV_RENDERED,
+    VV_ENCODED,
+    VV_NUM_SERVER_STAGES
+  };
+
     vvImage(short height, short width, uchar *pixels);
     vvImage();
     virtual ~vvImage();
@@ -91,11 +105,16 @@ class VIRVOEXPORT vvImage
     void setNewImagePtr(uchar*);
     void setVideoStyle(int);
     void setVideoQuant(int);
+    void setReferenceImage(const uchar*);
+    void setFrameId(int);
+    void setStageTime(ServerStage, float);
     CodeType getCodeType() const;
     short getHeight() const;
     short getWidth() const;
     int getSize() const;
     int getVideoSize() const;
+    int getFrameId() const;
+    float getStageTime(ServerStage) const;
     uchar* getImagePtr() const;
     uchar* getCodedImage() const;
     uchar* getVideoCodedImage() const;
@@ -115,9 +134,16 @@ class VIRVOEXPORT vvImage
     int videoquant;
     vvVideo* videoEncoder;
     vvVideo* videoDecoder;
+    const uchar* referenceimage;
+    int frameid;
+    float stagetimes[VV_NUM_SERVER_STAGES];
 
     int spec_RLC_encode(int, short, short, int dest=0);
     int spec_RLC_decode(int, short, int src=0);
+    int rect_RLC_encode(int, short, short, int dest, int limit);
+    int rect_RLC_decode(int, short, int src, int end);
+    int tilesEncode();
+    int tilesDecode();
     void put_diff(short&, int&);
     void put_same(short&, int&);
     int videoEncode();
@@ -24,6 +24,7 @@
 
 #include <limits>
 
+#include "vvclock.h"
 #include "vvimageclient.h"
 #include "float.h"
 #include "vvshaderfactory.h"
@@ -76,7 +77,9 @@ vvRemoteClient::ErrorType vvImageClient::render()
     return vvRemoteClient::VV_SOCKET_ERROR;
   }
 
+  const double received = vvClock::getTime();
   _image->decode();
+  frameReceived(_image, received, vvClock::getTime());
 
   const int h = _image->getHeight();
   const int w = _image->getWidth();
@@ -110,6 +113,7 @@ vvRemoteClient::ErrorType vvImageClient::render()
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, _image->getImagePtr());
 
   vvGLTools::drawQuad();
+  frameDisplayed(_image->getFrameId());
 
   glPopAttrib();
 
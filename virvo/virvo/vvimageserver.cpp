@@ -18,22 +18,29 @@
 // License along with this library (see license.txt); if not, write to the
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
+#include <algorithm>
 #include <cmath>
 
+#include "vvclock.h"
 #include "vvimageserver.h"
 #include "vvrenderer.h"
 #include "vvsocketio.h"
 #include "vvopengl.h"
 #include "vvdebugmsg.h"
 #include "vvimage.h"
+#include "vvtrace.h"
 
 #include "private/vvgltools.h"
 
 vvImageServer::vvImageServer(vvSocket *socket)
   : vvRemoteServer(socket)
   , _image(NULL)
+  , _encoded(false)
+  , _hasReference(false)
 {
   vvDebugMsg::msg(1, "vvImageServer::vvImageServer()");
+
+  _quality.setScalable(true);
 }
 
 vvImageServer::~vvImageServer()
@@ -51,22 +58,35 @@ void vvImageServer::renderImage(const vvMatrix& pr, const vvMatrix& mv, vvRender
 {
   vvDebugMsg::msg(3, "vvImageServer::renderImage()");
 
-  // Render volume:
+  VV_TRACE_ZONE("vvImageServer::renderImage");
+
+  // Render volume, into a part of the viewport if the image is scaled down:
+  const virvo::Viewport vp = vvGLTools::getViewport();
+  const int w = std::max(1, int(vp[2] * _imageScale + 0.5f));
+  const int h = std::max(1, int(vp[3] * _imageScale + 0.5f));
+  if (w != vp[2] || h != vp[3])
+  {
+    glViewport(vp[0], vp[1], w, h);
+  }
+
   vvGLTools::setProjectionMatrix(pr);
   vvGLTools::setModelviewMatrix(mv);
 
   glClearColor(0., 0., 0., 0.);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  renderer->renderVolumeGL();
+  const double renderStart = vvClock::getTime();
+  {
+    VV_TRACE_ZONE("render");
+    renderer->renderVolumeGL();
+  }
 
   // Fetch rendered image
-  virvo::Viewport vp = vvGLTools::getViewport();
-  int w = vp[2];
-  int h = vp[3];
   if(!_image || _image->getWidth() != w || _image->getHeight() != h)
   {
     _pixels.resize(w*h*4);
+    _reference.resize(w*h*4);
+    _hasReference = false;
     if(_image)
       _image->setNewImage(h, w, &_pixels[0]);
     else
@@ -77,17 +97,95 @@ void vvImageServer::renderImage(const vvMatrix& pr, const vvMatrix& mv, vvRender
     _image->setNewImagePtr(&_pixels[0]);
   }
 
-  glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, &_pixels[0]);
+  {
+    VV_TRACE_ZONE("readback");
+    glReadPixels(vp[0], vp[1], w, h, GL_RGBA, GL_UNSIGNED_BYTE, &_pixels[0]);
+  }
+
+  if (w != vp[2] || h != vp[3])
+  {
+    glViewport(vp[0], vp[1], vp[2], vp[3]);
+  }
+  const double renderTime = vvClock::getTime() - renderStart;
+  const double encodeStart = vvClock::getTime();
+
+  // run length encoded images are sent as the tiles that changed since
+  // the image the client holds
+  int codetype = _codetype;
+  if (codetype == vvImage::VV_RLE || codetype == vvImage::VV_RLE_RECT)
+  {
+    codetype = vvImage::VV_TILES;
+  }
+  if (codetype == vvImage::VV_TILES)
+  {
+    _image->setReferenceImage(_hasReference ? &_reference[0] : NULL);
+  }
 
-  if(_image->encode(_codetype, 0, h-1, 0, w-1) < 0)
+  int size = 0;
+  {
+    VV_TRACE_ZONE("encode");
+    size = _image->encode(codetype, 0, h-1, 0, w-1);
+  }
+
+  const double encodeTime = vvClock::getTime() - encodeStart;
+
+  _encoded = size >= 0;
+  if (_encoded)
+  {
+    int bytes = size;
+    if (_image->getCodeType() == vvImage::VV_VIDEO)
+    {
+      bytes += _image->getVideoSize();
+    }
+    _quality.update(renderTime, encodeTime, size_t(bytes));
+  }
+
+  // the client applies the next tiles to this image
+  _hasReference = _encoded && _image->getCodeType() == vvImage::VV_TILES;
+  if (_hasReference)
+  {
+    _reference.swap(_pixels);
+  }
+
+  VV_TRACE_ZONE("send");
+  if(size < 0)
   {
     vvImage emtpyImg;
+    setFrameTimes(&emtpyImg, renderStart, renderTime, encodeTime);
     _socketio->putImage(&emtpyImg);
   }
   else
   {
+    setFrameTimes(_image, renderStart, renderTime, encodeTime);
     _socketio->putImage(_image);
   }
+  _quality.sent();
+}
+
+//----------------------------------------------------------------------------
+/** Send the last image again. Video frames depend on their predecessors, so
+    they are rendered and encoded anew.
+*/
+void vvImageServer::repeatImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer* renderer)
+{
+  vvDebugMsg::msg(3, "vvImageServer::repeatImage()");
+
+  if (_image == NULL || _image->getCodeType() == vvImage::VV_VIDEO)
+  {
+    renderImage(pr, mv, renderer);
+  }
+  else if (_encoded)
+  {
+    setFrameTimes(_image, 0.0, 0.0, 0.0);
+    _socketio->putImage(_image);
+  }
+  else
+  {
+    vvImage emtpyImg;
+    setFrameTimes(&emtpyImg, 0.0, 0.0, 0.0);
+    _socketio->putImage(&emtpyImg);
+  }
+  _quality.sent();
 }
 
 void vvImageServer::resize(const int w, const int h)
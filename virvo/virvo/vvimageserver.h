@@ -37,9 +37,13 @@ public:
 
 private:
   void renderImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer* renderer);
+  void repeatImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer* renderer);
   void resize(int w, int h);
   vvImage *_image;
   std::vector<uchar> _pixels;
+  bool _encoded;                ///< true if the last image was encoded successfully
+  std::vector<uchar> _reference; ///< pixels of the last image sent as VV_TILES
+  bool _hasReference;           ///< true if the client holds _reference
 };
 
 #endif
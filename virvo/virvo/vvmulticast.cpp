@@ -22,23 +22,300 @@
 #include "vvconfig.h"
 #endif
 
+#include "vvclock.h"
 #include "vvdebugmsg.h"
 #include "vvinttypes.h"
 #include "vvmulticast.h"
 #include "vvsocketmonitor.h"
-#include "vvinttypes.h"
+#include "vvtrace.h"
 
 #include <algorithm>
+#include <cerrno>
 #include <cmath>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <set>
 
 #ifdef HAVE_NORM
 #include <normApi.h>
 #include <stdlib.h>
 #endif
 
+namespace
+{
+
+//----------------------------------------------------------------------------
+// VV_RELIABLE protocol
+//
+// Every datagram starts with a header, all fields in network byte order:
+//
+//   uint8  type
+//   uint8  reserved
+//   uint16 group size  data datagrams per parity datagram, 0 for no FEC
+//   uint32 id          transfer id, one per write()
+//   uint32 seq         Data: datagram number, Parity: group number,
+//                      Ack: receiver node id, Nack: number of ranges
+//   uint32 count       number of data datagrams
+//   uint64 size        size of the transfer [bytes]
+//
+// NACKs carry (first, count) pairs of missing data datagrams.
+
+enum PacketType
+{
+  Data = 1,
+  Parity,
+  Poll,
+  Nack,
+  Ack
+};
+
+struct Header
+{
+  uint8_t  type;
+  uint16_t groupSize;
+  uint32_t id;
+  uint32_t seq;
+  uint32_t count;
+  uint64_t size;
+};
+
+const size_t HeaderSize = 24;
+const size_t PayloadSize = vvMulticast::DGRAM_SIZE - HeaderSize;
+const size_t MaxNackRanges = 512;
+
+const double PollInterval = 0.02;     // [s]
+const int    QuietPolls = 3;          // polls without NACKs before write() returns
+const int    AckRepeats = 3;          // ACKs are not answered, send them several times
+const double MinRate = 1024.0 * 1024.0; // [bytes/s]
+const double RateIncrease = 1.25;     // after each poll round without losses
+
+void put32(uchar* p, uint32_t v)
+{
+  p[0] = uchar(v >> 24);
+  p[1] = uchar(v >> 16);
+  p[2] = uchar(v >> 8);
+  p[3] = uchar(v);
+}
+
+uint32_t get32(const uchar* p)
+{
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+void writeHeader(uchar* p, const Header& h)
+{
+  p[0] = h.type;
+  p[1] = 0;
+  p[2] = uchar(h.groupSize >> 8);
+  p[3] = uchar(h.groupSize);
+  put32(p + 4, h.id);
+  put32(p + 8, h.seq);
+  put32(p + 12, h.count);
+  put32(p + 16, uint32_t(h.size >> 32));
+  put32(p + 20, uint32_t(h.size));
+}
+
+bool readHeader(const uchar* p, ssize_t len, Header& h)
+{
+  if (len < ssize_t(HeaderSize) || p[0] < Data || p[0] > Ack)
+  {
+    return false;
+  }
+  h.type = p[0];
+  h.groupSize = uint16_t((p[2] << 8) | p[3]);
+  h.id = get32(p + 4);
+  h.seq = get32(p + 8);
+  h.count = get32(p + 12);
+  h.size = (uint64_t(get32(p + 16)) << 32) | get32(p + 20);
+  return true;
+}
+
+// Size of the payload of data datagram i
+size_t payloadSize(uint64_t size, uint32_t i)
+{
+  return size_t(std::min(uint64_t(PayloadSize), size - uint64_t(i) * PayloadSize));
+}
+
+bool wouldBlock()
+{
+#ifdef _WIN32
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS;
+#endif
+}
+
+ssize_t receiveDatagram(vvsock_t fd, uchar* data, sockaddr_in* from)
+{
+  socklen_t len = sizeof(sockaddr_in);
+  ssize_t got = recvfrom(fd, (char*)data, vvMulticast::DGRAM_SIZE, 0, (sockaddr*)from, &len);
+  if (got > 0)
+  {
+    virvo::trace::bytesReceived.add(long(got));
+  }
+  return got;
+}
+
+// Receiver side of one transfer
+struct Transfer
+{
+  uchar* data;
+  size_t bufSize;
+  Header hdr;
+  std::vector<bool> have;
+  uint32_t numHave;
+  std::map<uint32_t, std::vector<uchar> > parity; // by group, until the group is complete
+
+  Transfer(uchar* data, size_t bufSize)
+    : data(data)
+    , bufSize(bufSize)
+    , numHave(0)
+  {
+    hdr.id = 0;
+  }
+
+  bool start(const Header& h)
+  {
+    if (h.size > bufSize || h.count != std::max(uint64_t(1), (h.size + PayloadSize - 1) / PayloadSize))
+    {
+      vvDebugMsg::msg(1, "vvMulticast::read() transfer does not fit into the buffer");
+      return false;
+    }
+    hdr = h;
+    have.assign(h.count, false);
+    numHave = 0;
+    parity.clear();
+    return true;
+  }
+
+  bool complete() const
+  {
+    return numHave == hdr.count;
+  }
+
+  void addData(uint32_t seq, const uchar* payload, size_t len)
+  {
+    if (seq >= hdr.count || have[seq] || len != payloadSize(hdr.size, seq))
+    {
+      return;
+    }
+    memcpy(data + size_t(seq) * PayloadSize, payload, len);
+    have[seq] = true;
+    ++numHave;
+    if (hdr.groupSize > 0)
+    {
+      recover(seq / hdr.groupSize);
+    }
+  }
+
+  void addParity(uint32_t group, const uchar* payload, size_t len)
+  {
+    if (hdr.groupSize == 0 || len != PayloadSize || uint64_t(group) * hdr.groupSize >= hdr.count)
+    {
+      return;
+    }
+    parity[group].assign(payload, payload + len);
+    recover(group);
+  }
+
+  // Restore a single missing datagram of a group from its parity datagram
+  void recover(uint32_t group)
+  {
+    std::map<uint32_t, std::vector<uchar> >::iterator it = parity.find(group);
+    if (it == parity.end())
+    {
+      return;
+    }
+
+    const uint32_t first = group * hdr.groupSize;
+    const uint32_t last = std::min(hdr.count, first + hdr.groupSize);
+    uint32_t missing = last;
+    for (uint32_t i=first; i<last; ++i)
+    {
+      if (!have[i])
+      {
+        if (missing != last)
+        {
+          return;
+        }
+        missing = i;
+      }
+    }
+
+    if (missing != last)
+    {
+      std::vector<uchar>& x = it->second;
+      for (uint32_t i=first; i<last; ++i)
+      {
+        if (i == missing)
+        {
+          continue;
+        }
+        const uchar* p = data + size_t(i) * PayloadSize;
+        const size_t len = payloadSize(hdr.size, i);
+        for (size_t j=0; j<len; ++j)
+        {
+          x[j] ^= p[j];
+        }
+      }
+      memcpy(data + size_t(missing) * PayloadSize, &x[0], payloadSize(hdr.size, missing));
+      have[missing] = true;
+      ++numHave;
+    }
+    parity.erase(it);
+  }
+
+  // Write (first, count) pairs of missing datagrams, returns the number of pairs
+  uint32_t missingRanges(uchar* out) const
+  {
+    uint32_t n = 0;
+    uint32_t i = 0;
+    while (i < hdr.count && n < MaxNackRanges)
+    {
+      if (have[i])
+      {
+        ++i;
+        continue;
+      }
+      uint32_t j = i;
+      while (j < hdr.count && !have[j])
+      {
+        ++j;
+      }
+      put32(out + n * 8, i);
+      put32(out + n * 8 + 4, j - i);
+      ++n;
+      i = j;
+    }
+    return n;
+  }
+};
+
+} // namespace
+
 vvMulticast::vvMulticast(const MulticastType type, const MulticastApi api, const char* addr, const ushort port)
 : _type(type), _api(api), _socket(NULL)
+, _transferId(0)
+, _nodeId(0)
+, _numReceivers(0)
+, _maxRate(0.0)
+, _fecGroupSize(0)
+, _lossRate(0.0)
+, _random(0)
 {
+  // distinguish senders and receivers without coordination
+  const uint32_t seed = uint32_t(time(NULL)) ^ uint32_t(size_t(this) >> 4);
+  _random = seed | 1;
+  if(VV_SENDER == type)
+  {
+    _transferId = seed;
+  }
+  else
+  {
+    _nodeId = seed;
+  }
+
   if(VV_NORM == _api)
   {
 #ifdef HAVE_NORM
@@ -70,7 +347,7 @@ vvMulticast::vvMulticast(const MulticastType type, const MulticastApi api, const
     (void)port;
 #endif
   }
-  else if(VV_VVSOCKET == _api)
+  else if(VV_VVSOCKET == _api || VV_RELIABLE == _api)
   {
     _socket = new vvUdpSocket();
     vvSocket::ErrorType retVal;
@@ -91,6 +368,15 @@ vvMulticast::vvMulticast(const MulticastType type, const MulticastApi api, const
     {
       vvDebugMsg::msg(2, "vvMulticast() error while calling vvSocket::setParameter()");
     }
+    if(VV_RELIABLE == _api && VV_SENDER == _type)
+    {
+      // receivers on the sending host must get the datagrams too
+      char loopch = 1;
+      if(setsockopt(_socket->getSockfd(), IPPROTO_IP, IP_MULTICAST_LOOP, &loopch, sizeof(loopch)) < 0)
+      {
+        vvDebugMsg::msg(2, "vvMulticast() error enabling multicast loopback");
+      }
+    }
   }
 }
 
@@ -112,12 +398,32 @@ vvMulticast::~vvMulticast()
     NormDestroyInstance(_instance);
 #endif
   }
-  else if(VV_VVSOCKET == _api)
+  else
   {
     delete _socket;
   }
 }
 
+void vvMulticast::setNumReceivers(size_t n)
+{
+  _numReceivers = n;
+}
+
+void vvMulticast::setRate(double bytesPerSec)
+{
+  _maxRate = std::max(0.0, bytesPerSec);
+}
+
+void vvMulticast::setFecGroupSize(size_t n)
+{
+  _fecGroupSize = std::min(n, size_t(0xFFFF));
+}
+
+void vvMulticast::setLossRate(double p)
+{
+  _lossRate = p;
+}
+
 ssize_t vvMulticast::write(const uchar* bytes, const size_t size, double timeout)
 {
   vvDebugMsg::msg(3, "vvMulticast::write()");
@@ -202,6 +508,10 @@ ssize_t vvMulticast::write(const uchar* bytes, const size_t size, double timeout
     return -1;
 #endif
   }
+  else if(VV_RELIABLE == _api)
+  {
+    return writeReliable(bytes, size, timeout);
+  }
   else
   {
     // number datagrams
@@ -210,12 +520,8 @@ ssize_t vvMulticast::write(const uchar* bytes, const size_t size, double timeout
 
     size_t nleft = nsize;
 
-    vvSocketMonitor monitor = vvSocketMonitor();
-    std::vector<vvSocket*> sock;
-    vvUdpSocket *udpSock = new vvUdpSocket;
-    udpSock->setSockfd(_socket->getSockfd());
-    sock.push_back(reinterpret_cast<vvSocket*>(udpSock));
-    monitor.setWriteFds(sock);
+    vvSocketMonitor monitor;
+    monitor.add(_socket, vvSocketMonitor::VV_WRITABLE);
 
     while(nleft > 0)
     {
@@ -224,11 +530,13 @@ ssize_t vvMulticast::write(const uchar* bytes, const size_t size, double timeout
       if(vvSocketMonitor::VV_TIMEOUT == smErr)
       {
         vvDebugMsg::msg(2, "vvMulticast::write() timeout reached.");
+        delete[] ndata;
         return size-nleft;
       }
       else if(vvSocketMonitor::VV_ERROR == smErr)
       {
         vvDebugMsg::msg(2, "vvMulticast::write() error.");
+        delete[] ndata;
         return -1;
       }
       else
@@ -238,6 +546,7 @@ ssize_t vvMulticast::write(const uchar* bytes, const size_t size, double timeout
         if(vvSocket::VV_OK != err)
         {
           vvDebugMsg::msg(0, "vvMulticast::write() error", true);
+          delete[] ndata;
           return -1;
         }
         else
@@ -246,6 +555,7 @@ ssize_t vvMulticast::write(const uchar* bytes, const size_t size, double timeout
         }
       }
     }
+    delete[] ndata;
     return size;
   }
 }
@@ -326,12 +636,16 @@ ssize_t vvMulticast::read(uchar* data, const size_t size, double timeout)
     return -1;
 #endif
   }
+  else if(VV_RELIABLE == _api)
+  {
+    return readReliable(data, size, timeout);
+  }
   else
   {
     size_t nsize = size+size_t(ceil(float(size)/float((DGRAM_SIZE-4)))*4.0);
     size_t nleft = nsize;
 
-    vvSocketMonitor monitor = vvSocketMonitor();
+    vvSocketMonitor monitor;
     std::vector<vvSocket*> sock;
     sock.push_back(_socket);
     monitor.setReadFds(sock);
@@ -385,6 +699,354 @@ ssize_t vvMulticast::read(uchar* data, const size_t size, double timeout)
   }
 }
 
+ssize_t vvMulticast::writeReliable(const uchar* bytes, const size_t size, double timeout)
+{
+  const uint32_t count = uint32_t(std::max(size_t(1), (size + PayloadSize - 1) / PayloadSize));
+  const uint32_t groupSize = uint32_t(_fecGroupSize);
+  const uint32_t numGroups = groupSize > 0 ? (count + groupSize - 1) / groupSize : 0;
+
+  if(++_transferId == 0)
+  {
+    ++_transferId;
+  }
+
+  Header hdr;
+  hdr.groupSize = uint16_t(groupSize);
+  hdr.id = _transferId;
+  hdr.count = count;
+  hdr.size = size;
+
+  // XOR of the zero-padded payloads of each group
+  std::vector<uchar> parity(size_t(numGroups) * PayloadSize, 0);
+  for(uint32_t i=0; i<count && groupSize>0; i++)
+  {
+    uchar* x = &parity[size_t(i / groupSize) * PayloadSize];
+    const uchar* p = bytes + size_t(i) * PayloadSize;
+    const size_t len = payloadSize(size, i);
+    for(size_t j=0; j<len; j++)
+    {
+      x[j] ^= p[j];
+    }
+  }
+
+  // first pass: each group followed by its parity datagram, which is numbered count+group
+  std::deque<uint32_t> queue;
+  for(uint32_t i=0; i<count; i++)
+  {
+    queue.push_back(i);
+    if(groupSize > 0 && ((i+1) % groupSize == 0 || i+1 == count))
+    {
+      queue.push_back(count + i / groupSize);
+    }
+  }
+  std::set<uint32_t> resend;
+  std::set<uint32_t> acked;
+
+  vvSocketMonitor monitor;
+  monitor.add(_socket, vvSocketMonitor::VV_READABLE);
+  std::vector<vvSocketMonitor::Event> events;
+  std::vector<uchar> packet(DGRAM_SIZE);
+  sockaddr_in from;
+
+  const double start = vvClock::getTime();
+  double rate = _maxRate;
+  double nextSend = start;
+  double nextPoll = start;
+  size_t bytesSent = 0;
+  bool polled = false;
+  bool lossSincePoll = false;
+  bool blocked = false;
+  int quietPolls = 0;
+
+  for(;;)
+  {
+    double now = vvClock::getTime();
+    if(timeout >= 0.0 && now - start > timeout)
+    {
+      vvDebugMsg::msg(2, "vvMulticast::write() timeout reached.");
+      return -1;
+    }
+
+    // wait for NACKs until the next datagram or poll is due
+    const bool haveData = !queue.empty() || !resend.empty();
+    double wait = std::max(0.0, (haveData ? nextSend : nextPoll) - now);
+    if(blocked)
+    {
+      wait = PollInterval;
+    }
+    if(timeout >= 0.0)
+    {
+      wait = std::min(wait, std::max(0.0, start + timeout - now));
+    }
+    monitor.modify(_socket, vvSocketMonitor::VV_READABLE | (blocked ? vvSocketMonitor::VV_WRITABLE : 0));
+    if(vvSocketMonitor::VV_ERROR == monitor.wait(events, &wait))
+    {
+      vvDebugMsg::msg(2, "vvMulticast::write() error.");
+      return -1;
+    }
+    blocked = false;
+
+    ssize_t got;
+    while((got = receiveDatagram(_socket->getSockfd(), &packet[0], &from)) > 0)
+    {
+      Header in;
+      if(!readHeader(&packet[0], got, in) || in.id != hdr.id)
+      {
+        continue;
+      }
+      if(Ack == in.type)
+      {
+        acked.insert(in.seq);
+      }
+      else if(Nack == in.type)
+      {
+        const uint32_t numRanges = std::min(in.seq, uint32_t((got - HeaderSize) / 8));
+        for(uint32_t r=0; r<numRanges; r++)
+        {
+          const uint32_t first = get32(&packet[HeaderSize + r * 8]);
+          const uint32_t n = get32(&packet[HeaderSize + r * 8 + 4]);
+          for(uint32_t i=first; i<count && i-first<n; i++)
+          {
+            resend.insert(i);
+          }
+        }
+        lossSincePoll = true;
+      }
+    }
+
+    if(_numReceivers > 0 && acked.size() >= _numReceivers)
+    {
+      break;
+    }
+
+    now = vvClock::getTime();
+    if(haveData)
+    {
+      if(now < nextSend)
+      {
+        continue;
+      }
+
+      // retransmissions first, they hold up the receivers
+      const uint32_t seq = resend.empty() ? queue.front() : *resend.begin();
+      size_t len;
+      if(seq < count)
+      {
+        hdr.type = Data;
+        hdr.seq = seq;
+        len = payloadSize(size, seq);
+        memcpy(&packet[HeaderSize], bytes + size_t(seq) * PayloadSize, len);
+      }
+      else
+      {
+        hdr.type = Parity;
+        hdr.seq = seq - count;
+        len = PayloadSize;
+        memcpy(&packet[HeaderSize], &parity[size_t(hdr.seq) * PayloadSize], len);
+      }
+      writeHeader(&packet[0], hdr);
+      len += HeaderSize;
+
+      const int ret = sendDatagram(&packet[0], len);
+      if(ret < 0)
+      {
+        return -1;
+      }
+      else if(ret == 0)
+      {
+        blocked = true;
+        continue;
+      }
+
+      if(resend.empty())
+      {
+        queue.pop_front();
+      }
+      else
+      {
+        resend.erase(resend.begin());
+      }
+      bytesSent += len;
+      if(rate > 0.0)
+      {
+        // don't catch up after idle time
+        nextSend = std::max(nextSend, now - PollInterval) + double(len) / rate;
+      }
+    }
+    else if(now >= nextPoll)
+    {
+      if(polled)
+      {
+        if(lossSincePoll)
+        {
+          const double current = rate > 0.0 ? rate : double(bytesSent) / std::max(now - start, PollInterval);
+          rate = std::max(MinRate, current / 2.0);
+          quietPolls = 0;
+        }
+        else
+        {
+          if(rate > 0.0)
+          {
+            rate *= RateIncrease;
+            if(_maxRate > 0.0 && rate > _maxRate)
+            {
+              rate = _maxRate;
+            }
+          }
+          ++quietPolls;
+        }
+      }
+      if(_numReceivers == 0 && quietPolls >= QuietPolls)
+      {
+        break;
+      }
+
+      hdr.type = Poll;
+      hdr.seq = 0;
+      writeHeader(&packet[0], hdr);
+      if(sendDatagram(&packet[0], HeaderSize) < 0)
+      {
+        return -1;
+      }
+      polled = true;
+      lossSincePoll = false;
+      nextPoll = now + PollInterval;
+    }
+  }
+
+  return size;
+}
+
+ssize_t vvMulticast::readReliable(uchar* data, const size_t size, double timeout)
+{
+  Transfer transfer(data, size);
+
+  vvSocketMonitor monitor;
+  monitor.add(_socket, vvSocketMonitor::VV_READABLE);
+  std::vector<vvSocketMonitor::Event> events;
+  std::vector<uchar> packet(DGRAM_SIZE);
+  sockaddr_in from;
+
+  for(;;)
+  {
+    vvSocketMonitor::ErrorType err = monitor.wait(events, &timeout);
+    if(vvSocketMonitor::VV_TIMEOUT == err)
+    {
+      vvDebugMsg::msg(2, "vvMulticast::read() timeout reached.");
+      return -1;
+    }
+    else if(vvSocketMonitor::VV_ERROR == err)
+    {
+      vvDebugMsg::msg(2, "vvMulticast::read() error.");
+      return -1;
+    }
+
+    ssize_t got;
+    while((got = receiveDatagram(_socket->getSockfd(), &packet[0], &from)) > 0)
+    {
+      Header in;
+      if(!readHeader(&packet[0], got, in) || Nack == in.type || Ack == in.type)
+      {
+        continue;
+      }
+
+      Header reply = in;
+      reply.seq = _nodeId;
+      reply.type = Ack;
+
+      if(in.id == _transferId)
+      {
+        // the sender missed our ACK for the last transfer
+        if(Poll == in.type)
+        {
+          writeHeader(&packet[0], reply);
+          sendDatagram(&packet[0], HeaderSize, &from);
+        }
+        continue;
+      }
+
+      if(in.id != transfer.hdr.id)
+      {
+        // a new transfer, the sender gave up on the previous one
+        if(!transfer.start(in))
+        {
+          return -1;
+        }
+      }
+
+      if(Data == in.type)
+      {
+        transfer.addData(in.seq, &packet[HeaderSize], size_t(got) - HeaderSize);
+      }
+      else if(Parity == in.type)
+      {
+        transfer.addParity(in.seq, &packet[HeaderSize], size_t(got) - HeaderSize);
+      }
+
+      if(transfer.complete())
+      {
+        _transferId = in.id;
+        writeHeader(&packet[0], reply);
+        for(int i=0; i<AckRepeats; i++)
+        {
+          sendDatagram(&packet[0], HeaderSize, &from);
+        }
+        return ssize_t(transfer.hdr.size);
+      }
+      else if(Poll == in.type)
+      {
+        reply.type = Nack;
+        reply.seq = transfer.missingRanges(&packet[HeaderSize]);
+        writeHeader(&packet[0], reply);
+        sendDatagram(&packet[0], HeaderSize + reply.seq * 8, &from);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Send a datagram to the group or to a single node.
+  Drops the datagram instead if the loss simulation says so.
+  @return 1 if sent or dropped, 0 if the socket buffer is full, -1 on error
+*/
+int vvMulticast::sendDatagram(const uchar* data, const size_t size, const sockaddr_in* to)
+{
+  if(_lossRate > 0.0)
+  {
+    _random = _random * 1664525u + 1013904223u;
+    if(double(_random >> 8) / double(1 << 24) < _lossRate)
+    {
+      return 1;
+    }
+  }
+
+  if(to == NULL)
+  {
+    ssize_t written;
+    if(vvSocket::VV_OK == _socket->writeData(data, size, &written))
+    {
+      return 1;
+    }
+    if(wouldBlock())
+    {
+      return 0;
+    }
+  }
+  else if(sendto(_socket->getSockfd(), (const char*)data, int(size), 0, (const sockaddr*)to, sizeof(sockaddr_in)) >= 0)
+  {
+    virvo::trace::bytesSent.add(long(size));
+    return 1;
+  }
+  else if(wouldBlock())
+  {
+    // the sender polls again
+    return 1;
+  }
+
+  vvDebugMsg::msg(1, "vvMulticast::sendDatagram() error", true);
+  return -1;
+}
+
 uchar* vvMulticast::numberConsecutively(const uchar* data, const size_t size)
 {
   uchar *numbered = new uchar[size_t(size+(ceil(float(size)/float((DGRAM_SIZE-4)))*4))];
@@ -36,6 +36,14 @@ typedef uint32_t    NormNodeId;
 /** Wrapper class for multicasting.
   This class can be used for lossless multicast communication via NormAPI
   or for standard but paket-ordered multicasting with vvSocket
+
+  VV_RELIABLE is lossless without NormAPI: the sender numbers the datagrams
+  and polls the receivers after each pass, receivers answer with a NACK
+  listing the missing datagrams or with an ACK when they are complete.
+  Missing datagrams are sent again until no NACKs arrive. Optionally, an XOR
+  parity datagram per group of datagrams lets receivers repair a single
+  loss per group without a retransmission. The send rate is halved after
+  each round with losses and raised slowly otherwise.
   @author Stavros Delisavas (stavros.delisavas@uni-koeln.de)
  */
 class VIRVOEXPORT vvMulticast
@@ -54,7 +62,8 @@ public:
   enum MulticastApi
   {
     VV_NORM,
-    VV_VVSOCKET
+    VV_VVSOCKET,
+    VV_RELIABLE   ///< vvSocket datagrams with NACK-based retransmission
   };
 
   /** Constructor creating a sending or receiving multicast-unit
@@ -82,10 +91,24 @@ public:
     */
   ssize_t read(uchar* data, const size_t size, double timeout = -1.0);
 
+  /** VV_RELIABLE sender: number of receivers that must acknowledge each write.
+    With 0 (default), write() returns after several polls without NACKs.
+    */
+  void setNumReceivers(size_t n);
+  /// VV_RELIABLE sender: maximum send rate in bytes per second, 0 for unlimited (default)
+  void setRate(double bytesPerSec);
+  /// VV_RELIABLE sender: send an XOR parity datagram after every n datagrams, 0 for none (default)
+  void setFecGroupSize(size_t n);
+  /// VV_RELIABLE: drop this fraction of the outgoing datagrams to simulate a lossy network
+  void setLossRate(double p);
+
   std::vector<NormNodeId> _nodes;
 
 private:
   uchar* numberConsecutively(const uchar* data, const size_t size);
+  ssize_t writeReliable(const uchar* bytes, const size_t size, double timeout);
+  ssize_t readReliable(uchar* data, const size_t size, double timeout);
+  int sendDatagram(const uchar* data, const size_t size, const sockaddr_in* to = NULL);
   MulticastType _type;
   MulticastApi  _api;
 
@@ -102,6 +125,15 @@ private:
     uchar    x[4];
     uint32_t y;
   };
+
+  // Variables for reliable multicasting
+  uint32_t _transferId;    ///< sender: id of the last write(), receiver: id of the last complete read()
+  uint32_t _nodeId;        ///< identifies a receiver in ACKs
+  size_t   _numReceivers;
+  double   _maxRate;
+  size_t   _fecGroupSize;
+  double   _lossRate;
+  uint32_t _random;        ///< state of the loss simulation
 };
 
 struct VIRVOEXPORT vvMulticastParameters
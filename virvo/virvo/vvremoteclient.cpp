@@ -18,22 +18,54 @@
 // License along with this library (see license.txt); if not, write to the
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
+#include "vvclock.h"
 #include "vvdebugmsg.h"
+#include "vvpthread.h"
 #include "vvremoteclient.h"
 #include "vvsocketio.h"
 #include "vvtcpsocket.h"
 #include "vvopengl.h"
 #include "vvvoldesc.h"
+#include "vvvolumeupload.h"
 #include "vvimage.h"
 #include "vvtoolshed.h"
 
 #include "private/vvgltools.h"
 
+#include <algorithm>
+#include <deque>
+
 namespace
 {
   virvo::Viewport viewport;
+
+  // Volume chunks uploaded per rendered frame after the first volume frame
+  const size_t ChunksPerRender = 16;
 }
 
+struct vvRemoteClient::Timing
+{
+  virvo::Mutex mutex;
+  std::deque<double> requested;         ///< send times of the unanswered frame requests
+  int answered;                         ///< frame requests answered so far
+  bool pending;                         ///< a received frame was not displayed yet
+  int pendingId;                        ///< frame id of the pending frame
+  double times[virvo::FrameStats::NumStages];
+  double requestTime;                   ///< send time of the pending frame's request
+  double decodeTime;                    ///< time the pending frame was decoded
+  virvo::FrameStats stats;
+
+  Timing()
+    : answered(0)
+    , pending(false)
+    , pendingId(0)
+    , requestTime(0.0)
+    , decodeTime(0.0)
+  {
+    std::fill(times, times + virvo::FrameStats::NumStages, 0.0);
+  }
+};
+
 vvRemoteClient::vvRemoteClient(vvVolDesc *vd, vvRenderState renderState,
                                vvTcpSocket* socket, const std::string &filename)
    : vvRenderer(vd, renderState)
@@ -41,10 +73,19 @@ vvRemoteClient::vvRemoteClient(vvVolDesc *vd, vvRenderState renderState,
    , _filename(filename)
    , _socketIO(NULL)
    , _changes(true)
+   , _nextChunk(0)
+   , _numChunks(0)
+   , _timing(new Timing)
 {
   vvDebugMsg::msg(1, "vvRemoteClient::vvRemoteClient()");
 
   _socketIO = new vvSocketIO(_socket);
+
+  // a server on the same host is reached through shared memory
+  if (_socketIO->requestSharedMemory() != vvSocket::VV_OK)
+  {
+    vvDebugMsg::msg(0, "vvRemoteClient::vvRemoteClient(): shared memory request failed");
+  }
   sendVolume(vd);
 }
 
@@ -53,6 +94,7 @@ vvRemoteClient::~vvRemoteClient()
   vvDebugMsg::msg(1, "vvRemoteClient::~vvRemoteClient()");
 
   delete _socketIO;
+  delete _timing;
 }
 
 void vvRemoteClient::renderVolumeGL()
@@ -60,13 +102,21 @@ void vvRemoteClient::renderVolumeGL()
   virvo::Viewport vp = vvGLTools::getViewport();
   if (::viewport != vp)
   {
+    _socketIO->beginMessage();
     if (_socketIO->putEvent(virvo::WindowResize) == vvSocket::VV_OK)
     {
       _socketIO->putWinDims(vp[2], vp[3]);
     }
+    _socketIO->endMessage();
     ::viewport = vp;
   }
 
+  // continue the volume upload, the server renders the frames it has
+  if (_nextChunk < _numChunks && sendVolumeChunks(ChunksPerRender) != vvRemoteClient::VV_OK)
+  {
+    vvDebugMsg::msg(0, "vvRemoteClient::renderVolumeGL(): error sending volume data");
+  }
+
   vvGLTools::getModelviewMatrix(&_currentMv);
   vvGLTools::getProjectionMatrix(&_currentPr);
 
@@ -81,35 +131,75 @@ vvRemoteClient::ErrorType vvRemoteClient::sendVolume(vvVolDesc*& vd)
 {
   if (!_filename.empty())
   {
+    _socketIO->beginMessage();
     _socketIO->putEvent(virvo::VolumeFile);
     _socketIO->putFileName(_filename);
+    _socketIO->endMessage();
   }
   else
   {
-    if (_socketIO->putEvent(virvo::Volume) == vvSocket::VV_OK)
+    // the server replies with the number of chunks it kept from an
+    // interrupted upload of the same volume
+    const uint64_t id = virvo::VolumeUpload::computeId(vd);
+
+    _socketIO->beginMessage();
+    vvSocket::ErrorType err = _socketIO->putEvent(virvo::VolumeHeader);
+    if (err == vvSocket::VV_OK)
+      err = _socketIO->putVolumeAttributes(vd);
+    if (err == vvSocket::VV_OK)
+      err = _socketIO->putInt32(int(id >> 32));
+    if (err == vvSocket::VV_OK)
+      err = _socketIO->putInt32(int(id & 0xFFFFFFFF));
+    if (_socketIO->endMessage() != vvSocket::VV_OK || err != vvSocket::VV_OK)
     {
-      switch (_socketIO->putVolume(vd))
-      {
-        case vvSocket::VV_OK:
-          vvDebugMsg::msg(1, "Volume transferred successfully");
-          break;
-        case vvSocket::VV_ALLOC_ERROR:
-          vvDebugMsg::msg(0, "Not enough memory to accomodate volume");
-          return VV_SOCKET_ERROR;
-        default:
-          vvDebugMsg::msg(0, "Unknown error writing volume to socket");
-          return VV_SOCKET_ERROR;
-      }
+      vvDebugMsg::msg(0, "Unknown socket error");
+      return VV_SOCKET_ERROR;
     }
-    else
+
+    int received = 0;
+    if (_socketIO->getInt32(received) != vvSocket::VV_OK || received < 0)
     {
-      vvDebugMsg::msg(0, "Unknown socket error");
+      vvDebugMsg::msg(0, "Server cannot accomodate volume");
       return VV_SOCKET_ERROR;
     }
+
+    _numChunks = virvo::VolumeUpload::getNumChunks(vd);
+    _nextChunk = std::min(size_t(received), _numChunks);
+
+    // send the first frame now, the other frames while rendering
+    const size_t chunksPerFrame = virvo::VolumeUpload::getChunksPerFrame(vd);
+    if (_nextChunk < chunksPerFrame)
+    {
+      return sendVolumeChunks(chunksPerFrame - _nextChunk);
+    }
   }
   return VV_OK;
 }
 
+vvRemoteClient::ErrorType vvRemoteClient::sendVolumeChunks(size_t count)
+{
+  count = std::min(count, _numChunks - _nextChunk);
+  if (count == 0)
+  {
+    return VV_OK;
+  }
+
+  _socketIO->beginMessage();
+  vvSocket::ErrorType err = _socketIO->putEvent(virvo::VolumeChunks);
+  if (err == vvSocket::VV_OK)
+    err = _socketIO->putInt32(int(count));
+  if (err == vvSocket::VV_OK)
+    err = _socketIO->putVolumeChunks(vd, _nextChunk, count);
+  if (_socketIO->endMessage() != vvSocket::VV_OK || err != vvSocket::VV_OK)
+  {
+    vvDebugMsg::msg(0, "Error writing volume data to socket");
+    return VV_SOCKET_ERROR;
+  }
+
+  _nextChunk += count;
+  return VV_OK;
+}
+
 void vvRemoteClient::setCurrentFrame(size_t index)
 {
   vvDebugMsg::msg(3, "vvRemoteClient::setCurrentFrame()");
@@ -120,10 +210,12 @@ void vvRemoteClient::setCurrentFrame(size_t index)
     return;
   }
 
+  _socketIO->beginMessage();
   if (_socketIO->putEvent(virvo::CurrentFrame) == vvSocket::VV_OK)
   {
     _socketIO->putInt32(index);
   }
+  _socketIO->endMessage();
 }
 
 void vvRemoteClient::setObjectDirection(const vvVector3& od)
@@ -134,10 +226,12 @@ void vvRemoteClient::setObjectDirection(const vvVector3& od)
   if(!_socketIO)
     return;
 
+  _socketIO->beginMessage();
   if (_socketIO->putEvent(virvo::ObjectDirection) == vvSocket::VV_OK)
   {
     _socketIO->putVector3(od);
   }
+  _socketIO->endMessage();
 }
 
 void vvRemoteClient::setViewingDirection(const vvVector3& vd)
@@ -150,10 +244,12 @@ void vvRemoteClient::setViewingDirection(const vvVector3& vd)
     return;
   }
 
+  _socketIO->beginMessage();
   if (_socketIO->putEvent(virvo::ViewingDirection) == vvSocket::VV_OK)
   {
     _socketIO->putVector3(vd);
   }
+  _socketIO->endMessage();
 }
 
 void vvRemoteClient::setPosition(const vvVector3& p)
@@ -166,10 +262,12 @@ void vvRemoteClient::setPosition(const vvVector3& p)
     return;
   }
 
+  _socketIO->beginMessage();
   if (_socketIO->putEvent(virvo::Position) == vvSocket::VV_OK)
   {
     _socketIO->putVector3(p);
   }
+  _socketIO->endMessage();
 }
 
 void vvRemoteClient::updateTransferFunction()
@@ -182,10 +280,12 @@ void vvRemoteClient::updateTransferFunction()
     return;
   }
 
+  _socketIO->beginMessage();
   if (_socketIO->putEvent(virvo::TransFunc) == vvSocket::VV_OK)
   {
     _socketIO->putTransferFunction(vd->tf);
   }
+  _socketIO->endMessage();
 }
 
 void vvRemoteClient::setParameter(ParameterType param, const vvParam& value)
@@ -201,78 +301,92 @@ void vvRemoteClient::setParameter(ParameterType param, const vvParam& value)
 
   if (value.isa(vvParam::VV_BOOL))
   {
+    _socketIO->beginMessage();
     if (_socketIO->putEvent(virvo::Parameter1B) == vvSocket::VV_OK)
     {
       _socketIO->putInt32((int32_t)param);
       _socketIO->putBool(value);
     }
+    _socketIO->endMessage();
     return;
   }
 
   if (value.isa(vvParam::VV_INT))
   {
+    _socketIO->beginMessage();
     if (_socketIO->putEvent(virvo::Parameter1I) == vvSocket::VV_OK)
     {
       _socketIO->putInt32((int32_t)param);
       _socketIO->putInt32((int32_t)value);
     }
+    _socketIO->endMessage();
     return;
   }
 
   if (value.isa(vvParam::VV_FLOAT))
   {
+    _socketIO->beginMessage();
     if (_socketIO->putEvent(virvo::Parameter1F) == vvSocket::VV_OK)
     {
       _socketIO->putInt32((int32_t)param);
       _socketIO->putFloat(value);
     }
+    _socketIO->endMessage();
     return;
   }
 
   if (value.isa(vvParam::VV_VEC3))
   {
+    _socketIO->beginMessage();
     if (_socketIO->putEvent(virvo::Parameter3F) == vvSocket::VV_OK)
     {
       _socketIO->putInt32((int32_t)param);
       _socketIO->putVector3(value);
     }
+    _socketIO->endMessage();
     return;
   }
 
   if (value.isa(vvParam::VV_VEC4))
   {
+    _socketIO->beginMessage();
     if (_socketIO->putEvent(virvo::Parameter4F) == vvSocket::VV_OK)
     {
       _socketIO->putInt32((int32_t)param);
       _socketIO->putVector4(value);
     }
+    _socketIO->endMessage();
     return;
   }
 
   if (value.isa(vvParam::VV_COLOR))
   {
+    _socketIO->beginMessage();
     if (_socketIO->putEvent(virvo::ParameterColor) == vvSocket::VV_OK)
     {
       _socketIO->putInt32((int32_t)param);
       _socketIO->putColor(value);
     }
+    _socketIO->endMessage();
     return;
   }
 
   if (value.isa(vvParam::VV_AABBI))
   {
+    _socketIO->beginMessage();
     if (_socketIO->putEvent(virvo::ParameterAABBI) == vvSocket::VV_OK)
     {
       _socketIO->putInt32((int32_t)param);
       _socketIO->putAABBi(value);
     }
+    _socketIO->endMessage();
     return;
   }
 
   assert( 0 && "Parameter not handled" );
 }
 
-vvRemoteClient::ErrorType vvRemoteClient::requestFrame() const
+vvRemoteClient::ErrorType vvRemoteClient::requestFrame()
 {
   vvDebugMsg::msg(1, "vvRemoteClient::requestFrame()");
 
@@ -281,22 +395,84 @@ vvRemoteClient::ErrorType vvRemoteClient::requestFrame() const
     return vvRemoteClient::VV_SOCKET_ERROR;
   }
 
-  if (_socketIO->putEvent(virvo::CameraMatrix) != vvSocket::VV_OK)
+  // the camera matrices are the frame request, send them in one packet
+  _socketIO->beginMessage();
+
+  vvSocket::ErrorType err = _socketIO->putEvent(virvo::CameraMatrix);
+
+  if (err == vvSocket::VV_OK)
+    err = _socketIO->putMatrix(&_currentPr);
+
+  if (err == vvSocket::VV_OK)
+    err = _socketIO->putMatrix(&_currentMv);
+
+  if (_socketIO->endMessage() != vvSocket::VV_OK || err != vvSocket::VV_OK)
   {
     return vvRemoteClient::VV_SOCKET_ERROR;
   }
 
-  if (_socketIO->putMatrix(&_currentPr) != vvSocket::VV_OK)
+  virvo::ScopedLock lock(&_timing->mutex);
+  _timing->requested.push_back(vvClock::getTime());
+
+  return vvRemoteClient::VV_OK;
+}
+
+virvo::FrameStats vvRemoteClient::getFrameStats() const
+{
+  virvo::ScopedLock lock(&_timing->mutex);
+  return _timing->stats;
+}
+
+void vvRemoteClient::frameReceived(const vvImage* image, double received, double decoded)
+{
+  vvDebugMsg::msg(3, "vvRemoteClient::frameReceived()");
+
+  virvo::ScopedLock lock(&_timing->mutex);
+
+  // the server answers the requests in order and numbers them like we do
+  while (_timing->answered < image->getFrameId() && !_timing->requested.empty())
   {
-    return vvRemoteClient::VV_SOCKET_ERROR;
+    _timing->requested.pop_front();
+    ++_timing->answered;
   }
+  if (_timing->requested.empty())
+  {
+    return;
+  }
+  const double requested = _timing->requested.front();
+  _timing->requested.pop_front();
+  ++_timing->answered;
+
+  double* t = _timing->times;
+  t[virvo::FrameStats::Queue] = image->getStageTime(vvImage::VV_QUEUED);
+  t[virvo::FrameStats::Render] = image->getStageTime(vvImage::VV_RENDERED);
+  t[virvo::FrameStats::Encode] = image->getStageTime(vvImage::VV_ENCODED);
+  const double server = t[virvo::FrameStats::Queue] + t[virvo::FrameStats::Render] + t[virvo::FrameStats::Encode];
+  t[virvo::FrameStats::Network] = std::max(received - requested - server, 0.0);
+  t[virvo::FrameStats::Decode] = decoded - received;
+  _timing->requestTime = requested;
+  _timing->decodeTime = decoded;
+  _timing->pending = true;
+  _timing->pendingId = image->getFrameId();
+}
 
-  if (_socketIO->putMatrix(&_currentMv) != vvSocket::VV_OK)
+void vvRemoteClient::frameDisplayed(int frameId)
+{
+  vvDebugMsg::msg(3, "vvRemoteClient::frameDisplayed()");
+
+  virvo::ScopedLock lock(&_timing->mutex);
+
+  if (!_timing->pending || _timing->pendingId != frameId)
   {
-    return vvRemoteClient::VV_SOCKET_ERROR;
+    return;
   }
 
-  return vvRemoteClient::VV_OK;
+  const double now = vvClock::getTime();
+  double* t = _timing->times;
+  t[virvo::FrameStats::Display] = now - _timing->decodeTime;
+  t[virvo::FrameStats::Total] = now - _timing->requestTime;
+  _timing->stats.add(t);
+  _timing->pending = false;
 }
 
 // vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
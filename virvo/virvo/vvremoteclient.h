@@ -22,6 +22,7 @@
 #define _VV_REMOTECLIENT_H_
 
 #include "vvexport.h"
+#include "vvframestats.h"
 #include "vvrenderer.h"
 #include "vvvecmath.h"
 
@@ -57,7 +58,10 @@ public:
   void setPosition(const vvVector3& p);
   virtual void updateTransferFunction();
   virtual void setParameter(ParameterType param, const vvParam& value);
-  virtual ErrorType requestFrame() const;
+  virtual ErrorType requestFrame();
+
+  /// Latencies of the last frames displayed
+  virvo::FrameStats getFrameStats() const;
 
 protected:
   vvTcpSocket* _socket;
@@ -67,10 +71,21 @@ protected:
   bool _changes; ///< indicate if a new rendering is required
   vvMatrix _currentMv;                                    ///< Current modelview matrix
   vvMatrix _currentPr;                                    ///< Current projection matrix
+  size_t _nextChunk;                                      ///< next volume chunk to upload
+  size_t _numChunks;                                      ///< number of volume chunks to upload
+
+  /// Call when an image was received and decoded, received and decoded are vvClock times
+  void frameReceived(const vvImage* image, double received, double decoded);
+  /// Call when a received image was drawn
+  void frameDisplayed(int frameId);
 private:
+  struct Timing;
+  Timing* _timing;                                        ///< request times and frame statistics
+
   virtual void destroyThreads() { }
 
   ErrorType sendVolume(vvVolDesc*& vd);
+  ErrorType sendVolumeChunks(size_t count);
 };
 
 #endif
@@ -28,6 +28,8 @@ namespace virvo
     // initialization
     Volume = 0,
     VolumeFile,
+    VolumeHeader,       // start or resume a chunked upload, see vvRemoteClient::sendVolume()
+    VolumeChunks,
 
     // renderer parameters
     Parameter1B,
@@ -52,7 +54,10 @@ namespace virvo
     Statistics,
     WindowResize,
     RemoteServerType,
-    Disconnect
+    Disconnect,
+
+    // transport
+    SharedMemory        // continue over shared memory, see vvSocketIO::requestSharedMemory()
   };
 }
 
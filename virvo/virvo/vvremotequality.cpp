@@ -0,0 +1,273 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifdef HAVE_CONFIG_H
+#include "vvconfig.h"
+#endif
+
+#include "vvclock.h"
+#include "vvdebugmsg.h"
+#include "vvimage.h"
+#include "vvremotequality.h"
+#include "vvvideo.h"
+
+#include <algorithm>
+
+namespace virvo
+{
+
+namespace
+{
+
+/// Weight of a new measurement in the running averages
+const double Smoothing = 0.25;
+
+/// Higher quality is only chosen again if it is predicted to take at most
+/// this part of the target frame time
+const double Headroom = 0.8;
+
+/// Image scales tried while the view changes
+const float Scales[] = { 1.0f, 0.75f, 0.5f, 0.35f, 0.25f };
+
+void average(double& value, double sample)
+{
+  value = value < 0.0 ? sample : value + (sample - value) * Smoothing;
+}
+
+size_t scaledPixels(size_t pixels, float scale)
+{
+  return std::max(size_t(1), size_t(double(pixels) * scale * scale));
+}
+
+} // namespace
+
+RemoteQuality::RemoteQuality()
+  : targetFrameTime(0.0)
+  , scalable(false)
+  , moving(false)
+  , pixels(0)
+  , renderPerPixel(-1.0)
+  , latency(-1.0)
+  , transferPerByte(-1.0)
+  , lastBytes(0)
+  , sentTime(0.0)
+{
+  // initial guesses until a codec was used
+  Codec raw = { vvImage::VV_RAW, true, false, 0.0, 1.0 };
+  codecs.push_back(raw);
+  Codec tiles = { vvImage::VV_TILES, true, false, 4e-9, 0.5 };
+  codecs.push_back(tiles);
+#ifdef HAVE_SNAPPY
+  Codec snappy = { vvImage::VV_SNAPPY, true, false, 2e-9, 0.5 };
+  codecs.push_back(snappy);
+#endif
+#ifdef HAVE_FFMPEG
+  Codec video = { vvImage::VV_VIDEO + vvVideo::VV_MPEG4, false, false, 2e-8, 0.05 };
+  codecs.push_back(video);
+#endif
+}
+
+void RemoteQuality::setTargetFrameTime(double seconds)
+{
+  targetFrameTime = seconds;
+}
+
+double RemoteQuality::getTargetFrameTime() const
+{
+  return targetFrameTime;
+}
+
+void RemoteQuality::setPreferred(const Settings& settings)
+{
+  preferred = settings;
+
+  if (findCodec(settings.codec) == NULL)
+  {
+    Codec c = { settings.codec, settings.codec < vvImage::VV_VIDEO, false, 4e-9, 0.5 };
+    codecs.push_back(c);
+  }
+}
+
+const RemoteQuality::Settings& RemoteQuality::getPreferred() const
+{
+  return preferred;
+}
+
+void RemoteQuality::setScalable(bool scalable)
+{
+  this->scalable = scalable;
+}
+
+RemoteQuality::Settings RemoteQuality::select(bool moving, size_t pixels)
+{
+  vvDebugMsg::msg(3, "RemoteQuality::select()");
+
+  // the client requests the next frame right after the last one while the
+  // user interacts, so the gap is the round trip of that frame
+  if (sentTime > 0.0 && moving && this->moving)
+  {
+    const double roundTrip = vvClock::getTime() - sentTime;
+    if (latency < 0.0 || roundTrip < latency)
+    {
+      latency = roundTrip;
+    }
+    else
+    {
+      latency += (roundTrip - latency) * 0.01;
+    }
+    if (lastBytes > 0)
+    {
+      average(transferPerByte, std::max(roundTrip - latency, 0.0) / double(lastBytes));
+    }
+  }
+
+  this->moving = moving;
+  this->pixels = pixels;
+
+  if (!moving || targetFrameTime <= 0.0 || renderPerPixel < 0.0 || transferPerByte < 0.0)
+  {
+    current = preferred;
+    return current;
+  }
+
+  std::vector<Settings> options;
+  const size_t numScales = scalable ? sizeof(Scales) / sizeof(Scales[0]) : 1;
+  for (size_t i = 0; i < numScales; ++i)
+  {
+    options.push_back(Settings(preferred.codec, Scales[i], preferred.depthPrecision));
+    for (int p = std::min(preferred.depthPrecision, 16); p >= 8; p /= 2)
+    {
+      if (p < preferred.depthPrecision)
+      {
+        options.push_back(Settings(preferred.codec, Scales[i], p));
+      }
+    }
+  }
+
+  Settings fallback = options.back();
+  for (std::vector<Settings>::iterator it = options.begin(); it != options.end(); ++it)
+  {
+    Settings& s = *it;
+    const bool better = s.scale > current.scale || s.depthPrecision > current.depthPrecision;
+    const double limit = better ? targetFrameTime * Headroom : targetFrameTime;
+
+    // the preferred codec if it is fast enough, else the fastest lossless
+    // codec, else the fastest codec
+    double fastest[2] = { -1.0, -1.0 };
+    int fastestCodec[2] = { preferred.codec, preferred.codec };
+    for (std::vector<Codec>::const_iterator c = codecs.begin(); c != codecs.end(); ++c)
+    {
+      const double t = predict(Settings(c->codec, s.scale, s.depthPrecision), pixels);
+      for (int lossy = 0; lossy < 2; ++lossy)
+      {
+        if ((c->lossless || lossy) && (fastest[lossy] < 0.0 || t < fastest[lossy]))
+        {
+          fastest[lossy] = t;
+          fastestCodec[lossy] = c->codec;
+        }
+      }
+    }
+
+    if (predict(s, pixels) <= limit)
+    {
+      current = s;
+      return current;
+    }
+    for (int lossy = 0; lossy < 2; ++lossy)
+    {
+      if (fastest[lossy] >= 0.0 && fastest[lossy] <= limit)
+      {
+        s.codec = fastestCodec[lossy];
+        current = s;
+        return current;
+      }
+    }
+    fallback.codec = fastestCodec[1];
+  }
+
+  // nothing meets the target, use the fastest settings
+  current = fallback;
+  return current;
+}
+
+void RemoteQuality::update(double renderTime, double encodeTime, size_t bytes)
+{
+  const size_t px = scaledPixels(pixels, current.scale);
+  average(renderPerPixel, renderTime / double(px));
+
+  Codec* c = findCodec(current.codec);
+  if (c != NULL)
+  {
+    const double raw = double(px) * (4.0 + current.depthPrecision / 8.0);
+    if (!c->measured)
+    {
+      c->encodePerPixel = -1.0;
+      c->ratio = -1.0;
+      c->measured = true;
+    }
+    average(c->encodePerPixel, encodeTime / double(px));
+    average(c->ratio, double(bytes) / raw);
+  }
+
+  lastBytes = bytes;
+}
+
+void RemoteQuality::sent()
+{
+  sentTime = vvClock::getTime();
+}
+
+double RemoteQuality::predict(const Settings& settings, size_t pixels) const
+{
+  const Codec* c = findCodec(settings.codec);
+  const double px = double(scaledPixels(pixels, settings.scale));
+  const double raw = px * (4.0 + settings.depthPrecision / 8.0);
+  const double encodePerPixel = c != NULL ? c->encodePerPixel : 0.0;
+  const double ratio = c != NULL ? c->ratio : 1.0;
+
+  return px * (std::max(renderPerPixel, 0.0) + encodePerPixel)
+       + raw * ratio * std::max(transferPerByte, 0.0)
+       + std::max(latency, 0.0);
+}
+
+RemoteQuality::Codec* RemoteQuality::findCodec(int codec)
+{
+  if (codec == vvImage::VV_RLE || codec == vvImage::VV_RLE_RECT)
+  {
+    codec = vvImage::VV_TILES;
+  }
+  for (std::vector<Codec>::iterator it = codecs.begin(); it != codecs.end(); ++it)
+  {
+    if (it->codec == codec)
+    {
+      return &*it;
+    }
+  }
+  return NULL;
+}
+
+const RemoteQuality::Codec* RemoteQuality::findCodec(int codec) const
+{
+  return const_cast<RemoteQuality*>(this)->findCodec(codec);
+}
+
+} // namespace virvo
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
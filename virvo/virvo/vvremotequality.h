@@ -0,0 +1,129 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef _VV_REMOTEQUALITY_H_
+#define _VV_REMOTEQUALITY_H_
+
+#include "vvexport.h"
+
+#include <stddef.h>
+#include <vector>
+
+namespace virvo
+{
+
+//------------------------------------------------------------------------------
+// RemoteQuality
+//
+// Chooses the codec, image scale and depth precision of the images a remote
+// rendering server sends, so that frames arrive at a target rate while the
+// view changes. The cost of a frame is modelled from measurements of the
+// previous frames: render time per pixel, encode time and compression ratio
+// per codec, and the round trip until the client requests the next frame,
+// split into a latency and a transfer time per byte.
+//
+// While the view changes, the best settings whose predicted frame time
+// meets the target are selected. When it stops changing, the settings
+// preferred by the user are used again.
+//
+//   Settings s = quality.select(moving, pixels);
+//   ... render with s, encode with s.codec ...
+//   quality.update(renderTime, encodeTime, bytes);
+//   ... send ...
+//   quality.sent();
+//
+class VVAPI RemoteQuality
+{
+public:
+  struct Settings
+  {
+    int codec;                ///< vvImage code type
+    float scale;              ///< image resolution relative to the viewport
+    int depthPrecision;       ///< bits per depth value of IBR images, 0 = no depth
+
+    Settings(int codec = 0, float scale = 1.0f, int depthPrecision = 0)
+      : codec(codec)
+      , scale(scale)
+      , depthPrecision(depthPrecision)
+    {
+    }
+  };
+
+  RemoteQuality();
+
+  /// Frame time to meet while the view changes [s], 0 = always use the
+  /// preferred settings
+  void setTargetFrameTime(double seconds);
+  double getTargetFrameTime() const;
+
+  /// Settings chosen by the user, they are used when the view does not change
+  void setPreferred(const Settings& settings);
+  const Settings& getPreferred() const;
+
+  /// Allow images smaller than the viewport
+  void setScalable(bool scalable);
+
+  /// Returns the settings for the next frame of the given number of
+  /// viewport pixels. moving is true if the view or the rendering
+  /// parameters changed since the last frame.
+  Settings select(bool moving, size_t pixels);
+
+  /// Report the costs of the frame rendered with the last selected settings
+  void update(double renderTime, double encodeTime, size_t bytes);
+
+  /// Call when the frame was sent, the time until the next select() is the
+  /// round trip of the frame
+  void sent();
+
+  /// Predicted time of a frame [s]
+  double predict(const Settings& settings, size_t pixels) const;
+
+private:
+  struct Codec
+  {
+    int codec;
+    bool lossless;
+    bool measured;
+    double encodePerPixel;    ///< [s]
+    double ratio;             ///< encoded bytes / raw bytes
+  };
+
+  std::vector<Codec> codecs;
+  Settings preferred;
+  Settings current;
+  double targetFrameTime;
+  bool scalable;
+  bool moving;
+  size_t pixels;
+
+  double renderPerPixel;      ///< [s]
+  double latency;             ///< shortest round trip seen [s]
+  double transferPerByte;     ///< [s]
+  size_t lastBytes;
+  double sentTime;            ///< time the last frame was sent, 0 = not yet
+
+  Codec* findCodec(int codec);
+  const Codec* findCodec(int codec) const;
+};
+
+} // namespace virvo
+
+#endif
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
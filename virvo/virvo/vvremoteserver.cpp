@@ -18,20 +18,42 @@
 // License along with this library (see license.txt); if not, write to the
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
+#include "vvclock.h"
 #include "vvfileio.h"
+#include "vvimage.h"
 #include "vvrenderer.h"
 #include "vvremoteserver.h"
 #include "vvdebugmsg.h"
 #include "vvsocketio.h"
 #include "vvtcpsocket.h"
+#include "vvtrace.h"
 
 #include "private/vvgltools.h"
 
+#include <algorithm>
+
 using std::cerr;
 using std::endl;
 
+namespace
+{
+
+/// Events deferred before the server renders anyway
+const size_t MaxDeferredEvents = 256;
+
+virvo::trace::Counter eventsCoalesced("remote events coalesced");
+virvo::trace::Counter framesDropped("remote frames dropped");
+
+}
+
 vvRemoteServer::vvRemoteServer(vvSocket *socket)
   : _codetype(0)
+  , _imageScale(1.0f)
+  , _frameRequests(0)
+  , _requestsReceived(0)
+  , _frameId(0)
+  , _deferred(0)
+  , _changed(true)
 {
   _socketio = new vvSocketIO(socket);
   vvDebugMsg::msg(1, "vvRemoteServer::vvRemoteServer()");
@@ -58,12 +80,6 @@ bool vvRemoteServer::processEvent(virvo::RemoteEvent event, vvRenderer* renderer
 {
   vvDebugMsg::msg(3, "vvRemoteServer::processEvents()");
 
-  vvVector3 position;
-  vvVector3 viewDir;
-  vvVector3 objDir;
-  int currentFrame;
-  vvTransFunc tf;
-
   switch (event)
   {
   case virvo::CameraMatrix:
@@ -73,122 +89,123 @@ bool vvRemoteServer::processEvent(virvo::RemoteEvent event, vvRenderer* renderer
       if ((_socketio->getMatrix(&pr) == vvSocket::VV_OK)
          && (_socketio->getMatrix(&mv) == vvSocket::VV_OK))
       {
-        renderImage(pr, mv, renderer);
+        if (_frameRequests > 0)
+        {
+          framesDropped.add(1);
+        }
+        _pr = pr;
+        _mv = mv;
+        ++_frameRequests;
+        _requestTimes.push_back(vvClock::getTime());
+        ++_requestsReceived;
+        ++_deferred;
       }
     }
     break;
   case virvo::CurrentFrame:
-    if ((_socketio->getInt32(currentFrame)) == vvSocket::VV_OK)
     {
-      renderer->setCurrentFrame(currentFrame);
+      Update update(event, -1);
+      if ((_socketio->getInt32(update.i)) == vvSocket::VV_OK)
+      {
+        defer(update);
+      }
     }
     break;
   case virvo::ObjectDirection:
-    if ((_socketio->getVector3(objDir)) == vvSocket::VV_OK)
-    {
-      renderer->setObjectDirection(objDir);
-    }
-    break;
   case virvo::ViewingDirection:
-    if ((_socketio->getVector3(viewDir)) == vvSocket::VV_OK)
-    {
-      renderer->setViewingDirection(viewDir);
-    }
-    break;
   case virvo::Position:
-    if ((_socketio->getVector3(position)) == vvSocket::VV_OK)
     {
-      renderer->setPosition(position);
+      Update update(event, -1);
+      if ((_socketio->getVector3(update.v3)) == vvSocket::VV_OK)
+      {
+        defer(update);
+      }
     }
     break;
   case virvo::TransFunc:
-    for (std::vector<vvTFWidget*>::const_iterator it = tf._widgets.begin();
-         it != tf._widgets.end(); ++it)
-    {
-      delete *it;
-    }
-    tf._widgets.clear();
-    if ((_socketio->getTransferFunction(tf)) == vvSocket::VV_OK)
     {
-      renderer->getVolDesc()->tf = tf;
-      renderer->updateTransferFunction();
+      vvTransFunc tf;
+      if ((_socketio->getTransferFunction(tf)) == vvSocket::VV_OK)
+      {
+        _transFunc = tf;
+        defer(Update(event, -1));
+      }
     }
     break;
   case virvo::Parameter1B:
     {
       int32_t param;
-      bool value = false;
-      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getBool(value) == vvSocket::VV_OK)
+      Update update(event, -1);
+      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getBool(update.b) == vvSocket::VV_OK)
       {
-        renderer->setParameter((vvRenderState::ParameterType)param, value);
+        update.param = param;
+        defer(update);
       }
     }
     break;
   case virvo::Parameter1I:
     {
       int32_t param;
-      int value = 0;
-      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getInt32(value) == vvSocket::VV_OK)
+      Update update(event, -1);
+      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getInt32(update.i) == vvSocket::VV_OK)
       {
-        switch(param)
-        {
-        case vvRenderer::VV_CODEC:
-          _codetype = value;
-          break;
-        default:
-          renderer->setParameter((vvRenderState::ParameterType)param, value);
-          break;
-        }
+        update.param = param;
+        defer(update);
       }
     }
     break;
   case virvo::Parameter1F:
     {
       int32_t param;
-      float value = 0.f;
-      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getFloat(value) == vvSocket::VV_OK)
+      Update update(event, -1);
+      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getFloat(update.f) == vvSocket::VV_OK)
       {
-        renderer->setParameter((vvRenderState::ParameterType)param, value);
+        update.param = param;
+        defer(update);
       }
     }
     break;
   case virvo::Parameter3F:
     {
       int32_t param;
-      vvVector3 value;
-      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getVector3(value) == vvSocket::VV_OK)
+      Update update(event, -1);
+      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getVector3(update.v3) == vvSocket::VV_OK)
       {
-        renderer->setParameter((vvRenderState::ParameterType)param, value);
+        update.param = param;
+        defer(update);
       }
     }
     break;
   case virvo::Parameter4F:
     {
       int32_t param;
-      vvVector4 value;
-      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getVector4(value) == vvSocket::VV_OK)
+      Update update(event, -1);
+      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getVector4(update.v4) == vvSocket::VV_OK)
       {
-        renderer->setParameter((vvRenderState::ParameterType)param, value);
+        update.param = param;
+        defer(update);
       }
     }
     break;
   case virvo::ParameterColor:
     {
       int32_t param;
-      vvColor value;
-      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getColor(value) == vvSocket::VV_OK)
+      Update update(event, -1);
+      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getColor(update.color) == vvSocket::VV_OK)
       {
-        renderer->setParameter((vvRenderState::ParameterType)param, value);
+        update.param = param;
+        defer(update);
       }
     }
     break;
   case virvo::ParameterAABBI:
     {
       int32_t param;
-      vvAABBi value = vvAABBi(vvVector3i(), vvVector3i());
-      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getAABBi(value) == vvSocket::VV_OK)
+      Update update(event, -1);
+      if (_socketio->getInt32(param) == vvSocket::VV_OK && _socketio->getAABBi(update.aabbi) == vvSocket::VV_OK)
       {
-        renderer->setParameter((vvRenderState::ParameterType)param, value);
+        update.param = param;
+        defer(update);
       }
     }
     break;
@@ -197,6 +214,187 @@ bool vvRemoteServer::processEvent(virvo::RemoteEvent event, vvRenderer* renderer
     return true;
   }
 
+  // handle the events already sent by the client before doing any work,
+  // but do not let a client that never pauses starve its frame requests
+  if (_deferred >= MaxDeferredEvents || !_socketio->hasPendingData())
+  {
+    flush(renderer);
+  }
+
   return true;
 }
+
+void vvRemoteServer::flush(vvRenderer* renderer)
+{
+  vvDebugMsg::msg(3, "vvRemoteServer::flush()");
+
+  for (std::vector<Update>::const_iterator it = _updates.begin(); it != _updates.end(); ++it)
+  {
+    const Update& u = *it;
+    const vvRenderState::ParameterType param = (vvRenderState::ParameterType)u.param;
+
+    switch (u.event)
+    {
+    case virvo::CurrentFrame:
+      renderer->setCurrentFrame(u.i);
+      break;
+    case virvo::ObjectDirection:
+      renderer->setObjectDirection(u.v3);
+      break;
+    case virvo::ViewingDirection:
+      renderer->setViewingDirection(u.v3);
+      break;
+    case virvo::Position:
+      renderer->setPosition(u.v3);
+      break;
+    case virvo::TransFunc:
+      renderer->getVolDesc()->tf = _transFunc;
+      renderer->updateTransferFunction();
+      break;
+    case virvo::Parameter1B:
+      renderer->setParameter(param, u.b);
+      break;
+    case virvo::Parameter1I:
+      if (u.param == vvRenderer::VV_CODEC)
+      {
+        virvo::RemoteQuality::Settings preferred = _quality.getPreferred();
+        preferred.codec = u.i;
+        _quality.setPreferred(preferred);
+      }
+      else
+      {
+        if (u.param == vvRenderer::VV_IBR_DEPTH_PREC)
+        {
+          virvo::RemoteQuality::Settings preferred = _quality.getPreferred();
+          preferred.depthPrecision = u.i;
+          _quality.setPreferred(preferred);
+        }
+        renderer->setParameter(param, u.i);
+      }
+      break;
+    case virvo::Parameter1F:
+      renderer->setParameter(param, u.f);
+      break;
+    case virvo::Parameter3F:
+      renderer->setParameter(param, u.v3);
+      break;
+    case virvo::Parameter4F:
+      renderer->setParameter(param, u.v4);
+      break;
+    case virvo::ParameterColor:
+      renderer->setParameter(param, u.color);
+      break;
+    case virvo::ParameterAABBI:
+      renderer->setParameter(param, u.aabbi);
+      break;
+    default:
+      break;
+    }
+  }
+  _changed |= !_updates.empty();
+  _updates.clear();
+
+  for (std::vector<vvTFWidget*>::const_iterator it = _transFunc._widgets.begin();
+       it != _transFunc._widgets.end(); ++it)
+  {
+    delete *it;
+  }
+  _transFunc._widgets.clear();
+
+  if (_frameRequests > 0)
+  {
+    // adapt the images to the connection while the user interacts
+    const bool moving = _changed || !_pr.equal(_lastPr) || !_mv.equal(_lastMv);
+    const virvo::Viewport vp = vvGLTools::getViewport();
+    _quality.setTargetFrameTime(renderer->getParameter(vvRenderState::VV_REMOTE_FRAME_TIME));
+    virvo::RemoteQuality::Settings settings = _quality.select(moving, size_t(vp[2]) * size_t(vp[3]));
+    _codetype = settings.codec;
+    _imageScale = settings.scale;
+    if (settings.depthPrecision > 0 && settings.depthPrecision != int(renderer->getParameter(vvRenderer::VV_IBR_DEPTH_PREC)))
+    {
+      renderer->setParameter(vvRenderer::VV_IBR_DEPTH_PREC, settings.depthPrecision);
+    }
+    _lastPr = _pr;
+    _lastMv = _mv;
+    _changed = false;
+
+    _frameId = _requestsReceived - int(_frameRequests);
+    renderImage(_pr, _mv, renderer);
+
+    // the client expects an answer to each request
+    for (size_t i = 1; i < _frameRequests; ++i)
+    {
+      ++_frameId;
+      repeatImage(_pr, _mv, renderer);
+    }
+    _frameRequests = 0;
+    _requestTimes.clear();
+
+    virvo::trace::sampleCounters();
+  }
+
+  if (_deferred > 1)
+  {
+    vvDebugMsg::msg(3, "vvRemoteServer::flush() events handled at once: ", (int)_deferred);
+  }
+  _deferred = 0;
+}
+
+void vvRemoteServer::setFrameTimes(vvImage* image, double renderStart, double renderTime, double encodeTime) const
+{
+  const size_t pending = size_t(_frameId - (_requestsReceived - int(_requestTimes.size())));
+  const double received = pending < _requestTimes.size() ? _requestTimes[pending] : vvClock::getTime();
+  const double queued = (renderStart > 0.0 ? renderStart : vvClock::getTime()) - received;
+
+  image->setFrameId(_frameId);
+  image->setStageTime(vvImage::VV_QUEUED, float(std::max(queued, 0.0)));
+  image->setStageTime(vvImage::VV_RENDERED, float(renderTime));
+  image->setStageTime(vvImage::VV_ENCODED, float(encodeTime));
+}
+
+bool vvRemoteServer::isRenderEvent(virvo::RemoteEvent event)
+{
+  switch (event)
+  {
+  case virvo::CameraMatrix:
+  case virvo::CurrentFrame:
+  case virvo::ObjectDirection:
+  case virvo::ViewingDirection:
+  case virvo::Position:
+  case virvo::TransFunc:
+  case virvo::Parameter1B:
+  case virvo::Parameter1I:
+  case virvo::Parameter1F:
+  case virvo::Parameter3F:
+  case virvo::Parameter4F:
+  case virvo::ParameterColor:
+  case virvo::ParameterAABBI:
+    return true;
+  default:
+    return false;
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Defer a state update. An earlier update of the same state is dropped, so
+  the updates are applied in the order in which their latest values arrived.
+*/
+void vvRemoteServer::defer(const Update& update)
+{
+  ++_deferred;
+
+  for (std::vector<Update>::iterator it = _updates.begin(); it != _updates.end(); ++it)
+  {
+    // parameters are identified by their type, whichever event set them
+    bool same = update.param >= 0 ? it->param == update.param : it->event == update.event;
+    if (same)
+    {
+      _updates.erase(it);
+      eventsCoalesced.add(1);
+      break;
+    }
+  }
+
+  _updates.push_back(update);
+}
 // vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -21,10 +21,18 @@
 #ifndef VVREMOTESERVER_H
 #define VVREMOTESERVER_H
 
+#include "vvaabb.h"
+#include "vvcolor.h"
 #include "vvexport.h"
 #include "vvremoteevents.h"
+#include "vvremotequality.h"
 #include "vvsocket.h"
+#include "vvtransfunc.h"
+#include "vvvecmath.h"
 
+#include <vector>
+
+class vvImage;
 class vvMatrix;
 class vvRenderer;
 class vvSocketIO;
@@ -44,16 +52,79 @@ public:
   vvRemoteServer(vvSocket *socket);
   virtual ~vvRemoteServer();
 
+  /** Handle a rendering event. State updates and frame requests are
+    deferred while more events are waiting on the socket: an update is
+    dropped when a later event sets the same state, and only the latest
+    frame request is rendered. The deferred events take effect when the
+    socket runs dry or when flush() is called.
+    */
   virtual bool processEvent(virvo::RemoteEvent event, vvRenderer* renderer);
+
+  /// Apply the deferred state updates and answer the pending frame requests
+  void flush(vvRenderer* renderer);
+
+  /// Returns true for the events processEvent() handles
+  static bool isRenderEvent(virvo::RemoteEvent event);
 protected:
   vvSocketIO* _socketio;                    ///< socket for remote rendering
 
-  int _codetype;
+  int _codetype;                            ///< code type of the next image
+  float _imageScale;                        ///< resolution of the next image relative to the viewport
+  virvo::RemoteQuality _quality;            ///< chooses code type, scale and depth precision of the images
 
   virtual void renderImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer* renderer) = 0;
+
+  /// Stamp an image with the frame request it answers and the time the
+  /// server stages took. renderStart is the vvClock time rendering started,
+  /// 0 if the image is sent again without rendering.
+  void setFrameTimes(vvImage* image, double renderStart, double renderTime, double encodeTime) const;
   virtual void resize(int w, int h) { (void)w; (void)h; }
+
+  /// Answer a frame request superseded by the last one rendered, the
+  /// default renders the frame again
+  virtual void repeatImage(const vvMatrix& pr, const vvMatrix& mv, vvRenderer* renderer)
+  {
+    renderImage(pr, mv, renderer);
+  }
 private:
+  struct Update                             ///< deferred state update
+  {
+    virvo::RemoteEvent event;
+    int32_t param;                          ///< parameter type, -1 for events without one
+    bool b;
+    int i;
+    float f;
+    vvVector3 v3;
+    vvVector4 v4;
+    vvColor color;
+    vvAABBi aabbi;
+
+    Update(virvo::RemoteEvent event, int32_t param)
+      : event(event)
+      , param(param)
+      , b(false)
+      , i(0)
+      , f(0.0f)
+      , aabbi(vvVector3i(), vvVector3i())
+    {
+    }
+  };
+
+  std::vector<Update> _updates;             ///< deferred updates, in the order of their latest occurrence
+  vvTransFunc _transFunc;                   ///< transfer function of a deferred TransFunc update
+  vvMatrix _pr;                             ///< projection matrix of the latest frame request
+  vvMatrix _mv;                             ///< modelview matrix of the latest frame request
+  size_t _frameRequests;                    ///< frame requests not answered yet
+  std::vector<double> _requestTimes;       ///< times the unanswered frame requests were received
+  int _requestsReceived;                    ///< frame requests received over the connection
+  int _frameId;                             ///< frame request answered next
+  size_t _deferred;                         ///< events deferred since the last flush
+  vvMatrix _lastPr;                         ///< projection matrix of the last frame rendered
+  vvMatrix _lastMv;                         ///< modelview matrix of the last frame rendered
+  bool _changed;                            ///< true if the state changed since the last frame rendered
+
   vvRemoteServer::ErrorType initSocket();
+  void defer(const Update& update);
 };
 
 #endif // VVREMOTESERVER_H
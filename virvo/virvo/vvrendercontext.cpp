@@ -323,6 +323,26 @@ bool vvRenderContext::makeCurrent() const
   return false;
 }
 
+void vvRenderContext::doneCurrent() const
+{
+  vvDebugMsg::msg(3, "vvRenderContext::doneCurrent()");
+
+  if (_initialized)
+  {
+#ifdef USE_COCOA
+    _archData->cocoaContext->doneCurrent();
+#endif
+
+#if defined(HAVE_X11) && defined(USE_X11)
+    glXMakeCurrent(_archData->display, None, NULL);
+#endif
+
+#ifdef _WIN32
+    wglMakeCurrent(NULL, NULL);
+#endif
+  }
+}
+
 void vvRenderContext::swapBuffers() const
 {
   vvDebugMsg::msg(3, "vvRenderContext::swapBuffers()");
@@ -89,6 +89,11 @@ public:
     @return true on success, false on error
     */
   bool makeCurrent() const;
+  /**
+    Release this rendercontext from the calling thread, so that
+    another thread can make it current
+    */
+  void doneCurrent() const;
   /**
     Swap buffers in case of double-buffering
     */
@@ -91,6 +91,9 @@ vvRenderState::vvRenderState()
   , _interpolation(true)
   , _earlyRayTermination(true)
   , _preIntegration(false)
+  , _lod(true)
+  , _lodFrameTime(0.0f)
+  , _remoteFrameTime(0.0f)
 {
   
 }
@@ -241,6 +244,15 @@ void vvRenderState::setParameter(ParameterType param, const vvParam& value)
   case VV_TERMINATEEARLY:
     _earlyRayTermination = value;
     break;
+  case VV_LOD:
+    _lod = value;
+    break;
+  case VV_LOD_FRAME_TIME:
+    _lodFrameTime = value;
+    break;
+  case VV_REMOTE_FRAME_TIME:
+    _remoteFrameTime = value;
+    break;
   default:
     break;
   }
@@ -338,6 +350,12 @@ vvParam vvRenderState::getParameter(ParameterType param) const
     return _preIntegration;
   case VV_TERMINATEEARLY:
     return _earlyRayTermination;
+  case VV_LOD:
+    return _lod;
+  case VV_LOD_FRAME_TIME:
+    return _lodFrameTime;
+  case VV_REMOTE_FRAME_TIME:
+    return _remoteFrameTime;
   default:
     return vvParam();
   }
@@ -115,7 +115,10 @@ public:
     VV_IMG_PRECISION,                           ///< render to high-res target to minimize slicing rounding error
     VV_LIGHTING,
     VV_MEASURETIME,
-    VV_PIX_SHADER
+    VV_PIX_SHADER,
+    VV_LOD,                                     ///< render coarser levels of detail where voxels are smaller than pixels
+    VV_LOD_FRAME_TIME,                          ///< render time per frame while the view changes [s], 0 = no limit
+    VV_REMOTE_FRAME_TIME                        ///< remote rendering: frame time to adapt images to while the view changes [s], 0 = no limit
   };
 
   virtual void setParameter(ParameterType param, const vvParam& value);
@@ -173,6 +176,9 @@ protected:
   bool _interpolation;                          ///< interpolation mode: true=linear interpolation (default), false=nearest neighbor
   bool _earlyRayTermination;                    ///< terminate ray marching when enough alpha was gathered
   bool _preIntegration;                         ///< true = try to use pre-integrated rendering (planar 3d textures)
+  bool _lod;                                    ///< true = use levels of detail of the volume, if available
+  float _lodFrameTime;                          ///< coarsen levels of detail while the view changes to meet this render time [s]
+  float _remoteFrameTime;                       ///< reduce the quality of remote images while the view changes to meet this frame time [s]
 public:
   vvRenderState();
 };
@@ -0,0 +1,457 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvslicer.h"
+#include "vvdebugmsg.h"
+#include "vvvoldesc.h"
+#include "vvworkerpool.h"
+
+#include "mem/align.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VV_SLICER_SSE 1
+#include "sse/vec.h"
+#endif
+
+namespace virvo
+{
+
+namespace
+{
+
+#if VV_SLICER_SSE
+typedef sse::Vec Vec;
+const size_t Lanes = 4;
+
+inline Vec loadLanes(const float* p) { return Vec(p); }
+inline void storeLanes(const Vec& v, float* p) { sse::store(v, p); }
+inline Vec vmin(const Vec& u, const Vec& v) { return sse::min(u, v); }
+inline Vec vmax(const Vec& u, const Vec& v) { return sse::max(u, v); }
+#else
+typedef float Vec;
+const size_t Lanes = 1;
+
+inline Vec loadLanes(const float* p) { return *p; }
+inline void storeLanes(Vec v, float* p) { *p = v; }
+inline Vec vmin(Vec u, Vec v) { return u < v ? u : v; }
+inline Vec vmax(Vec u, Vec v) { return u > v ? u : v; }
+#endif
+
+inline Vec lerp(const Vec& a, const Vec& b, const Vec& t)
+{
+  return a + (b - a) * t;
+}
+
+// Voxel value as stored, 2 byte voxels are big endian
+template <size_t Bpc>
+inline float fetch(const uint8_t* p);
+
+template <>
+inline float fetch<1>(const uint8_t* p)
+{
+  return float(p[0]);
+}
+
+template <>
+inline float fetch<2>(const uint8_t* p)
+{
+  return float(int(p[0]) * 256 + int(p[1]));
+}
+
+template <>
+inline float fetch<4>(const uint8_t* p)
+{
+  float f;
+  memcpy(&f, p, sizeof(f));
+  return f;
+}
+
+} // namespace
+
+// Parameters of one sample() call, shared by the jobs
+struct SliceParams
+{
+  const uint8_t* raw;           // first byte of the channel
+  size_t bpc;
+  ptrdiff_t stride[3];          // bytes between neighbors along x, y, z
+  ptrdiff_t step[3];            // stride, or 0 for axes with a single voxel
+  int base[3];                  // highest lower corner of an interpolation cell
+  float extent[3];              // highest voxel coordinate
+  Slicer::Plane plane;
+  vvVector3 normal;             // one voxel along the plane normal
+  size_t samples;
+  Slicer::Mode mode;
+  float lo;                     // data value mapped to 0
+  float scale;                  // 1 / window width
+  const uint8_t* colors;
+  size_t entries;
+  size_t width;
+  uint8_t* dst;
+};
+
+struct Slicer::Job
+{
+  const SliceParams* params;
+  size_t firstRow;
+  size_t lastRow;
+};
+
+namespace
+{
+
+template <size_t Bpc>
+void sampleRows(const SliceParams& p, size_t firstRow, size_t lastRow)
+{
+  const size_t bpp = p.colors ? 3 : 1;
+  const ptrdiff_t dx = p.step[0];
+  const ptrdiff_t dy = p.step[1];
+  const ptrdiff_t dz = p.step[2];
+  const Vec lowest(-FLT_MAX);
+
+  CACHE_ALIGN float corner[8][Lanes];
+  CACHE_ALIGN float frac[3][Lanes];
+  CACHE_ALIGN float inside[Lanes];
+  CACHE_ALIGN float value[Lanes];
+  CACHE_ALIGN float count[Lanes];
+
+  for (size_t j = firstRow; j < lastRow; ++j)
+  {
+    uint8_t* out = p.dst + j * p.width * bpp;
+
+    for (size_t i = 0; i < p.width; i += Lanes)
+    {
+      Vec acc = p.mode == Slicer::MaxIntensity ? lowest : Vec(0.0f);
+      Vec n(0.0f);
+
+      for (size_t k = 0; k < p.samples; ++k)
+      {
+        float offset = float(k) - float(p.samples - 1) * 0.5f;
+
+        // gather the corners of the interpolation cells
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+          float pos[3];
+          bool in = i + l < p.width;
+          for (int a = 0; a < 3; ++a)
+          {
+            pos[a] = p.plane.origin[a] + float(i + l) * p.plane.u[a] + float(j) * p.plane.v[a] + offset * p.normal[a];
+            in = in && pos[a] >= 0.0f && pos[a] <= p.extent[a];
+          }
+
+          if (!in)
+          {
+            for (int c = 0; c < 8; ++c)
+              corner[c][l] = 0.0f;
+            frac[0][l] = frac[1][l] = frac[2][l] = 0.0f;
+            inside[l] = 0.0f;
+            continue;
+          }
+
+          int cell[3];
+          for (int a = 0; a < 3; ++a)
+          {
+            cell[a] = std::min(int(pos[a]), p.base[a]);
+            frac[a][l] = pos[a] - float(cell[a]);
+          }
+
+          const uint8_t* v = p.raw + cell[0] * p.stride[0] + cell[1] * p.stride[1] + cell[2] * p.stride[2];
+          corner[0][l] = fetch<Bpc>(v);
+          corner[1][l] = fetch<Bpc>(v + dx);
+          corner[2][l] = fetch<Bpc>(v + dy);
+          corner[3][l] = fetch<Bpc>(v + dx + dy);
+          corner[4][l] = fetch<Bpc>(v + dz);
+          corner[5][l] = fetch<Bpc>(v + dx + dz);
+          corner[6][l] = fetch<Bpc>(v + dy + dz);
+          corner[7][l] = fetch<Bpc>(v + dx + dy + dz);
+          inside[l] = 1.0f;
+        }
+
+        // trilinear interpolation of all lanes
+        Vec fx = loadLanes(frac[0]);
+        Vec fy = loadLanes(frac[1]);
+        Vec fz = loadLanes(frac[2]);
+        Vec c0 = lerp(lerp(loadLanes(corner[0]), loadLanes(corner[1]), fx), lerp(loadLanes(corner[2]), loadLanes(corner[3]), fx), fy);
+        Vec c1 = lerp(lerp(loadLanes(corner[4]), loadLanes(corner[5]), fx), lerp(loadLanes(corner[6]), loadLanes(corner[7]), fx), fy);
+        Vec s = lerp(c0, c1, fz);
+        Vec w = loadLanes(inside);
+
+        if (p.mode == Slicer::MaxIntensity)
+        {
+          acc = vmax(acc, s * w + (Vec(1.0f) - w) * lowest);
+        }
+        else
+        {
+          acc = acc + s * w;
+        }
+        n = n + w;
+      }
+
+      if (p.mode != Slicer::MaxIntensity)
+      {
+        acc = acc / vmax(n, Vec(1.0f));
+      }
+
+      // window/level
+      Vec t = vmin(vmax((acc - Vec(p.lo)) * Vec(p.scale), Vec(0.0f)), Vec(1.0f));
+      storeLanes(t, value);
+      storeLanes(n, count);
+
+      size_t lanes = std::min(Lanes, p.width - i);
+      for (size_t l = 0; l < lanes; ++l)
+      {
+        if (p.colors)
+        {
+          if (count[l] > 0.0f)
+          {
+            const uint8_t* c = p.colors + 3 * size_t(value[l] * float(p.entries - 1) + 0.5f);
+            out[0] = c[0];
+            out[1] = c[1];
+            out[2] = c[2];
+          }
+          else
+          {
+            out[0] = out[1] = out[2] = 0;
+          }
+          out += 3;
+        }
+        else
+        {
+          *out++ = count[l] > 0.0f ? uint8_t(value[l] * 255.0f + 0.5f) : 0;
+        }
+      }
+    }
+  }
+}
+
+void sampleRows(const SliceParams& p, size_t firstRow, size_t lastRow)
+{
+  switch (p.bpc)
+  {
+  case 1: sampleRows<1>(p, firstRow, lastRow); break;
+  case 2: sampleRows<2>(p, firstRow, lastRow); break;
+  case 4: sampleRows<4>(p, firstRow, lastRow); break;
+  default: assert(0); break;
+  }
+}
+
+} // namespace
+
+Slicer::Plane Slicer::axisPlane(const vvVolDesc* vd, vvVecmath::AxisType axis, size_t slice)
+{
+  Plane plane;
+  switch (axis)
+  {
+  case vvVecmath::X_AXIS:
+    plane.origin = vvVector3(float(vd->vox[0] - slice - 1), 0.0f, 0.0f);
+    plane.u = vvVector3(0.0f, 0.0f, 1.0f);
+    plane.v = vvVector3(0.0f, 1.0f, 0.0f);
+    break;
+  case vvVecmath::Y_AXIS:
+    plane.origin = vvVector3(0.0f, float(slice), float(vd->vox[2] - 1));
+    plane.u = vvVector3(1.0f, 0.0f, 0.0f);
+    plane.v = vvVector3(0.0f, 0.0f, -1.0f);
+    break;
+  default:
+    plane.origin = vvVector3(0.0f, 0.0f, float(slice));
+    plane.u = vvVector3(1.0f, 0.0f, 0.0f);
+    plane.v = vvVector3(0.0f, 1.0f, 0.0f);
+    break;
+  }
+  return plane;
+}
+
+Slicer::Slicer(int numThreads)
+  : pool(new WorkerPool(numThreads, "virvo slicer"))
+  , level(127.5f)
+  , width(255.0f)
+  , mode(Single)
+  , thickness(1)
+{
+}
+
+Slicer::~Slicer()
+{
+  delete pool;
+}
+
+void Slicer::setWindow(float level, float width)
+{
+  this->level = level;
+  this->width = width;
+}
+
+void Slicer::setWindow(const vvVolDesc* vd, float lo, float hi)
+{
+  float min = 0.0f;
+  float max = 255.0f;
+  if (vd->bpc == 2)
+  {
+    max = 65535.0f;
+  }
+  else if (vd->bpc == 4)
+  {
+    min = vd->real[0];
+    max = vd->real[1];
+  }
+
+  float a = min + lo * (max - min);
+  float b = min + hi * (max - min);
+  setWindow((a + b) * 0.5f, b - a);
+}
+
+float Slicer::getLevel() const
+{
+  return level;
+}
+
+float Slicer::getWidth() const
+{
+  return width;
+}
+
+void Slicer::setSlab(Mode mode, size_t thickness)
+{
+  this->mode = mode;
+  this->thickness = std::max(thickness, size_t(1));
+}
+
+Slicer::Mode Slicer::getMode() const
+{
+  return mode;
+}
+
+size_t Slicer::getThickness() const
+{
+  return thickness;
+}
+
+void Slicer::setColors(const std::vector<uint8_t>& rgb)
+{
+  colors = rgb;
+  colors.resize(colors.size() / 3 * 3);
+}
+
+void Slicer::setColors(vvVolDesc* vd, size_t entries)
+{
+  colors.resize(std::max(entries, size_t(2)) * 3);
+
+  float range = 255.0f;
+  float offset = 0.0f;
+  if (vd->bpc == 2)
+  {
+    range = 65535.0f;
+  }
+  else if (vd->bpc == 4)
+  {
+    offset = vd->real[0];
+    range = vd->real[1] - vd->real[0];
+  }
+
+  size_t n = colors.size() / 3;
+  for (size_t i = 0; i < n; ++i)
+  {
+    float value = level - width * 0.5f + width * float(i) / float(n - 1);
+    vvColor c = vd->tf.computeColor((value - offset) / range);
+    for (int k = 0; k < 3; ++k)
+    {
+      colors[i * 3 + k] = uint8_t(std::min(std::max(c[k], 0.0f), 1.0f) * 255.0f);
+    }
+  }
+}
+
+size_t Slicer::getBytesPerPixel() const
+{
+  return colors.empty() ? 1 : 3;
+}
+
+void Slicer::sample(const vvVolDesc* vd, size_t frame, size_t channel, const Plane& plane,
+                    size_t width, size_t height, uint8_t* dst)
+{
+  vvDebugMsg::msg(3, "Slicer::sample()");
+
+  const uint8_t* raw = vd->getRaw(frame);
+  if (raw == NULL || vd->vox[0] * vd->vox[1] * vd->vox[2] == 0 || channel >= vd->chan
+   || (vd->bpc != 1 && vd->bpc != 2 && vd->bpc != 4))
+  {
+    memset(dst, 0, width * height * getBytesPerPixel());
+    return;
+  }
+
+  SliceParams p;
+  p.raw = raw + channel * vd->bpc;
+  p.bpc = vd->bpc;
+  p.stride[0] = ptrdiff_t(vd->getBPV());
+  p.stride[1] = p.stride[0] * ptrdiff_t(vd->vox[0]);
+  p.stride[2] = p.stride[1] * ptrdiff_t(vd->vox[1]);
+  for (int a = 0; a < 3; ++a)
+  {
+    p.step[a] = vd->vox[a] > 1 ? p.stride[a] : 0;
+    p.base[a] = std::max(int(vd->vox[a]) - 2, 0);
+    p.extent[a] = float(vd->vox[a] - 1);
+  }
+  p.plane = plane;
+  p.normal = plane.u;
+  p.normal.cross(plane.v);
+  if (p.normal.length() > 0.0f)
+  {
+    p.normal.normalize();
+  }
+  p.samples = mode == Single ? 1 : thickness;
+  p.mode = mode;
+  p.lo = level - this->width * 0.5f;
+  p.scale = this->width != 0.0f ? 1.0f / this->width : FLT_MAX;
+  p.colors = colors.empty() ? NULL : &colors[0];
+  p.entries = colors.size() / 3;
+  p.width = width;
+  p.dst = dst;
+
+  // small images are not worth waking up the pool
+  size_t bands = std::min(height, size_t(pool->size()) * 4);
+  if (width * height * p.samples < 16384 || bands <= 1)
+  {
+    sampleRows(p, 0, height);
+    return;
+  }
+
+  std::vector<Job> jobs(bands);
+  for (size_t b = 0; b < bands; ++b)
+  {
+    jobs[b].params = &p;
+    jobs[b].firstRow = height * b / bands;
+    jobs[b].lastRow = height * (b + 1) / bands;
+    pool->submit(run, &jobs[b]);
+  }
+  pool->wait();
+}
+
+void Slicer::run(void* param)
+{
+  Job* job = static_cast<Job*>(param);
+  sampleRows(*job->params, job->firstRow, job->lastRow);
+}
+
+} // namespace virvo
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
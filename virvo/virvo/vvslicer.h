@@ -0,0 +1,136 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef _VV_SLICER_H_
+#define _VV_SLICER_H_
+
+#include "vvexport.h"
+#include "vvinttypes.h"
+#include "vvvecmath.h"
+
+#include <stddef.h>
+#include <vector>
+
+class vvVolDesc;
+
+namespace virvo
+{
+
+class WorkerPool;
+
+//------------------------------------------------------------------------------
+// Slicer
+//
+// Multi-planar reformatting: samples arbitrary planes through a volume with
+// trilinear interpolation, optionally as a thick slab combined by maximum
+// intensity or average. Data values are mapped to the output by a
+// window/level, and optionally colored by a lookup table. Rows are
+// distributed over a worker pool and processed four pixels at a time with
+// SSE where available.
+//
+// A plane is given in voxel coordinates: pixel (i, j) of the image samples
+// the volume at origin + i * u + j * v. Slab samples are spaced one voxel
+// apart along the normal of the plane, centered on the plane.
+//
+//   virvo::Slicer slicer;
+//   virvo::Slicer::Plane plane = virvo::Slicer::axisPlane(vd, vvVecmath::Z_AXIS, 10);
+//   slicer.setWindow(vd, 0.0f, 1.0f);
+//   slicer.sample(vd, frame, 0, plane, vd->vox[0], vd->vox[1], image);
+//
+class VVAPI Slicer
+{
+public:
+  enum Mode
+  {
+    Single,           ///< the plane only
+    MaxIntensity,     ///< maximum over the slab
+    Average           ///< average over the slab
+  };
+
+  struct Plane
+  {
+    vvVector3 origin;   ///< position of pixel (0, 0) [voxels]
+    vvVector3 u;        ///< step from one pixel to the next in a row [voxels]
+    vvVector3 v;        ///< step from one row to the next [voxels]
+  };
+
+  /// Returns the plane of an axis aligned slice, with the image size and
+  /// orientation of vvVolDesc::makeSliceImage()
+  static Plane axisPlane(const vvVolDesc* vd, vvVecmath::AxisType axis, size_t slice);
+
+  /// Start numThreads threads, or one per processor if numThreads <= 0
+  explicit Slicer(int numThreads = 0);
+  ~Slicer();
+
+  /// Data values in [level - width/2, level + width/2] are mapped to the
+  /// output range. Values are given as stored: 0..255 for 1 byte, 0..65535
+  /// for 2 byte and floats for 4 byte voxels.
+  void setWindow(float level, float width);
+
+  /// Window covering the fraction [lo, hi] of the data range of vd: the
+  /// integer range for 1 and 2 byte voxels, vd->real for floats
+  void setWindow(const vvVolDesc* vd, float lo, float hi);
+
+  float getLevel() const;
+  float getWidth() const;
+
+  /// Combine thickness voxels along the plane normal with mode
+  void setSlab(Mode mode, size_t thickness);
+
+  Mode getMode() const;
+  size_t getThickness() const;
+
+  /// Color the windowed values with an RGB table, the output then has 3
+  /// bytes per pixel. An empty table gives 8 bit gray values.
+  void setColors(const std::vector<uint8_t>& rgb);
+
+  /// Set the colors to the transfer function of vd, sampled over the window
+  void setColors(vvVolDesc* vd, size_t entries = 256);
+
+  /// Bytes per output pixel, 1 or 3
+  size_t getBytesPerPixel() const;
+
+  /// Sample a width x height image of a channel of a frame into dst, which
+  /// must hold width * height * getBytesPerPixel() bytes. Pixels without
+  /// samples inside the volume are black.
+  void sample(const vvVolDesc* vd, size_t frame, size_t channel, const Plane& plane,
+              size_t width, size_t height, uint8_t* dst);
+
+private:
+  struct Job;
+
+  WorkerPool* pool;
+  float level;
+  float width;
+  Mode mode;
+  size_t thickness;
+  std::vector<uint8_t> colors;
+
+  static void run(void* param);
+
+  // NOT copyable!
+  Slicer(Slicer const&);
+  Slicer& operator=(Slicer const&);
+};
+
+} // namespace virvo
+
+#endif
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
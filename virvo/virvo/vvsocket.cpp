@@ -23,6 +23,9 @@
 
 #include "vvsocket.h"
 #include "vvdebugmsg.h"
+#include "vvtrace.h"
+
+#include "private/vvmessagebuffers.h"
 
 #ifndef _WIN32
 #include <signal.h>
@@ -60,6 +63,7 @@ namespace
 vvSocket::vvSocket()
   : _sockfd(VV_INVALID_SOCKET)
   , _sockBuffsize(-1)
+  , _messageBuffers(NULL)
 {
   _bufflen = sizeof(_sendBuffsize);
 #ifdef _WIN32
@@ -71,6 +75,8 @@ vvSocket::vvSocket()
 /// Destructor
 vvSocket::~vvSocket()
 {
+  delete _messageBuffers;
+
   if (_sockfd == VV_INVALID_SOCKET)
     return;
 
@@ -157,6 +163,23 @@ vvSocket::ErrorType vvSocket::setParameter(const SocketOption so, const float va
   case VV_BUFFSIZE:
     _sockBuffsize=(int)value;
     break;
+  case VV_RECV_TIMEOUT:
+    {
+#ifdef _WIN32
+      DWORD tv = (DWORD)(value * 1000.0f);
+#else
+      struct timeval tv;
+      tv.tv_sec = (long)value;
+      tv.tv_usec = (long)((value - (float)tv.tv_sec) * 1000000.0f);
+#endif
+      if (setsockopt(_sockfd, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(tv)))
+      {
+        vvDebugMsg::msg(1, "vvSocket::setSocketOption() error: setsockopt()");
+        return VV_SOCKOPT_ERROR;
+      }
+      return VV_OK;
+    }
+    break;
     default:
     vvDebugMsg::msg(1, "vvSocket::setSocketOption() Unknown SocketOption-value-combination");
     break;
@@ -383,6 +406,8 @@ vvSocket::ErrorType vvSocket::readData(uchar* dataptr, size_t size, ssize_t *ret
     vvDebugMsg::msg(0, errmsg.str().c_str());
   }
 
+  virvo::trace::bytesReceived.add(long(s));
+
   if(ret) *ret = s;
   return VV_OK;
 }
@@ -411,10 +436,49 @@ vvSocket::ErrorType vvSocket::writeData(const uchar* dataptr, size_t size, ssize
     vvDebugMsg::msg(0, errmsg.str().c_str());
   }
 
+  virvo::trace::bytesSent.add(long(s));
+
   if(ret) *ret = s;
   return VV_OK;
 }
 
+//----------------------------------------------------------------------------
+/** Function to write several buffers to the socket. Sockets supporting
+ gather writes send all buffers with as few system calls as possible.
+ @param buffers  buffers to write, empty buffers are skipped.
+ @param count  number of buffers.
+  */
+vvSocket::ErrorType vvSocket::writeBuffers(const Buffer* buffers, size_t count)
+{
+  ssize_t s;
+
+  s = writevn(buffers, count);
+
+  if (s == -1)
+  {
+    vvDebugMsg::msg(1, "vvSocket::writeBuffers(): Writing data failed, writevn()");
+    return VV_WRITE_ERROR;
+  }
+  if(vvDebugMsg::getDebugLevel() >= 3)
+  {
+    std::ostringstream errmsg;
+    errmsg << "Sending " << s << " Bytes of Data";
+    vvDebugMsg::msg(0, errmsg.str().c_str());
+  }
+
+  virvo::trace::bytesSent.add(long(s));
+
+  return VV_OK;
+}
+
+//----------------------------------------------------------------------------
+virvo::MessageBuffers* vvSocket::getMessageBuffers()
+{
+  if (_messageBuffers == NULL)
+    _messageBuffers = new virvo::MessageBuffers;
+  return _messageBuffers;
+}
+
 //----------------------------------------------------------------------------
 /** Returns the number of bytes currently in the socket receive buffer.
  */
@@ -687,6 +751,29 @@ vvSocket::ErrorType vvSocket::write(const uchar* dataptr, size_t size)
   return VV_OK;
 }
 
+//----------------------------------------------------------------------------
+/** Writes several buffers to the socket, one writen() call per buffer.
+ Sockets supporting gather writes override this.
+ @return number of bytes written, -1 on error
+*/
+ssize_t vvSocket::writevn(const Buffer* buffers, size_t count)
+{
+  ssize_t total = 0;
+
+  for (size_t i=0; i<count; ++i)
+  {
+    if (buffers[i].size == 0)
+      continue;
+
+    if (writen((const char*)buffers[i].data, buffers[i].size) == -1)
+      return (ssize_t)-1;
+
+    total += buffers[i].size;
+  }
+
+  return total;
+}
+
 //----------------------------------------------------------------------------
 /** Server for Measurement of the bandwidth-delay-product. Socket
  buffers are set to the measured BDP if BDP is larger than default buffer sizes.
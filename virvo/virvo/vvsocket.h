@@ -61,13 +61,19 @@ typedef int vvsock_t;
 #define VV_INVALID_SOCKET (-1)
 #endif
 
+namespace virvo
+{
+  struct MessageBuffers;
+}
+
 //----------------------------------------------------------------------------
 /** This abstract class provides basic socket functionality. It is used for
     TCP and UDP sockets. For example code see documentation about vvSocket<BR>
 
     For timeout-support set Socket to non-blocking with
     setParameter(VV_NONBLOCKING, true) and use vvSocketMonitor (or select() by
-    hand) for event and timeout-handling
+    hand) for event and timeout-handling, or limit the time blocking reads
+    wait for data with setParameter(VV_RECV_TIMEOUT, seconds)
 */
 class VIRVOEXPORT vvSocket
 {
@@ -104,7 +110,14 @@ public:
     VV_NONBLOCKING,
     VV_NO_NAGLE,
     VV_LINGER,
-    VV_BUFFSIZE
+    VV_BUFFSIZE,
+    VV_RECV_TIMEOUT         ///< max. time [s] a read waits for data, then it fails with VV_READ_ERROR. 0 = no limit
+  };
+
+  struct Buffer             /// one part of a gather write
+  {
+    const uchar* data;
+    size_t size;
   };
 
   vvSocket();
@@ -129,8 +142,14 @@ public:
 
   virtual ErrorType readData (      uchar *dataptr, size_t size, ssize_t *ret = NULL);
   virtual ErrorType writeData(const uchar *dataptr, size_t size, ssize_t *ret = NULL);
+  ErrorType writeBuffers(const Buffer* buffers, size_t count);
+
+  /** Framing state of vvSocketIO, shared by all vvSocketIO objects
+    using this socket. Created on first use.
+    */
+  virvo::MessageBuffers* getMessageBuffers();
 
-  int isDataWaiting() const;
+  virtual int isDataWaiting() const;
   void setSockfd(vvsock_t fd);
   vvsock_t  getSockfd() const;
   int getRecvBuffsize();
@@ -151,6 +170,7 @@ protected:
 
   virtual ssize_t readn (char*,       size_t) = 0;
   virtual ssize_t writen(const char*, size_t) = 0;
+  virtual ssize_t writevn(const Buffer*, size_t);
 
   int measureBdpServer();
   int measureBdpClient();
@@ -175,6 +195,13 @@ protected:
 
   socklen_t _hostAddrLen;
   socklen_t _bufflen;
+
+private:
+  virvo::MessageBuffers* _messageBuffers;
+
+  // NOT copyable!
+  vvSocket(vvSocket const&);
+  vvSocket& operator=(vvSocket const&);
 };
 
 //----------------------------------------------------------------------------
@@ -22,22 +22,138 @@
 #include "vvibrimage.h"
 #include "vvinttypes.h"
 #include "vvvoldesc.h"
+#include "vvvolumeupload.h"
 #include "vvdebugmsg.h"
 #include "vvmulticast.h"
+#include "vvtcpsocket.h"
 #include "vvtoolshed.h"
+#include "vvtrace.h"
+#include "vvworkerpool.h"
 
+#include "private/vvcompress.h"
 #include "private/vvgltools.h"
 #include "private/vvimage.h"
 #include "private/vvibrimage.h"
+#include "private/vvmessagebuffers.h"
+#include "private/vvshmchannel.h"
 
 //#ifdef VV_DEBUG_MEMORY
 //#include <crtdbg.h>
 //#define new new(_NORMAL_BLOCK,__FILE__, __LINE__)
 //#endif
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <sstream>
 #include <string>
 
+namespace
+{
+
+// Payloads smaller than this are copied into the message buffer, larger
+// payloads are sent directly from the caller's memory with writev()
+const size_t MaxCopySize = 4096;
+
+// Maximum payload of a single frame
+const size_t MaxFrameSize = 1 << 30;
+
+// Frame data is received in chunks of this size, reads of at least this
+// size go directly to the caller's memory
+const size_t RecvChunkSize = 65536;
+
+// Read exactly size bytes
+vvSocket::ErrorType readFully(vvSocket* socket, uchar* data, size_t size)
+{
+  ssize_t s = 0;
+  vvSocket::ErrorType err = socket->readData(data, size, &s);
+  if (err == vvSocket::VV_OK && s != (ssize_t)size)
+    return vvSocket::VV_PEER_SHUTDOWN;
+  return err;
+}
+
+struct VolumeChunk
+{
+  size_t frame;
+  size_t index;
+  const uchar* raw;
+  const uchar* previous;    // same chunk of the previous frame, NULL for frame 0
+  size_t size;
+  std::vector<uchar> data;  // compressed data
+  bool compressed;
+  bool delta;               // data is the XOR with previous
+};
+
+void compressVolumeChunk(void* param)
+{
+  VV_TRACE_ZONE("compress chunk");
+
+  VolumeChunk* chunk = static_cast<VolumeChunk*>(param);
+  chunk->delta = false;
+
+  // Slowly changing time steps are mostly zero after the XOR with the
+  // previous frame. Keep the delta if it is clearly smaller, otherwise
+  // compare with the plain encoding.
+  std::vector<uchar> delta;
+  if (chunk->previous != NULL)
+  {
+    std::vector<uchar> diff(chunk->size);
+    virvo::xorDelta(chunk->raw, chunk->previous, chunk->size, &diff[0]);
+    if (!virvo::compress(&diff[0], diff.size(), delta))
+    {
+      delta.clear();
+    }
+    else if (delta.size() < chunk->size / 2)
+    {
+      chunk->data.swap(delta);
+      chunk->compressed = true;
+      chunk->delta = true;
+      return;
+    }
+  }
+
+  chunk->compressed = virvo::compress(chunk->raw, chunk->size, chunk->data)
+                   && chunk->data.size() < chunk->size;
+  if (!delta.empty() && delta.size() < chunk->size
+   && (!chunk->compressed || delta.size() < chunk->data.size()))
+  {
+    chunk->data.swap(delta);
+    chunk->compressed = true;
+    chunk->delta = true;
+  }
+  if (!chunk->compressed)
+    std::vector<uchar>().swap(chunk->data);
+}
+
+// Queue compression of the chunks [first..min(first+count, end)) of vd
+// @return index of the first chunk not queued
+size_t submitVolumeChunks(virvo::WorkerPool* pool, const vvVolDesc* vd,
+                          size_t first, size_t end, size_t count,
+                          std::vector<VolumeChunk>& chunks)
+{
+  const size_t chunksPerFrame = virvo::VolumeUpload::getChunksPerFrame(vd);
+  const size_t frameBytes = vd->getFrameBytes();
+
+  chunks.resize(std::min(count, end - std::min(first, end)));
+  for (size_t i=0; i<chunks.size(); ++i)
+  {
+    VolumeChunk& chunk = chunks[i];
+    chunk.frame = (first + i) / chunksPerFrame;
+    chunk.index = (first + i) % chunksPerFrame;
+    chunk.raw = vd->getRaw(chunk.frame) + chunk.index * virvo::VolumeUpload::ChunkSize;
+    chunk.previous = chunk.frame > 0
+                   ? vd->getRaw(chunk.frame - 1) + chunk.index * virvo::VolumeUpload::ChunkSize
+                   : NULL;
+    chunk.size = std::min(virvo::VolumeUpload::ChunkSize, frameBytes - chunk.index * virvo::VolumeUpload::ChunkSize);
+    chunk.compressed = false;
+    chunk.delta = false;
+    pool->submit(compressVolumeChunk, &chunk);
+  }
+  return first + chunks.size();
+}
+
+} // namespace
+
 //----------------------------------------------------------------------------
 /** Constructor
  @param sock ready to use socket of type vvSocket
@@ -53,6 +169,208 @@ vvSocketIO::~vvSocketIO()
 {
 }
 
+//----------------------------------------------------------------------------
+/** Start a message. All data put until the matching endMessage() is sent
+  as one frame with a single system call. Messages may be nested, only the
+  outermost endMessage() sends data. Large payloads are not copied and are
+  sent when they are put, together with the data collected before them.
+  Do not wait for a reply while a message is open.
+*/
+void vvSocketIO::beginMessage() const
+{
+  if (_socket)
+  {
+    ++_socket->getMessageBuffers()->depth;
+  }
+}
+
+//----------------------------------------------------------------------------
+/** End a message started with beginMessage().
+  @return error from sending the message
+*/
+vvSocket::ErrorType vvSocketIO::endMessage() const
+{
+  if (_socket)
+  {
+    return finishMessage(vvSocket::VV_OK);
+  }
+  else
+  {
+    return vvSocket::VV_SOCK_ERROR;
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Returns true if data was received from the socket but not consumed yet.
+  Such data does not trigger socket monitors.
+*/
+bool vvSocketIO::hasBufferedData() const
+{
+  if (_socket)
+  {
+    const virvo::MessageBuffers* mb = _socket->getMessageBuffers();
+    return mb->recvPos < mb->recvBuffer.size();
+  }
+  else
+  {
+    return false;
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Returns true if data can be read without waiting for the peer: it was
+  either received already or is waiting on the socket.
+*/
+bool vvSocketIO::hasPendingData() const
+{
+  return hasBufferedData() || (_socket && _socket->isDataWaiting() > 0);
+}
+
+//----------------------------------------------------------------------------
+/** Ends a message, sends the collected data if the outermost message ends.
+  If err is not VV_OK, the collected data is discarded.
+*/
+vvSocket::ErrorType vvSocketIO::finishMessage(vvSocket::ErrorType err) const
+{
+  virvo::MessageBuffers* mb = _socket->getMessageBuffers();
+  assert(mb->depth > 0);
+
+  if (--mb->depth > 0)
+  {
+    return err;
+  }
+
+  if (err == vvSocket::VV_OK)
+  {
+    return flush(NULL, 0);
+  }
+
+  mb->sendBuffer.clear();
+  return err;
+}
+
+//----------------------------------------------------------------------------
+/** Sends the collected data followed by size bytes from data. Data is split
+  into frames of at most MaxFrameSize bytes, each frame is written with a
+  single call to vvSocket::writeBuffers().
+*/
+vvSocket::ErrorType vvSocketIO::flush(const uchar* data, size_t size) const
+{
+  std::vector<uchar>& pending = _socket->getMessageBuffers()->sendBuffer;
+
+  vvSocket::ErrorType err = vvSocket::VV_OK;
+  size_t pendingSize = pending.size();
+
+  while (err == vvSocket::VV_OK && pendingSize + size > 0)
+  {
+    size_t n = std::min(size, MaxFrameSize - pendingSize);
+
+    uchar header[4];
+    vvToolshed::write32(header, uint32_t(pendingSize + n));
+
+    vvSocket::Buffer buffers[3] =
+    {
+      { header, 4 },
+      { pendingSize > 0 ? &pending[0] : NULL, pendingSize },
+      { data, n }
+    };
+    err = _socket->writeBuffers(buffers, 3);
+
+    pendingSize = 0;
+    data += n;
+    size -= n;
+  }
+
+  pending.clear();
+  return err;
+}
+
+//----------------------------------------------------------------------------
+/** Write data as part of the current message. Outside of a message the data
+  is sent immediately.
+*/
+vvSocket::ErrorType vvSocketIO::write(const uchar* data, size_t size) const
+{
+  virvo::MessageBuffers* mb = _socket->getMessageBuffers();
+
+  if (size >= MaxCopySize || mb->sendBuffer.size() + size > MaxFrameSize)
+  {
+    return flush(data, size);
+  }
+
+  mb->sendBuffer.insert(mb->sendBuffer.end(), data, data + size);
+
+  if (mb->depth == 0)
+  {
+    return flush(NULL, 0);
+  }
+  return vvSocket::VV_OK;
+}
+
+//----------------------------------------------------------------------------
+/** Read data from the frames sent by the peer. Frame boundaries are ignored,
+  so a read may span several frames.
+*/
+vvSocket::ErrorType vvSocketIO::read(uchar* data, size_t size) const
+{
+  virvo::MessageBuffers* mb = _socket->getMessageBuffers();
+  vvSocket::ErrorType err = vvSocket::VV_OK;
+
+  while (size > 0)
+  {
+    size_t available = mb->recvBuffer.size() - mb->recvPos;
+
+    if (available > 0)
+    {
+      size_t n = std::min(size, available);
+      memcpy(data, &mb->recvBuffer[mb->recvPos], n);
+      mb->recvPos += n;
+      data += n;
+      size -= n;
+
+      if (mb->recvPos == mb->recvBuffer.size())
+      {
+        mb->recvBuffer.clear();
+        mb->recvPos = 0;
+      }
+    }
+    else if (mb->frameLeft == 0)
+    {
+      uchar header[4];
+      if ((err = readFully(_socket, header, 4)) != vvSocket::VV_OK)
+      {
+        return err;
+      }
+      mb->frameLeft = vvToolshed::read32(header);
+    }
+    else if (size >= mb->frameLeft || size >= RecvChunkSize)
+    {
+      size_t n = std::min(size, mb->frameLeft);
+      if ((err = readFully(_socket, data, n)) != vvSocket::VV_OK)
+      {
+        return err;
+      }
+      mb->frameLeft -= n;
+      data += n;
+      size -= n;
+    }
+    else
+    {
+      size_t n = std::min(mb->frameLeft, RecvChunkSize);
+      mb->recvBuffer.resize(n);
+      mb->recvPos = 0;
+      if ((err = readFully(_socket, &mb->recvBuffer[0], n)) != vvSocket::VV_OK)
+      {
+        mb->recvBuffer.clear();
+        return err;
+      }
+      mb->frameLeft -= n;
+    }
+  }
+
+  return err;
+}
+
 //----------------------------------------------------------------------------
 /** Checks if there is data in the socket receive buffer.
  @return  true for data in the socket receive buffer, false for not.
@@ -61,7 +379,7 @@ bool vvSocketIO::sock_action()
 {
   if(_socket)
   {
-    if (_socket->isDataWaiting() > 0)
+    if (hasBufferedData() || _socket->isDataWaiting() > 0)
       return true;
     else
       return false;
@@ -91,6 +409,97 @@ vvSocket::ErrorType vvSocketIO::putEvent(const virvo::RemoteEvent event) const
   return putInt32((int32_t)event);
 }
 
+//----------------------------------------------------------------------------
+/** Offer the peer to continue the connection over shared memory. Only done
+  for TCP connections to the same host, unless disabled with the environment
+  variable VV_SHARED_MEMORY=0. Sends a virvo::SharedMemory event and waits
+  for the answer of acceptSharedMemory(). Afterwards all data goes through
+  the channel, the connection only carries wake-ups.
+  @return VV_OK also if shared memory is not used
+*/
+vvSocket::ErrorType vvSocketIO::requestSharedMemory() const
+{
+  vvTcpSocket* sock = dynamic_cast<vvTcpSocket*>(_socket);
+  if (sock == NULL || sock->getChannel() != NULL || !sock->isLocalPeer() || !virvo::ShmChannel::isEnabled())
+  {
+    return vvSocket::VV_OK;
+  }
+
+  virvo::ShmChannel* channel = virvo::ShmChannel::create(sock->getSockfd());
+  if (channel == NULL)
+  {
+    return vvSocket::VV_OK;
+  }
+
+  vvSocket::ErrorType err = vvSocket::VV_OK;
+  int accepted = 0;
+
+  beginMessage();
+  putEvent(virvo::SharedMemory);
+  putInt32(channel->getPid());
+  putInt32(channel->getHandle());
+  putInt32(int(channel->getCookie()));
+  putInt32(int(channel->getRingSize()));
+  if ((err = endMessage()) == vvSocket::VV_OK)
+  {
+    err = getInt32(accepted);
+  }
+
+  if (err == vvSocket::VV_OK && accepted)
+  {
+    vvDebugMsg::msg(1, "vvSocketIO::requestSharedMemory(): using shared memory");
+    channel->closeHandle();
+    sock->setChannel(channel);
+  }
+  else
+  {
+    delete channel;
+  }
+  return err;
+}
+
+//----------------------------------------------------------------------------
+/** Answer the request of a virvo::SharedMemory event. The connection switches
+  to shared memory if the segment of the peer can be opened.
+*/
+vvSocket::ErrorType vvSocketIO::acceptSharedMemory() const
+{
+  int pid = 0;
+  int handle = 0;
+  int cookie = 0;
+  int ringSize = 0;
+
+  vvSocket::ErrorType err = vvSocket::VV_OK;
+  if ((err = getInt32(pid)) != vvSocket::VV_OK
+   || (err = getInt32(handle)) != vvSocket::VV_OK
+   || (err = getInt32(cookie)) != vvSocket::VV_OK
+   || (err = getInt32(ringSize)) != vvSocket::VV_OK)
+  {
+    return err;
+  }
+
+  vvTcpSocket* sock = dynamic_cast<vvTcpSocket*>(_socket);
+  virvo::ShmChannel* channel = NULL;
+  if (sock != NULL && sock->getChannel() == NULL && sock->isLocalPeer() && virvo::ShmChannel::isEnabled() && ringSize > 0)
+  {
+    channel = virvo::ShmChannel::attach(sock->getSockfd(), pid, handle, uint32_t(cookie), size_t(ringSize));
+  }
+
+  // answer over the connection, then switch
+  if ((err = putInt32(channel != NULL)) != vvSocket::VV_OK)
+  {
+    delete channel;
+    return err;
+  }
+
+  if (channel != NULL)
+  {
+    vvDebugMsg::msg(1, "vvSocketIO::acceptSharedMemory(): using shared memory");
+    sock->setChannel(channel);
+  }
+  return vvSocket::VV_OK;
+}
+
 //----------------------------------------------------------------------------
 /** Get volume attributes from socket.
   @param vd  empty volume description which is to be filled with the volume attributes
@@ -104,7 +513,7 @@ vvSocket::ErrorType vvSocketIO::getVolumeAttributes(vvVolDesc* vd) const
     size_t size = vd->serializeAttributes();
 
     std::vector<uint8_t> buffer(size+4);
-    if ((retval =_socket->readData(&buffer[0], size+4)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], size+4)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -133,22 +542,28 @@ vvSocket::ErrorType vvSocketIO::getVolume(vvVolDesc* vd) const
     if(retval != vvSocket::VV_OK)
       return retval;
 
-    size_t size = vd->getFrameBytes();
+    virvo::VolumeUpload upload(vd);
+    if (!upload.initStatus())
+    {
+      upload.release();
+      return vvSocket::VV_ALLOC_ERROR;
+    }
 
-    for(size_t k =0; k< vd->frames; k++)
+    const size_t chunks = virvo::VolumeUpload::getNumChunks(vd);
+    for (size_t i=0; i<chunks && retval == vvSocket::VV_OK; ++i)
     {
-      uint8_t *buffer = new uint8_t[size];
-      if (!buffer)
-        return vvSocket::VV_ALLOC_ERROR;
-      if ((retval =_socket->readData(buffer, size)) != vvSocket::VV_OK)
-      {
-        delete[] buffer;
-        return retval;
-      }
-      vd->addFrame(buffer, vvVolDesc::ARRAY_DELETE);
+      retval = getVolumeChunk(upload);
     }
+
+    if (retval == vvSocket::VV_OK && !upload.wait())
+    {
+      vvDebugMsg::msg(1, "vvSocketIO::getVolume(): cannot decompress volume data");
+      retval = vvSocket::VV_DATA_ERROR;
+    }
+
+    upload.release();
     vvDebugMsg::msg(3, "Data received");
-    return vvSocket::VV_OK;
+    return retval;
   }
   else
   {
@@ -169,7 +584,7 @@ vvSocket::ErrorType vvSocketIO::putVolumeAttributes(const vvVolDesc* vd) const
     vd->serializeAttributes(&buffer[0]);
     vvToolshed::writeFloat(&buffer[size], vd->_scale);
     vvDebugMsg::msg(3, "Sending header ...");
-    return _socket->writeData(&buffer[0], size+4);
+    return write(&buffer[0], size+4);
   }
   else
   {
@@ -185,20 +600,82 @@ vvSocket::ErrorType vvSocketIO::putVolume(const vvVolDesc* vd) const
 {
   if(_socket)
   {
+    beginMessage();
+
     vvSocket::ErrorType retval = putVolumeAttributes(vd);
     if(retval != vvSocket::VV_OK)
-      return retval;
-
-    size_t frames = vd->frames;
+      return finishMessage(retval);
 
-    size_t size = vd->getFrameBytes();
     vvDebugMsg::msg(3, "Sending data ...");
 
-    for(size_t k=0; k < frames; k++)
+    return finishMessage(putVolumeChunks(vd, 0, virvo::VolumeUpload::getNumChunks(vd)));
+  }
+  else
+  {
+    return vvSocket::VV_SOCK_ERROR;
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Write chunks of volume data to socket. The chunks are compressed in
+  parallel, the next chunks are compressed while the previous ones are sent.
+  Chunks that do not get smaller are sent uncompressed. Chunks of later
+  frames are sent as the XOR with the previous frame if that compresses
+  better.
+  @param vd  volume description of volume to be send.
+  @param first  index of the first chunk, see virvo::VolumeUpload
+  @param count  number of chunks to send
+*/
+vvSocket::ErrorType vvSocketIO::putVolumeChunks(const vvVolDesc* vd, size_t first, size_t count) const
+{
+  if(_socket)
+  {
+    virvo::MessageBuffers* mb = _socket->getMessageBuffers();
+    if (mb->compressionPool == NULL)
     {
-      const uint8_t *buffer = vd->getRaw(k);
-      if ((retval =_socket->writeData(buffer, size)) != vvSocket::VV_OK)
+      mb->compressionPool = new virvo::WorkerPool(0, "compress");
+    }
+    virvo::WorkerPool* pool = mb->compressionPool;
+
+    const size_t end = std::min(first + count, virvo::VolumeUpload::getNumChunks(vd));
+    const size_t batchSize = 2 * std::max(pool->size(), 1);
+
+    std::vector<VolumeChunk> batches[2];
+    size_t next = submitVolumeChunks(pool, vd, first, end, batchSize, batches[0]);
+    pool->wait();
+
+    vvSocket::ErrorType retval = vvSocket::VV_OK;
+    for (int cur = 0; !batches[cur].empty(); cur ^= 1)
+    {
+      next = submitVolumeChunks(pool, vd, next, end, batchSize, batches[cur ^ 1]);
+
+      for (size_t i=0; i<batches[cur].size() && retval == vvSocket::VV_OK; ++i)
+      {
+        const VolumeChunk& chunk = batches[cur][i];
+        const uchar* data = chunk.compressed ? &chunk.data[0] : chunk.raw;
+        const size_t size = chunk.compressed ? chunk.data.size() : chunk.size;
+
+        beginMessage();
+        retval = putInt32(int(chunk.frame));
+        if (retval == vvSocket::VV_OK)
+          retval = putInt32(int(chunk.index));
+        if (retval == vvSocket::VV_OK)
+          retval = putInt32(int(chunk.size));
+        if (retval == vvSocket::VV_OK)
+          retval = putInt32(int(size));
+        if (retval == vvSocket::VV_OK)
+          retval = putInt32(chunk.delta ? 1 : 0);
+        if (retval == vvSocket::VV_OK)
+          retval = write(data, size);
+        retval = finishMessage(retval);
+      }
+
+      pool->wait();
+      batches[cur].clear();
+
+      if (retval != vvSocket::VV_OK)
       {
+        batches[cur ^ 1].clear();
         return retval;
       }
     }
@@ -210,6 +687,56 @@ vvSocket::ErrorType vvSocketIO::putVolume(const vvVolDesc* vd) const
   }
 }
 
+//----------------------------------------------------------------------------
+/** Get the next chunk of volume data from the socket. Compressed chunks are
+  decompressed by the upload while further chunks are read.
+  @param upload  volume the chunk is added to
+*/
+vvSocket::ErrorType vvSocketIO::getVolumeChunk(virvo::VolumeUpload& upload) const
+{
+  if(_socket)
+  {
+    int header[5]; // frame, index, raw size, transferred size, encoding
+    for (int i=0; i<5; ++i)
+    {
+      vvSocket::ErrorType retval = getInt32(header[i]);
+      if (retval != vvSocket::VV_OK)
+        return retval;
+      if (header[i] < 0)
+        return vvSocket::VV_DATA_ERROR;
+    }
+
+    // The sizes come from the peer, check them before allocating
+    const size_t rawSize = size_t(header[2]);
+    const size_t size = size_t(header[3]);
+    if (rawSize > virvo::VolumeUpload::ChunkSize || size > virvo::maxCompressedSize(rawSize))
+    {
+      vvDebugMsg::msg(1, "vvSocketIO::getVolumeChunk(): invalid chunk size");
+      return vvSocket::VV_DATA_ERROR;
+    }
+
+    std::vector<uchar> data(size);
+    if (!data.empty())
+    {
+      vvSocket::ErrorType retval = read(&data[0], data.size());
+      if (retval != vvSocket::VV_OK)
+        return retval;
+    }
+
+    if (header[4] > 1
+     || !upload.addChunk(header[0], header[1], data, header[2], header[4] == 1))
+    {
+      vvDebugMsg::msg(1, "vvSocketIO::getVolumeChunk(): unexpected chunk");
+      return vvSocket::VV_DATA_ERROR;
+    }
+    return vvSocket::VV_OK;
+  }
+  else
+  {
+    return vvSocket::VV_SOCK_ERROR;
+  }
+}
+
 //----------------------------------------------------------------------------
 /** Get a transfer function from the socket.
   @param tf  pointer to a vvTransFunc.
@@ -229,7 +756,7 @@ vvSocket::ErrorType vvSocketIO::getTransferFunction(vvTransFunc& tf) const
     }
 
     buffer = new uchar[len+1];
-    if ((retval =_socket->readData(buffer, len)) != vvSocket::VV_OK)
+    if ((retval =read(buffer, len)) != vvSocket::VV_OK)
     {
       delete[] buffer;
       return retval;
@@ -288,6 +815,8 @@ vvSocket::ErrorType vvSocketIO::putTransferFunction(vvTransFunc& tf) const
 {
   if(_socket)
   {
+    beginMessage();
+
     uchar* buffer = NULL;
     vvSocket::ErrorType retval;
 
@@ -305,14 +834,14 @@ vvSocket::ErrorType vvSocketIO::putTransferFunction(vvTransFunc& tf) const
 
     putInt32((int)len);
 
-    if ((retval =_socket->writeData(buffer, len)) != vvSocket::VV_OK)
+    if ((retval =write(buffer, len)) != vvSocket::VV_OK)
     {
       delete[] buffer;
-      return retval;
+      return finishMessage(retval);
     }
 
     delete[] buffer;
-    return vvSocket::VV_OK;
+    return finishMessage(vvSocket::VV_OK);
   }
   else
   {
@@ -328,14 +857,14 @@ vvSocket::ErrorType vvSocketIO::getImage(vvImage* im) const
 {
   if(_socket)
   {
-    const size_t BUFSIZE = 13;
+    const size_t BUFSIZE = 17 + 4 * vvImage::VV_NUM_SERVER_STAGES;
     uchar buffer[BUFSIZE];
     vvSocket::ErrorType retval;
     short w, h;
     int imagesize;
     int videosize;
 
-    if ((retval =_socket->readData(&buffer[0], BUFSIZE)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], BUFSIZE)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -344,7 +873,15 @@ vvSocket::ErrorType vvSocketIO::getImage(vvImage* im) const
     h = vvToolshed::read16(&buffer[0]);
 
     vvImage::CodeType ct = (vvImage::CodeType)vvToolshed::read8(&buffer[4]);
-    if (h != im->getHeight() || w  != im->getWidth() || ct != im->getCodeType() )
+
+    // tiles are applied to the previous image, keep it
+    bool keep = ct == vvImage::VV_TILES && h == im->getHeight() && w == im->getWidth()
+        && im->getImagePtr() != NULL && im->getImagePtr() != im->getCodedImage();
+    if (keep)
+    {
+      im->setCodeType(ct);
+    }
+    else if (h != im->getHeight() || w  != im->getWidth() || ct != im->getCodeType() )
     {
       im->setCodeType(ct);
       im->setHeight(h);
@@ -356,16 +893,22 @@ vvSocket::ErrorType vvSocketIO::getImage(vvImage* im) const
     videosize = (int)vvToolshed::read32(&buffer[9]);
     im->setSize(imagesize);
     im->setVideoSize(videosize);
+    im->setFrameId((int)vvToolshed::read32(&buffer[13]));
+    for (int i=0; i<vvImage::VV_NUM_SERVER_STAGES; ++i)
+    {
+      // microseconds
+      im->setStageTime((vvImage::ServerStage)i, float(vvToolshed::read32(&buffer[17 + 4 * i])) * 1e-6f);
+    }
     if (vvDebugMsg::isActive(3))
       fprintf(stderr, "imgsize=%d, videosize=%d\n", imagesize, videosize);
-    if ((retval =_socket->readData(im->getCodedImage(), imagesize)) != vvSocket::VV_OK)
+    if ((retval =read(im->getCodedImage(), imagesize)) != vvSocket::VV_OK)
     {
       return retval;
     }
     vvDebugMsg::msg(3, "Image data received");
     if (ct == vvImage::VV_VIDEO)
     {
-      if ((retval =_socket->readData(im->getVideoCodedImage(), videosize)) != vvSocket::VV_OK)
+      if ((retval =read(im->getVideoCodedImage(), videosize)) != vvSocket::VV_OK)
       {
         return retval;
       }
@@ -387,7 +930,9 @@ vvSocket::ErrorType vvSocketIO::putImage(const vvImage* im) const
 {
   if(_socket)
   {
-    const int BUFSIZE = 13;
+    beginMessage();
+
+    const int BUFSIZE = 17 + 4 * vvImage::VV_NUM_SERVER_STAGES;
     uchar buffer[BUFSIZE];
     vvSocket::ErrorType retval;
     int imagesize;
@@ -401,26 +946,32 @@ vvSocket::ErrorType vvSocketIO::putImage(const vvImage* im) const
     vvToolshed::write8(&buffer[4], (uchar)ct);
     vvToolshed::write32(&buffer[5], (ulong)imagesize);
     vvToolshed::write32(&buffer[9], (ulong)videosize);
+    vvToolshed::write32(&buffer[13], (ulong)im->getFrameId());
+    for (int i=0; i<vvImage::VV_NUM_SERVER_STAGES; ++i)
+    {
+      const float t = im->getStageTime((vvImage::ServerStage)i);
+      vvToolshed::write32(&buffer[17 + 4 * i], (ulong)(t > 0.0f ? t * 1e6f + 0.5f : 0.0f));
+    }
 
     vvDebugMsg::msg(3, "Sending header ...");
-    if ((retval =_socket->writeData(&buffer[0], BUFSIZE)) != vvSocket::VV_OK)
+    if ((retval =write(&buffer[0], BUFSIZE)) != vvSocket::VV_OK)
     {
-      return retval;
+      return finishMessage(retval);
     }
     vvDebugMsg::msg(3, "Sending image data ...");
-    if ((retval =_socket->writeData(im->getImagePtr(), imagesize)) != vvSocket::VV_OK)
+    if ((retval =write(im->getImagePtr(), imagesize)) != vvSocket::VV_OK)
     {
-      return retval;
+      return finishMessage(retval);
     }
     if (ct == vvImage::VV_VIDEO)
     {
       vvDebugMsg::msg(3, "Sending video image data ...");
-      if ((retval =_socket->writeData(im->getVideoCodedImage(), videosize)) != vvSocket::VV_OK)
+      if ((retval =write(im->getVideoCodedImage(), videosize)) != vvSocket::VV_OK)
       {
-        return retval;
+        return finishMessage(retval);
       }
     }
-    return vvSocket::VV_OK;
+    return finishMessage(vvSocket::VV_OK);
   }
   else
   {
@@ -508,31 +1059,33 @@ vvSocket::ErrorType vvSocketIO::putIbrImage(const vvIbrImage* im) const
 {
   if(_socket)
   {
+    beginMessage();
+
     vvSocket::ErrorType err = putImage(im);
     if (err != vvSocket::VV_OK)
     {
-      return err;
+      return finishMessage(err);
     }
 
     vvMatrix pm = im->getProjectionMatrix();
     err = putMatrix(&pm);
     if (err != vvSocket::VV_OK)
     {
-      return err;
+      return finishMessage(err);
     }
 
     vvMatrix mv = im->getModelViewMatrix();
     err = putMatrix(&mv);
     if (err != vvSocket::VV_OK)
     {
-      return err;
+      return finishMessage(err);
     }
 
     virvo::Viewport vp = im->getViewport();
     err = putViewport(vp);
     if (err != vvSocket::VV_OK)
     {
-      return err;
+      return finishMessage(err);
     }
 
     float drMin = 0.f, drMax = 0.f;
@@ -540,39 +1093,39 @@ vvSocket::ErrorType vvSocketIO::putIbrImage(const vvIbrImage* im) const
     err = putFloat(drMin);
     if (err != vvSocket::VV_OK)
     {
-      return err;
+      return finishMessage(err);
     }
     err = putFloat(drMax);
     if (err != vvSocket::VV_OK)
     {
-      return err;
+      return finishMessage(err);
     }
 
     err = putInt32(im->getDepthPrecision());
     if (err != vvSocket::VV_OK)
     {
-      return err;
+      return finishMessage(err);
     }
 
     err = putInt32(im->getDepthCodetype());
     if (err != vvSocket::VV_OK)
     {
-      return err;
+      return finishMessage(err);
     }
 
     err = putInt32(im->getDepthSize());
     if (err != vvSocket::VV_OK)
     {
-      return err;
+      return finishMessage(err);
     }
 
     err = putData(im->getCodedDepth(), im->getDepthSize(), vvSocketIO::VV_UCHAR);
     if (err != vvSocket::VV_OK)
     {
-      return err;
+      return finishMessage(err);
     }
 
-    return vvSocket::VV_OK;
+    return finishMessage(vvSocket::VV_OK);
   }
   else
   {
@@ -591,14 +1144,14 @@ vvSocket::ErrorType vvSocketIO::getFileName(std::string& fn) const
     vvSocket::ErrorType retval;
 
     uchar sizebuf[4];
-    if ((retval =_socket->readData(sizebuf, 4)) != vvSocket::VV_OK)
+    if ((retval =read(sizebuf, 4)) != vvSocket::VV_OK)
     {
       return retval;
     }
     size_t len = vvToolshed::read32(sizebuf);
 
     std::vector<uchar> buf(len);
-    if ((retval =_socket->readData(&buf[0], len)) != vvSocket::VV_OK)
+    if ((retval =read(&buf[0], len)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -621,18 +1174,20 @@ vvSocket::ErrorType vvSocketIO::putFileName(const std::string& fn) const
 {
   if (_socket != NULL)
   {
+    beginMessage();
+
     vvSocket::ErrorType retval;
 
     uchar sizebuf[4];
     vvToolshed::write32(sizebuf, fn.length());
 
-    if ((retval = _socket->writeData(sizebuf, 4)) != vvSocket::VV_OK)
+    if ((retval = write(sizebuf, 4)) != vvSocket::VV_OK)
     {
-      return retval;
+      return finishMessage(retval);
     }
 
     uchar* buf = (uchar*)fn.data();
-    return _socket->writeData(buf, fn.length());
+    return finishMessage(write(buf, fn.length()));
   }
   else
   {
@@ -655,14 +1210,14 @@ vvSocket::ErrorType vvSocketIO::allocateAndGetData(uchar** data, int& size) cons
 
     *data = NULL; // make it safe to delete[] *data
 
-    if ((retval =_socket->readData(&buffer[0], 4)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], 4)) != vvSocket::VV_OK)
     {
       return retval;
     }
     vvDebugMsg::msg(3, "Header received");
     size = (int)vvToolshed::read32(&buffer[0]);
     *data = new uchar[size];                        // delete buffer outside!!!
-    if ((retval =_socket->readData(*data, size)) != vvSocket::VV_OK)
+    if ((retval =read(*data, size)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -684,21 +1239,23 @@ vvSocket::ErrorType vvSocketIO::putData(uchar* data, int size) const
 {
   if(_socket)
   {
+    beginMessage();
+
     uchar buffer[4];
     vvSocket::ErrorType retval;
 
     vvToolshed::write32(&buffer[0], (ulong)size);
     vvDebugMsg::msg(3, "Sending header ...");
-    if ((retval =_socket->writeData(&buffer[0], 4)) != vvSocket::VV_OK)
+    if ((retval =write(&buffer[0], 4)) != vvSocket::VV_OK)
     {
-      return retval;
+      return finishMessage(retval);
     }
     vvDebugMsg::msg(3, "Sending data ...");
-    if ((retval =_socket->writeData(data, size)) != vvSocket::VV_OK)
+    if ((retval =write(data, size)) != vvSocket::VV_OK)
     {
-      return retval;
+      return finishMessage(retval);
     }
-    return vvSocket::VV_OK;
+    return finishMessage(vvSocket::VV_OK);
   }
   else
   {
@@ -727,7 +1284,7 @@ vvSocket::ErrorType vvSocketIO::getData(void* data, int number, DataType type) c
       case VV_UCHAR:
       {
         size = number;
-        if ((retval =_socket->readData((uint8_t*)data, size)) != vvSocket::VV_OK)
+        if ((retval =read((uint8_t*)data, size)) != vvSocket::VV_OK)
         {
           return retval;
         }
@@ -738,7 +1295,7 @@ vvSocket::ErrorType vvSocketIO::getData(void* data, int number, DataType type) c
         int tmp;
         size = number*2;
         buffer = new uint8_t[size];
-        if ((retval =_socket->readData(buffer, size)) != vvSocket::VV_OK)
+        if ((retval =read(buffer, size)) != vvSocket::VV_OK)
         {
           delete[] buffer;
           return retval;
@@ -756,7 +1313,7 @@ vvSocket::ErrorType vvSocketIO::getData(void* data, int number, DataType type) c
         int tmp;
         size = number*4;
         buffer = new uint8_t[size];
-        if ((retval =_socket->readData(buffer, size)) != vvSocket::VV_OK)
+        if ((retval =read(buffer, size)) != vvSocket::VV_OK)
         {
           delete[] buffer;
           return retval;
@@ -774,7 +1331,7 @@ vvSocket::ErrorType vvSocketIO::getData(void* data, int number, DataType type) c
         float tmp;
         size = number*4;
         buffer = new uint8_t[size];
-        if ((retval =_socket->readData(buffer, size)) != vvSocket::VV_OK)
+        if ((retval =read(buffer, size)) != vvSocket::VV_OK)
         {
           delete[] buffer;
           return retval;
@@ -864,7 +1421,7 @@ vvSocket::ErrorType vvSocketIO::putData(void* data, int number, DataType type) c
         vvDebugMsg::msg(0, "No supported data type");
         return vvSocket::VV_DATA_ERROR;
     }
-    if ((retval =_socket->writeData(buffer, size)) != vvSocket::VV_OK)
+    if ((retval =write(buffer, size)) != vvSocket::VV_OK)
     {
       if (type != VV_UCHAR)
         delete[] buffer;
@@ -918,7 +1475,7 @@ vvSocket::ErrorType vvSocketIO::putBool(const bool val) const
   if(_socket)
   {
     uchar buffer[] = { (uchar)val };
-    return _socket->writeData(&buffer[0], 1);
+    return write(&buffer[0], 1);
   }
   else
   {
@@ -937,7 +1494,7 @@ vvSocket::ErrorType vvSocketIO::getBool(bool& val) const
     uchar buffer[1];
     vvSocket::ErrorType retval;
 
-    if ((retval =_socket->readData(&buffer[0], 1)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], 1)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -961,7 +1518,7 @@ vvSocket::ErrorType vvSocketIO::putInt32(const int val) const
   {
     uchar buffer[4];
     vvToolshed::write32(&buffer[0], val);
-    return _socket->writeData(&buffer[0], 4);
+    return write(&buffer[0], 4);
   }
   else
   {
@@ -980,7 +1537,7 @@ vvSocket::ErrorType vvSocketIO::getInt32(int& val) const
     uchar buffer[4];
     vvSocket::ErrorType retval;
 
-    if ((retval =_socket->readData(&buffer[0], 4)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], 4)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -1004,7 +1561,7 @@ vvSocket::ErrorType vvSocketIO::putFloat(const float val) const
   {
     uchar buffer[4];
     vvToolshed::writeFloat(&buffer[0], val);
-    return _socket->writeData(&buffer[0], 4);
+    return write(&buffer[0], 4);
   }
   else
   {
@@ -1023,7 +1580,7 @@ vvSocket::ErrorType vvSocketIO::getFloat(float& val) const
     uchar buffer[4];
     vvSocket::ErrorType retval;
 
-    if ((retval =_socket->readData(&buffer[0], 4)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], 4)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -1049,7 +1606,7 @@ vvSocket::ErrorType vvSocketIO::putVector3(const vvVector3& val) const
     vvToolshed::writeFloat(&buffer[0], val[0]);
     vvToolshed::writeFloat(&buffer[4], val[1]);
     vvToolshed::writeFloat(&buffer[8], val[2]);
-    return _socket->writeData(&buffer[0], 12);
+    return write(&buffer[0], 12);
   }
   else
   {
@@ -1068,7 +1625,7 @@ vvSocket::ErrorType vvSocketIO::getVector3(vvVector3& val) const
     uchar buffer[12];
     vvSocket::ErrorType retval;
 
-    if ((retval =_socket->readData(&buffer[0], 12)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], 12)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -1097,7 +1654,7 @@ vvSocket::ErrorType vvSocketIO::putVector4(const vvVector4& val) const
     vvToolshed::writeFloat(&buffer[4], val[1]);
     vvToolshed::writeFloat(&buffer[8], val[2]);
     vvToolshed::writeFloat(&buffer[12], val[3]);
-    return _socket->writeData(&buffer[0], 16);
+    return write(&buffer[0], 16);
   }
   else
   {
@@ -1116,7 +1673,7 @@ vvSocket::ErrorType vvSocketIO::getVector4(vvVector4& val) const
     uchar buffer[16];
     vvSocket::ErrorType retval;
 
-    if ((retval =_socket->readData(&buffer[0], 16)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], 16)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -1171,7 +1728,7 @@ vvSocket::ErrorType vvSocketIO::putAABBi(const vvAABBi& val) const
     vvToolshed::write32(&buffer[12], maxval[0]);
     vvToolshed::write32(&buffer[16], maxval[1]);
     vvToolshed::write32(&buffer[20], maxval[2]);
-    return _socket->writeData(&buffer[0], 24);
+    return write(&buffer[0], 24);
   }
   else
   {
@@ -1190,7 +1747,7 @@ vvSocket::ErrorType vvSocketIO::getAABBi(vvAABBi& val) const
     uchar buffer[24];
     vvSocket::ErrorType retval;
 
-    if ((retval =_socket->readData(&buffer[0], 24)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], 24)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -1225,7 +1782,7 @@ vvSocket::ErrorType vvSocketIO::putViewport(const virvo::Viewport &val) const
     vvToolshed::write32(&buffer[4], val[1]);
     vvToolshed::write32(&buffer[8], val[2]);
     vvToolshed::write32(&buffer[12], val[3]);
-    return _socket->writeData(&buffer[0], 16);
+    return write(&buffer[0], 16);
   }
   else
   {
@@ -1244,7 +1801,7 @@ vvSocket::ErrorType vvSocketIO::getViewport(virvo::Viewport &val) const
     uchar buffer[16];
     vvSocket::ErrorType retval;
 
-    if ((retval =_socket->readData(&buffer[0], 16)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], 16)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -1270,7 +1827,7 @@ vvSocket::ErrorType vvSocketIO::putWinDims(const int w, const int h) const
     vvToolshed::write32(&buffer[0], w);
     vvToolshed::write32(&buffer[4], h);
 
-    return _socket->writeData(&buffer[0], 8);
+    return write(&buffer[0], 8);
   }
   else
   {
@@ -1285,7 +1842,7 @@ vvSocket::ErrorType vvSocketIO::getWinDims(int& w, int& h) const
     uchar buffer[8];
     vvSocket::ErrorType retval;
 
-    if ((retval =_socket->readData(&buffer[0], 8)) != vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], 8)) != vvSocket::VV_OK)
     {
       return  retval;
     }
@@ -1341,14 +1898,14 @@ vvSocket::ErrorType vvSocketIO::getServerInfo(vvServerInfo& info) const
     vvSocket::ErrorType retval;
 
     uchar sizebuf[4];
-    if ((retval =_socket->readData(sizebuf, 4)) != vvSocket::VV_OK)
+    if ((retval =read(sizebuf, 4)) != vvSocket::VV_OK)
     {
       return retval;
     }
     size_t len = vvToolshed::read32(sizebuf);
 
     std::vector<uchar> buf(len);
-    if ((retval =_socket->readData(&buf[0], len)) != vvSocket::VV_OK)
+    if ((retval =read(&buf[0], len)) != vvSocket::VV_OK)
     {
       return retval;
     }
@@ -1367,18 +1924,20 @@ vvSocket::ErrorType vvSocketIO::putServerInfo(vvServerInfo info) const
 {
   if (_socket != NULL)
   {
+    beginMessage();
+
     vvSocket::ErrorType retval;
 
     uchar sizebuf[4];
     vvToolshed::write32(sizebuf, info.renderers.length());
 
-    if ((retval = _socket->writeData(sizebuf, 4)) != vvSocket::VV_OK)
+    if ((retval = write(sizebuf, 4)) != vvSocket::VV_OK)
     {
-      return retval;
+      return finishMessage(retval);
     }
 
     uchar* buf = (uchar*)info.renderers.data();
-    return _socket->writeData(buf, info.renderers.length());
+    return finishMessage(write(buf, info.renderers.length()));
   }
   else
   {
@@ -1397,7 +1956,7 @@ vvSocket::ErrorType vvSocketIO::getGpuInfo(vvGpu::vvGpuInfo& ginfo) const
     uchar buffer[8];
     vvSocket::ErrorType retval;
 
-    if ((retval =_socket->readData(&buffer[0], 8)) == vvSocket::VV_OK)
+    if ((retval =read(&buffer[0], 8)) == vvSocket::VV_OK)
     {
       ginfo.freeMem  = vvToolshed::read32(&buffer[0]);
       ginfo.totalMem = vvToolshed::read32(&buffer[4]);
@@ -1426,7 +1985,7 @@ vvSocket::ErrorType vvSocketIO::putGpuInfo(const vvGpu::vvGpuInfo& ginfo) const
     uchar buffer[8];
     vvToolshed::write32(&buffer[0], ginfo.freeMem);
     vvToolshed::write32(&buffer[4], ginfo.totalMem);
-    return _socket->writeData(&buffer[0], 8);
+    return write(&buffer[0], 8);
   }
   else
   {
@@ -1475,17 +2034,19 @@ vvSocket::ErrorType vvSocketIO::putGpuInfos(const std::vector<vvGpu::vvGpuInfo>&
 {
   if(_socket)
   {
+    beginMessage();
+
     vvSocket::ErrorType retval;
 
     retval = putInt32(ginfos.size());
-    if(retval != vvSocket::VV_OK) return retval;
+    if(retval != vvSocket::VV_OK) return finishMessage(retval);
 
     for(std::vector<vvGpu::vvGpuInfo>::const_iterator ginfo = ginfos.begin();ginfo != ginfos.end(); ginfo++)
     {
       retval = putGpuInfo(*ginfo);
-      if(retval != vvSocket::VV_OK) return retval;
+      if(retval != vvSocket::VV_OK) return finishMessage(retval);
     }
-    return vvSocket::VV_OK;
+    return finishMessage(vvSocket::VV_OK);
   }
   else
   {
@@ -1540,23 +2101,25 @@ vvSocket::ErrorType vvSocketIO::putRequest(const vvRequest& req) const
 {
   if(_socket)
   {
+    beginMessage();
+
     vvSocket::ErrorType retval;
 
     retval = putInt32((int32_t)req.niceness);
-    if(retval != vvSocket::VV_OK) return retval;
+    if(retval != vvSocket::VV_OK) return finishMessage(retval);
 
     retval = putInt32((int32_t)req.type);
-    if(retval != vvSocket::VV_OK) return retval;
+    if(retval != vvSocket::VV_OK) return finishMessage(retval);
 
     retval = putInt32((int32_t)req.nodes.size());
-    if(retval != vvSocket::VV_OK) return retval;
+    if(retval != vvSocket::VV_OK) return finishMessage(retval);
 
     for(unsigned int i=0; i<req.nodes.size(); i++)
     {
       retval = putInt32((int32_t)req.nodes[i]);
-      if(retval != vvSocket::VV_OK) return retval;
+      if(retval != vvSocket::VV_OK) return finishMessage(retval);
     }
-    return vvSocket::VV_OK;
+    return finishMessage(vvSocket::VV_OK);
   }
   else
   {
@@ -1576,7 +2139,7 @@ vvSocket::ErrorType vvSocketIO::getStdVector(std::vector<unsigned char>& vec) co
   if (err == vvSocket::VV_OK)
   {
     vec.resize(static_cast<size_t>(size));
-    err = getSocket()->readData(&vec[0], vec.size());
+    err = read(&vec[0], vec.size());
   }
 
   return err;
@@ -1590,12 +2153,14 @@ vvSocket::ErrorType vvSocketIO::putStdVector(std::vector<unsigned char> const& v
   if (vec.size() > static_cast<size_t>(0x7FFFFFFF))
     return vvSocket::VV_DATA_ERROR;
 
+  beginMessage();
+
   vvSocket::ErrorType err = putInt32(static_cast<int>(vec.size()));
 
   if (err == vvSocket::VV_OK)
-    err = getSocket()->writeData(&vec[0], vec.size());
+    err = write(&vec[0], vec.size());
 
-  return err;
+  return finishMessage(err);
 }
 
 vvSocket::ErrorType vvSocketIO::getImage(virvo::Image& image) const
@@ -1605,7 +2170,7 @@ vvSocket::ErrorType vvSocketIO::getImage(virvo::Image& image) const
 
   unsigned char header[16]; // 4 int's
 
-  vvSocket::ErrorType err = getSocket()->readData(header, sizeof(header));
+  vvSocket::ErrorType err = read(header, sizeof(header));
 
   if (err == vvSocket::VV_OK)
   {
@@ -1627,6 +2192,8 @@ vvSocket::ErrorType vvSocketIO::putImage(virvo::Image const& image) const
   if (!getSocket())
     return vvSocket::VV_SOCK_ERROR;
 
+  beginMessage();
+
   unsigned char header[16]; // 4 int's
 
   vvToolshed::write32(&header[ 0], image.width());
@@ -1634,12 +2201,12 @@ vvSocket::ErrorType vvSocketIO::putImage(virvo::Image const& image) const
   vvToolshed::write32(&header[ 8], image.pixlen());
   vvToolshed::write32(&header[12], image.stride());
 
-  vvSocket::ErrorType err = getSocket()->writeData(header, sizeof(header));
+  vvSocket::ErrorType err = write(header, sizeof(header));
 
   if (err == vvSocket::VV_OK)
     err = putStdVector(image.data_);
 
-  return err;
+  return finishMessage(err);
 }
 
 vvSocket::ErrorType vvSocketIO::getIbrImage(virvo::IbrImage& image) const
@@ -1666,6 +2233,8 @@ vvSocket::ErrorType vvSocketIO::putIbrImage(virvo::IbrImage const& image) const
   if (!getSocket())
     return vvSocket::VV_SOCK_ERROR;
 
+  beginMessage();
+
   vvSocket::ErrorType err = vvSocket::VV_OK;
 
   if (err == vvSocket::VV_OK) err = putImage(image);
@@ -1677,7 +2246,7 @@ vvSocket::ErrorType vvSocketIO::putIbrImage(virvo::IbrImage const& image) const
   if (err == vvSocket::VV_OK) err = putMatrix(&image.projMatrix_);
   if (err == vvSocket::VV_OK) err = putViewport(image.viewport_);
 
-  return err;
+  return finishMessage(err);
 }
 
 //----------------------------------------------------------------------------
@@ -42,6 +42,7 @@ namespace virvo
 {
   class Image;
   class IbrImage;
+  class VolumeUpload;
 }
 
 /** This class provides specific data transfer through sockets.
@@ -118,6 +119,19 @@ namespace virvo
   delete sock;
   delete sio;
 
+</PRE>
+  All data is sent in length-prefixed frames, so both ends of a connection
+  must use vvSocketIO. Every put call is sent with a single system call.
+  Enclose several puts in beginMessage() and endMessage() to send them
+  together, e.g. an event and its parameters:<BR>
+  <PRE>
+
+  sio->beginMessage();
+  sio->putEvent(virvo::CameraMatrix);
+  sio->putMatrix(&pr);
+  sio->putMatrix(&mv);
+  sio->endMessage();
+
 </PRE>
 @see vvSocket
 @author Michael Poehnl
@@ -138,10 +152,14 @@ class VIRVOEXPORT vvSocketIO
     bool sock_action();
     vvSocket::ErrorType getEvent(virvo::RemoteEvent& event) const;
     vvSocket::ErrorType putEvent(virvo::RemoteEvent event) const;
+    vvSocket::ErrorType requestSharedMemory() const;
+    vvSocket::ErrorType acceptSharedMemory() const;
     vvSocket::ErrorType getVolumeAttributes(vvVolDesc* vd) const;
     vvSocket::ErrorType getVolume(vvVolDesc* vd) const;
     vvSocket::ErrorType putVolumeAttributes(const vvVolDesc*) const;
     vvSocket::ErrorType putVolume(const vvVolDesc* vd) const;
+    vvSocket::ErrorType getVolumeChunk(virvo::VolumeUpload& upload) const;
+    vvSocket::ErrorType putVolumeChunks(const vvVolDesc* vd, size_t first, size_t count) const;
     vvSocket::ErrorType getTransferFunction(vvTransFunc& tf) const;
     vvSocket::ErrorType putTransferFunction(vvTransFunc& tf) const;
     vvSocket::ErrorType getImage(vvImage*) const;
@@ -191,9 +209,20 @@ class VIRVOEXPORT vvSocketIO
     vvSocket::ErrorType getIbrImage(virvo::IbrImage& image) const;
     vvSocket::ErrorType putIbrImage(virvo::IbrImage const& image) const;
 
+    void beginMessage() const;
+    vvSocket::ErrorType endMessage() const;
+    bool hasBufferedData() const;
+    bool hasPendingData() const;
+
     vvSocket* getSocket() const;
 
     vvSocket *_socket;
+
+  private:
+    vvSocket::ErrorType finishMessage(vvSocket::ErrorType err) const;
+    vvSocket::ErrorType flush(const uchar* data, size_t size) const;
+    vvSocket::ErrorType write(const uchar* data, size_t size) const;
+    vvSocket::ErrorType read(uchar* data, size_t size) const;
 };
 #endif
 // vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -20,221 +20,527 @@
 
 #include "vvclock.h"
 #include "vvdebugmsg.h"
+#include "vvpthread.h"
 #include "vvsocketmonitor.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fcntl.h>
 #include <iostream>
+#include <map>
+
+#if defined(__linux__) || defined(LINUX)
+#define VV_USE_EPOLL
+#include <sys/epoll.h>
+#endif
 
 using std::cerr;
 using std::endl;
 
-vvSocketMonitor::vvSocketMonitor()
+namespace
 {
-  FD_ZERO(&_readsockfds);
-  FD_ZERO(&_writesockfds);
-  FD_ZERO(&_errorsockfds);
 
-  _highestSocketNum = VV_INVALID_SOCKET;
+#ifndef VV_USE_EPOLL
+void reportSelectError()
+{
+#ifndef _WIN32
+  switch(errno)
+  {
+  case EAGAIN:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() The kernel was (perhaps temporarily) unable to allocate the requested number of file descriptors.");
+    break;
+  case EBADF:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() One of the descriptor sets specified an invalid descriptor.");
+    break;
+  case EINTR:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() A signal was delivered before the time limit expired and before any of the selected events occurred..");
+    break;
+  case EINVAL:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() The specified time limit is invalid. One of its components is negative or too large. \n OR: ndfs is greater than FD_SETSIZE and _DARWIN_UNLIMITED_SELECT is not defined.");
+    break;
+  default:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() unknown erro occurred.");
+    break;
+  }
+#else
+  switch(errno)
+  {
+  case WSANOTINITIALISED:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() A successful WSAStartup call must occur before using this function.");
+    break;
+  case WSAEFAULT:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() The Windows Sockets implementation was unable to allocate needed resources for its internal operations, or the readfds, writefds, exceptfds, or timeval parameters are not part of the user address space.");
+    break;
+  case WSAENETDOWN:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() The network subsystem has failed.");
+    break;
+  case WSAEINVAL:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() The time-out value is not valid, or all three descriptor parameters were null.");
+    break;
+  case WSAEINTR:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() A blocking Windows Socket 1.1 call was canceled through WSACancelBlockingCall.");
+    break;
+  case WSAEINPROGRESS:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() A blocking Windows Sockets 1.1 call is in progress, or the service provider is still processing a callback function.");
+    break;
+  case WSAENOTSOCK:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() One of the descriptor sets contains an entry that is not a socket.");
+    break;
+  default:
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() unknown error occurred.");
+    break;
+  }
+#endif
 }
-
-vvSocketMonitor::~vvSocketMonitor()
+#else
+uint32_t toEpoll(int interests)
 {
+  uint32_t result = 0;
+  if (interests & vvSocketMonitor::VV_READABLE) result |= EPOLLIN;
+  if (interests & vvSocketMonitor::VV_WRITABLE) result |= EPOLLOUT;
+  if (interests & vvSocketMonitor::VV_EXCEPT)   result |= EPOLLPRI;
+  if (interests & vvSocketMonitor::VV_ONESHOT)  result |= EPOLLONESHOT;
+  return result;
 }
+#endif
 
-void vvSocketMonitor::setReadFds(const std::vector<vvSocket*>& readfds)
+} // namespace
+
+struct vvSocketMonitor::Impl
 {
-  vvDebugMsg::msg(3, "vvSocketMonitor::addReadFds()");
+  struct Registration
+  {
+    vvSocket* socket;
+    int interests;
+    void* userData;
+    bool armed;       ///< false after a VV_ONESHOT registration was reported
+  };
 
-  _readSockets = readfds;
+  typedef std::map<vvsock_t, Registration> Registrations;
 
-  for (std::vector<vvSocket*>::const_iterator it = _readSockets.begin(); it != _readSockets.end(); ++it)
+  enum Op
   {
-    vvSocket* socket = (*it);
-    FD_SET(socket->getSockfd(), &_readsockfds);
+    Add,
+    Modify,
+    Remove
+  };
 
-    if (_highestSocketNum == VV_INVALID_SOCKET || _highestSocketNum < socket->getSockfd())
+  virvo::Mutex mutex;
+  Registrations registrations;
+#ifdef VV_USE_EPOLL
+  int epfd;
+#endif
+
+  Impl()
+  {
+#ifdef VV_USE_EPOLL
+    epfd = epoll_create(64);
+    if (epfd < 0)
     {
-      _highestSocketNum = socket->getSockfd();
+      vvDebugMsg::msg(0, "vvSocketMonitor: epoll_create() failed", true);
     }
+#endif
   }
-}
 
-void vvSocketMonitor::setWriteFds(const std::vector<vvSocket*>& writefds)
-{
-  vvDebugMsg::msg(3, "vvSocketMonitor::addWriteFds()");
-
-  _writeSockets = writefds;
-
-  for (std::vector<vvSocket*>::const_iterator it = _writeSockets.begin(); it != _writeSockets.end(); ++it)
+  ~Impl()
   {
-    vvSocket* socket = (*it);
-    FD_SET(socket->getSockfd(), &_writesockfds);
-
-    if (_highestSocketNum == VV_INVALID_SOCKET || _highestSocketNum < socket->getSockfd())
+#ifdef VV_USE_EPOLL
+    if (epfd >= 0)
     {
-      _highestSocketNum = socket->getSockfd();
+      close(epfd);
     }
+#endif
   }
-}
 
-void vvSocketMonitor::setErrorFds(const std::vector<vvSocket*>& errorfds)
-{
-  vvDebugMsg::msg(3, "vvSocketMonitor::addErrorFds()");
-
-  _errorSockets = errorfds;
-
-  for (std::vector<vvSocket*>::const_iterator it = _errorSockets.begin(); it != _errorSockets.end(); ++it)
+  // Update the kernel registration, nothing to do for select
+  bool control(Op op, vvsock_t fd, int interests)
   {
-    vvSocket* socket = (*it);
-    FD_SET(socket->getSockfd(), &_errorsockfds);
+#ifdef VV_USE_EPOLL
+    static const int ops[] = { EPOLL_CTL_ADD, EPOLL_CTL_MOD, EPOLL_CTL_DEL };
 
-    if (_highestSocketNum == VV_INVALID_SOCKET || _highestSocketNum < socket->getSockfd())
+    epoll_event ev;
+    ev.events = toEpoll(interests);
+    ev.data.u64 = 0;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, ops[op], fd, &ev) != 0)
     {
-      _highestSocketNum = socket->getSockfd();
+      vvDebugMsg::msg(2, "vvSocketMonitor: epoll_ctl() failed", true);
+      return false;
     }
+#else
+    (void)op;
+    (void)fd;
+    (void)interests;
+#endif
+    return true;
   }
-}
 
-vvSocketMonitor::ErrorType vvSocketMonitor::wait(vvSocket** socket, double* timeout)
-{
-  vvDebugMsg::msg(3, "vvSocketMonitor::wait()");
+  // Returns the interests of a socket, 0 if not registered
+  int interestsOf(vvSocket* socket)
+  {
+    virvo::ScopedLock lock(&mutex);
+    Registrations::const_iterator it = registrations.find(socket->getSockfd());
+    return it != registrations.end() ? it->second.interests : 0;
+  }
 
-  timeval* tout;
-  if(NULL != timeout)
+  void elapsed(double* timeout, double startTime)
   {
-    if(*timeout >= 0.0)
+    if (timeout != NULL && *timeout >= 0.0)
     {
-      tout = new timeval;
-      tout->tv_sec  = static_cast<int>(*timeout);
-      tout->tv_usec = long((*timeout - static_cast<int>(*timeout)) * 1000000.0);
-    }
-    else
-    {
-      tout = NULL;
+      *timeout = std::max(0.0, *timeout - (vvClock::getTime() - startTime));
     }
   }
-  else
+
+  ErrorType wait(std::vector<Event>& events, double* timeout);
+};
+
+#ifdef VV_USE_EPOLL
+
+vvSocketMonitor::ErrorType vvSocketMonitor::Impl::wait(std::vector<Event>& events, double* timeout)
+{
+  const int MaxEvents = 64;
+  epoll_event ready[MaxEvents];
+
+  int ms = -1;
+  if (timeout != NULL && *timeout >= 0.0)
   {
-    tout = NULL;
+    ms = static_cast<int>(std::ceil(*timeout * 1000.0));
   }
 
   double startTime = vvClock::getTime();
 
-  int done = select(_highestSocketNum + 1, &_readsockfds, &_writesockfds, &_errorsockfds, tout);
+  int done = epoll_wait(epfd, ready, MaxEvents, ms);
 
-  delete tout;
+  elapsed(timeout, startTime);
 
-  if(timeout != NULL) *timeout -= (vvClock::getTime()-startTime);
+  if (done < 0)
+  {
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() epoll_wait() failed", true);
+    return VV_ERROR;
+  }
+  else if (done == 0)
+  {
+    vvDebugMsg::msg(3, "vvSocketMonitor::wait() timelimit reached.");
+    return VV_TIMEOUT;
+  }
+
+  virvo::ScopedLock lock(&mutex);
 
-  if (done > 0)
+  for (int i = 0; i < done; ++i)
   {
-    for (std::vector<vvSocket*>::const_iterator it = _readSockets.begin(); it != _readSockets.end(); ++it)
+    Registrations::iterator it = registrations.find(ready[i].data.fd);
+    if (it == registrations.end())
     {
-      *socket = (*it);
-      if (FD_ISSET((*socket)->getSockfd(), &_readsockfds))
-      {
-        return VV_OK;
-      }
+      // removed by another thread meanwhile
+      continue;
     }
 
-    for (std::vector<vvSocket*>::const_iterator it = _writeSockets.begin(); it != _writeSockets.end(); ++it)
+    Registration& reg = it->second;
+
+    Event e;
+    e.socket = reg.socket;
+    e.userData = reg.userData;
+    e.events = 0;
+    if (ready[i].events & EPOLLIN)  e.events |= VV_READABLE;
+    if (ready[i].events & EPOLLOUT) e.events |= VV_WRITABLE;
+    if (ready[i].events & EPOLLPRI) e.events |= VV_EXCEPT;
+    // errors and hang-ups are discovered by the next read or write
+    if (ready[i].events & (EPOLLERR | EPOLLHUP))
     {
-      *socket = (*it);
-      if (FD_ISSET((*socket)->getSockfd(), &_writesockfds))
-      {
-        return VV_OK;
-      }
+      e.events |= reg.interests & (VV_READABLE | VV_WRITABLE);
     }
 
-    for (std::vector<vvSocket*>::const_iterator it = _errorSockets.begin(); it != _errorSockets.end(); ++it)
+    if (reg.interests & VV_ONESHOT)
     {
-      *socket = (*it);
-      if (FD_ISSET((*socket)->getSockfd(), &_errorsockfds))
-      {
-        return VV_OK;
-      }
+      reg.armed = false;
     }
+
+    events.push_back(e);
   }
-  else if(done == 0)
+
+  return events.empty() ? VV_TIMEOUT : VV_OK;
+}
+
+#else
+
+vvSocketMonitor::ErrorType vvSocketMonitor::Impl::wait(std::vector<Event>& events, double* timeout)
+{
+  fd_set readsockfds;
+  fd_set writesockfds;
+  fd_set errorsockfds;
+
+  FD_ZERO(&readsockfds);
+  FD_ZERO(&writesockfds);
+  FD_ZERO(&errorsockfds);
+
+  vvsock_t highestSocketNum = 0;
+
+  {
+    virvo::ScopedLock lock(&mutex);
+
+    for (Registrations::const_iterator it = registrations.begin(); it != registrations.end(); ++it)
+    {
+      const Registration& reg = it->second;
+      if (!reg.armed)
+        continue;
+
+      if (reg.interests & VV_READABLE) FD_SET(it->first, &readsockfds);
+      if (reg.interests & VV_WRITABLE) FD_SET(it->first, &writesockfds);
+      if (reg.interests & VV_EXCEPT)   FD_SET(it->first, &errorsockfds);
+
+      highestSocketNum = std::max(highestSocketNum, it->first);
+    }
+  }
+
+  timeval tout;
+  timeval* ptout = NULL;
+  if (timeout != NULL && *timeout >= 0.0)
+  {
+    tout.tv_sec  = static_cast<int>(*timeout);
+    tout.tv_usec = long((*timeout - static_cast<int>(*timeout)) * 1000000.0);
+    ptout = &tout;
+  }
+
+  double startTime = vvClock::getTime();
+
+  int done = select(int(highestSocketNum) + 1, &readsockfds, &writesockfds, &errorsockfds, ptout);
+
+  elapsed(timeout, startTime);
+
+  if (done < 0)
+  {
+    vvDebugMsg::msg(2, "vvSocketMonitor::wait() error by select() returned!");
+    reportSelectError();
+    return VV_ERROR;
+  }
+  else if (done == 0)
   {
     vvDebugMsg::msg(3, "vvSocketMonitor::wait() timelimit reached.");
     return VV_TIMEOUT;
   }
-  else if(done == -1)
+
+  virvo::ScopedLock lock(&mutex);
+
+  for (Registrations::iterator it = registrations.begin(); it != registrations.end(); ++it)
   {
-    vvDebugMsg::msg(2, "vvSocketMonitor::wait() error by select() returned!");
-#ifndef _WIN32
-	switch(errno)
+    Registration& reg = it->second;
+
+    Event e;
+    e.socket = reg.socket;
+    e.userData = reg.userData;
+    e.events = 0;
+    if (FD_ISSET(it->first, &readsockfds))  e.events |= VV_READABLE;
+    if (FD_ISSET(it->first, &writesockfds)) e.events |= VV_WRITABLE;
+    if (FD_ISSET(it->first, &errorsockfds)) e.events |= VV_EXCEPT;
+
+    if (e.events == 0 || !reg.armed)
+      continue;
+
+    if (reg.interests & VV_ONESHOT)
     {
-    case EAGAIN:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() The kernel was (perhaps temporarily) unable to allocate the requested number of file descriptors.");
-      break;
-    case EBADF:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() One of the descriptor sets specified an invalid descriptor.");
-      break;
-    case EINTR:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() A signal was delivered before the time limit expired and before any of the selected events occurred..");
-      break;
-    case EINVAL:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() The specified time limit is invalid. One of its components is negative or too large. \n OR: ndfs is greater than FD_SETSIZE and _DARWIN_UNLIMITED_SELECT is not defined.");
-      break;
-    default:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() unknown erro occurred.");
-      break;
+      reg.armed = false;
     }
+
+    events.push_back(e);
+  }
+
+  return events.empty() ? VV_TIMEOUT : VV_OK;
+}
+
+#endif
+
+vvSocketMonitor::vvSocketMonitor()
+  : _impl(new Impl)
+{
+}
+
+vvSocketMonitor::~vvSocketMonitor()
+{
+  delete _impl;
+}
+
+bool vvSocketMonitor::add(vvSocket* socket, int interests, void* userData)
+{
+  vvDebugMsg::msg(3, "vvSocketMonitor::add()");
+
+  virvo::ScopedLock lock(&_impl->mutex);
+
+  vvsock_t fd = socket->getSockfd();
+  if (_impl->registrations.find(fd) != _impl->registrations.end())
+  {
+    vvDebugMsg::msg(2, "vvSocketMonitor::add() socket already registered");
+    return false;
+  }
+
+  if (!_impl->control(Impl::Add, fd, interests))
+  {
+    return false;
+  }
+
+  Impl::Registration reg;
+  reg.socket = socket;
+  reg.interests = interests;
+  reg.userData = userData;
+  reg.armed = true;
+  _impl->registrations[fd] = reg;
+  return true;
+}
+
+bool vvSocketMonitor::modify(vvSocket* socket, int interests, void* userData)
+{
+  vvDebugMsg::msg(3, "vvSocketMonitor::modify()");
+
+  virvo::ScopedLock lock(&_impl->mutex);
+
+  Impl::Registrations::iterator it = _impl->registrations.find(socket->getSockfd());
+  if (it == _impl->registrations.end())
+  {
+    vvDebugMsg::msg(2, "vvSocketMonitor::modify() socket not registered");
+    return false;
+  }
+
+  // update the registration first, the socket may be reported immediately
+  it->second.socket = socket;
+  it->second.interests = interests;
+  it->second.userData = userData;
+  it->second.armed = true;
+
+  return _impl->control(Impl::Modify, it->first, interests);
+}
+
+bool vvSocketMonitor::remove(vvSocket* socket)
+{
+  vvDebugMsg::msg(3, "vvSocketMonitor::remove()");
+
+  virvo::ScopedLock lock(&_impl->mutex);
+
+  Impl::Registrations::iterator it = _impl->registrations.find(socket->getSockfd());
+  if (it == _impl->registrations.end())
+  {
+    return false;
+  }
+
+  _impl->registrations.erase(it);
+  return _impl->control(Impl::Remove, socket->getSockfd(), 0);
+}
+
+vvSocketMonitor::ErrorType vvSocketMonitor::wait(std::vector<Event>& events, double* timeout)
+{
+  vvDebugMsg::msg(3, "vvSocketMonitor::wait()");
+
+  events.clear();
+  return _impl->wait(events, timeout);
+}
+
+bool vvSocketMonitor::concurrentUpdates()
+{
+#ifdef VV_USE_EPOLL
+  return true;
 #else
-	  switch(errno)
-      {
-	  case WSANOTINITIALISED:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() A successful WSAStartup call must occur before using this function.");  	  
-		  break;
-    case WSAEFAULT:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() The Windows Sockets implementation was unable to allocate needed resources for its internal operations, or the readfds, writefds, exceptfds, or timeval parameters are not part of the user address space.");
-      break;
-    case WSAENETDOWN:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() The network subsystem has failed.");
-      break;
-    case WSAEINVAL:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() The time-out value is not valid, or all three descriptor parameters were null.");
-      break;
-    case WSAEINTR:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() A blocking Windows Socket 1.1 call was canceled through WSACancelBlockingCall.");
-      break;
-    case WSAEINPROGRESS:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() A blocking Windows Sockets 1.1 call is in progress, or the service provider is still processing a callback function.");
-      break;
-    case WSAENOTSOCK:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() One of the descriptor sets contains an entry that is not a socket.");
-      break;
-    default:
-      vvDebugMsg::msg(2, "vvSocketMonitor::wait() unknown error occurred.");
-      break;
-    }
+  return false;
 #endif
+}
+
+void vvSocketMonitor::setLegacyFds(std::vector<vvSocket*>& current, const std::vector<vvSocket*>& fds, int interest)
+{
+  for (std::vector<vvSocket*>::const_iterator it = current.begin(); it != current.end(); ++it)
+  {
+    int interests = _impl->interestsOf(*it) & ~interest;
+    if (interests == 0)
+      remove(*it);
+    else
+      modify(*it, interests);
   }
 
-  return VV_ERROR;
+  current = fds;
+
+  for (std::vector<vvSocket*>::const_iterator it = current.begin(); it != current.end(); ++it)
+  {
+    int interests = _impl->interestsOf(*it);
+    if (interests == 0)
+      add(*it, interest);
+    else
+      modify(*it, interests | interest);
+  }
 }
 
-void vvSocketMonitor::clear()
+void vvSocketMonitor::setReadFds(const std::vector<vvSocket*>& readfds)
 {
-  vvDebugMsg::msg(3, "vvSocketMonitor::clear()");
-  for (std::vector<vvSocket*>::const_iterator it = _readSockets.begin(); it != _readSockets.end(); ++it)
+  vvDebugMsg::msg(3, "vvSocketMonitor::addReadFds()");
+
+  setLegacyFds(_readSockets, readfds, VV_READABLE);
+}
+
+void vvSocketMonitor::setWriteFds(const std::vector<vvSocket*>& writefds)
+{
+  vvDebugMsg::msg(3, "vvSocketMonitor::addWriteFds()");
+
+  setLegacyFds(_writeSockets, writefds, VV_WRITABLE);
+}
+
+void vvSocketMonitor::setErrorFds(const std::vector<vvSocket*>& errorfds)
+{
+  vvDebugMsg::msg(3, "vvSocketMonitor::addErrorFds()");
+
+  setLegacyFds(_errorSockets, errorfds, VV_EXCEPT);
+}
+
+vvSocketMonitor::ErrorType vvSocketMonitor::wait(vvSocket** socket, double* timeout)
+{
+  vvDebugMsg::msg(3, "vvSocketMonitor::wait()");
+
+  *socket = NULL;
+
+  std::vector<Event> events;
+  ErrorType err = wait(events, timeout);
+  if (err != VV_OK)
   {
-    delete (*it);
+    return err;
   }
-  for (std::vector<vvSocket*>::const_iterator it = _writeSockets.begin(); it != _writeSockets.end(); ++it)
+
+  // report read sockets first, then write sockets, then error sockets
+  const std::vector<vvSocket*>* sets[] = { &_readSockets, &_writeSockets, &_errorSockets };
+  const int interests[] = { VV_READABLE, VV_WRITABLE, VV_EXCEPT };
+  for (int i = 0; i < 3; ++i)
   {
-    delete (*it);
+    for (std::vector<vvSocket*>::const_iterator it = sets[i]->begin(); it != sets[i]->end(); ++it)
+    {
+      for (std::vector<Event>::const_iterator e = events.begin(); e != events.end(); ++e)
+      {
+        if (e->socket == *it && (e->events & interests[i]))
+        {
+          *socket = *it;
+          return VV_OK;
+        }
+      }
+    }
   }
-  for (std::vector<vvSocket*>::const_iterator it = _errorSockets.begin(); it != _errorSockets.end(); ++it)
+
+  *socket = events[0].socket;
+  return VV_OK;
+}
+
+void vvSocketMonitor::clear()
+{
+  vvDebugMsg::msg(3, "vvSocketMonitor::clear()");
+
+  std::vector<vvSocket*> none;
+  std::vector<vvSocket*> sockets = _readSockets;
+  sockets.insert(sockets.end(), _writeSockets.begin(), _writeSockets.end());
+  sockets.insert(sockets.end(), _errorSockets.begin(), _errorSockets.end());
+
+  setLegacyFds(_readSockets, none, VV_READABLE);
+  setLegacyFds(_writeSockets, none, VV_WRITABLE);
+  setLegacyFds(_errorSockets, none, VV_EXCEPT);
+
+  // a socket may be in several sets
+  std::sort(sockets.begin(), sockets.end());
+  sockets.erase(std::unique(sockets.begin(), sockets.end()), sockets.end());
+
+  for (std::vector<vvSocket*>::const_iterator it = sockets.begin(); it != sockets.end(); ++it)
   {
     delete (*it);
   }
-
-  FD_ZERO(&_readsockfds);
-  FD_ZERO(&_writesockfds);
-  FD_ZERO(&_errorsockfds);
 }
 
 // vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
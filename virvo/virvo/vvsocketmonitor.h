@@ -21,13 +21,26 @@
 #ifndef _VV_SOCKETMONITOR_H_
 #define _VV_SOCKETMONITOR_H_
 
+#include "vvexport.h"
 #include "vvsocket.h"
 
 #include <vector>
 
-/** Class handling non-blocking file-describtors with select
+/** Class handling non-blocking file-describtors
 
-  For usage, use setters ((setReadFds(), setWriteFds(),
+  On Linux, the monitor is built on epoll, elsewhere on select. Sockets
+  stay registered across calls to wait(), so a single monitor can watch
+  hundreds of connections without rebuilding descriptor sets.
+
+  Registration interface: add() a socket with a set of interests and an
+  optional user pointer, and call wait() with a vector to receive all
+  sockets that are ready. Registrations with VV_ONESHOT are disabled after
+  they have been reported once and must be re-armed with modify(). add(),
+  modify() and remove() may be called from other threads while a thread
+  is blocked in wait(). With the select backend, such changes take effect
+  when wait() returns, so use a finite timeout there.
+
+  Legacy interface: use setters ((setReadFds(), setWriteFds(),
   setErrorFds()) to fill the filedescribtor-sets and call wait(),
   which will handle all sets at once and provide the first socket
   with any events to handle.
@@ -35,7 +48,7 @@
   @author Stefan Zellmann (zellmans@uni-koeln.de)
   @author Stavros Delisavas (stavros.delisavas@uni-koeln.de)
  */
-class vvSocketMonitor
+class VIRVOEXPORT vvSocketMonitor
 {
 public:
 
@@ -46,10 +59,56 @@ public:
     VV_ERROR
   };
 
+  enum Interest
+  {
+    VV_READABLE = 0x1,  ///< data can be read or the peer closed the connection
+    VV_WRITABLE = 0x2,  ///< data can be written
+    VV_EXCEPT   = 0x4,  ///< out-of-band data is available
+    VV_ONESHOT  = 0x8   ///< disable the registration after it was reported
+  };
+
+  /** A socket reported by wait() */
+  struct Event
+  {
+    vvSocket* socket;   ///< the registered socket
+    int       events;   ///< ready interests (VV_READABLE|VV_WRITABLE|VV_EXCEPT)
+    void*     userData; ///< user pointer passed to add() or modify()
+  };
+
   /** Constructor creating a socketmonitor */
   vvSocketMonitor();
   ~vvSocketMonitor();
 
+  /** Register a socket
+    \param socket the socket to watch, not owned by the monitor
+    \param interests combination of Interest flags
+    \param userData user pointer reported by wait()
+    \return false if the socket is already registered or on error
+    */
+  bool add(vvSocket* socket, int interests, void* userData = NULL);
+  /** Change the interests and the user pointer of a registered socket.
+    Use this to re-arm a VV_ONESHOT registration.
+    */
+  bool modify(vvSocket* socket, int interests, void* userData = NULL);
+  /** Unregister a socket. Call this before the socket is closed. */
+  bool remove(vvSocket* socket);
+
+  /** Wait until at least one registered socket is ready
+
+    \param events filled with all sockets that are ready
+    \param timeout pointer to timeout, decreased while time goes by. NULL or negative for no timeout.
+
+    \return VV_OK if events is not empty
+    \return VV_TIMEOUT if timeout reached. events is empty and timeout (if given) is decreased
+    \return VV_ERROR on any error, including interruption by a signal
+    */
+  ErrorType wait(std::vector<Event>& events, double* timeout = NULL);
+
+  /** Returns true if add(), modify() and remove() take effect while
+    another thread is blocked in wait() (epoll backend)
+    */
+  static bool concurrentUpdates();
+
   /** Add a List of filedescribtors for reading
     \param readfds vector of vvSockets
     */
@@ -73,19 +132,22 @@ public:
     \return VV_ERROR on any error.
     */
   ErrorType wait(vvSocket** socket, double* timeout = NULL);
-  /** Delete all Sockets and emtpy the filedescribtor-sets
+  /** Delete all Sockets set with the legacy setters and emtpy the filedescribtor-sets
     */
   void clear();
 private:
-  fd_set _readsockfds;
-  fd_set _writesockfds;
-  fd_set _errorsockfds;
+  struct Impl;
+  Impl* _impl;
 
   std::vector<vvSocket*> _readSockets;
   std::vector<vvSocket*> _writeSockets;
   std::vector<vvSocket*> _errorSockets;
 
-  vvsock_t _highestSocketNum;
+  void setLegacyFds(std::vector<vvSocket*>& current, const std::vector<vvSocket*>& fds, int interest);
+
+  // NOT copyable!
+  vvSocketMonitor(vvSocketMonitor const&);
+  vvSocketMonitor& operator=(vvSocketMonitor const&);
 };
 
 #endif
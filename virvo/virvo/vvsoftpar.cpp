@@ -48,6 +48,7 @@ vvSoftPar::vvSoftPar(vvVolDesc* vd, vvRenderState rs) : vvSoftVR(vd, rs)
    rendererType = SOFTPAR;
    bufSlice[0] = bufSlice[1] = NULL;
    bufSliceLen[0] = bufSliceLen[1] = 0;
+   lastIPos[0] = lastIPos[1] = 0;
    readSlice = 0;
    wViewDir.set(0.0f, 0.0f, 1.0f);
 
@@ -141,18 +142,34 @@ void vvSoftPar::compositeVolume(int from, int to)
       }
    }
 
+   // The compositing loops are specialized for clipping so that
+   // the per-voxel clipping test is compiled out when it is off:
+   const bool clipping = (_clipMode != 0);
+
    for (slice=firstSlice; slice!=lastSlice; slice += sliceStep)
    {
       if (_preIntegration)  compositeSlicePreIntegrated(slice, sliceStep);
       else if (compression && rleStart[0]!=NULL)
       {
-         if (sliceInterpol) compositeSliceCompressedBilinear(slice);
-         else               compositeSliceCompressedNearest(slice);
+         if (sliceInterpol)
+         {
+            if (clipping) compositeSliceCompressedBilinear<true>(slice);
+            else          compositeSliceCompressedBilinear<false>(slice);
+         }
+         else compositeSliceCompressedNearest(slice);
       }
       else
       {
-         if (sliceInterpol) compositeSliceBilinear(slice);
-         else               compositeSliceNearest(slice, from, to);
+         if (sliceInterpol)
+         {
+            if (clipping) compositeSliceBilinear<true>(slice);
+            else          compositeSliceBilinear<false>(slice);
+         }
+         else
+         {
+            if (clipping) compositeSliceNearest<true>(slice, from, to);
+            else          compositeSliceNearest<false>(slice, from, to);
+         }
       }
    }
 
@@ -183,6 +200,7 @@ ia := ia + va * (1 - ia)
 @param from    first intermediate image line to render (bottom-most line, -1 to render all lines)
 @param to      last intermediate image line to render (top-most line)
 */
+template <bool Clipping>
 void vvSoftPar::compositeSliceNearest(int slice, int from, int to)
 {
    vvVector3 vStart;                              // bottom left voxel of this slice
@@ -236,7 +254,7 @@ void vvSoftPar::compositeSliceNearest(int slice, int from, int to)
          if (rgbaConv[*vScalar][3]==0) ++earlyRayTermination;
          if (rgbaConv[*vScalar][3]>0 &&           // skip transparent voxels
                                                   // skip clipped voxels
-            (_clipMode == 0 || !isVoxelClipped(ix, iSlice[1]-iy-1, slice)))
+            (!Clipping || !isVoxelClipped(ix, iSlice[1]-iy-1, slice)))
          {
             // Determine image color components and scale to [0..1]:
             ir = (float)(*(iPixel++)) / 255.0f;
@@ -275,6 +293,7 @@ void vvSoftPar::compositeSliceNearest(int slice, int from, int to)
 /** Composite a slice to the intermediate image using bilinear interpolation.
   @param slice slice number to composite
 */
+template <bool Clipping>
 void vvSoftPar::compositeSliceBilinear(int slice)
 {
    vvVector3 vStart;                              // bottom left voxel of this slice
@@ -321,7 +340,7 @@ void vvSoftPar::compositeSliceBilinear(int slice)
       for (ix=0; ix<iSlice[0]-1; ++ix)
       {
                                                   // skip clipped voxels
-         if (_clipMode == 0 || !isVoxelClipped(ix, iSlice[1]-iy-1, slice))
+         if (!Clipping || !isVoxelClipped(ix, iSlice[1]-iy-1, slice))
          {
                                                   // skip transparent voxels
             if (rgbaConv[*vScalar[0]][3]>0 || rgbaConv[*vScalar[1]][3]>0 ||
@@ -552,6 +571,7 @@ void vvSoftPar::compositeSliceCompressedNearest(int slice)
     and RLE compression.
   @param slice slice number to composite
 */
+template <bool Clipping>
 void vvSoftPar::compositeSliceCompressedBilinear(int slice)
 {
    vvVector3 vStart;                              // bottom left voxel of this slice
@@ -597,7 +617,7 @@ void vvSoftPar::compositeSliceCompressedBilinear(int slice)
       for (ix=0; ix<iSlice[0]-1; ++ix)
       {
                                                   // skip clipped voxels
-         if (_clipMode == 0 || !isVoxelClipped(ix, iSlice[1]-iy-1, slice))
+         if (!Clipping || !isVoxelClipped(ix, iSlice[1]-iy-1, slice))
          {
                                                   // skip transparent voxels
             if (rgbaConv[*vScalar[0]][3]>0 || rgbaConv[*vScalar[1]][3]>0 ||
@@ -685,7 +705,6 @@ void vvSoftPar::compositeSlicePreIntegrated(int slice, int sliceStep)
    int    bufX, bufY;                             // coordinates in buffer slice
    int    iSliceOffset[2];                        // difference of locations of current and previous slice
    float  tmp;
-   static int   lastIPos[2];                      // last slice position on the intermediate image
 
    findSlicePosition(slice, &vStart, NULL);
    iPosX     = int(vStart[0]) + 1;                // use intermediate image column right of bottom left voxel location
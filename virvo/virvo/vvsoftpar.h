@@ -80,6 +80,7 @@ class VIRVOEXPORT vvSoftPar : public vvSoftVR
       float* bufSlice[2];                         ///< buffer slices for preintegrated rendering
       int bufSliceLen[2];                         ///< size of buffer slices
       int readSlice;                              ///< index of buffer slice currently used for reading [0..1]
+      int lastIPos[2];                            ///< last slice position on the intermediate image
       enum
       {
          VV_OP_CORR_TABLE_SIZE = 1024
@@ -87,10 +88,10 @@ class VIRVOEXPORT vvSoftPar : public vvSoftVR
       float opacityCorr[VV_OP_CORR_TABLE_SIZE];
       float colorCorr[VV_OP_CORR_TABLE_SIZE];
 
-      void compositeSliceNearest(int, int = -1, int = -1);
-      void compositeSliceBilinear(int);
+      template <bool Clipping> void compositeSliceNearest(int, int = -1, int = -1);
+      template <bool Clipping> void compositeSliceBilinear(int);
       void compositeSliceCompressedNearest(int);
-      void compositeSliceCompressedBilinear(int);
+      template <bool Clipping> void compositeSliceCompressedBilinear(int);
       void compositeSlicePreIntegrated(int, int);
       void findOViewingDirection();
       void findPrincipalAxis();
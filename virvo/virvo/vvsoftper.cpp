@@ -73,15 +73,22 @@ void vvSoftPer::compositeVolume(int from, int to)
 
    intImg->clear();
 
+   // Select compositing function according to current rendering mode,
+   // indexed by [interpolation][clipping]:
+   static const CompositeSliceFunc funcs[2][2] =
+   {
+      { &vvSoftPer::compositeSliceNearest<false>,  &vvSoftPer::compositeSliceNearest<true>  },
+      { &vvSoftPer::compositeSliceBilinear<false>, &vvSoftPer::compositeSliceBilinear<true> }
+   };
+   const CompositeSliceFunc compositeSlice = funcs[sliceInterpol][_clipMode != 0];
+
    for (i=0; i<len[2]; ++i)                       // traverse volume slice by slice
    {
       // Determine slice index which depends on the stacking order:
       if (stacking) slice = i;
       else slice = len[2] - i - 1;
 
-      // Composite slice according to current rendering mode:
-      if (sliceInterpol) compositeSliceBilinear(slice, from, to);
-      else compositeSliceNearest(slice, from, to);
+      (this->*compositeSlice)(slice, from, to);
    }
 }
 
@@ -108,6 +115,7 @@ ia := ia + va * (1 - ia)
 @param from    first intermediate image line to render (bottom-most line, -1 to render all lines)
 @param to      last intermediate image line to render (top-most line)
 */
+template <bool Clipping>
 void vvSoftPer::compositeSliceNearest(int slice, int from, int to)
 {
 #define FLOAT_MATH                             // undefine for integer math
@@ -207,7 +215,7 @@ void vvSoftPer::compositeSliceNearest(int slice, int from, int to)
 #endif
          if ((ia<255) &&                          // early ray termination for opaque image pixels
                                                   // skip clipped voxels
-            (_clipMode == 0 || (!isVoxelClipped(vPosX >> 16, vPosY >> 16, slice))))
+            (!Clipping || (!isVoxelClipped(vPosX >> 16, vPosY >> 16, slice))))
          {
             // Determine voxel color components and scale to [0..1]:
 #ifdef FLOAT_MATH
@@ -265,6 +273,7 @@ void vvSoftPer::compositeSliceNearest(int slice, int from, int to)
   @param from    first intermediate image line to render (bottom-most line, -1 to render all lines)
   @param to      last intermediate image line to render (top-most line)
 */
+template <bool Clipping>
 void vvSoftPer::compositeSliceBilinear(int slice, int from, int to)
 {
    vvVector3 vStart;                              // bottom left voxel of the current slice
@@ -353,7 +362,7 @@ void vvSoftPer::compositeSliceBilinear(int slice, int from, int to)
 
          if ((ia<255) &&                          // early ray termination for opaque image pixels
                                                   // skip clipped voxels
-            (_clipMode == 0 || (!isVoxelClipped((int)vPosX, (int)vPosY, slice))))
+            (!Clipping || (!isVoxelClipped((int)vPosX, (int)vPosY, slice))))
          {
             // Determine voxel color components and scale to [0..1]:
             if (zoomMode)
@@ -89,8 +89,11 @@ class VIRVOEXPORT vvSoftPer : public vvSoftVR
       vvMatrix diConv;                           ///< convert deformed space to intermediate image space
       vvMatrix sdShear;                          ///< shear matrix from standard object space to deformed (sheared) space
 
-      void compositeSliceNearest(int, int = -1, int = -1);
-      void compositeSliceBilinear(int, int = -1, int = -1);
+      /// Pointer to one of the specialized slice compositing functions
+      typedef void (vvSoftPer::*CompositeSliceFunc)(int, int, int);
+
+      template <bool Clipping> void compositeSliceNearest(int, int = -1, int = -1);
+      template <bool Clipping> void compositeSliceBilinear(int, int = -1, int = -1);
       void interpolateVoxels(uchar*, float, float, float*, float*, float*, float*);
       void accumulateVoxels(uchar*, float, float, float, float, float*, float*, float*, float*);
       void setQuality(float);
@@ -13,10 +13,14 @@
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "vvaabb.h"
+#include "vvatomic.h"
+#include "vvclock.h"
 #include "vvdebugmsg.h"
 #include "vvpthread.h"
 #include "vvsoftrayrend.h"
+#include "vvbrickcache.h"
 #include "vvtoolshed.h"
+#include "vvtrace.h"
 #include "vvvoldesc.h"
 
 #include "mem/allocator.h"
@@ -35,6 +39,7 @@
 #endif
 
 #include <cstdlib>
+#include <algorithm>
 #include <cstring>
 #include <queue>
 
@@ -125,7 +130,7 @@ inline T vec_cast(U u)
 #endif
 }
 
-inline Vec volume(uint8_t* raw, index_t idx)
+inline Vec volume(const uint8_t* raw, index_t idx)
 {
 #if VV_USE_SSE
 #if 0//__LP64__
@@ -145,7 +150,7 @@ inline Vec volume(uint8_t* raw, index_t idx)
 #endif
 }
 
-inline Vec4 rgba(vecf* tf, Vecs idx)
+inline Vec4 rgba(vecf const* tf, Vecs idx)
 {
 #if VV_USE_SSE
   CACHE_ALIGN int indices[4];
@@ -180,6 +185,17 @@ inline Vec pixely(int y)
 #endif
 }
 
+// Round up, v must not be negative
+inline Vec ceilPositive(Vec const& v)
+{
+  Vec t = vec_cast<Vec>(vec_cast<Vecs>(v));
+#if VV_USE_SSE
+  return if_else(t + 1.0f, t, t < v);
+#else
+  return t < v ? t + 1.0f : t;
+#endif
+}
+
 struct Ray
 {
   Vec3 o;
@@ -215,14 +231,94 @@ Vec intersectBox(const Ray& ray, const AABB& aabb,
   return ((tmax >= tmin) && (tmax >= 0.0f));
 }
 
+// Distance between samples along a ray [voxels] for a volume of size vox
+static float sampleDistance(const vvsize3& vox, float quality)
+{
+  const float diagonalVoxels = sqrtf(float(vox[0] * vox[0] +
+                                           vox[1] * vox[1] +
+                                           vox[2] * vox[2]));
+  size_t numSlices = std::max(size_t(1), static_cast<size_t>(quality * diagonalVoxels));
+  return diagonalVoxels / float(numSlices);
+}
+
+// Sample coordinates [voxels] of an object space point, or of a direction
+// if p[3] is 0. This is the inverse of objectCoords() below and matches
+// the mapping in vvSoftRayRend::renderTile()
+static virvo::Vec3 sampleCoords(const vvVolDesc* vd, const virvo::Vec4& p)
+{
+  const virvo::Vec3 size2 = vd->getSize() * 0.5f;
+  virvo::Vec3 result(( p[0] - (vd->pos[0] - size2[0]) * p[3]) / (size2[0] * 2.0f),
+                     (-p[1] - (vd->pos[1] - size2[1]) * p[3]) / (size2[1] * 2.0f),
+                     (-p[2] - (vd->pos[2] - size2[2]) * p[3]) / (size2[2] * 2.0f));
+  for (size_t i = 0; i < 3; ++i)
+  {
+    result[i] *= float(std::max(vd->vox[i], size_t(2)) - 1);
+  }
+  return result;
+}
+
+// Object space box of the sample coordinates [lo..hi] (texture coordinates
+// for lo and hi in [0..1])
+static void objectBox(const vvVolDesc* vd, const virvo::Vec3& lo, const virvo::Vec3& hi,
+                      virvo::Vec3* minCorner, virvo::Vec3* maxCorner)
+{
+  const virvo::Vec3 size2 = vd->getSize() * 0.5f;
+  for (size_t i = 0; i < 3; ++i)
+  {
+    float a = lo[i] * size2[i] * 2.0f - size2[i] + vd->pos[i];
+    float b = hi[i] * size2[i] * 2.0f - size2[i] + vd->pos[i];
+    if (i > 0)
+    {
+      // y and z are flipped
+      a = -a;
+      b = -b;
+    }
+    (*minCorner)[i] = std::min(a, b);
+    (*maxCorner)[i] = std::max(a, b);
+  }
+}
+
+/** Voxels that a render pass samples: the whole volume, or one brick
+  of an out-of-core volume. Bricks are rendered front to back, each pass
+  continues the rays of the passes before.
+*/
+struct vvSoftRayRend::Region
+{
+  const uint8_t* raw;
+  virvo::size3 vox;         ///< size of the level of detail that is sampled
+  float alphaScale;         ///< opacity correction relative to the sample distance
+  virvo::size3 first;       ///< voxel stored at raw[0]
+  virvo::size3 last;        ///< last voxel stored
+  virvo::size3 size;        ///< voxels stored along each axis
+  virvo::Vec3 minCorner;    ///< object space box to render
+  virvo::Vec3 maxCorner;
+  virvo::Vec3 volumeMin;    ///< object space box of the whole volume
+  virvo::Vec3 volumeMax;
+  bool bricked;             ///< composite over the color buffer
+};
+
+/** Immutable transfer function snapshot. A new snapshot is published
+  whenever the transfer function changes, a frame renders against the
+  snapshot that was current when it started.
+*/
+struct vvSoftRayRend::TFSnapshot
+{
+  vecf rgba;
+  size_t lutEntries;
+  long version;
+};
+
 struct vvSoftRayRend::Thread
 {
   size_t id;
   pthread_t threadHandle;
 
   vvSoftRayRend* renderer;
+  RenderTileFunc renderTileFunc;
+  TFSnapshot const* tf;
   Matrix invViewMatrix;
   vecf* colors;
+  Region const* region;
 
   pthread_barrier_t* barrier;
   pthread_mutex_t* mutex;
@@ -239,7 +335,93 @@ struct vvSoftRayRend::Thread
 
 struct vvSoftRayRend::Impl
 {
-  vecf rgbaTF;
+  Impl()
+    : tf(NULL)
+    , tfInUse(NULL)
+    , tfVersion(0)
+    , bricks(NULL)
+    , lodLevel(0)
+    , lastMoving(false)
+    , lastFrameTime(0.0f)
+  {
+  }
+
+  ~Impl()
+  {
+    delete tf.load();
+    for (std::vector<TFSnapshot*>::const_iterator it = retiredTFs.begin();
+         it != retiredTFs.end(); ++it)
+    {
+      delete *it;
+    }
+  }
+
+  // RGBA color buffer of the last frame
+  vecf colors;
+
+  // Most recently published transfer function
+  virvo::AtomicPtr<TFSnapshot> tf;
+  // Transfer function the current frame renders with (NULL if idle)
+  virvo::AtomicPtr<TFSnapshot> tfInUse;
+  // Replaced transfer functions that may still be in use
+  std::vector<TFSnapshot*> retiredTFs;
+  // Serializes transfer function updates, never taken by the render threads
+  virvo::Mutex tfMutex;
+  long tfVersion;
+
+  // Out-of-core volume data, NULL if the volume is in memory
+  virvo::BrickCache* bricks;
+
+  // Level of detail that met the frame time while the view changed
+  size_t lodLevel;
+  // View and render time of the last frame
+  vvMatrix lastMv;
+  vvMatrix lastPr;
+  bool lastMoving;
+  float lastFrameTime;
+
+  // Acquire the current transfer function for a frame.
+  // Does not block, even if a transfer function update is in progress
+  TFSnapshot const* acquireTF()
+  {
+    TFSnapshot* result = tf.load();
+    for (;;)
+    {
+      tfInUse.store(result);
+      TFSnapshot* current = tf.load();
+      if (current == result)
+        return result;
+      result = current;
+    }
+  }
+
+  // Signal that the frame is done with its transfer function
+  void releaseTF()
+  {
+    tfInUse.store(NULL);
+  }
+
+  // Make snapshot the current transfer function. Replaced transfer
+  // functions are freed once no frame renders with them anymore
+  void publishTF(TFSnapshot* snapshot)
+  {
+    virvo::ScopedLock lock(&tfMutex);
+
+    snapshot->version = ++tfVersion;
+    retiredTFs.push_back(tf.exchange(snapshot));
+
+    TFSnapshot* inUse = tfInUse.load();
+    std::vector<TFSnapshot*> stillInUse;
+    for (std::vector<TFSnapshot*>::const_iterator it = retiredTFs.begin();
+         it != retiredTFs.end(); ++it)
+    {
+      if (*it == inUse)
+        stillInUse.push_back(*it);
+      else
+        delete *it;
+    }
+    retiredTFs.swap(stillInUse);
+  }
 };
 
 vvSoftRayRend::vvSoftRayRend(vvVolDesc* vd, vvRenderState renderState)
@@ -257,6 +439,13 @@ vvSoftRayRend::vvSoftRayRend(vvVolDesc* vd, vvRenderState renderState)
 
   updateTransferFunction();
 
+  // Volumes loaded without their voxels from bricked files are paged in
+  // brick by brick
+  if (vd->frames == 0 && virvo::BrickCache::isBrickFile(vd->getFilename()))
+  {
+    impl->bricks = virvo::BrickCache::open(vd->getFilename());
+  }
+
   size_t numThreads = static_cast<size_t>(vvToolshed::getNumProcessors());
   char* envNumThreads = getenv("VV_NUM_THREADS");
   if (envNumThreads != NULL)
@@ -322,6 +511,12 @@ vvSoftRayRend::~vvSoftRayRend()
     delete *it;
   }
 
+  if (impl->bricks != NULL)
+  {
+    impl->bricks->prefetch(this, std::vector<size_t>());
+    virvo::BrickCache::close(impl->bricks);
+  }
+
   delete impl;
 }
 
@@ -329,67 +524,389 @@ void vvSoftRayRend::renderVolumeGL()
 {
   vvDebugMsg::msg(3, "vvSoftRayRend::renderVolumeGL()");
 
-  Matrix mv;
-  Matrix pr;
+  vvMatrix mv;
+  vvMatrix pr;
+  int w = _width;
+  int h = _height;
 
 #ifdef HAVE_OPENGL
   mv = virvo::gltools::getModelViewMatrix();
   pr = virvo::gltools::getProjectionMatrix();
   const virvo::Viewport viewport = vvGLTools::getViewport();
-  _width = viewport[2];
-  _height = viewport[3];
+  w = viewport[2];
+  h = viewport[3];
+#endif
+
+  renderVolume(mv, pr, w, h);
+
+#ifdef HAVE_OPENGL
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glWindowPos2i(0, 0);
+  glDrawPixels(_width, _height, GL_RGBA, GL_FLOAT, &impl->colors[0]);
 #endif
+}
+
+/** Render the volume into the color buffer, OpenGL is not required.
+  Use getColorBuffer() to retrieve the result.
+  @param mv   modelview matrix
+  @param pr   projection matrix
+  @param w,h  image size [pixels]
+*/
+void vvSoftRayRend::renderVolume(const vvMatrix& mv, const vvMatrix& pr, int w, int h)
+{
+  vvDebugMsg::msg(3, "vvSoftRayRend::renderVolume()");
+
+  VV_TRACE_ZONE("vvSoftRayRend::renderVolume");
+
+  vvStopwatch stopwatch;
+  stopwatch.start();
+
+  _width = w;
+  _height = h;
 
   Matrix invViewMatrix = mv;
-  invViewMatrix = pr * invViewMatrix;
+  invViewMatrix = Matrix(pr) * invViewMatrix;
   invViewMatrix.invert();
 
-  std::vector<Tile> tiles = makeTiles(_width, _height);
+  impl->colors.resize(_width * _height * 4);
+  std::fill(impl->colors.begin(), impl->colors.end(), 0.0f);
 
-  vecf colors;
-  colors.resize(_width * _height * 4);
+  size_t level = impl->bricks != NULL ? 0 : selectLevel(mv, pr);
+  if (vd->getLevelRaw(level) == NULL)
+  {
+    level = 0;
+  }
+
+  // Select the render kernel once per frame so that the per-sample
+  // loop doesn't have to branch on the render flags. Coarser levels
+  // always need opacity correction to look like the volume.
+  RenderTileFunc renderTileFunc = getRenderTileFunc(_opacityCorrection || level > 0);
+
+  // All threads render with the same transfer function, even if
+  // it is updated while the frame is in flight
+  TFSnapshot const* tf = impl->acquireTF();
 
   for (std::vector<Thread*>::const_iterator it = _threads.begin();
        it != _threads.end(); ++it)
   {
+    (*it)->renderTileFunc = renderTileFunc;
+    (*it)->tf = tf;
     (*it)->invViewMatrix = invViewMatrix;
-    (*it)->colors = &colors;
+    (*it)->colors = &impl->colors;
+  }
+
+  if (impl->bricks != NULL)
+  {
+    renderBricks(mv, pr);
+  }
+  else
+  {
+    Region region;
+    region.raw = vd->getLevelRaw(level);
+    region.vox = vd->getLevelSize(level);
+    region.alphaScale = 1.0f;
+    region.first = virvo::size3(0, 0, 0);
+    region.size = region.vox;
+    region.last = region.vox - virvo::size3(1, 1, 1);
+    region.bricked = false;
+
+    if (level > 0)
+    {
+      // A sample of the level stands for several samples of the volume.
+      // Without opacity correction the opacities are meant per sample.
+      region.alphaScale = float(vd->vox[0]) / float(region.vox[0]);
+      if (!_opacityCorrection)
+      {
+        region.alphaScale /= sampleDistance(vd->vox, _quality);
+      }
+    }
+
+    virvo::size3 minVox = _visibleRegion.getMin();
+    virvo::size3 maxVox = _visibleRegion.getMax();
+    for (size_t i = 0; i < 3; ++i)
+    {
+      minVox[i] = std::max(minVox[i], size_t(0));
+      maxVox[i] = std::min(maxVox[i], vd->vox[i]);
+    }
+    region.minCorner = vd->objectCoords(minVox);
+    region.maxCorner = vd->objectCoords(maxVox);
+    region.volumeMin = region.minCorner;
+    region.volumeMax = region.maxCorner;
+
+    std::vector<Tile> tiles = makeTiles(_width, _height);
+    renderRegion(region, tiles);
+  }
+
+  impl->releaseTF();
+
+  impl->lastFrameTime = stopwatch.getTime();
+}
+
+/** Select the level of detail to render a frame with. Levels are coarser
+  where a voxel of the volume is smaller than a pixel. While the view
+  changes, levels are also coarsened until a frame takes at most
+  _lodFrameTime seconds. When it stops changing, the finest level that
+  makes sense on screen is rendered again.
+*/
+size_t vvSoftRayRend::selectLevel(const vvMatrix& mv, const vvMatrix& pr)
+{
+  const size_t numLevels = _lod ? vd->getNumLevels() : 1;
+
+  const bool moving = !mv.equal(impl->lastMv) || !pr.equal(impl->lastPr);
+  impl->lastMv = mv;
+  impl->lastPr = pr;
+
+  if (numLevels <= 1)
+  {
+    impl->lastMoving = moving;
+    return 0;
+  }
+
+  // Size of a voxel on screen at the center of the volume [pixels]
+  virvo::Matrix viewProj = pr;
+  viewProj = viewProj * mv;
+  const virvo::Vec3 size = vd->getSize();
+  const virvo::Vec4 c = viewProj * virvo::Vec4(vd->pos[0], vd->pos[1], vd->pos[2], 1.0f);
+  float pixelsPerVoxel = 0.0f;
+  for (size_t i = 0; i < 3; ++i)
+  {
+    virvo::Vec4 p(vd->pos[0], vd->pos[1], vd->pos[2], 1.0f);
+    p[i] += size[i] / float(vd->vox[i]);
+    p = viewProj * p;
+    if (c[3] <= 0.0f || p[3] <= 0.0f)
+    {
+      // the eye is inside or close to the volume
+      pixelsPerVoxel = 1.0f;
+      break;
+    }
+    const float dx = (p[0] / p[3] - c[0] / c[3]) * 0.5f * float(_width);
+    const float dy = (p[1] / p[3] - c[1] / c[3]) * 0.5f * float(_height);
+    pixelsPerVoxel = std::max(pixelsPerVoxel, sqrtf(dx * dx + dy * dy));
+  }
+
+  size_t level = 0;
+  while (level + 1 < numLevels && pixelsPerVoxel * float(size_t(1) << (level + 1)) <= 1.0f)
+  {
+    ++level;
+  }
+
+  if (moving && _lodFrameTime > 0.0f)
+  {
+    // Each level halves the samples per ray
+    if (impl->lastMoving && impl->lastFrameTime > _lodFrameTime && impl->lodLevel + 1 < numLevels)
+    {
+      ++impl->lodLevel;
+    }
+    else if (impl->lastMoving && impl->lastFrameTime * 2.0f < _lodFrameTime && impl->lodLevel > 0)
+    {
+      --impl->lodLevel;
+    }
+    level = std::max(level, impl->lodLevel);
+  }
+
+  impl->lastMoving = moving;
+  return level;
+}
+
+/** Render the tiles of one region with all threads, the per-frame
+  state of the threads must be set up
+*/
+void vvSoftRayRend::renderRegion(const Region& region, std::vector<Tile>& tiles)
+{
+  for (std::vector<Thread*>::const_iterator it = _threads.begin();
+       it != _threads.end(); ++it)
+  {
+    pthread_mutex_lock((*it)->mutex);
+    (*it)->region = &region;
     (*it)->tiles = &tiles;
     (*it)->events.push(Thread::VV_RENDER);
+    pthread_mutex_unlock((*it)->mutex);
   }
   pthread_barrier_wait(_firstThread->barrier);
 
   // threads render
 
   pthread_barrier_wait(_firstThread->barrier);
-#ifdef HAVE_OPENGL
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glWindowPos2i(0, 0);
-  glDrawPixels(_width, _height, GL_RGBA, GL_FLOAT, &colors[0]);
-#endif
 }
 
-void vvSoftRayRend::updateTransferFunction()
+/** Render an out-of-core volume brick by brick in front-to-back order.
+  The brick cache loads the bricks in that order while the bricks in
+  front are rendered.
+*/
+void vvSoftRayRend::renderBricks(const vvMatrix& mv, const vvMatrix& pr)
 {
-  vvDebugMsg::msg(3, "vvSoftRayRend::updateTransferFunction()");
+  VV_TRACE_ZONE("vvSoftRayRend::renderBricks");
+
+  virvo::BrickCache* cache = impl->bricks;
 
-  if (_firstThread != NULL && _firstThread->mutex != NULL)
+  virvo::Matrix viewProj = pr;
+  viewProj = viewProj * mv;
+  virvo::Matrix invViewProj = viewProj;
+  invViewProj.invert();
+
+  // The eye is where all rays meet, the clip space point (0,0,1,0).
+  // For orthographic projections this is the viewing direction.
+  virvo::Vec4 eye = invViewProj * virvo::Vec4(0.0f, 0.0f, 1.0f, 0.0f);
+  const bool perspective = fabsf(eye[3]) > 1e-6f * (fabsf(eye[0]) + fabsf(eye[1]) + fabsf(eye[2]));
+  if (perspective)
   {
-    pthread_mutex_lock(_firstThread->mutex);
+    eye = eye / eye[3];
   }
+  const virvo::Vec3 eyeSample = sampleCoords(vd, eye);
+
+  virvo::Vec3 volumeMin;
+  virvo::Vec3 volumeMax;
+  objectBox(vd, virvo::Vec3(0.0f, 0.0f, 0.0f), virvo::Vec3(1.0f, 1.0f, 1.0f), &volumeMin, &volumeMax);
+
+  std::vector<Tile> allTiles = makeTiles(_width, _height);
+
+  // Visible bricks and their distances. The bricks form a grid of equal
+  // cubes in sample coordinates, so sorting by the distance of the cube
+  // centers gives a valid visibility order for all rays.
+  const size_t brickSize = cache->getBrickSize();
+  std::vector<std::pair<float, size_t> > sorted;
+  std::vector<virvo::Vec3> minCorners(cache->getNumBricks());
+  std::vector<virvo::Vec3> maxCorners(cache->getNumBricks());
+  for (size_t i = 0; i < cache->getNumBricks(); ++i)
+  {
+    const virvo::BrickCache::Brick& b = cache->getBrick(i);
+
+    virvo::Vec3 lo;
+    virvo::Vec3 hi;
+    bool empty = false;
+    for (size_t j = 0; j < 3; ++j)
+    {
+      // texture coordinates of the samples the brick owns, clipped to the visible region
+      const float n = float(std::max(vd->vox[j], size_t(2)) - 1);
+      lo[j] = std::max(b.first[j] / n,
+                       float(std::min(_visibleRegion.getMin()[j], vd->vox[j])) / vd->vox[j]);
+      hi[j] = std::min(std::min(b.first[j] + b.size[j], vd->vox[j] - 1) / n,
+                       float(std::min(_visibleRegion.getMax()[j], vd->vox[j])) / vd->vox[j]);
+      empty = empty || lo[j] >= hi[j];
+    }
+    if (empty)
+    {
+      continue;
+    }
+    objectBox(vd, lo, hi, &minCorners[i], &maxCorners[i]);
 
-  size_t lutEntries = getLUTSize();
-  impl->rgbaTF.resize(4 * lutEntries);
+    virvo::Vec3 center;
+    for (size_t j = 0; j < 3; ++j)
+    {
+      center[j] = b.first[j] + brickSize * 0.5f;
+    }
+
+    float key;
+    if (perspective)
+    {
+      const virvo::Vec3 d = center - eyeSample;
+      key = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+    }
+    else
+    {
+      key = center[0] * eyeSample[0] + center[1] * eyeSample[1] + center[2] * eyeSample[2];
+    }
+    sorted.push_back(std::make_pair(key, i));
+  }
+  std::sort(sorted.begin(), sorted.end());
 
-  vd->computeTFTexture(lutEntries, 1, 1, &impl->rgbaTF[0]);
+  std::vector<size_t> order;
+  for (size_t i = 0; i < sorted.size(); ++i)
+  {
+    order.push_back(sorted[i].second);
+  }
+  cache->prefetch(this, order);
 
-  if (_firstThread != NULL && _firstThread->mutex != NULL)
+  for (std::vector<size_t>::const_iterator it = order.begin(); it != order.end(); ++it)
   {
-    pthread_mutex_unlock(_firstThread->mutex);
+    const virvo::BrickCache::Brick& b = cache->getBrick(*it);
+
+    // image tiles the brick projects to
+    std::vector<Tile> tiles;
+    int rect[4] = { _width, _height, -1, -1 };
+    bool clipped = false;
+    for (size_t c = 0; c < 8 && !clipped; ++c)
+    {
+      const virvo::Vec4 corner((c & 1) ? maxCorners[*it][0] : minCorners[*it][0],
+                               (c & 2) ? maxCorners[*it][1] : minCorners[*it][1],
+                               (c & 4) ? maxCorners[*it][2] : minCorners[*it][2],
+                               1.0f);
+      const virvo::Vec4 p = viewProj * corner;
+      if (p[3] <= 0.0f)
+      {
+        // crosses the eye plane
+        clipped = true;
+        break;
+      }
+      const float px = (p[0] / p[3] + 1.0f) * 0.5f * float(_width - 1);
+      const float py = (p[1] / p[3] + 1.0f) * 0.5f * float(_height - 1);
+      rect[0] = std::min(rect[0], int(floorf(px)) - 1);
+      rect[1] = std::min(rect[1], int(floorf(py)) - 1);
+      rect[2] = std::max(rect[2], int(ceilf(px)) + 1);
+      rect[3] = std::max(rect[3], int(ceilf(py)) + 1);
+    }
+    for (std::vector<Tile>::const_iterator t = allTiles.begin(); t != allTiles.end(); ++t)
+    {
+      if (clipped || (t->right > rect[0] && t->left <= rect[2] && t->top > rect[1] && t->bottom <= rect[3]))
+      {
+        tiles.push_back(*t);
+      }
+    }
+    if (tiles.empty())
+    {
+      continue;
+    }
+
+    const uint8_t* raw = cache->acquire(this, *it);
+    if (raw == NULL)
+    {
+      VV_LOG(0) << "vvSoftRayRend: cannot load brick " << *it;
+      continue;
+    }
+
+    Region region;
+    region.raw = raw;
+    region.vox = vd->vox;
+    region.alphaScale = 1.0f;
+    region.first = b.first;
+    region.size = b.stored;
+    region.last = b.first + b.stored - virvo::size3(1, 1, 1);
+    region.minCorner = minCorners[*it];
+    region.maxCorner = maxCorners[*it];
+    region.volumeMin = volumeMin;
+    region.volumeMax = volumeMax;
+    region.bricked = true;
+
+    renderRegion(region, tiles);
+
+    cache->release(*it);
   }
 }
 
+/** RGBA color buffer (32 bit float per channel) that the
+  last frame was rendered to, size is w x h from renderVolume()
+*/
+const float* vvSoftRayRend::getColorBuffer() const
+{
+  return impl->colors.empty() ? NULL : &impl->colors[0];
+}
+
+void vvSoftRayRend::updateTransferFunction()
+{
+  vvDebugMsg::msg(3, "vvSoftRayRend::updateTransferFunction()");
+
+  // Build the new lookup table aside and publish it when it is
+  // complete, so that render threads never see a partial update
+  TFSnapshot* snapshot = new TFSnapshot;
+  snapshot->lutEntries = getLUTSize();
+  snapshot->rgba.resize(4 * snapshot->lutEntries);
+
+  vd->computeTFTexture(snapshot->lutEntries, 1, 1, &snapshot->rgba[0]);
+
+  impl->publishTF(snapshot);
+}
+
 size_t vvSoftRayRend::getLUTSize() const
 {
   vvDebugMsg::msg(3, "vvSoftRayRend::getLUTSize()");
@@ -442,30 +959,56 @@ std::vector<vvSoftRayRend::Tile> vvSoftRayRend::makeTiles(int w, int h)
   return result;
 }
 
+vvSoftRayRend::RenderTileFunc vvSoftRayRend::getRenderTileFunc(bool opacityCorrection) const
+{
+  vvDebugMsg::msg(3, "vvSoftRayRend::getRenderTileFunc()");
+
+  // Indexed by [interpolation][opacity correction][early ray termination]
+  static const RenderTileFunc funcs[2][2][2] =
+  {
+    {
+      { &vvSoftRayRend::renderTile<false, false, false>, &vvSoftRayRend::renderTile<false, false, true> },
+      { &vvSoftRayRend::renderTile<false, true,  false>, &vvSoftRayRend::renderTile<false, true,  true> }
+    },
+    {
+      { &vvSoftRayRend::renderTile<true,  false, false>, &vvSoftRayRend::renderTile<true,  false, true> },
+      { &vvSoftRayRend::renderTile<true,  true,  false>, &vvSoftRayRend::renderTile<true,  true,  true> }
+    }
+  };
+
+  return funcs[_interpolation][opacityCorrection][_earlyRayTermination];
+}
+
+/** Render one image tile. The render flags are template parameters
+  so that the innermost sample loop is free of branches on them,
+  use getRenderTileFunc() to select a specialization at runtime.
+*/
+template <bool Interpolation, bool OpacityCorrection, bool EarlyRayTermination>
 void vvSoftRayRend::renderTile(const vvSoftRayRend::Tile& tile, const Thread* thread)
 {
   vvDebugMsg::msg(3, "vvSoftRayRend::renderTile()");
 
   static const Vec opacityThreshold = 0.95f;
 
-  virvo::size3 minVox = _visibleRegion.getMin();
-  virvo::size3 maxVox = _visibleRegion.getMax();
-  for (size_t i = 0; i < 3; ++i)
-  {
-    minVox[i] = std::max(minVox[i], size_t(0));
-    maxVox[i] = std::min(maxVox[i], vd->vox[i]);
-  }
-  const virvo::Vec3 minCorner = vd->objectCoords(minVox);
-  const virvo::Vec3 maxCorner = vd->objectCoords(maxVox);
-  const AABB aabb(minCorner, maxCorner);
+  using std::max;
+
+  const Region& region = *thread->region;
+  const AABB aabb(region.minCorner, region.maxCorner);
+  const AABB volumeAabb(region.volumeMin, region.volumeMax);
+  const dim_t first[3] = { dim_t(region.first[0]), dim_t(region.first[1]), dim_t(region.first[2]) };
+  const dim_t last[3] = { dim_t(region.last[0]), dim_t(region.last[1]), dim_t(region.last[2]) };
 
   Vec3 size2 = vd->getSize() * 0.5f;
-  const float diagonalVoxels = sqrtf(float(vd->vox[0] * vd->vox[0] +
-                                           vd->vox[1] * vd->vox[1] +
-                                           vd->vox[2] * vd->vox[2]));
-  size_t numSlices = std::max(size_t(1), static_cast<size_t>(_quality * diagonalVoxels));
+  const float sampleDist = sampleDistance(region.vox, _quality);
+  const vvsize3& vox = region.vox;
+
+  const uint8_t* raw = region.raw;
+  const vecf* rgbaTF = &thread->tf->rgba;
+  const float lutSize = static_cast<float>(thread->tf->lutEntries);
 
-  uint8_t* raw = vd->getRaw(vd->getCurrentFrame());
+  // Sample and ray counters for tracing, counted per packet of rays
+  long samples = 0;
+  long terminated = 0;
 
   for (int y = tile.bottom; y < tile.top; y += PACK_SIZE_Y)
   {
@@ -491,12 +1034,47 @@ void vvSoftRayRend::renderTile(const vvSoftRayRend::Tile& tile, const Thread* th
       Vec active = intersectBox(ray, aabb, &tbnear, &tbfar);
       if (any(active))
       {
-        Vec dist = diagonalVoxels / Vec(numSlices);
+        Vec dist = sampleDist;
         Vec t = tbnear;
-        Vec3 pos = ray.o + ray.d * tbnear;
-        const Vec3 step = ray.d * dist;
         Vec4 dst(0.0f);
 
+        if (region.bricked)
+        {
+          // Continue the rays of the bricks in front. Sample at the same
+          // distances as for the whole volume, so that brick boundaries
+          // are neither skipped nor sampled twice.
+          Vec tvnear = 0.0f;
+          Vec tvfar = 0.0f;
+          intersectBox(ray, volumeAabb, &tvnear, &tvfar);
+          t = tvnear + ceilPositive(max((tbnear - tvnear) / dist, Vec(0.0f))) * dist;
+          active = active && (t < tbfar);
+
+#if VV_USE_SSE
+          CACHE_ALIGN float c[4][4];
+          for (int y1 = y; y1 < y + PACK_SIZE_Y; ++y1)
+          {
+            for (int x1 = x; x1 < x + PACK_SIZE_X; ++x1)
+            {
+              for (size_t i = 0; i < 4; ++i)
+              {
+                c[i][(y1 - y) * PACK_SIZE_X + (x1 - x)] = (*thread->colors)[y1 * _width * 4 + x1 * 4 + i];
+              }
+            }
+          }
+          dst = Vec4(Vec(c[0]), Vec(c[1]), Vec(c[2]), Vec(c[3]));
+#else
+          dst = Vec4(&(*thread->colors)[y * _width * 4 + x * 4]);
+#endif
+
+          if (!any(active) || (EarlyRayTermination && all(dst[3] > opacityThreshold)))
+          {
+            continue;
+          }
+        }
+
+        Vec3 pos = ray.o + ray.d * t;
+        const Vec3 step = ray.d * dist;
+
         while (true)
         {
           Vec3 texcoord((pos[0] - vd->pos[0] + size2[0]) / (size2[0] * 2.0f),
@@ -507,11 +1085,11 @@ void vvSoftRayRend::renderTile(const vvSoftRayRend::Tile& tile, const Thread* th
           texcoord[2] = clamp(texcoord[2], Vec(0.0f), Vec(1.0f));
 
           Vec sample = 0.0f;
-          if (_interpolation)
+          if (Interpolation)
           {
-            Vec3 texcoordf(texcoord[0] * float(vd->vox[0] - 1),
-                           texcoord[1] * float(vd->vox[1] - 1),
-                           texcoord[2] * float(vd->vox[2] - 1));
+            Vec3 texcoordf(texcoord[0] * float(vox[0] - 1),
+                           texcoord[1] * float(vox[1] - 1),
+                           texcoord[2] * float(vox[2] - 1));
 
             Vec3s texcoordsi[8] =
             {
@@ -530,11 +1108,11 @@ void vvSoftRayRend::renderTile(const vvSoftRayRend::Tile& tile, const Thread* th
             for (size_t i = 0; i < 8; ++i)
             {
               // clamp to edge
-              texcoordsi[i][0] = clamp<dim_t>(texcoordsi[i][0], 0, vd->vox[0] - 1);
-              texcoordsi[i][1] = clamp<dim_t>(texcoordsi[i][1], 0, vd->vox[1] - 1);
-              texcoordsi[i][2] = clamp<dim_t>(texcoordsi[i][2], 0, vd->vox[2] - 1);
+              texcoordsi[i][0] = clamp<dim_t>(texcoordsi[i][0], first[0], last[0]) - first[0];
+              texcoordsi[i][1] = clamp<dim_t>(texcoordsi[i][1], first[1], last[1]) - first[1];
+              texcoordsi[i][2] = clamp<dim_t>(texcoordsi[i][2], first[2], last[2]) - first[2];
 
-              index_t idx = texcoordsi[i][2] * vd->vox[0] * vd->vox[1] + texcoordsi[i][1] * vd->vox[0] + texcoordsi[i][0];
+              index_t idx = texcoordsi[i][2] * region.size[0] * region.size[1] + texcoordsi[i][1] * region.size[0] + texcoordsi[i][0];
               samples[i] = volume(raw, idx) / 255.0f;
             }
 
@@ -556,24 +1134,24 @@ void vvSoftRayRend::renderTile(const vvSoftRayRend::Tile& tile, const Thread* th
           else
           {
             // calc voxel coordinates using Manhattan distance
-            Vec3s texcoordi(vec_cast<Vecs>(round(texcoord[0] * float(vd->vox[0] - 1))),
-                            vec_cast<Vecs>(round(texcoord[1] * float(vd->vox[1] - 1))),
-                            vec_cast<Vecs>(round(texcoord[2] * float(vd->vox[2] - 1))));
+            Vec3s texcoordi(vec_cast<Vecs>(round(texcoord[0] * float(vox[0] - 1))),
+                            vec_cast<Vecs>(round(texcoord[1] * float(vox[1] - 1))),
+                            vec_cast<Vecs>(round(texcoord[2] * float(vox[2] - 1))));
   
             // clamp to edge
-            texcoordi[0] = clamp<dim_t>(texcoordi[0], 0, vd->vox[0] - 1);
-            texcoordi[1] = clamp<dim_t>(texcoordi[1], 0, vd->vox[1] - 1);
-            texcoordi[2] = clamp<dim_t>(texcoordi[2], 0, vd->vox[2] - 1);
+            texcoordi[0] = clamp<dim_t>(texcoordi[0], first[0], last[0]) - first[0];
+            texcoordi[1] = clamp<dim_t>(texcoordi[1], first[1], last[1]) - first[1];
+            texcoordi[2] = clamp<dim_t>(texcoordi[2], first[2], last[2]) - first[2];
 
-            index_t idx = texcoordi[2] * vd->vox[0] * vd->vox[1] + texcoordi[1] * vd->vox[0] + texcoordi[0];
+            index_t idx = texcoordi[2] * region.size[0] * region.size[1] + texcoordi[1] * region.size[0] + texcoordi[0];
             sample = volume(raw, idx) / 255.0f;
           }
 
-          Vec4 src = rgba(&impl->rgbaTF, vec_cast<Vecs>(sample * static_cast<float>(getLUTSize())) * 4);
+          Vec4 src = rgba(rgbaTF, vec_cast<Vecs>(sample * lutSize) * 4);
 
-          if (_opacityCorrection)
+          if (OpacityCorrection)
           {
-            src[3] = 1 - powf(1 - src[3], dist);
+            src[3] = 1 - powf(1 - src[3], dist * region.alphaScale);
           }
 
           // pre-multiply alpha
@@ -582,9 +1160,11 @@ void vvSoftRayRend::renderTile(const vvSoftRayRend::Tile& tile, const Thread* th
           src[2] *= src[3];
 
           dst = dst + mul(src, sub(1.0f, dst[3], active), active);
+          ++samples;
 
-          if (_earlyRayTermination && all(dst[3] > opacityThreshold))
+          if (EarlyRayTermination && all(dst[3] > opacityThreshold))
           {
+            ++terminated;
             break;
           }
 
@@ -626,6 +1206,9 @@ void vvSoftRayRend::renderTile(const vvSoftRayRend::Tile& tile, const Thread* th
       }
     }
   }
+
+  virvo::trace::samplesTaken.add(samples * PACK_SIZE_X * PACK_SIZE_Y);
+  virvo::trace::raysTerminatedEarly.add(terminated * PACK_SIZE_X * PACK_SIZE_Y);
 }
 
 void* vvSoftRayRend::renderFunc(void* args)
@@ -634,6 +1217,8 @@ void* vvSoftRayRend::renderFunc(void* args)
 
   Thread* thread = static_cast<Thread*>(args);
 
+  virvo::trace::setThreadName("vvSoftRayRend worker");
+
 #ifdef __linux__
   cpu_set_t cpuset;
   CPU_ZERO(&cpuset);
@@ -682,18 +1267,21 @@ void vvSoftRayRend::render(vvSoftRayRend::Thread* thread)
   vvDebugMsg::msg(3, "vvSoftRayRend::render()");
 
   pthread_barrier_wait(thread->barrier);
-  while (true)
   {
-    pthread_mutex_lock(thread->mutex);
-    if (thread->tiles->empty())
+    VV_TRACE_ZONE("render tiles");
+    while (true)
     {
+      pthread_mutex_lock(thread->mutex);
+      if (thread->tiles->empty())
+      {
+        pthread_mutex_unlock(thread->mutex);
+        break;
+      }
+      Tile tile = thread->tiles->back();
+      thread->tiles->pop_back();
       pthread_mutex_unlock(thread->mutex);
-      break;
+      (thread->renderer->*thread->renderTileFunc)(tile, thread);
     }
-    Tile tile = thread->tiles->back();
-    thread->tiles->pop_back();
-    pthread_mutex_unlock(thread->mutex);
-    thread->renderer->renderTile(tile, thread);
   }
   pthread_barrier_wait(thread->barrier);
 }
@@ -32,11 +32,15 @@ public:
   ~vvSoftRayRend();
 
   void renderVolumeGL(); ///< TODO: rename, no OpenGL here
+  void renderVolume(const vvMatrix& mv, const vvMatrix& pr, int w, int h);
+  const float* getColorBuffer() const;
   void updateTransferFunction();
   void setParameter(ParameterType param, const vvParam& newValue);
   vvParam getParameter(ParameterType param) const;
 private:
   struct Thread;
+  struct TFSnapshot;
+  struct Region;
   struct Tile 
   { 
     int left; 
@@ -48,6 +52,9 @@ private:
   struct Impl;
   Impl* impl;
 
+  /// Pointer to one of the specialized renderTile() kernels
+  typedef void (vvSoftRayRend::*RenderTileFunc)(const Tile& tile, const Thread* thread);
+
   int _width;
   int _height;
 
@@ -56,6 +63,11 @@ private:
 
   size_t getLUTSize() const;
   std::vector<Tile> makeTiles(int w, int h);
+  void renderRegion(const Region& region, std::vector<Tile>& tiles);
+  void renderBricks(const vvMatrix& mv, const vvMatrix& pr);
+  size_t selectLevel(const vvMatrix& mv, const vvMatrix& pr);
+  RenderTileFunc getRenderTileFunc(bool opacityCorrection) const;
+  template <bool Interpolation, bool OpacityCorrection, bool EarlyRayTermination>
   void renderTile(const Tile& tile, const Thread* thread);
 
   static void* renderFunc(void* args);
@@ -36,10 +36,10 @@ using std::endl;
 #include "vvvecmath.h"
 #include "vvsoftimg.h"
 #include "vvsoftvr.h"
-#include "vvclock.h"
 #include "vvimage.h"
 #include "vvvoldesc.h"
 #include "vvtoolshed.h"
+#include "vvtrace.h"
 
 #include "private/vvgltools.h"
 
@@ -66,7 +66,6 @@ vvSoftVR::vvSoftVR(vvVolDesc* vd, vvRenderState rs) : vvRenderer(vd, rs)
    earlyRayTermination = 0;
    oldQuality = 1.f;
    quality = 1.f;
-   _timing = false;
    _size = vd->getSize();
 
    //  setWarpMode(SOFTWARE);     // initialize warp mode
@@ -117,21 +116,13 @@ vvSoftVR::~vvSoftVR()
 void vvSoftVR::renderVolumeGL()
 {
 #ifndef VV_REMOTE_RENDERING
-   GLint matrixMode;                              // current OpenGL matrix mode
-   vvStopwatch* sw = NULL;                        // stop watch
-                                                  // rendering times
-   float preparation=0.0f, compositing=0.0f, warp=0.0f, total=0.0f;
    bool result;
 
    vvDebugMsg::msg(3, "vvSoftPer::renderVolumeGL()");
 
    if (vd->getBPV() != 1) return;                      // TODO: should work with all color depths
 
-   if (_timing)
-   {
-      sw = new vvStopwatch();
-      sw->start();
-   }
+   VV_TRACE_ZONE("vvSoftVR::renderVolumeGL");
 
    if(oldQuality != _quality)
    {
@@ -140,35 +131,20 @@ void vvSoftVR::renderVolumeGL()
    }
 
 
-   // Memorize current OpenGL matrix mode and modelview matrix
-   // because prepareRendering modifies the modelview matrix:
-   glGetIntegerv(GL_MATRIX_MODE, &matrixMode);
-   glMatrixMode(GL_MODELVIEW);
-   glPushMatrix();
-
-   result = prepareRendering();
-
-   // Undo translation:
-   glMatrixMode(GL_MODELVIEW);
-   glPopMatrix();
-   glMatrixMode(matrixMode);                      // restore matrix mode
-
-   if (!result)
    {
-      delete sw;
-      return;
+      VV_TRACE_ZONE("prepare");
+      result = prepareRendering();
    }
 
-   if (_timing)
+   if (!result)
    {
-      preparation = sw->getTime();
+      return;
    }
 
-   compositeVolume();
-
-   if (_timing)
    {
-      compositing = sw->getTime() - preparation;
+      VV_TRACE_ZONE("composite");
+      compositeVolume();
+      virvo::trace::samplesTaken.add(long(len[0]) * len[1] * len[2]);
    }
 
    if (vvDebugMsg::isActive(3))
@@ -180,6 +156,7 @@ void vvSoftVR::renderVolumeGL()
 
    if (warpMode==SOFTWARE)
    {
+      VV_TRACE_ZONE("warp");
       outImg->warp(&ivWarp, intImg);
       if (vvDebugMsg::isActive(3))
          outImg->overlay(intImg);
@@ -187,6 +164,7 @@ void vvSoftVR::renderVolumeGL()
    }
    else
    {
+      VV_TRACE_ZONE("warp");
       intImg->warpTex(&iwWarp);
       if (vvDebugMsg::isActive(3))
          intImg->draw();
@@ -196,18 +174,59 @@ void vvSoftVR::renderVolumeGL()
                                                   // draw front boundaries
       drawBoundingBox(_size, vd->pos, _boundColor /*FIXME:, true*/);
 
-   if (_timing)
+   vvRenderer::renderVolumeGL();                  // draw coordinate axes
+#endif
+}
+
+
+//----------------------------------------------------------------------------
+/** Render the volume into the output image without using OpenGL.
+  The warp is always done in software, use getOutputImage() to
+  retrieve the result. Resizing the output image needs the OpenGL
+  context, call setOutputImageSize() with w and h on its thread before
+  rendering on other threads.
+  @param mv  modelview matrix
+  @param pm  projection matrix
+  @param w,h output image size [pixels]
+*/
+void vvSoftVR::renderVolume(const vvMatrix& mv, const vvMatrix& pm, int w, int h)
+{
+   vvDebugMsg::msg(3, "vvSoftVR::renderVolume()");
+
+   if (vd->getBPV() != 1) return;                      // TODO: should work with all color depths
+
+   if(oldQuality != _quality)
    {
-      total = sw->getTime();
-      warp = total - compositing - preparation;
-      cerr << "Times [ms]: prep=" << (preparation*1000.0f) <<
-         ", comp=" << (compositing*1000.0f) << ", warp=" <<
-         (warp * 1000.0f) << ", total=" << (total*1000.0f) << endl;
-      delete sw;
+     setQuality(_quality);
+     oldQuality = _quality;
    }
 
-   vvRenderer::renderVolumeGL();                  // draw coordinate axes
-#endif
+   VV_TRACE_ZONE("vvSoftVR::renderVolume");
+
+   {
+      VV_TRACE_ZONE("prepare");
+      if (!prepareRendering(mv, pm, w, h))
+         return;
+   }
+
+   {
+      VV_TRACE_ZONE("composite");
+      compositeVolume();
+      virvo::trace::samplesTaken.add(long(len[0]) * len[1] * len[2]);
+   }
+
+   {
+      VV_TRACE_ZONE("warp");
+      outImg->warp(&ivWarp, intImg);
+   }
+}
+
+
+//----------------------------------------------------------------------------
+/// Return the output image of the last call to renderVolume().
+vvSoftImg* vvSoftVR::getOutputImage() const
+{
+   return outImg;
 }
 
 
@@ -279,27 +298,41 @@ void vvSoftVR::compositeOutline()
 
 
 //----------------------------------------------------------------------------
-/// Set new values for output image if necessary
+/// Set new values for output image from the OpenGL viewport if necessary
 void vvSoftVR::setOutputImageSize()
 {
 #ifndef VV_REMOTE_RENDERING
-   GLint viewport[4];                             // OpenGL viewport information (position and size)
+                                                  // OpenGL viewport information (position and size)
+   GLint viewport[4] = { 0, 0, 0, 0 };
 
    vvDebugMsg::msg(3, "vvSoftVR::setOutputImageSize()");
    glGetIntegerv(GL_VIEWPORT, viewport);
 
+   setOutputImageSize(viewport[2], viewport[3]);
+#endif
+}
+
+
+//----------------------------------------------------------------------------
+/** Set new values for output image if necessary. Creating the image
+  needs the OpenGL context.
+  @param w,h output image size [pixels]
+*/
+void vvSoftVR::setOutputImageSize(int w, int h)
+{
+   vvDebugMsg::msg(3, "vvSoftVR::setOutputImageSize() ", w, h);
+
    if (vWidth>0 && vHeight>0 &&
-      vWidth==viewport[2] && vHeight==viewport[3])// already done?
+      vWidth==w && vHeight==h)                    // already done?
       return;
-   vWidth = viewport[2];
-   vHeight = viewport[3];
+   vWidth = w;
+   vHeight = h;
    vvDebugMsg::msg(1, "Window dimensions: ", vWidth, vHeight);
    if (vWidth<1 || vHeight<1) vWidth = vHeight = 1;
    if (outImg != NULL) delete outImg;
    outImg = new vvSoftImg(vWidth, vHeight);
 
    findViewportMatrix(vWidth, vHeight);
-#endif
 }
 
 
@@ -614,17 +647,11 @@ int vvSoftVR::getLUTSize()
 */
 void vvSoftVR::findViewMatrix()
 {
-   vvMatrix mv;                                  // modelview matrix
-   vvMatrix pm;                                  // projection matrix
-
    vvDebugMsg::msg(3, "vvSoftVR::findViewMatrix()");
 
-   vvGLTools::getModelviewMatrix(&mv);
-   vvGLTools::getProjectionMatrix(&pm);
-
    // Compute view matrix:
-   owView = vvMatrix(mv);
-   owView.multiplyLeft(pm);
+   owView = vvMatrix(_modelviewMatrix);
+   owView.multiplyLeft(_projectionMatrix);
    if (vvDebugMsg::isActive(3)) owView.print("owView");
 }
 
@@ -963,14 +990,35 @@ void vvSoftVR::getIntermediateImageExtent(int* xmin, int* xmax, int* ymin, int*
 
 
 //----------------------------------------------------------------------------
-/** Prepare the rendering of the intermediate image: check projection type,
-    factor view matrix, etc.
+/** Prepare the rendering of the intermediate image with the current
+    OpenGL matrices and viewport.
     @return true if preparation was ok, false if an error occurred
 */
 bool vvSoftVR::prepareRendering()
 {
    vvMatrix mv;                                  // modelview matrix
    vvMatrix pm;                                  // projection matrix
+
+   vvDebugMsg::msg(3, "vvSoftVR::prepareRendering()");
+
+   vvGLTools::getModelviewMatrix(&mv);
+   vvGLTools::getProjectionMatrix(&pm);
+   const virvo::Viewport viewport = vvGLTools::getViewport();
+
+   return prepareRendering(mv, pm, viewport[2], viewport[3]);
+}
+
+
+//----------------------------------------------------------------------------
+/** Prepare the rendering of the intermediate image: check projection type,
+    factor view matrix, etc.
+    @param mv  modelview matrix
+    @param pm  projection matrix
+    @param w,h output image size [pixels]
+    @return true if preparation was ok, false if an error occurred
+*/
+bool vvSoftVR::prepareRendering(const vvMatrix& mv, const vvMatrix& pm, int w, int h)
+{
    vvMatrix trans;                               // translation matrix
 
    vvDebugMsg::msg(3, "vvSoftVR::prepareRendering()");
@@ -978,12 +1026,11 @@ bool vvSoftVR::prepareRendering()
    // Translate object by its position:
    trans.identity();
    trans.translate(vd->pos[0], vd->pos[1], vd->pos[2]);
-   vvGLTools::getModelviewMatrix(&mv);
-   mv.multiplyRight(trans);
-   vvGLTools::setModelviewMatrix(mv);
+   _modelviewMatrix = mv;
+   _modelviewMatrix.multiplyRight(trans);
+   _projectionMatrix = pm;
 
    // Make sure a parallel projection matrix is used:
-   vvGLTools::getProjectionMatrix(&pm);
    if (rendererType==SOFTPAR && !pm.isProjOrtho())
    {
       vvDebugMsg::msg(1, "Parallel projection matrix expected! Rendering aborted.");
@@ -1005,7 +1052,7 @@ bool vvSoftVR::prepareRendering()
       }
    }
 
-   setOutputImageSize();
+   setOutputImageSize(w, h);
    findViewMatrix();
    factorViewMatrix();                            // do the factorization
    findVolumeDimensions();                        // precompute the permuted volume dimensions
@@ -1047,7 +1094,6 @@ int vvSoftVR::getCullingStatus(float nearPlaneZ)
    vvVector3 volPos;                              // volume position
    float     radius;                              // bounding sphere radius
    float     volDist;                             // distance of volume from near plane
-   vvMatrix mv;                                  // modelview matrix
 
    // Generate plane equation for near plane (distance value = nearPlaneZ):
    nearNormal.set(0.0f, 0.0f, 1.0f);
@@ -1056,9 +1102,8 @@ int vvSoftVR::getCullingStatus(float nearPlaneZ)
    radius = _size.length() / 2.0f;
 
    // Find volume midpoint location:
-   vvGLTools::getModelviewMatrix(&mv);
    volPos.zero();
-   volPos.multiply(mv);
+   volPos.multiply(_modelviewMatrix);
 
    // Apply plane equation to volume midpoint:
    volDist = nearNormal.dot(volPos) - nearPlaneZ;
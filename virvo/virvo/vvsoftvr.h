@@ -115,8 +115,9 @@ class VIRVOEXPORT vvSoftVR : public vvRenderer
                                                   ///< size of pre-integrated LUT ([sf][sb][RGBA])
       uchar preIntTable[PRE_INT_TABLE_SIZE][PRE_INT_TABLE_SIZE][4];
       int earlyRayTermination;                    ///< counter for number of voxels which are skipped due to early ray termination
-      bool _timing;
       vvVector3 _size;
+      vvMatrix _modelviewMatrix;                 ///< modelview matrix of the current frame, including volume position
+      vvMatrix _projectionMatrix;                ///< projection matrix of the current frame
 
       void setOutputImageSize();
       void findVolumeDimensions();
@@ -150,9 +151,13 @@ class VIRVOEXPORT vvSoftVR : public vvRenderer
       WarpType getWarpMode();
       void     setCurrentFrame(size_t);
       void     renderVolumeGL();
+      void     setOutputImageSize(int, int);
+      void     renderVolume(const vvMatrix&, const vvMatrix&, int, int);
+      vvSoftImg* getOutputImage() const;
       void     getIntermediateImage(vvImage*);
       void     getWarpMatrix(vvMatrix*);
       bool     prepareRendering();
+      bool     prepareRendering(const vvMatrix&, const vvMatrix&, int, int);
       virtual void setParameter(ParameterType param, const vvParam& value);
       virtual vvParam getParameter(ParameterType param) const;
       virtual void compositeVolume(int = -1, int = -1) = 0;
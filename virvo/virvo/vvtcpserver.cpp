@@ -71,7 +71,8 @@ vvTcpServer::vvTcpServer(const ushort port)
     return;
   }
 
-  if (listen(sockfd, 1))
+  // allow a burst of clients to connect while earlier ones are accepted
+  if (listen(sockfd, SOMAXCONN))
   {
     vvDebugMsg::msg(0, "Error: listen()");
     return;
@@ -128,17 +129,55 @@ vvTcpSocket* vvTcpServer::nextConnection(double timeout)
     }
   }
 
-  vvsock_t n = TEMP_FAILURE_RETRY(accept(_listener->getSockfd(), (struct sockaddr *)&_hostAddr, &_hostAddrlen));
+  return accept();
+}
+
+vvTcpSocket* vvTcpServer::acceptConnection()
+{
+  if(!initStatus())
+  {
+    vvDebugMsg::msg(0, "vvTcpServer::acceptConnection() error: server not correctly initialized");
+    return NULL;
+  }
+
+  if(vvSocket::VV_OK != _listener->setParameter(vvSocket::VV_NONBLOCKING, 1.f))
+  {
+    vvDebugMsg::msg(0, "vvTcpServer::acceptConnection() error: setting O_NONBLOCK on server-socket failed");
+    return NULL;
+  }
+
+  return accept();
+}
+
+vvSocket* vvTcpServer::getSocket() const
+{
+  return _listener;
+}
+
+vvTcpSocket* vvTcpServer::accept()
+{
+  vvsock_t n = TEMP_FAILURE_RETRY(::accept(_listener->getSockfd(), (struct sockaddr *)&_hostAddr, &_hostAddrlen));
 
   if (n == VV_INVALID_SOCKET)
   {
-    vvDebugMsg::msg(0, "vvTcpServer::nextConnection() error: accept() failed", true);
+#ifdef _WIN32
+    bool pending = WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    bool pending = errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+    if (!pending)
+    {
+      vvDebugMsg::msg(0, "vvTcpServer::accept() error: accept() failed", true);
+    }
     return NULL;
   }
 
   vvTcpSocket *next = new vvTcpSocket();
   next->setSockfd(n);
 
+  // accepted sockets may inherit O_NONBLOCK from the listener
+  next->setParameter(vvSocket::VV_NONBLOCKING, 0.0f);
+
   std::ostringstream errmsg;
   errmsg << "Incoming connection from " << inet_ntoa(_hostAddr.sin_addr);
   vvDebugMsg::msg(2, errmsg.str().c_str());
@@ -54,6 +54,18 @@ public:
     @return Pointer to an ready to use vvTcpSocket or NULL if errer occured
     */
   vvTcpSocket* nextConnection(double timeout = -1.0);
+  /**
+    Accept a pending connection without waiting. Register getSocket()
+    with a vvSocketMonitor (VV_READABLE) to learn when connections are
+    pending, then call this until it returns NULL.
+    @return Pointer to an ready to use vvTcpSocket or NULL if no connection is pending
+    */
+  vvTcpSocket* acceptConnection();
+  /**
+    Get the listening socket, e.g. to register it with a vvSocketMonitor.
+    The socket is owned by the server.
+    */
+  vvSocket* getSocket() const;
 
 private:
   vvTcpSocket *_listener;
@@ -63,6 +75,8 @@ private:
 #endif
   socklen_t _hostAddrlen;
 
+  vvTcpSocket* accept();
+
 };
 
 #endif
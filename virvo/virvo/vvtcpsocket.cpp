@@ -19,15 +19,30 @@
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include <cassert>
+#include <climits>
+#include <algorithm>
 #include <sstream>
+#include <vector>
 
 #include "vvtcpsocket.h"
 #include "vvdebugmsg.h"
 
+#include "private/vvshmchannel.h"
+
+#ifndef _WIN32
+#include <limits.h>
+#include <sys/uio.h>
+#endif
+
+#if !defined(_WIN32) && !defined(IOV_MAX)
+#define IOV_MAX 16
+#endif
+
 //----------------------------------------------------------------------------
 /** Constructor
 */
 vvTcpSocket::vvTcpSocket() : vvSocket()
+  , _channel(NULL)
 {
 }
 
@@ -36,6 +51,7 @@ vvTcpSocket::vvTcpSocket() : vvSocket()
 */
 vvTcpSocket::~vvTcpSocket()
 {
+  delete _channel;
 }
 
 
@@ -193,6 +209,50 @@ vvSocket::ErrorType vvTcpSocket::disconnectFromHost()
   return VV_SOCK_ERROR;
 }
 
+//----------------------------------------------------------------------------
+bool vvTcpSocket::isLocalPeer() const
+{
+  sockaddr_in local;
+  sockaddr_in peer;
+  socklen_t localLen = sizeof(local);
+  socklen_t peerLen = sizeof(peer);
+
+  if (getsockname(_sockfd, (sockaddr*)&local, &localLen) != 0
+   || getpeername(_sockfd, (sockaddr*)&peer, &peerLen) != 0)
+  {
+    return false;
+  }
+
+  return local.sin_family == AF_INET && peer.sin_family == AF_INET
+      && local.sin_addr.s_addr == peer.sin_addr.s_addr;
+}
+
+//----------------------------------------------------------------------------
+void vvTcpSocket::setChannel(virvo::ShmChannel* channel)
+{
+  delete _channel;
+  _channel = channel;
+}
+
+//----------------------------------------------------------------------------
+virvo::ShmChannel* vvTcpSocket::getChannel() const
+{
+  return _channel;
+}
+
+//----------------------------------------------------------------------------
+/** Returns the number of bytes that can be read without waiting. With a
+ shared memory channel, these are the bytes in its ring buffer.
+ */
+int vvTcpSocket::isDataWaiting() const
+{
+  if (_channel)
+  {
+    return (int)std::min(_channel->available(), (size_t)INT_MAX);
+  }
+  return vvSocket::isDataWaiting();
+}
+
 //----------------------------------------------------------------------------
 /** Reads data from the TCP socket.
  @param buffer  pointer to the data to write
@@ -201,6 +261,9 @@ vvSocket::ErrorType vvTcpSocket::disconnectFromHost()
 */
 ssize_t vvTcpSocket::readn(char* buffer, size_t size)
 {
+  if (_channel)
+    return _channel->read(buffer, size);
+
   size_t nleft;
   ssize_t nread;
 
@@ -239,6 +302,9 @@ ssize_t vvTcpSocket::readn(char* buffer, size_t size)
 */
 ssize_t vvTcpSocket::writen(const char* buffer, size_t size)
 {
+  if (_channel)
+    return _channel->write(buffer, size);
+
   size_t nleft;
   ssize_t nwritten;
 
@@ -272,4 +338,72 @@ ssize_t vvTcpSocket::writen(const char* buffer, size_t size)
   return size;
 }
 
+//----------------------------------------------------------------------------
+/** Writes several buffers to the TCP socket with writev(), so that small
+ buffers are sent in a single packet.
+ @param buffers  buffers to write
+ @param count  number of buffers
+
+*/
+ssize_t vvTcpSocket::writevn(const Buffer* buffers, size_t count)
+{
+#ifdef _WIN32
+  return vvSocket::writevn(buffers, count);
+#else
+  if (_channel)
+    return vvSocket::writevn(buffers, count);   // one copy per buffer, no system calls
+
+  std::vector<iovec> iov;
+  ssize_t total = 0;
+
+  for (size_t i=0; i<count; ++i)
+  {
+    if (buffers[i].size == 0)
+      continue;
+
+    iovec v;
+    v.iov_base = const_cast<uchar*>(buffers[i].data);
+    v.iov_len = buffers[i].size;
+    iov.push_back(v);
+    total += buffers[i].size;
+  }
+
+  ::signal(SIGPIPE, peerUnreachable);
+
+  size_t first = 0;
+  while (first < iov.size())
+  {
+    int n = (int)std::min(iov.size() - first, (size_t)IOV_MAX);
+    ssize_t nwritten = ::writev(_sockfd, &iov[first], n);
+    if (nwritten < 0)
+    {
+      if (errno == EINTR)
+        continue;                                 // interrupted, call writev again
+
+      vvDebugMsg::msg(1, "Error: writev()");
+      return (ssize_t)-1;
+    }
+
+    // skip what was written, writev() may return early
+    size_t nleft = nwritten;
+    while (nleft > 0)
+    {
+      if (nleft >= iov[first].iov_len)
+      {
+        nleft -= iov[first].iov_len;
+        ++first;
+      }
+      else
+      {
+        iov[first].iov_base = (char*)iov[first].iov_base + nleft;
+        iov[first].iov_len -= nleft;
+        nleft = 0;
+      }
+    }
+  }
+
+  return total;
+#endif
+}
+
 // vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
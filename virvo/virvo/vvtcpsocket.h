@@ -24,6 +24,11 @@
 #include "vvexport.h"
 #include "vvsocket.h"
 
+namespace virvo
+{
+  class ShmChannel;
+}
+
 //----------------------------------------------------------------------------
 /** This class provides basic socket functionality. It is used for TCP and UDP
     sockets. For example code see documentation about vvSocket  <BR>
@@ -48,9 +53,25 @@ public:
     */
   ErrorType disconnectFromHost();
 
+  /** Returns true if the peer runs on the same host, i.e. both ends of the
+    connection have the same address
+    */
+  bool isLocalPeer() const;
+
+  /** Continue the connection over a shared memory channel, see
+    vvSocketIO::requestSharedMemory(). The socket takes ownership.
+    */
+  void setChannel(virvo::ShmChannel* channel);
+  virvo::ShmChannel* getChannel() const;
+
+  int isDataWaiting() const;
+
 private:
+  virvo::ShmChannel* _channel;
+
   ssize_t readn(char*, size_t);
   ssize_t writen(const char*, size_t);
+  ssize_t writevn(const Buffer*, size_t);
 };
 
 #endif
@@ -18,6 +18,11 @@
 // License along with this library (see license.txt); if not, write to the
 // Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
+// 64 bit file offsets for seekFile() and tellFile() on 32 bit systems
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <fstream>
 #include <iostream>
 #include <iomanip>
@@ -945,6 +950,28 @@ bool vvToolshed::isFile(const char* filename)
 #endif
 }
 
+//----------------------------------------------------------------------------
+/** Checks if two file names refer to the same existing file, e.g. through
+    different relative paths or links.
+    @return true if both files exist and are the same
+*/
+bool vvToolshed::isSameFile(const char* filename1, const char* filename2)
+{
+#ifdef _WIN32
+  char path1[MAX_PATH];
+  char path2[MAX_PATH];
+  if (!isFile(filename1) || !isFile(filename2)) return false;
+  if (GetFullPathNameA(filename1, MAX_PATH, path1, NULL) == 0) return false;
+  if (GetFullPathNameA(filename2, MAX_PATH, path2, NULL) == 0) return false;
+  return strCompare(path1, path2) == 0;
+#else
+  struct stat buf1;
+  struct stat buf2;
+  if (stat(filename1, &buf1) != 0 || stat(filename2, &buf2) != 0) return false;
+  return buf1.st_dev == buf2.st_dev && buf1.st_ino == buf2.st_ino;
+#endif
+}
+
 //----------------------------------------------------------------------------
 /** Checks if a directory exists.
     @param dir directory name to check for
@@ -998,6 +1025,36 @@ long vvToolshed::getFileSize(const char* filename)
   return size;
 }
 
+//----------------------------------------------------------------------------
+/** Sets the position of a file, also beyond 2 GB where long has 32 bits.
+    @param  fp      file pointer
+    @param  offset  offset in bytes, relative to whence
+    @param  whence  SEEK_SET, SEEK_CUR or SEEK_END
+    @return true if successful
+*/
+bool vvToolshed::seekFile(FILE* fp, int64_t offset, int whence)
+{
+#ifdef _WIN32
+  return _fseeki64(fp, offset, whence) == 0;
+#else
+  return fseeko(fp, off_t(offset), whence) == 0;
+#endif
+}
+
+//----------------------------------------------------------------------------
+/** Returns the position of a file, also beyond 2 GB where long has 32 bits.
+    @param  fp  file pointer
+    @return position in bytes or -1 on error
+*/
+int64_t vvToolshed::tellFile(FILE* fp)
+{
+#ifdef _WIN32
+  return _ftelli64(fp);
+#else
+  return int64_t(ftello(fp));
+#endif
+}
+
 //----------------------------------------------------------------------------
 /** Find the minimum and the maximum values in an uchar data array.
     @param data        source data array
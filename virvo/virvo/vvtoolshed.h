@@ -196,8 +196,11 @@ class VIRVOEXPORT vvToolshed
     static void    draw2DLine(int, int, int, int, uint, uchar*, int, int, int);
     static size_t  getTextureSize(size_t);
     static bool    isFile(const char*);
+    static bool    isSameFile(const char*, const char*);
     static bool    isDirectory(const char*);
     static long    getFileSize(const char*);
+    static bool    seekFile(FILE*, int64_t, int = SEEK_SET);
+    static int64_t tellFile(FILE*);
     static void    getMinMax(const float*, int, float*, float*);
     static void    getMinMax(const uchar*, int, int*, int*);
     static void    getMinMax16bitBE(const uchar*, int, int*, int*);
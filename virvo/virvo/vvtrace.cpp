@@ -0,0 +1,354 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#include "vvtrace.h"
+#include "vvclock.h"
+#include "vvpthread.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace virvo
+{
+namespace trace
+{
+
+namespace
+{
+
+// Number of events per thread, older events are overwritten
+const long BufferSize = 16384;
+
+struct Event
+{
+  const char* name;
+  const char* category;
+  double ts;      // [us]
+  double value;   // duration [us] for zones, value for counters
+  int tid;
+  char phase;     // 'X' = complete event, 'C' = counter
+};
+
+struct ThreadBuffer
+{
+  Event events[BufferSize];
+  // Number of events written so far. Only the owning thread writes,
+  // the atomic increment publishes the event to dump().
+  long volatile written;
+
+  ThreadBuffer() : written(0) {}
+};
+
+struct ThreadState
+{
+  int tid;
+  ThreadBuffer* buffer;
+};
+
+void releaseThreadState(void* p);
+
+struct Registry
+{
+  Mutex mutex;
+  pthread_key_t key;
+  int nextTid;
+  // All buffers ever allocated, buffers of exited threads are reused
+  std::vector<ThreadBuffer*> buffers;
+  std::vector<ThreadBuffer*> freeBuffers;
+  std::map<int, std::string> threadNames;
+
+  Registry() : nextTid(1)
+  {
+    pthread_key_create(&key, releaseThreadState);
+  }
+
+  ~Registry()
+  {
+    for (size_t i=0; i<buffers.size(); ++i)
+      delete buffers[i];
+  }
+
+  ThreadState* getThreadState()
+  {
+    ThreadState* state = static_cast<ThreadState*>(pthread_getspecific(key));
+    if (state == NULL)
+    {
+      state = new ThreadState;
+      state->buffer = NULL;
+      {
+        ScopedLock lock(&mutex);
+        state->tid = nextTid++;
+      }
+      pthread_setspecific(key, state);
+    }
+    return state;
+  }
+
+  ThreadBuffer* getBuffer(ThreadState* state)
+  {
+    if (state->buffer == NULL)
+    {
+      ScopedLock lock(&mutex);
+      if (freeBuffers.empty())
+      {
+        buffers.push_back(new ThreadBuffer);
+        state->buffer = buffers.back();
+      }
+      else
+      {
+        state->buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+      }
+    }
+    return state->buffer;
+  }
+};
+
+Registry registry;
+
+// Called when a thread exits, keeps its events for dump()
+void releaseThreadState(void* p)
+{
+  ThreadState* state = static_cast<ThreadState*>(p);
+  if (state->buffer != NULL)
+  {
+    ScopedLock lock(&registry.mutex);
+    registry.freeBuffers.push_back(state->buffer);
+  }
+  delete state;
+}
+
+void record(const char* name, const char* category, char phase, double ts, double value)
+{
+  ThreadState* state = registry.getThreadState();
+  ThreadBuffer* buffer = registry.getBuffer(state);
+
+  Event& e = buffer->events[buffer->written % BufferSize];
+  e.name = name;
+  e.category = category;
+  e.ts = ts;
+  e.value = value;
+  e.tid = state->tid;
+  e.phase = phase;
+
+  atomic::add(&buffer->written, 1);
+}
+
+Counter* firstCounter = NULL;
+
+std::string quote(const std::string& str)
+{
+  std::string result = "\"";
+  for (size_t i=0; i<str.size(); ++i)
+  {
+    if (str[i] == '"' || str[i] == '\\')
+      result += '\\';
+    result += str[i];
+  }
+  return result + "\"";
+}
+
+void writeEvent(std::ostream& out, const Event& e)
+{
+  out << "{\"name\":" << quote(e.name)
+      << ",\"cat\":" << quote(e.category)
+      << ",\"ph\":\"" << e.phase << "\""
+      << ",\"ts\":" << e.ts
+      << ",\"pid\":1,\"tid\":" << e.tid;
+  if (e.phase == 'X')
+    out << ",\"dur\":" << e.value;
+  else
+    out << ",\"args\":{\"value\":" << e.value << "}";
+  out << "}";
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// detail
+//
+
+bool volatile detail::enabled = false;
+
+double detail::now()
+{
+  return vvClock::getTime() * 1000000.0;
+}
+
+void detail::complete(const char* name, const char* category, double start, double end)
+{
+  record(name, category, 'X', start, end - start);
+}
+
+//------------------------------------------------------------------------------
+// Interface
+//
+
+void setEnabled(bool enabled)
+{
+  detail::enabled = enabled;
+}
+
+void setThreadName(const char* name)
+{
+  ThreadState* state = registry.getThreadState();
+  ScopedLock lock(&registry.mutex);
+  registry.threadNames[state->tid] = name;
+}
+
+void sampleCounters()
+{
+  if (!isEnabled())
+    return;
+
+  const double ts = detail::now();
+  for (Counter* c = firstCounter; c != NULL; c = c->next)
+    record(c->name, "counter", 'C', ts, double(c->value()));
+}
+
+void clear()
+{
+  ScopedLock lock(&registry.mutex);
+  for (size_t i=0; i<registry.buffers.size(); ++i)
+    registry.buffers[i]->written = 0;
+  for (Counter* c = firstCounter; c != NULL; c = c->next)
+    c->total.store(0);
+}
+
+void dump(std::ostream& out)
+{
+  ScopedLock lock(&registry.mutex);
+
+  std::ios_base::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3);
+
+  out << "{\"traceEvents\":[" << std::endl;
+
+  bool first = true;
+  for (std::map<int, std::string>::const_iterator it = registry.threadNames.begin();
+       it != registry.threadNames.end(); ++it)
+  {
+    out << (first ? "" : ",\n")
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << it->first
+        << ",\"args\":{\"name\":" << quote(it->second) << "}}";
+    first = false;
+  }
+
+  for (size_t i=0; i<registry.buffers.size(); ++i)
+  {
+    const ThreadBuffer* buffer = registry.buffers[i];
+    const long written = atomic::add(const_cast<long volatile*>(&buffer->written), 0);
+    const long begin = written > BufferSize ? written - BufferSize : 0;
+    for (long j=begin; j<written; ++j)
+    {
+      out << (first ? "" : ",\n");
+      writeEvent(out, buffer->events[j % BufferSize]);
+      first = false;
+    }
+  }
+
+  // Final counter values
+  const double ts = detail::now();
+  for (Counter* c = firstCounter; c != NULL; c = c->next)
+  {
+    Event e = { c->name, "counter", ts, double(c->value()), 0, 'C' };
+    out << (first ? "" : ",\n");
+    writeEvent(out, e);
+    first = false;
+  }
+
+  out << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+bool dump(const char* filename)
+{
+  std::ofstream out(filename);
+  if (!out)
+  {
+    std::cerr << "Cannot write trace file: " << filename << std::endl;
+    return false;
+  }
+  dump(out);
+  return out.good();
+}
+
+//------------------------------------------------------------------------------
+// Counter
+//
+
+// Counters are constructed during static initialization, before any
+// other thread can access the list
+Counter::Counter(const char* name)
+  : name(name)
+  , total(0)
+  , next(firstCounter)
+{
+  firstCounter = this;
+}
+
+Counter samplesTaken("samples taken");
+Counter raysTerminatedEarly("rays terminated early");
+Counter bytesEncoded("bytes encoded");
+Counter bytesSent("bytes sent");
+Counter bytesReceived("bytes received");
+
+//------------------------------------------------------------------------------
+// VV_TRACE environment variable
+//
+
+namespace
+{
+
+const char* traceFile = NULL;
+
+void dumpAtExit()
+{
+  dump(traceFile);
+}
+
+struct EnvironmentInit
+{
+  EnvironmentInit()
+  {
+    traceFile = getenv("VV_TRACE");
+    if (traceFile != NULL && traceFile[0] != '\0')
+    {
+      setEnabled(true);
+      atexit(dumpAtExit);
+    }
+  }
+};
+
+EnvironmentInit environmentInit;
+
+} // namespace
+
+} // namespace trace
+} // namespace virvo
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,183 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+#ifndef _VV_TRACE_H_
+#define _VV_TRACE_H_
+
+#include "vvatomic.h"
+#include "vvexport.h"
+
+#include <iosfwd>
+
+//------------------------------------------------------------------------------
+// Low-overhead tracing
+//
+// Each thread records events into its own ring buffer, so recording never
+// takes a lock. When tracing is disabled, zones and counters cost one load
+// and one branch.
+//
+// Usage:
+//
+//   void render()
+//   {
+//     VV_TRACE_ZONE("render");
+//     ...
+//     virvo::trace::samplesTaken.add(n);
+//   }
+//
+//   virvo::trace::setEnabled(true);
+//   render();
+//   virvo::trace::dump("trace.json");  // open with chrome://tracing
+//
+// Tracing can also be enabled for a whole process by setting the
+// environment variable VV_TRACE to the name of the output file. The
+// trace is then written when the process exits.
+//
+// Zone and counter names are not copied and must be string literals.
+//
+
+#define VV_TRACE_CONCAT_(a, b) a ## b
+#define VV_TRACE_CONCAT(a, b) VV_TRACE_CONCAT_(a, b)
+
+/// Record the time from here to the end of the enclosing scope
+#define VV_TRACE_ZONE(NAME) \
+  ::virvo::trace::ScopedZone VV_TRACE_CONCAT(vvTraceZone, __LINE__)(NAME)
+
+namespace virvo
+{
+namespace trace
+{
+
+namespace detail
+{
+  VVAPI extern bool volatile enabled;
+
+  VVAPI double now();
+  VVAPI void complete(const char* name, const char* category, double start, double end);
+}
+
+/// Enable or disable recording at runtime
+VVAPI void setEnabled(bool enabled);
+
+/// Returns true if events are recorded
+inline bool isEnabled()
+{
+  return detail::enabled;
+}
+
+/// Name the calling thread in the trace output
+VVAPI void setThreadName(const char* name);
+
+/// Record the current values of all counters
+VVAPI void sampleCounters();
+
+/// Discard all recorded events and reset all counters
+VVAPI void clear();
+
+/// Write all recorded events as Chrome trace-event JSON.
+/// Threads that record while the trace is written may produce
+/// inconsistent events, so disable tracing first if possible.
+VVAPI void dump(std::ostream& out);
+
+/// Write all recorded events to a file.
+/// @return true if the file was written successfully
+VVAPI bool dump(const char* filename);
+
+//------------------------------------------------------------------------------
+// ScopedZone
+//
+class ScopedZone
+{
+  const char* name;
+  const char* category;
+  double start;
+  bool active;
+
+  // NOT copyable!
+  ScopedZone(ScopedZone const&);
+  ScopedZone& operator=(ScopedZone const&);
+
+public:
+  ScopedZone(const char* name, const char* category = "virvo")
+    : name(name)
+    , category(category)
+    , start(0.0)
+    , active(isEnabled())
+  {
+    if (active)
+      start = detail::now();
+  }
+
+  ~ScopedZone()
+  {
+    if (active)
+      detail::complete(name, category, start, detail::now());
+  }
+};
+
+//------------------------------------------------------------------------------
+// Counter
+//
+// Accumulates a value over the lifetime of the process. Counters must
+// have static storage duration. Use sampleCounters() to record their
+// current values in the trace, e.g. once per frame.
+//
+class VVAPI Counter
+{
+  const char* name;
+  AtomicCounter total;
+  Counter* next;
+
+  // NOT copyable!
+  Counter(Counter const&);
+  Counter& operator=(Counter const&);
+
+  friend void sampleCounters();
+  friend void clear();
+  friend void dump(std::ostream&);
+
+public:
+  explicit Counter(const char* name);
+
+  /// Add v if tracing is enabled
+  void add(long v)
+  {
+    if (isEnabled())
+      total.add(v);
+  }
+
+  /// Returns the accumulated value
+  long value() const { return total.load(); }
+
+  /// Returns the counter name
+  const char* getName() const { return name; }
+};
+
+// Counters recorded by Virvo
+VVAPI extern Counter samplesTaken;        ///< volume samples taken by the CPU renderers
+VVAPI extern Counter raysTerminatedEarly; ///< rays stopped by early ray termination
+VVAPI extern Counter bytesEncoded;        ///< size of encoded remote images
+VVAPI extern Counter bytesSent;           ///< bytes written to sockets
+VVAPI extern Counter bytesReceived;       ///< bytes read from sockets
+
+} // namespace trace
+} // namespace virvo
+
+#endif
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
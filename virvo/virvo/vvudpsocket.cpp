@@ -23,6 +23,7 @@
 
 #include "vvudpsocket.h"
 #include "vvdebugmsg.h"
+#include "vvtrace.h"
 
 vvUdpSocket::vvUdpSocket() : vvSocket()
 {
@@ -389,6 +390,7 @@ vvSocket::ErrorType vvUdpSocket::readData(uchar* dataptr, size_t size, ssize_t *
     if(ret) *ret = got;
     if(got >= 0)
     {
+      virvo::trace::bytesReceived.add(long(got));
       return VV_OK;
     }
     else
@@ -415,6 +417,7 @@ vvSocket::ErrorType vvUdpSocket::writeData(const uchar* dataptr, size_t size, ss
     if(ret) *ret = written;
     if(written == (ssize_t)size)
     {
+      virvo::trace::bytesSent.add(long(written));
       return VV_OK;
     }
     else
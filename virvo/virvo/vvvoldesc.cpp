@@ -40,6 +40,8 @@
 #include "vvvecmath.h"
 #include "vvclock.h"
 #include "vvvoldesc.h"
+#include "vvpthread.h"
+#include "vvworkerpool.h"
 
 #ifdef __sun
 #define logf log
@@ -289,6 +291,32 @@ vvVolDesc::vvVolDesc(vvVolDesc* v, int f)
     copyFrame(v->getRaw(f));
     ++frames;
   }
+
+  // Copy levels of detail if all frames were copied:
+  if (f==-1)
+  {
+    for (size_t l=1; l<v->getNumLevels() && v->getLevelRaw(l, int(frames)-1)!=NULL; ++l)
+    {
+      std::vector<uint8_t*> data;
+      const vvsize3 size = v->getLevelSize(l);
+      const size_t bytes = size[0] * size[1] * size[2] * getBPV();
+      for (size_t i=0; i<frames; ++i)
+      {
+        data.push_back(new uint8_t[bytes]);
+        memcpy(data.back(), v->getLevelRaw(l, int(i)), bytes);
+      }
+      addLevel(data);
+    }
+
+    if (v->hasStatistics())
+    {
+      stats = v->stats;
+      statsValid = v->statsValid;
+      statsVox = v->statsVox;
+      statsBpc = v->statsBpc;
+      statsChan = v->statsChan;
+    }
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -337,6 +365,9 @@ const uint8_t* vvVolDesc::operator()(size_t f, size_t x, size_t y, size_t slice)
 void vvVolDesc::initialize()
 {
   vvDebugMsg::msg(2, "vvVolDesc::initialize()");
+  statsVox = vvsize3(0, 0, 0);
+  statsBpc = 0;
+  statsChan = 0;
   setDefaults();
   removeSequence();
   currentFrame = 0;
@@ -379,6 +410,8 @@ void vvVolDesc::setDefaults()
 void vvVolDesc::removeSequence()
 {
   vvDebugMsg::msg(2, "vvVolDesc::removeSequence()");
+  deleteLevels();
+  invalidateStatistics();
   if (raw.isEmpty()) return;
   raw.removeAll();
   deleteChannelNames();
@@ -506,6 +539,8 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
   if (src->frames==0) return OK;                  // is source src empty?
                                                   // are data types the same?
   if ((bpc != src->bpc) && frames != 0) return TYPE_ERROR;
+  deleteLevels();
+  invalidateStatistics();
 
   // If target VD empty: create a copy:
   if (frames==0)
@@ -625,6 +660,8 @@ vvVolDesc::ErrorType vvVolDesc::merge(vvVolDesc* src, vvVolDesc::MergeType mtype
 */
 vvVolDesc::ErrorType vvVolDesc::mergeFrames()
 {
+  deleteLevels();
+  invalidateStatistics();
   uint8_t *newRaw = new uint8_t[getFrameBytes() * frames];
   for (size_t f=0; f<frames; f++)
   {
@@ -748,6 +785,8 @@ the same.
 void vvVolDesc::updateFrame(int frame, uint8_t* newData, DeleteType deleteData)
 {
   vvDebugMsg::msg(3, "vvVolDesc::updateFrame()");
+  deleteLevels();
+  invalidateStatistics();
   raw.makeCurrent(frame);
   raw.remove();
   switch(deleteData)
@@ -832,6 +871,26 @@ void vvVolDesc::makeHistogram(int frame, size_t chan1, size_t numChan, int* buck
   }
   memset(count, 0, totalBuckets * sizeof(int));   // initialize counter array
 
+  if (numChan==1 && bpc!=4)
+  {
+    // Integer data: sum up the voxels per value of the statistics
+    const float valuesPerBucket = getValueRange() / float(buckets[0]);
+    for (size_t f=0; f<frames; ++f)
+    {
+      if (frame != -1 && size_t(frame) != f)
+        continue;
+
+      const Statistics& s = getStatistics(f, chan1);
+      for (size_t v=0; v<s.histogram.size(); ++v)
+      {
+        if (s.histogram[v]==0) continue;
+        const int b = ts_clamp(int(float(v) / valuesPerBucket), 0, buckets[0]-1);
+        count[b] += int(s.histogram[v]);
+      }
+    }
+    return;
+  }
+
   voxVal = new float[numChan];
   bucket = new int[numChan];
   valPerBucket = new float[numChan];
@@ -1304,6 +1363,8 @@ void vvVolDesc::convertBPC(size_t newBPC, bool verbose)
 
   // Verify input parameters:
   if (bpc==newBPC) return;                        // this was easy!
+  deleteLevels();
+  invalidateStatistics();
   assert(newBPC==1 || newBPC==2 || newBPC==4);
 
   newSliceSize = vox[0] * vox[1] * newBPC * chan;
@@ -1394,6 +1455,8 @@ void vvVolDesc::convertChannels(size_t newChan, int frame, bool verbose)
   vvDebugMsg::msg(2, "vvVolDesc::convertChannels()");
 
   if (chan==newChan) return;                      // this was easy!
+  deleteLevels();
+  invalidateStatistics();
   assert(newChan>0);                              // ignore invalid values
 
   size_t startFrame = 0;
@@ -1468,6 +1531,8 @@ void vvVolDesc::deleteChannel(size_t channel, bool verbose)
   vvDebugMsg::msg(2, "vvVolDesc::deleteChannel()");
 
   if (channel >= chan) return;                    // this was easy!
+  deleteLevels();
+  invalidateStatistics();
 
   newSliceSize = vox[0] * vox[1] * (chan-1) * bpc;
   if (verbose) vvToolshed::initProgress(vox[2] * frames);
@@ -1526,6 +1591,8 @@ void vvVolDesc::bitShiftData(int bits, int frame, bool verbose)
   vvDebugMsg::msg(2, "vvVolDesc::bitShiftData()");
   assert(bpc*chan<=sizeof(long));                 // shift only works up to sizeof(long) byte per pixel
   if (bits==0) return;                            // done!
+  deleteLevels();
+  invalidateStatistics();
 
   sliceSize = getSliceBytes();
   shift = ts_max(bits, -bits);                    // find absolute value
@@ -1579,6 +1646,8 @@ void vvVolDesc::invert()
   uint8_t* rd;
 
   vvDebugMsg::msg(2, "vvVolDesc::invert()");
+  deleteLevels();
+  invalidateStatistics();
 
   raw.first();
   for (size_t f=0; f<frames; ++f)
@@ -1613,6 +1682,8 @@ void vvVolDesc::convertRGB24toRGB8()
   size_t oldSliceSize;
 
   vvDebugMsg::msg(2, "vvVolDesc::convertRGB24toRGB8()");
+  deleteLevels();
+  invalidateStatistics();
   assert(bpc==1 && chan==3);                      // cannot work on non-24bit-modes
 
   oldSliceSize = getSliceBytes();
@@ -1672,6 +1743,8 @@ void vvVolDesc::flip(vvVecmath::AxisType axis)
   size_t sliceSize;
 
   vvDebugMsg::msg(2, "vvVolDesc::flip()");
+  deleteLevels();
+  invalidateStatistics();
 
   lineSize = vox[0] * getBPV();
   sliceSize = getSliceBytes();
@@ -1749,6 +1822,8 @@ void vvVolDesc::rotate(vvVecmath::AxisType axis, int dir)
 
   vvDebugMsg::msg(2, "vvVolDesc::rotate()");
   if (dir!=-1 && dir!=1) return;                  // validate direction
+  deleteLevels();
+  invalidateStatistics();
 
   // Compute the new volume size:
   switch (axis)
@@ -1857,6 +1932,8 @@ void vvVolDesc::convertRGBPlanarToRGBInterleaved(int frame)
   uint8_t* tmpData;
 
   vvDebugMsg::msg(2, "vvVolDesc::convertRGBPlanarToRGBInterleaved()");
+  deleteLevels();
+  invalidateStatistics();
   assert(bpc==1 && chan==3);                      // this routine works only on RGB volumes
 
   size_t frameSize = getFrameBytes();
@@ -1896,6 +1973,8 @@ void vvVolDesc::toggleEndianness(int frame)
 
   vvDebugMsg::msg(2, "vvVolDesc::toggleEndianness()");
   if (bpc==1) return;                             // done
+  deleteLevels();
+  invalidateStatistics();
 
   size_t sliceSize = getSliceBytes();
   raw.first();
@@ -1957,6 +2036,8 @@ void vvVolDesc::toggleSign(int /* frame */)
   float  val;
 
   vvDebugMsg::msg(2, "vvVolDesc::toggleSign()");
+  deleteLevels();
+  invalidateStatistics();
 
   size_t frameVoxels = getFrameVoxels();
   raw.first();
@@ -2030,6 +2111,8 @@ void vvVolDesc::crop(size_t x, size_t y, size_t z, size_t w, size_t h, size_t s)
   uint8_t *src, *dst;
 
   vvDebugMsg::msg(2, "vvVolDesc::crop()");
+  deleteLevels();
+  invalidateStatistics();
 
   // Find minimum and maximum values for crop:
   xmin = ts_max(size_t(0), ts_min(x, vox[0]-1, x + w - 1));
@@ -2079,6 +2162,10 @@ void vvVolDesc::crop(size_t x, size_t y, size_t z, size_t w, size_t h, size_t s)
 */
 void vvVolDesc::cropTimesteps(size_t start, size_t steps)
 {
+  deleteLevels();
+  invalidateStatistics();
+  start = ts_min(start, frames);
+  steps = ts_min(steps, frames - start);
   raw.first();
 
   // Remove steps before the desired range:
@@ -2116,6 +2203,8 @@ void vvVolDesc::resize(size_t w, size_t h, size_t s, InterpolationType ipt, bool
   // Validate resize parameters:
   if (w<=0 || h<=0 || s<=0) return;
   if (w==vox[0] && h==vox[1] && s==vox[2]) return;// already done
+  deleteLevels();
+  invalidateStatistics();
 
   // Now resizing can be done:
   oldSliceVoxels = getSliceVoxels();
@@ -2206,6 +2295,8 @@ void vvVolDesc::shift(int sx, int sy, int sz)
 
   // Consider rotary boundary conditions and make shift values positive:
   if (sx==0 && sy==0 && sz==0) return;
+  deleteLevels();
+  invalidateStatistics();
 
   sval[0] =  sx % vox[0];
   sval[1] = -sy % vox[1];
@@ -2283,6 +2374,8 @@ void vvVolDesc::convertVoxelOrder()
   uint8_t* dst;
 
   vvDebugMsg::msg(2, "vvVolDesc::convertVoxelOrder()");
+  deleteLevels();
+  invalidateStatistics();
 
   size_t frameSize = getFrameBytes();
   tmpData = dst = new uint8_t[frameSize];
@@ -2315,6 +2408,8 @@ void vvVolDesc::convertCoviseToVirvo()
   uint8_t* ptr;
 
   vvDebugMsg::msg(2, "vvVolDesc::convertCoviseToVirvo()");
+  deleteLevels();
+  invalidateStatistics();
 
   size_t frameSize = getFrameBytes();
   tmpData = new uint8_t[frameSize];
@@ -2352,6 +2447,8 @@ void vvVolDesc::convertVirvoToCovise()
   size_t    dstIndex;                                // index into COVISE volume array
 
   vvDebugMsg::msg(2, "vvVolDesc::convertVirvoToCovise()");
+  deleteLevels();
+  invalidateStatistics();
 
   size_t frameSize = getFrameBytes();
   tmpData = new uint8_t[frameSize];
@@ -2385,6 +2482,8 @@ void vvVolDesc::convertVirvoToOpenGL()
   size_t    dstIndex;                                // index into OpenGL volume array
 
   vvDebugMsg::msg(2, "vvVolDesc::convertVirvoToOpenGL()");
+  deleteLevels();
+  invalidateStatistics();
 
   size_t frameSize = getFrameBytes();
   tmpData = new uint8_t[frameSize];
@@ -2418,6 +2517,8 @@ void vvVolDesc::convertOpenGLToVirvo()
   size_t    dstIndex;                                // index into Virvo volume array
 
   vvDebugMsg::msg(2, "vvVolDesc::convertOpenGLToVirvo()");
+  deleteLevels();
+  invalidateStatistics();
 
   size_t frameSize = getFrameBytes();
   tmpData = new uint8_t[frameSize];
@@ -2551,6 +2652,8 @@ void vvVolDesc::makeSphere(size_t outer, size_t inner, InterpolationType ipt, bo
   uint8_t interpolated[4];                        // interpolated voxel values
 
   vvDebugMsg::msg(2, "vvVolDesc::makeSphere()");
+  deleteLevels();
+  invalidateStatistics();
 
   newFrameSize = outer * outer * outer * getBPV();
   if (outer>1)
@@ -2956,6 +3059,8 @@ void vvVolDesc::drawBox(size_t p1x, size_t p1y, size_t p1z, size_t p2x, size_t p
   size_t lineSize, sliceSize;
 
   vvDebugMsg::msg(3, "vvVolDesc::drawBox()");
+  deleteLevels();
+  invalidateStatistics();
 
   p1x = ts_clamp(p1x, size_t(0), vox[0]-1);
   p1y = ts_clamp(p1y, size_t(0), vox[1]-1);
@@ -3044,6 +3149,8 @@ void vvVolDesc::drawSphere(size_t p1x, size_t p1y, size_t p1z, size_t radius, si
 
   sliceSize = getSliceBytes();
   lineSize  = vox[0] * getBPV();
+  deleteLevels();
+  invalidateStatistics();
   raw = getRaw(currentFrame);
   for (size_t z = zstart; z < zend; ++z)
   {
@@ -3074,6 +3181,8 @@ void vvVolDesc::drawLine(size_t p1x, size_t p1y, size_t p1z, size_t p2x, size_t
   uint8_t* raw;
 
   vvDebugMsg::msg(3, "vvVolDesc::drawLine()");
+  deleteLevels();
+  invalidateStatistics();
 
   raw = getRaw(currentFrame);
   vvToolshed::draw3DLine(p1x, p1y, p1z, p2x, p2y, p2z, val,
@@ -3204,6 +3313,8 @@ void vvVolDesc::drawBoundaries(uchar* color, int frame)
   };
 
   vvDebugMsg::msg(3, "vvVolDesc::drawBoundaries()");
+  deleteLevels();
+  invalidateStatistics();
 
   if (frame<0)
   {
@@ -3398,6 +3509,8 @@ void vvVolDesc::setSliceData(uint8_t* newData, int slice, int frame)
   uint8_t* dst;                                   // pointer to beginning of slice
   size_t sliceSize;                               // shortcut for speed
 
+  deleteLevels();
+  invalidateStatistics();
   if (frames>0 && vox[2]>0)                       // make sure at least one slice is stored
   {
     sliceSize = getSliceBytes();
@@ -3531,6 +3644,8 @@ void vvVolDesc::deinterlace()
   size_t frameSize;
 
   vvDebugMsg::msg(2, "vvVolDesc::deinterlace()");
+  deleteLevels();
+  invalidateStatistics();
 
   sliceSize = getSliceBytes();
   frameSize = getFrameBytes();
@@ -3565,8 +3680,6 @@ void vvVolDesc::deinterlace()
 void vvVolDesc::findMinMax(size_t channel, float& scalarMin, float& scalarMax)
 {
   (void)channel;
-  int mi, ma;
-  float fMin, fMax;
 
   vvDebugMsg::msg(2, "vvVolDesc::findMinMax()");
 
@@ -3588,25 +3701,14 @@ void vvVolDesc::findMinMax(size_t channel, float& scalarMin, float& scalarMax)
   }
 
   // TODO: make search channel dependent
-  for (size_t f=0; f<frames; ++f)
+  for (size_t f=0; f<frames && getFrameVoxels()>0; ++f)
   {
-    switch(bpc)
+    for (size_t c=0; c<chan; ++c)
     {
-      case 1: vvToolshed::getMinMax(getRaw(f), getFrameBytes(), &mi, &ma);
-        fMin = float(mi);
-        fMax = float(ma);
-        break;
-      case 2: vvToolshed::getMinMax16bitBE(getRaw(f), getFrameVoxels(), &mi, &ma);
-        fMin = float(mi);
-        fMax = float(ma);
-        break;
-      case 4:
-        vvToolshed::getMinMax((float*)getRaw(f), getFrameVoxels(), &fMin, &fMax);
-        break;
-      default: assert(0); break;
+      const Statistics& s = getStatistics(f, c);
+      if (s.min < scalarMin) scalarMin = s.min;
+      if (s.max > scalarMax) scalarMax = s.max;
     }
-    if (fMin < scalarMin) scalarMin = fMin;
-    if (fMax > scalarMax) scalarMax = fMax;
   }
 }
 
@@ -3707,52 +3809,26 @@ int vvVolDesc::findNumValue(int frame, float val)
 */
 int vvVolDesc::findNumUsed(size_t channel)
 {
-  bool* used;                                     // true = scalar value occurs in array
-  uint8_t* raw;
-  size_t numValues;
   int numUsed = 0;
-  int value;
 
   vvDebugMsg::msg(2, "vvVolDesc::findNumUsed()");
 
   if (bpc>=3) return -1;     // doesn't work with floats
 
-  size_t frameVoxels = getFrameVoxels();
-  numValues = (bpc==2) ? 65536 : 256;
-  used = new bool[numValues];
-
-  // Initialize occurrence array:
-  for (size_t i=0; i<numValues; ++i)
-  {
-    used[i] = false;
-  }
-
-  // Fill occurrence array:
+  // Count the values which occur in any frame:
+  std::vector<bool> used((bpc==2) ? 65536 : 256, false);
   for (size_t f=0; f<frames; ++f)
   {
-    raw = getRaw(f);
-    for (size_t i=0; i<frameVoxels; ++i)
+    const Statistics& s = getStatistics(f, channel);
+    for (size_t i=0; i<used.size(); ++i)
     {
-      switch (bpc)
+      if (s.histogram[i] > 0 && !used[i])
       {
-        case 1:
-          used[raw[i*chan+channel]] = true;
-          break;
-        case 2:
-          value = (int(raw[i*2*chan+channel]) << 8) | int(raw[i*2*chan+channel+1]);
-          used[value] = true;
-          break;
+        used[i] = true;
+        ++numUsed;
       }
     }
   }
-
-  // Count number of 'true' entries in occurrence array:
-  for (size_t i=0; i<numValues; ++i)
-  {
-    if (used[i]==true) ++numUsed;
-  }
-
-  delete[] used;
   return numUsed;
 }
 
@@ -3827,37 +3903,10 @@ int vvVolDesc::findNumTransparent(int frame)
 */
 float vvVolDesc::calculateMean(int frame)
 {
-  uint8_t* raw;
-  float scalar = 0.f;
-  float mean;
-  double sum = 0.0;
-
   vvDebugMsg::msg(2, "vvVolDesc::calculateMean()");
 
-  size_t frameSize = getFrameBytes();
-  size_t bpv = getBPV();
-
-  // Search volume:
-  raw = getRaw(frame);
-  for (size_t i=0; i<frameSize; i += bpv)
-  {
-    switch (bpc)
-    {
-      case 1:
-        scalar = float(raw[i]);
-        break;
-      case 2:
-        scalar = float((int(raw[i]) << 8) | int(raw[i+1]));
-        break;
-      case 4:
-        scalar = *((float*)(raw+i));
-        break;
-      default: assert(0); break;
-    }
-    sum += scalar;
-  }
-  mean = float(sum / double(getFrameVoxels()));
-  return mean;
+  const size_t f = (frame<0) ? currentFrame : size_t(frame);
+  return getStatistics(f, 0).mean;
 }
 
 //----------------------------------------------------------------------------
@@ -3868,38 +3917,12 @@ float vvVolDesc::calculateMean(int frame)
 */
 void vvVolDesc::calculateDistribution(int frame, size_t chan, float& mean, float& variance, float& stdev)
 {
-  uint8_t* raw;
-  double sumSquares = 0.0;
-  float scalar = 0.f;
-  float diff;
-
   vvDebugMsg::msg(2, "vvVolDesc::calculateDistribution()");
 
-  size_t frameSize = getFrameBytes();
-  size_t bpv = getBPV();
-  mean = calculateMean(frame);
-
-  // Search volume:
-  raw = getRaw(frame);
-  for (size_t i=chan*bpc; i<frameSize; i += bpv)
-  {
-    switch (bpc)
-    {
-      case 1:
-        scalar = float(raw[i]);
-        break;
-      case 2:
-        scalar = float((int(raw[i]) << 8) | int(raw[i+1]));
-        break;
-      case 4:
-        scalar = *((float*)(raw+i));
-        break;
-      default: assert(0); break;
-    }
-    diff = scalar - mean;
-    sumSquares += diff * diff;
-  }
-  variance = float(sumSquares / double(getFrameVoxels()));
+  const size_t f = (frame<0) ? currentFrame : size_t(frame);
+  const Statistics& s = getStatistics(f, chan);
+  mean = s.mean;
+  variance = s.variance;
   stdev = sqrtf(variance);
 }
 
@@ -3916,6 +3939,8 @@ void vvVolDesc::expandDataRange(bool verbose)
   float smin, smax;                               // scalar minimum and maximum
 
   vvDebugMsg::msg(2, "vvVolDesc::expandDataRange()");
+  deleteLevels();
+  invalidateStatistics();
 
   findMinMax(0, smin, smax);
   zoomDataRange(-1, int(smin), int(smax), verbose);
@@ -3939,6 +3964,8 @@ void vvVolDesc::zoomDataRange(int channel, int low, int high, bool verbose)
   vvDebugMsg::msg(2, "vvVolDesc::zoomDataRange()");
 
   if (bpc>2) return;                              // nothing to be done
+  deleteLevels();
+  invalidateStatistics();
 
   frameSize = getFrameVoxels();
   fmin = float(low);
@@ -4013,6 +4040,8 @@ void vvVolDesc::blend(vvVolDesc* blendVD, int method, bool verbose)
   float blended;                                  // result from blending operation
 
   vvDebugMsg::msg(2, "vvVolDesc::blend()");
+  deleteLevels();
+  invalidateStatistics();
 
   if (bpc != blendVD->bpc || chan != blendVD->chan || vox[0] != blendVD->vox[0] ||
     vox[1] != blendVD->vox[1] || vox[2] != blendVD->vox[2] ||
@@ -4096,6 +4125,8 @@ void vvVolDesc::swapChannels(size_t ch0, size_t ch1, bool verbose)
 
   vvDebugMsg::msg(2, "vvVolDesc::swapChannels()");
   if (ch0==ch1) return;                           // this was easy!
+  deleteLevels();
+  invalidateStatistics();
   assert(bpc<=4);                                 // determines buffer size
 
   sliceSize = getSliceBytes();
@@ -4151,6 +4182,8 @@ void vvVolDesc::extractChannel(float weights[3], bool verbose)
   bool is4th;
 
   vvDebugMsg::msg(2, "vvVolDesc::extractChannel()");
+  deleteLevels();
+  invalidateStatistics();
 
   // Verify input parameters:
   assert(bpc==1 && chan==3);
@@ -4224,6 +4257,8 @@ void vvVolDesc::computeVolume(int algorithm, size_t vx, size_t vy, size_t vz)
   uint8_t* rd;                                    // raw volume data
 
   vvDebugMsg::msg(1, "vvFileIO::computeDefaultVolume()");
+  deleteLevels();
+  invalidateStatistics();
 
   vox[0] = vx;
   vox[1] = vy;
@@ -4619,6 +4654,8 @@ bool vvVolDesc::makeHeightField(size_t slices, int mode, bool verbose)
   size_t zPos;
 
   vvDebugMsg::msg(2, "vvVolDesc::makeHeightField()");
+  deleteLevels();
+  invalidateStatistics();
 
   if (vox[2] != 1)
   {
@@ -5331,5 +5368,631 @@ vvVector3 vvVolDesc::objectCoords(const vvsize3& voxCoords) const
   return result;
 }
 
+namespace
+{
+  // Size of the level below a level of detail
+  vvsize3 halfSize(const vvsize3& vox)
+  {
+    return vvsize3((vox[0] + 1) / 2, (vox[1] + 1) / 2, (vox[2] + 1) / 2);
+  }
+
+  bool equal(const vvsize3& a, const vvsize3& b)
+  {
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+  }
+
+  // Slabs of one frame of a level, downsampled by a worker thread
+  struct DownsampleJob
+  {
+    const uint8_t* src;
+    uint8_t* dst;
+    vvsize3 srcVox;
+    vvsize3 dstVox;
+    size_t bpc;
+    size_t chan;
+    size_t firstSlice;
+    size_t lastSlice;
+  };
+
+  float readChannel(const uint8_t* p, size_t bpc)
+  {
+    switch (bpc)
+    {
+    case 1: return float(p[0]);
+    case 2: return float(int(p[0]) * 256 + int(p[1]));
+    default: return *reinterpret_cast<const float*>(p);
+    }
+  }
+
+  void writeChannel(uint8_t* p, size_t bpc, float value)
+  {
+    switch (bpc)
+    {
+    case 1:
+      p[0] = uint8_t(value + 0.5f);
+      break;
+    case 2:
+    {
+      const int ival = int(value + 0.5f);
+      p[0] = uint8_t(ival >> 8);
+      p[1] = uint8_t(ival & 0xff);
+      break;
+    }
+    default:
+      *reinterpret_cast<float*>(p) = value;
+      break;
+    }
+  }
+
+  // Average 2x2x2 voxels of the finer level per voxel, clamped at the
+  // upper borders of volumes with odd sizes
+  void downsample(void* param)
+  {
+    const DownsampleJob* job = static_cast<const DownsampleJob*>(param);
+    const size_t bpv = job->bpc * job->chan;
+    const vvsize3& sv = job->srcVox;
+
+    for (size_t z=job->firstSlice; z<job->lastSlice; ++z)
+    {
+      const size_t z0 = 2 * z;
+      const size_t z1 = std::min(z0 + 1, sv[2] - 1);
+      for (size_t y=0; y<job->dstVox[1]; ++y)
+      {
+        const size_t y0 = 2 * y;
+        const size_t y1 = std::min(y0 + 1, sv[1] - 1);
+        for (size_t x=0; x<job->dstVox[0]; ++x)
+        {
+          const size_t x0 = 2 * x;
+          const size_t x1 = std::min(x0 + 1, sv[0] - 1);
+          const size_t src[8] =
+          {
+            ((z0 * sv[1] + y0) * sv[0] + x0) * bpv, ((z0 * sv[1] + y0) * sv[0] + x1) * bpv,
+            ((z0 * sv[1] + y1) * sv[0] + x0) * bpv, ((z0 * sv[1] + y1) * sv[0] + x1) * bpv,
+            ((z1 * sv[1] + y0) * sv[0] + x0) * bpv, ((z1 * sv[1] + y0) * sv[0] + x1) * bpv,
+            ((z1 * sv[1] + y1) * sv[0] + x0) * bpv, ((z1 * sv[1] + y1) * sv[0] + x1) * bpv
+          };
+          uint8_t* dst = job->dst + ((z * job->dstVox[1] + y) * job->dstVox[0] + x) * bpv;
+          for (size_t c=0; c<bpv; c+=job->bpc)
+          {
+            float sum = 0.0f;
+            for (size_t i=0; i<8; ++i)
+            {
+              sum += readChannel(job->src + src[i] + c, job->bpc);
+            }
+            writeChannel(dst + c, job->bpc, sum * 0.125f);
+          }
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Build levels of detail for all frames. Each level halves the size of
+  the level before, the voxels are averages of 2x2x2 voxels. Level 0 is the
+  volume itself. The levels are computed in parallel.
+  vvVolDesc methods which change the voxels delete the levels, code that
+  changes voxels through getRaw() must call deleteLevels().
+  @param numLevels number of levels including level 0, 0 makes levels
+                   until the volume is a single voxel
+*/
+void vvVolDesc::makeLevels(size_t numLevels)
+{
+  vvDebugMsg::msg(2, "vvVolDesc::makeLevels()");
+
+  deleteLevels();
+  if (frames==0 || getBPV()==0) return;
+
+  const size_t slabSlices = 8;                    // slices per job
+  virvo::WorkerPool pool(0, "vvVolDesc levels");
+
+  vvsize3 size = vox;
+  while ((numLevels==0 || getNumLevels()<numLevels) && (size[0]>1 || size[1]>1 || size[2]>1))
+  {
+    const vvsize3 half = halfSize(size);
+    const size_t bytes = half[0] * half[1] * half[2] * getBPV();
+
+    std::vector<uint8_t*> data;
+    std::vector<DownsampleJob> jobs;
+    for (size_t f=0; f<frames; ++f)
+    {
+      data.push_back(new uint8_t[bytes]);
+      for (size_t z=0; z<half[2]; z+=slabSlices)
+      {
+        DownsampleJob job;
+        job.src = levels.empty() ? getRaw(f) : levels.back().raw[f];
+        job.dst = data.back();
+        job.srcVox = size;
+        job.dstVox = half;
+        job.bpc = bpc;
+        job.chan = chan;
+        job.firstSlice = z;
+        job.lastSlice = std::min(z + slabSlices, half[2]);
+        jobs.push_back(job);
+      }
+    }
+    for (size_t i=0; i<jobs.size(); ++i)
+    {
+      pool.submit(downsample, &jobs[i]);
+    }
+    pool.wait();
+
+    addLevel(data);
+    size = half;
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Add the next coarser level of detail, e.g. when loading from a file.
+  @param data one array per frame with the voxels of the level, its size is
+              half the size of the level before (rounded up). The arrays are
+              deleted with delete[] by vvVolDesc.
+*/
+void vvVolDesc::addLevel(const std::vector<uint8_t*>& data)
+{
+  vvDebugMsg::msg(2, "vvVolDesc::addLevel()");
+
+  Level level;
+  level.vox = halfSize(getLevelSize(getNumLevels() - 1));
+  level.bpv = getBPV();
+  level.raw = data;
+  levels.push_back(level);
+}
+
+//----------------------------------------------------------------------------
+/// Delete all levels of detail except for the volume itself.
+void vvVolDesc::deleteLevels()
+{
+  vvDebugMsg::msg(2, "vvVolDesc::deleteLevels()");
+
+  for (size_t l=0; l<levels.size(); ++l)
+  {
+    for (size_t f=0; f<levels[l].raw.size(); ++f)
+    {
+      delete[] levels[l].raw[f];
+    }
+  }
+  levels.clear();
+}
+
+//----------------------------------------------------------------------------
+/** @return number of levels of detail including the volume itself (level 0).
+  Levels that no longer match the volume size or data format are ignored.
+*/
+size_t vvVolDesc::getNumLevels() const
+{
+  if (levels.empty() || !equal(levels[0].vox, halfSize(vox)) || levels[0].bpv != getBPV()) return 1;
+  return levels.size() + 1;
+}
+
+//----------------------------------------------------------------------------
+/// @return size of a level of detail [voxels]
+vvsize3 vvVolDesc::getLevelSize(size_t level) const
+{
+  vvsize3 size = vox;
+  for (size_t l=0; l<level; ++l)
+  {
+    size = halfSize(size);
+  }
+  return size;
+}
+
+//----------------------------------------------------------------------------
+/** @return voxels of a frame of a level of detail, NULL if it does not exist
+  @param level level of detail, 0 is the volume itself
+  @param frame frame number, -1 for the current frame
+*/
+uint8_t* vvVolDesc::getLevelRaw(size_t level, int frame) const
+{
+  const size_t f = (frame<0) ? currentFrame : size_t(frame);
+  if (level==0) return getRaw(f);
+  if (level>=getNumLevels() || f>=levels[level-1].raw.size()) return NULL;
+  return levels[level-1].raw[f];
+}
+
+//============================================================================
+// Statistics
+//============================================================================
+
+const size_t vvVolDesc::Statistics::FloatBuckets = 1024;
+const size_t vvVolDesc::Statistics::BrickSize = 16;
+
+namespace
+{
+  // A frame whose statistics are computed
+  struct StatsFrame
+  {
+    const uint8_t* raw;
+    std::vector<vvVolDesc::Statistics*> stats;    // one per channel
+    std::vector<double> sums;                     // float data: sum of the values, then of the squared deviations
+  };
+
+  // A slab of BrickSize slices of a frame, processed by a worker thread
+  struct StatsJob
+  {
+    StatsFrame* frame;
+    vvsize3 vox;
+    size_t bpc;
+    size_t chan;
+    size_t firstSlice;
+    size_t lastSlice;
+    virvo::Mutex* mutex;                          // guards the merging into the frame statistics
+  };
+
+  // First pass: value ranges of the slab and its bricks, histograms of 8
+  // and 16 bit data, and sums of float data
+  void gatherStatistics(void* param)
+  {
+    const StatsJob* job = static_cast<const StatsJob*>(param);
+    const size_t bpc = job->bpc;
+    const size_t chan = job->chan;
+    const size_t bpv = bpc * chan;
+    const size_t brickSize = vvVolDesc::Statistics::BrickSize;
+    const vvsize3& vox = job->vox;
+    const vvsize3& bricks = job->frame->stats[0]->bricks;
+
+    std::vector<float> mins(chan, VV_FLT_MAX);
+    std::vector<float> maxs(chan, -VV_FLT_MAX);
+    std::vector<float> runMin(chan);
+    std::vector<float> runMax(chan);
+    std::vector<double> sums(chan, 0.0);
+    std::vector<std::vector<uint32_t> > hist;
+    if (bpc != 4)
+    {
+      hist.resize(chan, std::vector<uint32_t>(bpc == 1 ? 256 : 65536, 0));
+    }
+
+    for (size_t z=job->firstSlice; z<job->lastSlice; ++z)
+    {
+      for (size_t y=0; y<vox[1]; ++y)
+      {
+        const uint8_t* p = job->frame->raw + (z * vox[1] + y) * vox[0] * bpv;
+        for (size_t x0=0; x0<vox[0]; x0+=brickSize)
+        {
+          const size_t x1 = std::min(x0 + brickSize, vox[0]);
+          std::fill(runMin.begin(), runMin.end(), VV_FLT_MAX);
+          std::fill(runMax.begin(), runMax.end(), -VV_FLT_MAX);
+          for (size_t x=x0; x<x1; ++x)
+          {
+            for (size_t c=0; c<chan; ++c, p+=bpc)
+            {
+              float value;
+              switch (bpc)
+              {
+                case 1:
+                  ++hist[c][p[0]];
+                  value = float(p[0]);
+                  break;
+                case 2:
+                {
+                  const int ival = (int(p[0]) << 8) | int(p[1]);
+                  ++hist[c][ival];
+                  value = float(ival);
+                  break;
+                }
+                default:
+                  value = *reinterpret_cast<const float*>(p);
+                  sums[c] += value;
+                  break;
+              }
+              runMin[c] = ts_min(runMin[c], value);
+              runMax[c] = ts_max(runMax[c], value);
+            }
+          }
+
+          // Each slab holds whole bricks, so no other job writes them
+          const size_t b = ((z / brickSize) * bricks[1] + y / brickSize) * bricks[0] + x0 / brickSize;
+          for (size_t c=0; c<chan; ++c)
+          {
+            vvVolDesc::Statistics* s = job->frame->stats[c];
+            s->brickMin[b] = ts_min(s->brickMin[b], runMin[c]);
+            s->brickMax[b] = ts_max(s->brickMax[b], runMax[c]);
+            mins[c] = ts_min(mins[c], runMin[c]);
+            maxs[c] = ts_max(maxs[c], runMax[c]);
+          }
+        }
+      }
+    }
+
+    virvo::ScopedLock lock(job->mutex);
+    for (size_t c=0; c<chan; ++c)
+    {
+      vvVolDesc::Statistics* s = job->frame->stats[c];
+      s->min = ts_min(s->min, mins[c]);
+      s->max = ts_max(s->max, maxs[c]);
+      job->frame->sums[c] += sums[c];
+      if (!hist.empty())
+      {
+        for (size_t i=0; i<hist[c].size(); ++i)
+        {
+          s->histogram[i] += hist[c][i];
+        }
+      }
+    }
+  }
+
+  // Second pass for float data: histograms and squared deviations from
+  // the mean, which need the results of the first pass
+  void bucketStatistics(void* param)
+  {
+    const StatsJob* job = static_cast<const StatsJob*>(param);
+    const size_t chan = job->chan;
+    const size_t numBuckets = vvVolDesc::Statistics::FloatBuckets;
+    const size_t numVoxels = (job->lastSlice - job->firstSlice) * job->vox[1] * job->vox[0];
+
+    std::vector<std::vector<uint32_t> > hist(chan, std::vector<uint32_t>(numBuckets, 0));
+    std::vector<double> sums(chan, 0.0);
+    for (size_t c=0; c<chan; ++c)
+    {
+      const vvVolDesc::Statistics* s = job->frame->stats[c];
+      const float scale = (s->max > s->min) ? float(numBuckets) / (s->max - s->min) : 0.0f;
+      const float* p = reinterpret_cast<const float*>(job->frame->raw)
+                     + job->firstSlice * job->vox[1] * job->vox[0] * chan + c;
+      for (size_t i=0; i<numVoxels; ++i, p+=chan)
+      {
+        const int bucket = ts_clamp(int((*p - s->min) * scale), 0, int(numBuckets) - 1);
+        ++hist[c][bucket];
+        const float diff = *p - s->mean;
+        sums[c] += diff * diff;
+      }
+    }
+
+    virvo::ScopedLock lock(job->mutex);
+    for (size_t c=0; c<chan; ++c)
+    {
+      vvVolDesc::Statistics* s = job->frame->stats[c];
+      job->frame->sums[c] += sums[c];
+      for (size_t i=0; i<numBuckets; ++i)
+      {
+        s->histogram[i] += hist[c][i];
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+/// @return number of voxels the statistics were computed from
+size_t vvVolDesc::Statistics::getNumVoxels() const
+{
+  size_t n = 0;
+  for (size_t i=0; i<histogram.size(); ++i)
+  {
+    n += histogram[i];
+  }
+  return n;
+}
+
+//----------------------------------------------------------------------------
+/** @return value below which the given fraction of the voxels lies. Exact
+  for 8 and 16 bit data, interpolated within a histogram bucket for float data.
+  @param fraction fraction of the voxels [0..1], e.g. 0.5 for the median
+*/
+float vvVolDesc::Statistics::getPercentile(float fraction) const
+{
+  const size_t numVoxels = getNumVoxels();
+  if (numVoxels==0 || fraction<=0.0f) return min;
+  if (fraction>=1.0f) return max;
+
+  const double target = double(fraction) * double(numVoxels);
+  double count = 0.0;
+  for (size_t i=0; i<histogram.size(); ++i)
+  {
+    if (histogram[i] > 0 && count + histogram[i] >= target)
+    {
+      if (histogram.size() != FloatBuckets) return float(i);
+      const float inBucket = float((target - count) / double(histogram[i]));
+      return ts_min(min + (float(i) + inBucket) * (max - min) / float(FloatBuckets), max);
+    }
+    count += histogram[i];
+  }
+  return max;
+}
+
+//----------------------------------------------------------------------------
+/** Statistics of a channel of a frame: value range, mean, variance, a
+  histogram and the value ranges of bricks. They are computed in parallel
+  for all channels of the frame when first requested, and kept until the
+  data change. All vvVolDesc methods which change the voxels discard the
+  statistics and the levels of detail, code that changes voxels through
+  getRaw() must call invalidateStatistics() and deleteLevels().
+  The reference is valid until the statistics are discarded or other
+  statistics are computed.
+*/
+const vvVolDesc::Statistics& vvVolDesc::getStatistics(size_t frame, size_t channel)
+{
+  vvDebugMsg::msg(3, "vvVolDesc::getStatistics()");
+
+  assert(frame < frames && channel < chan);
+  prepareStatistics();
+  const size_t index = frame * chan + channel;
+  if (!statsValid[index])
+  {
+    computeStatistics(std::vector<size_t>(1, frame));
+  }
+  return stats[index];
+}
+
+//----------------------------------------------------------------------------
+/// Compute the statistics of all frames which have none, in parallel.
+void vvVolDesc::computeStatistics()
+{
+  vvDebugMsg::msg(2, "vvVolDesc::computeStatistics()");
+
+  prepareStatistics();
+  std::vector<size_t> frameNumbers;
+  for (size_t f=0; f<frames; ++f)
+  {
+    if (chan > 0 && !statsValid[f * chan]) frameNumbers.push_back(f);
+  }
+  computeStatistics(frameNumbers);
+}
+
+//----------------------------------------------------------------------------
+/// @return true if all frames have up to date statistics
+bool vvVolDesc::hasStatistics() const
+{
+  if (frames==0 || !equal(statsVox, vox) || statsBpc!=bpc || statsChan!=chan
+   || statsValid.size()!=frames * chan)
+  {
+    return false;
+  }
+  return std::find(statsValid.begin(), statsValid.end(), false) == statsValid.end();
+}
+
+//----------------------------------------------------------------------------
+/// Set the statistics of a channel of a frame, e.g. when loading from a file.
+void vvVolDesc::setStatistics(size_t frame, size_t channel, const Statistics& s)
+{
+  vvDebugMsg::msg(3, "vvVolDesc::setStatistics()");
+
+  assert(frame < frames && channel < chan);
+  prepareStatistics();
+  stats[frame * chan + channel] = s;
+  statsValid[frame * chan + channel] = true;
+}
+
+//----------------------------------------------------------------------------
+/// Discard the statistics of all frames.
+void vvVolDesc::invalidateStatistics()
+{
+  stats.clear();
+  statsValid.clear();
+}
+
+//----------------------------------------------------------------------------
+/// Discard the statistics if the data format changed, add entries for new frames.
+void vvVolDesc::prepareStatistics()
+{
+  if (!equal(statsVox, vox) || statsBpc!=bpc || statsChan!=chan)
+  {
+    invalidateStatistics();
+    statsVox = vox;
+    statsBpc = bpc;
+    statsChan = chan;
+  }
+  stats.resize(frames * chan);
+  statsValid.resize(frames * chan, false);
+}
+
+//----------------------------------------------------------------------------
+/// Compute the statistics of all channels of some frames, in parallel.
+void vvVolDesc::computeStatistics(const std::vector<size_t>& frameNumbers)
+{
+  if (frameNumbers.empty() || chan==0) return;
+  assert(bpc==1 || bpc==2 || bpc==4);
+
+  const size_t brickSize = Statistics::BrickSize;
+  const vvsize3 bricks((vox[0] + brickSize - 1) / brickSize,
+                       (vox[1] + brickSize - 1) / brickSize,
+                       (vox[2] + brickSize - 1) / brickSize);
+  const size_t numBuckets = (bpc==1) ? 256 : (bpc==2) ? 65536 : Statistics::FloatBuckets;
+
+  std::vector<StatsFrame> statsFrames(frameNumbers.size());
+  for (size_t i=0; i<frameNumbers.size(); ++i)
+  {
+    StatsFrame& frame = statsFrames[i];
+    frame.raw = getRaw(frameNumbers[i]);
+    frame.sums.resize(chan, 0.0);
+    for (size_t c=0; c<chan; ++c)
+    {
+      Statistics* s = &stats[frameNumbers[i] * chan + c];
+      s->min = VV_FLT_MAX;
+      s->max = -VV_FLT_MAX;
+      s->mean = 0.0f;
+      s->variance = 0.0f;
+      s->histogram.assign(numBuckets, 0);
+      s->bricks = bricks;
+      s->brickMin.assign(bricks[0] * bricks[1] * bricks[2], VV_FLT_MAX);
+      s->brickMax.assign(bricks[0] * bricks[1] * bricks[2], -VV_FLT_MAX);
+      frame.stats.push_back(s);
+    }
+  }
+
+  virvo::Mutex mutex;
+  std::vector<StatsJob> jobs;
+  for (size_t i=0; i<statsFrames.size(); ++i)
+  {
+    for (size_t z=0; z<vox[2]; z+=brickSize)
+    {
+      StatsJob job;
+      job.frame = &statsFrames[i];
+      job.vox = vox;
+      job.bpc = bpc;
+      job.chan = chan;
+      job.firstSlice = z;
+      job.lastSlice = std::min(z + brickSize, vox[2]);
+      job.mutex = &mutex;
+      jobs.push_back(job);
+    }
+  }
+
+  virvo::WorkerPool pool(0, "vvVolDesc statistics");
+  for (size_t i=0; i<jobs.size(); ++i)
+  {
+    pool.submit(gatherStatistics, &jobs[i]);
+  }
+  pool.wait();
+
+  const size_t numVoxels = getFrameVoxels();
+  for (size_t i=0; i<statsFrames.size(); ++i)
+  {
+    for (size_t c=0; c<chan; ++c)
+    {
+      Statistics* s = statsFrames[i].stats[c];
+      if (numVoxels==0)
+      {
+        s->min = s->max = 0.0f;
+      }
+      else if (bpc==4)
+      {
+        s->mean = float(statsFrames[i].sums[c] / double(numVoxels));
+        statsFrames[i].sums[c] = 0.0;
+      }
+      else
+      {
+        // Integer data: exact mean and variance from the histogram
+        uint64_t sum = 0;
+        for (size_t v=0; v<numBuckets; ++v)
+        {
+          sum += uint64_t(v) * s->histogram[v];
+        }
+        s->mean = float(double(sum) / double(numVoxels));
+        double sumSquares = 0.0;
+        for (size_t v=0; v<numBuckets; ++v)
+        {
+          const float diff = float(v) - s->mean;
+          sumSquares += double(s->histogram[v]) * double(diff * diff);
+        }
+        s->variance = float(sumSquares / double(numVoxels));
+      }
+    }
+  }
+
+  if (bpc==4 && numVoxels>0)
+  {
+    for (size_t i=0; i<jobs.size(); ++i)
+    {
+      pool.submit(bucketStatistics, &jobs[i]);
+    }
+    pool.wait();
+
+    for (size_t i=0; i<statsFrames.size(); ++i)
+    {
+      for (size_t c=0; c<chan; ++c)
+      {
+        statsFrames[i].stats[c]->variance = float(statsFrames[i].sums[c] / double(numVoxels));
+      }
+    }
+  }
+
+  for (size_t i=0; i<frameNumbers.size(); ++i)
+  {
+    for (size_t c=0; c<chan; ++c)
+    {
+      statsValid[frameNumbers[i] * chan + c] = true;
+    }
+  }
+}
+
 ///// EOF /////
 // vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -119,6 +119,25 @@ class VIRVOEXPORT vvVolDesc
       ISO_DATA,
       OPACITY
     };
+
+    struct Statistics                             ///  statistics of one channel of a frame, see getStatistics()
+    {
+      static const size_t FloatBuckets;           ///< histogram buckets of float data
+      static const size_t BrickSize;              ///< edge length of the bricks with value ranges [voxels]
+
+      float min;                                  ///< smallest value
+      float max;                                  ///< largest value
+      float mean;
+      float variance;
+      std::vector<uint32_t> histogram;            ///< 8 and 16 bit data: voxels per value,
+                                                  ///< float data: voxels per bucket of FloatBuckets buckets in [min..max]
+      vvsize3 bricks;                             ///< number of bricks along each axis
+      std::vector<float> brickMin;                ///< smallest value per brick, x runs fastest
+      std::vector<float> brickMax;                ///< largest value per brick
+
+      size_t getNumVoxels() const;
+      float  getPercentile(float fraction) const;
+    };
     
     static const size_t DEFAULT_ICON_SIZE;        ///< system default for icon size if not otherwise specified (only stored in XVF files)
     static const size_t NUM_HDR_BINS;             ///< constant value for HDR transfer functions
@@ -274,15 +293,45 @@ class VIRVOEXPORT vvVolDesc
     vvsize3 voxelCoords(const vvVector3& objCoords) const;
     vvVector3 objectCoords(const vvsize3& voxCoords) const;
 
+    // Levels of detail:
+    void   makeLevels(size_t numLevels = 0);
+    void   addLevel(const std::vector<uint8_t*>& data);
+    void   deleteLevels();
+    size_t getNumLevels() const;
+    vvsize3 getLevelSize(size_t level) const;
+    uint8_t* getLevelRaw(size_t level, int frame = -1) const;
+
+    // Statistics:
+    const Statistics& getStatistics(size_t frame, size_t channel = 0);
+    void   computeStatistics();
+    bool   hasStatistics() const;
+    void   setStatistics(size_t frame, size_t channel, const Statistics& s);
+    void   invalidateStatistics();
+
   private:
+    struct Level                                  ///  downsampled copy of all frames
+    {
+      vvsize3 vox;                                ///< size of the level [voxels]
+      size_t bpv;                                 ///< bytes per voxel when the level was made
+      std::vector<uint8_t*> raw;                  ///< one array per frame
+    };
+
     char*  filename;                              ///< name of volume data file, including extension, excluding path ("" if undefined)
     size_t currentFrame;                          ///< current animation frame
     mutable vvSLList<uint8_t*> raw;               ///< pointer list to raw volume data - mutable because of Java style iterators
     std::vector<size_t> rawFrameNumber;           ///< frame numbers (if frames do not come in sequence)
     vvArray<char*> channelNames;                  ///< names of data channels
+    std::vector<Level> levels;                    ///< levels of detail 1, 2, ... (level 0 is raw)
+    std::vector<Statistics> stats;                ///< statistics per frame and channel (frame * chan + channel)
+    std::vector<bool> statsValid;                 ///< true if the statistics with the same index are up to date
+    vvsize3 statsVox;                             ///< volume size the statistics were computed for
+    size_t statsBpc;                              ///< bytes per channel the statistics were computed for
+    size_t statsChan;                             ///< number of channels the statistics were computed for
 
     void initialize();
     void setDefaults();
+    void prepareStatistics();
+    void computeStatistics(const std::vector<size_t>& frameNumbers);
     void makeLineIntensDiag(size_t channel, vvArray<float*>, size_t numValues, int*);
     bool isChannelOn(size_t num, unsigned char);
 };
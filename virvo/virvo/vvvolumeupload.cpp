@@ -0,0 +1,311 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvvolumeupload.h"
+#include "vvatomic.h"
+#include "vvpthread.h"
+#include "vvtrace.h"
+#include "vvvoldesc.h"
+#include "vvworkerpool.h"
+
+#include "private/vvcompress.h"
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <new>
+
+namespace virvo
+{
+
+const size_t VolumeUpload::ChunkSize = 1 << 20;
+
+struct VolumeUpload::Impl
+{
+  struct Chunk
+  {
+    Impl* impl;
+    std::vector<uchar> data;
+    uchar* dst;
+    const uchar* previous;    // same chunk of the previous frame, for deltas
+    size_t size;
+    size_t number;            // index among all chunks
+    bool delta;
+  };
+
+  vvVolDesc* vd;
+  uint64_t id;
+  bool ok;
+  size_t chunksPerFrame;
+  size_t numChunks;
+  size_t numAdded;
+  WorkerPool* pool;
+  std::list<Chunk> pending;   // chunks queued for decompression
+  AtomicCounter failures;
+  Mutex mutex;
+  Condition storedCondition;
+  std::vector<bool> stored;   // chunks whose data is in place, protected by mutex
+
+  void setStored(size_t number);
+  void waitStored(size_t number);
+
+  static void decompressChunk(void* param);
+};
+
+void VolumeUpload::Impl::setStored(size_t number)
+{
+  ScopedLock lock(&mutex);
+  stored[number] = true;
+  storedCondition.broadcast();
+}
+
+void VolumeUpload::Impl::waitStored(size_t number)
+{
+  ScopedLock lock(&mutex);
+  while (!stored[number])
+  {
+    storedCondition.wait(&mutex);
+  }
+}
+
+void VolumeUpload::Impl::decompressChunk(void* param)
+{
+  VV_TRACE_ZONE("decompress chunk");
+
+  Chunk* chunk = static_cast<Chunk*>(param);
+  Impl* impl = chunk->impl;
+  if (chunk->data.size() == chunk->size)
+  {
+    memcpy(chunk->dst, &chunk->data[0], chunk->size);
+  }
+  else if (!decompress(&chunk->data[0], chunk->data.size(), chunk->dst, chunk->size))
+  {
+    impl->failures.add(1);
+  }
+
+  // free the compressed data early
+  std::vector<uchar>().swap(chunk->data);
+
+  if (chunk->delta)
+  {
+    // the chunk of the previous frame was queued earlier, so it is
+    // already being processed by another worker
+    const size_t previous = chunk->number - impl->chunksPerFrame;
+    impl->waitStored(previous);
+    xorDelta(chunk->dst, chunk->previous, chunk->size, chunk->dst);
+  }
+
+  impl->setStored(chunk->number);
+}
+
+size_t VolumeUpload::getChunksPerFrame(const vvVolDesc* vd)
+{
+  return (vd->getFrameBytes() + ChunkSize - 1) / ChunkSize;
+}
+
+size_t VolumeUpload::getNumChunks(const vvVolDesc* vd)
+{
+  return getChunksPerFrame(vd) * vd->frames;
+}
+
+uint64_t VolumeUpload::computeId(const vvVolDesc* vd)
+{
+  // FNV-1a
+  const uint64_t prime = 1099511628211ULL;
+  uint64_t hash = 14695981039346656037ULL;
+
+  std::vector<uint8_t> attributes(vd->serializeAttributes());
+  vd->serializeAttributes(&attributes[0]);
+  for (size_t i=0; i<attributes.size(); ++i)
+  {
+    hash = (hash ^ attributes[i]) * prime;
+  }
+
+  // all of the data, a word at a time, so that volumes which differ in a
+  // single voxel get different ids
+  const size_t frameBytes = vd->getFrameBytes();
+  const size_t words = frameBytes / sizeof(uint64_t);
+  for (size_t f=0; f<vd->frames; ++f)
+  {
+    const uint8_t* raw = vd->getRaw(f);
+    if (raw == NULL)
+      continue;
+
+    for (size_t i=0; i<words; ++i)
+    {
+      uint64_t word;
+      memcpy(&word, raw + i * sizeof(uint64_t), sizeof(uint64_t));
+      hash = (hash ^ word) * prime;
+      hash ^= hash >> 29;
+    }
+    for (size_t i=words * sizeof(uint64_t); i<frameBytes; ++i)
+    {
+      hash = (hash ^ raw[i]) * prime;
+    }
+  }
+
+  return hash;
+}
+
+VolumeUpload::VolumeUpload(vvVolDesc* vd, uint64_t id)
+  : impl(new Impl)
+{
+  impl->vd = vd;
+  impl->id = id;
+  impl->ok = true;
+  impl->chunksPerFrame = getChunksPerFrame(vd);
+  impl->numChunks = getNumChunks(vd);
+  impl->numAdded = 0;
+  impl->pool = NULL;
+  impl->stored.assign(impl->numChunks, false);
+
+  const size_t frameBytes = vd->getFrameBytes();
+  for (size_t f=0; f<vd->frames; ++f)
+  {
+    // zeroed, so missing frames render as empty space
+    uint8_t* raw = new (std::nothrow) uint8_t[frameBytes]();
+    if (raw == NULL)
+    {
+      impl->ok = false;
+      break;
+    }
+    vd->addFrame(raw, vvVolDesc::ARRAY_DELETE);
+  }
+}
+
+VolumeUpload::~VolumeUpload()
+{
+  wait();
+  delete impl->pool;
+  delete impl->vd;
+  delete impl;
+}
+
+bool VolumeUpload::initStatus() const
+{
+  return impl->ok;
+}
+
+uint64_t VolumeUpload::getId() const
+{
+  return impl->id;
+}
+
+vvVolDesc* VolumeUpload::getVolDesc() const
+{
+  return impl->vd;
+}
+
+bool VolumeUpload::addChunk(size_t frame, size_t index, std::vector<uchar>& data, size_t rawSize, bool delta)
+{
+  if (!impl->ok || impl->vd == NULL)
+    return false;
+
+  const size_t frameBytes = impl->vd->getFrameBytes();
+  if (frame >= impl->vd->frames
+   || index >= impl->chunksPerFrame
+   || frame * impl->chunksPerFrame + index != impl->numAdded
+   || rawSize != std::min(ChunkSize, frameBytes - index * ChunkSize)
+   || (delta && frame == 0))
+  {
+    return false;
+  }
+
+  uchar* dst = impl->vd->getRaw(frame) + index * ChunkSize;
+
+  if (data.size() == rawSize && !delta)
+  {
+    memcpy(dst, &data[0], rawSize);
+    impl->setStored(impl->numAdded);
+  }
+  else if (data.empty())
+  {
+    return false;
+  }
+  else
+  {
+    if (impl->pool == NULL)
+    {
+      impl->pool = new WorkerPool(0, "decompress");
+    }
+
+    impl->pending.push_back(Impl::Chunk());
+    Impl::Chunk& chunk = impl->pending.back();
+    chunk.impl = impl;
+    chunk.data.swap(data);
+    chunk.dst = dst;
+    chunk.previous = delta ? impl->vd->getRaw(frame - 1) + index * ChunkSize : NULL;
+    chunk.size = rawSize;
+    chunk.number = impl->numAdded;
+    chunk.delta = delta;
+    impl->pool->submit(Impl::decompressChunk, &chunk);
+  }
+
+  ++impl->numAdded;
+  return true;
+}
+
+bool VolumeUpload::wait()
+{
+  if (impl->pool != NULL)
+  {
+    impl->pool->wait();
+  }
+  impl->pending.clear();
+
+  if (impl->failures.load() != 0)
+  {
+    // a chunk is lost, so is the data of the chunks that follow it in
+    // delta frames: start over with the first chunk
+    impl->failures.store(0);
+    impl->numAdded = 0;
+    ScopedLock lock(&impl->mutex);
+    impl->stored.assign(impl->numChunks, false);
+    return false;
+  }
+  return true;
+}
+
+size_t VolumeUpload::getNumReceived() const
+{
+  return impl->failures.load() == 0 ? impl->numAdded : 0;
+}
+
+bool VolumeUpload::isFrameComplete(size_t frame) const
+{
+  return getNumReceived() >= (frame + 1) * impl->chunksPerFrame;
+}
+
+bool VolumeUpload::isComplete() const
+{
+  return getNumReceived() >= impl->numChunks;
+}
+
+vvVolDesc* VolumeUpload::release()
+{
+  wait();
+  vvVolDesc* vd = impl->vd;
+  impl->vd = NULL;
+  return vd;
+}
+
+} // namespace virvo
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
@@ -0,0 +1,112 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef _VV_VOLUMEUPLOAD_H_
+#define _VV_VOLUMEUPLOAD_H_
+
+#include "vvexport.h"
+#include "vvinttypes.h"
+
+#include <stddef.h>
+#include <vector>
+
+class vvVolDesc;
+
+namespace virvo
+{
+
+//------------------------------------------------------------------------------
+// VolumeUpload
+//
+// Assembles a volume that is received in chunks, see
+// vvSocketIO::putVolumeChunks(). The frames are allocated up front, so a
+// renderer can show the first frame while the remaining frames arrive.
+// Compressed chunks are decompressed by a worker pool while the next
+// chunks are received. Delta chunks hold the XOR with the same chunk of
+// the previous frame and are restored once that chunk is stored.
+//
+// Chunks must be added in order. Keep an incomplete upload to resume an
+// interrupted transfer at getNumReceived().
+//
+class VVAPI VolumeUpload
+{
+public:
+  /// Number of voxel bytes in a chunk, the last chunk of a frame may be smaller
+  static const size_t ChunkSize;
+
+  /// Returns the number of chunks per frame of vd
+  static size_t getChunksPerFrame(const vvVolDesc* vd);
+
+  /// Returns the number of chunks of all frames of vd
+  static size_t getNumChunks(const vvVolDesc* vd);
+
+  /// Returns an identifier for the attributes and the data of vd. All of
+  /// the data is hashed. Compare the attributes as well before resuming an
+  /// upload, the id is a 64 bit hash.
+  static uint64_t computeId(const vvVolDesc* vd);
+
+  /// Start an upload into vd, which must have its attributes set and no
+  /// frames. Takes ownership of vd and allocates all frames.
+  explicit VolumeUpload(vvVolDesc* vd, uint64_t id = 0);
+
+  /// Wait for pending chunks, deletes the volume unless it was released
+  ~VolumeUpload();
+
+  /// Returns false if the frames could not be allocated
+  bool initStatus() const;
+
+  uint64_t getId() const;
+  vvVolDesc* getVolDesc() const;
+
+  /// Add the next chunk. data is swapped out and is compressed if its size
+  /// differs from rawSize. delta marks the XOR with the same chunk of the
+  /// previous frame. Returns false for an unexpected chunk.
+  bool addChunk(size_t frame, size_t index, std::vector<uchar>& data, size_t rawSize, bool delta = false);
+
+  /// Wait until all added chunks are stored.
+  /// @return false if a chunk could not be decompressed, the upload then
+  ///         starts over with the first chunk
+  bool wait();
+
+  /// Returns the number of chunks stored, call wait() first
+  size_t getNumReceived() const;
+
+  /// Returns true if all chunks of frame are stored, call wait() first
+  bool isFrameComplete(size_t frame) const;
+
+  /// Returns true if all chunks are stored, call wait() first
+  bool isComplete() const;
+
+  /// Give up ownership of the volume
+  vvVolDesc* release();
+
+private:
+  struct Impl;
+  Impl* impl;
+
+  // NOT copyable!
+  VolumeUpload(VolumeUpload const&);
+  VolumeUpload& operator=(VolumeUpload const&);
+};
+
+} // namespace virvo
+
+#endif
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
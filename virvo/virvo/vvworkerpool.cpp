@@ -0,0 +1,276 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#include "vvworkerpool.h"
+#include "vvpthread.h"
+#include "vvtoolshed.h"
+#include "vvtrace.h"
+
+#include <deque>
+#include <vector>
+
+namespace virvo
+{
+
+struct WorkerPool::Impl
+{
+  struct Task
+  {
+    Job job;
+    void* param;
+  };
+
+  const char* name;
+  std::vector<pthread_t> threads;
+  std::deque<Task> queue;
+  Mutex mutex;
+  Condition jobAvailable;
+  Condition idle;
+  int busy;       // number of threads running a job
+  bool quit;
+
+  static void* workerFunc(void* param);
+};
+
+void* WorkerPool::Impl::workerFunc(void* param)
+{
+  Impl* impl = static_cast<Impl*>(param);
+
+  trace::setThreadName(impl->name);
+
+  ScopedLock lock(&impl->mutex);
+  for (;;)
+  {
+    while (impl->queue.empty() && !impl->quit)
+    {
+      impl->jobAvailable.wait(&impl->mutex);
+    }
+
+    if (impl->queue.empty())
+    {
+      // quit, and all queued jobs are done
+      break;
+    }
+
+    Task task = impl->queue.front();
+    impl->queue.pop_front();
+    ++impl->busy;
+
+    impl->mutex.unlock();
+    task.job(task.param);
+    impl->mutex.lock();
+
+    --impl->busy;
+    if (impl->busy == 0 && impl->queue.empty())
+    {
+      impl->idle.broadcast();
+    }
+  }
+
+  return NULL;
+}
+
+WorkerPool::WorkerPool(int numThreads, const char* name)
+  : impl(new Impl)
+{
+  if (numThreads <= 0)
+  {
+    numThreads = vvToolshed::getNumProcessors();
+  }
+
+  impl->name = name;
+  impl->busy = 0;
+  impl->quit = false;
+
+  for (int i = 0; i < numThreads; ++i)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, Impl::workerFunc, impl) == 0)
+    {
+      impl->threads.push_back(thread);
+    }
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    ScopedLock lock(&impl->mutex);
+    impl->quit = true;
+    impl->jobAvailable.broadcast();
+  }
+
+  for (size_t i = 0; i < impl->threads.size(); ++i)
+  {
+    pthread_join(impl->threads[i], NULL);
+  }
+
+  delete impl;
+}
+
+void WorkerPool::submit(Job job, void* param)
+{
+  if (impl->threads.empty())
+  {
+    // thread creation failed
+    job(param);
+    return;
+  }
+
+  Impl::Task task = { job, param };
+
+  ScopedLock lock(&impl->mutex);
+  impl->queue.push_back(task);
+  impl->jobAvailable.signal();
+}
+
+void WorkerPool::wait()
+{
+  ScopedLock lock(&impl->mutex);
+  while (impl->busy > 0 || !impl->queue.empty())
+  {
+    impl->idle.wait(&impl->mutex);
+  }
+}
+
+int WorkerPool::size() const
+{
+  return static_cast<int>(impl->threads.size());
+}
+
+namespace
+{
+
+struct OrderedItems
+{
+  size_t count;
+  size_t window;
+  ProcessItem process;
+  void* context;
+  Mutex mutex;
+  Condition cond;
+  size_t next;              // next item to process
+  size_t consumed;          // items consumed so far
+  std::vector<bool> done;   // items processed
+};
+
+void processItems(void* param)
+{
+  OrderedItems* items = static_cast<OrderedItems*>(param);
+
+  for (;;)
+  {
+    size_t index;
+    {
+      ScopedLock lock(&items->mutex);
+      while (items->next < items->count && items->next >= items->consumed + items->window)
+      {
+        items->cond.wait(&items->mutex);
+      }
+      if (items->next >= items->count)
+      {
+        return;
+      }
+      index = items->next++;
+    }
+
+    items->process(items->context, index);
+
+    ScopedLock lock(&items->mutex);
+    items->done[index] = true;
+    items->cond.broadcast();
+  }
+}
+
+} // namespace
+
+size_t processOrdered(size_t count, int numThreads, size_t window,
+                      ProcessItem process, ConsumeItem consume, void* context,
+                      const char* name)
+{
+  if (numThreads <= 0)
+  {
+    numThreads = vvToolshed::getNumProcessors();
+  }
+  if (static_cast<size_t>(numThreads) > count)
+  {
+    numThreads = static_cast<int>(count);
+  }
+
+  if (numThreads <= 1)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      process(context, i);
+      if (!consume(context, i))
+      {
+        return i;
+      }
+    }
+    return count;
+  }
+
+  OrderedItems items;
+  items.count = count;
+  items.window = (window > 0) ? window : 2 * static_cast<size_t>(numThreads);
+  items.process = process;
+  items.context = context;
+  items.next = 0;
+  items.consumed = 0;
+  items.done.resize(count, false);
+
+  WorkerPool pool(numThreads, name);
+  for (int i = 0; i < numThreads; ++i)
+  {
+    pool.submit(processItems, &items);
+  }
+
+  size_t consumed = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    {
+      ScopedLock lock(&items.mutex);
+      while (!items.done[i])
+      {
+        items.cond.wait(&items.mutex);
+      }
+    }
+
+    if (!consume(context, i))
+    {
+      ScopedLock lock(&items.mutex);
+      items.next = count;
+      items.cond.broadcast();
+      break;
+    }
+
+    ++consumed;
+    ScopedLock lock(&items.mutex);
+    items.consumed = consumed;
+    items.cond.broadcast();
+  }
+
+  pool.wait();
+  return consumed;
+}
+
+} // namespace virvo
+
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
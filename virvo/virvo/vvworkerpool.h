@@ -0,0 +1,104 @@
+// Virvo - Virtual Reality Volume Rendering
+// Contact: Stefan Zellmann, zellmans@uni-koeln.de
+//
+// This file is part of Virvo.
+//
+// Virvo is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library (see license.txt); if not, write to the
+// Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+
+#ifndef _VV_WORKERPOOL_H_
+#define _VV_WORKERPOOL_H_
+
+#include "vvexport.h"
+
+#include <stddef.h>
+
+namespace virvo
+{
+
+//------------------------------------------------------------------------------
+// WorkerPool
+//
+// A fixed number of threads that process jobs from a FIFO queue. Use this
+// instead of a thread per task when the number of tasks is unbounded, e.g.
+// one per client connection.
+//
+//   void job(void* param) { ... }
+//
+//   virvo::WorkerPool pool(4, "my worker");
+//   pool.submit(job, data);
+//   pool.wait();
+//
+class VVAPI WorkerPool
+{
+public:
+  typedef void (*Job)(void* param);
+
+  /// Start numThreads threads, or one per processor if numThreads <= 0.
+  /// The threads are named in trace output, name must be a string literal.
+  explicit WorkerPool(int numThreads = 0, const char* name = "virvo worker");
+
+  /// Finish all queued jobs and stop the threads
+  ~WorkerPool();
+
+  /// Queue a job, it is run by the next idle thread
+  void submit(Job job, void* param);
+
+  /// Block until the queue is empty and all threads are idle
+  void wait();
+
+  /// Returns the number of threads
+  int size() const;
+
+private:
+  struct Impl;
+  Impl* impl;
+
+  // NOT copyable!
+  WorkerPool(WorkerPool const&);
+  WorkerPool& operator=(WorkerPool const&);
+};
+
+//------------------------------------------------------------------------------
+// processOrdered
+//
+// Processes items on a pool of threads and consumes the results in item
+// order on the calling thread, e.g. to load files in parallel and merge
+// them in sequence. At most window items are processed ahead of the
+// consumer, which bounds the memory held by finished results.
+//
+//   void process(void* context, size_t index) { ... }
+//   bool consume(void* context, size_t index) { ...; return true; }
+//
+//   virvo::processOrdered(count, 0, 0, process, consume, context);
+//
+// consume returns false to stop early: items not yet started are skipped,
+// those in progress are finished but not consumed. Returns the number of
+// items consumed. With numThreads == 1, items are processed on the calling
+// thread, one at a time.
+//
+typedef void (*ProcessItem)(void* context, size_t index);
+typedef bool (*ConsumeItem)(void* context, size_t index);
+
+/// numThreads <= 0 uses one thread per processor, window == 0 allows
+/// two items per thread. name must be a string literal (see WorkerPool).
+VVAPI size_t processOrdered(size_t count, int numThreads, size_t window,
+                            ProcessItem process, ConsumeItem consume, void* context,
+                            const char* name = "virvo worker");
+
+} // namespace virvo
+
+#endif
+// vim: sw=2:expandtab:softtabstop=2:ts=2:cino=\:0g0t0
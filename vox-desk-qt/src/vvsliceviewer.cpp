@@ -41,7 +41,8 @@ void clamp(size_t* slice, size_t slices)
   *slice = std::max(size_t(0), *slice);
 }
 
-QImage getSlice(vvVolDesc* vd, std::vector<uchar>* texture, size_t slice, vvVecmath::AxisType axis)
+QImage getSlice(vvVolDesc* vd, virvo::Slicer* slicer, std::vector<uchar>* texture, size_t slice, vvVecmath::AxisType axis,
+                int outWidth, int outHeight)
 {
   assert(texture != NULL);
 
@@ -50,6 +51,20 @@ QImage getSlice(vvVolDesc* vd, std::vector<uchar>* texture, size_t slice, vvVecm
   size_t slices;
   vd->getVolumeSize(axis, width, height, slices);
   clamp(&slice, slices);
+
+  // scalar volumes are sampled at the size of the view, colored by the transfer function
+  if (vd->chan == 1 && outWidth > 1 && outHeight > 1)
+  {
+    virvo::Slicer::Plane plane = virvo::Slicer::axisPlane(vd, axis, slice);
+    plane.u.scale(float(width - 1) / float(outWidth - 1));
+    plane.v.scale(float(height - 1) / float(outHeight - 1));
+    slicer->setWindow(vd, 0.0f, 1.0f);
+    slicer->setColors(vd);
+    texture->resize(outWidth * outHeight * 3);
+    slicer->sample(vd, vd->getCurrentFrame(), 0, plane, outWidth, outHeight, &(*texture)[0]);
+    return QImage(&(*texture)[0], outWidth, outHeight, outWidth * 3 * sizeof(uchar), QImage::Format_RGB888);
+  }
+
   texture->resize(width * height * 3);
   vd->makeSliceImage(vd->getCurrentFrame(), axis, slice, &(*texture)[0]);
   size_t bytesPerLine = width * 3 * sizeof(uchar);
@@ -84,10 +99,13 @@ vvSliceViewer::vvSliceViewer(vvVolDesc* vd, QWidget* parent)
 void vvSliceViewer::paint()
 {
   std::vector<uchar> texture;
-  QImage img = QImage(getSlice(_vd, &texture, _slice, _axis));
+  QImage img = QImage(getSlice(_vd, &_slicer, &texture, _slice, _axis, ui->frame->width(), ui->frame->height()));
   if (!img.isNull())
   {
-    img = img.scaled(ui->frame->width(), ui->frame->height());
+    if (img.width() != ui->frame->width() || img.height() != ui->frame->height())
+    {
+      img = img.scaled(ui->frame->width(), ui->frame->height());
+    }
     if (ui->horizontalBox->isChecked() || ui->verticalBox->isChecked())
     {
       img = img.mirrored(ui->horizontalBox->isChecked(), ui->verticalBox->isChecked());
@@ -21,6 +21,7 @@
 #ifndef VV_SLICEVIEWER_H
 #define VV_SLICEVIEWER_H
 
+#include <virvo/vvslicer.h>
 #include <virvo/vvvecmath.h>
 
 #include <QDialog>
@@ -39,6 +40,7 @@ private:
   vvVolDesc* _vd;
   size_t _slice;
   vvVecmath::AxisType _axis;
+  virvo::Slicer _slicer;
 
   void paint();
   void updateUi();
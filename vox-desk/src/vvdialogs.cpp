@@ -1477,6 +1477,13 @@ VVMovieDialog::VVMovieDialog(FXWindow* owner, vvCanvas* c):FXDialogBox(owner,"Mo
   _fileTField = new FXTextField(fileFrame, 25, NULL,0,TEXTFIELD_NORMAL | LAYOUT_FILL_X);
   _fileTField->setText("image");
 
+  FXHorizontalFrame* parallelFrame = new FXHorizontalFrame(master, LAYOUT_FILL_X);
+  _parallelCheck = new FXCheckButton(parallelFrame,"Render in software on parallel threads",NULL,0,ICON_BEFORE_TEXT);
+  _parallelCheck->setCheck(false);
+  new FXLabel(parallelFrame, "Threads:");
+  _threadsTField = new FXTextField(parallelFrame, 5, NULL,0,TEXTFIELD_INTEGER | TEXTFIELD_NORMAL);
+  _threadsTField->setText(FXStringFormat("%d", vvToolshed::getNumProcessors()));
+
   FXHorizontalFrame* buttonFrame = new FXHorizontalFrame(master, LAYOUT_CENTER_X | LAYOUT_FILL_X | LAYOUT_FILL_Y | PACK_UNIFORM_WIDTH);
   new FXButton(buttonFrame,"Write Movie to Disk",NULL,this,ID_WRITE, FRAME_RAISED | FRAME_THICK | LAYOUT_LEFT);
   new FXButton(buttonFrame,"Help...",NULL,this,ID_HELP, FRAME_RAISED | FRAME_THICK | LAYOUT_CENTER_X);
@@ -1494,6 +1501,8 @@ VVMovieDialog::~VVMovieDialog()
   delete _dirTField;
   delete _widthTField;
   delete _heightTField;
+  delete _parallelCheck;
+  delete _threadsTField;
   delete _movie;
 }
 
@@ -1635,7 +1644,10 @@ long VVMovieDialog::onCmdWrite(FXObject*,FXSelector,void*)
   this->hide();   // prevent dialog window from blocking OpenGL canvas
   if(_shell->_glcanvas->makeCurrent())
   {
-    _movie->write(width, height, _fileTField->getText().text());
+    if(_parallelCheck->getCheck())
+      _movie->writeParallel(width, height, _fileTField->getText().text(), FXIntVal(_threadsTField->getText()));
+    else
+      _movie->write(width, height, _fileTField->getText().text());
     _shell->_glcanvas->makeNonCurrent();
   }
   this->show();
@@ -443,6 +443,8 @@ class VVMovieDialog : public FXDialogBox
     FXTextField* _fileTField;
     FXTextField* _dirTField;
     FXCheckButton* _useScreenDim;
+    FXCheckButton* _parallelCheck;
+    FXTextField* _threadsTField;
     vox::vvCanvas* _canvas;
     vox::vvMovie*  _movie;
     VVShell* _shell;
@@ -29,6 +29,11 @@
 #include <vvvecmath.h>
 #include <vvtoolshed.h>
 #include <vvfileio.h>
+#include <vvpthread.h>
+#include <vvsoftimg.h>
+#include <vvsoftpar.h>
+#include <vvsoftper.h>
+#include <vvworkerpool.h>
 
 // Local:
 #include "vvcanvas.h"
@@ -316,6 +321,158 @@ int vvMovie::getNumScriptSteps()
   return cnt;
 }
 
+//----------------------------------------------------------------------------
+/** Initialize a script state with the settings before the first command:
+  reset object view, first time step, and the current renderer settings.
+  @param frame  state to initialize
+*/
+void vvMovie::initFrame(vvMovieFrame* frame)
+{
+  vvDebugMsg::msg(3, "vvMovie::initFrame()");
+
+  vvRenderer* renderer = _canvas->_renderer;
+
+  _canvas->resetObjectView();
+  frame->camera = _canvas->_ov._camera;
+  frame->timestep = 0;
+  frame->peakSet = false;
+  frame->peak[0] = frame->peak[1] = 0.0f;
+  frame->clipMode = renderer->getParameter(vvRenderState::VV_CLIP_MODE).asUint();
+  frame->clipNormal = renderer->getParameter(vvRenderState::VV_CLIP_PLANE_NORMAL);
+  frame->clipPoint = renderer->getParameter(vvRenderState::VV_CLIP_PLANE_POINT);
+  frame->clipSingleSlice = renderer->getParameter(vvRenderState::VV_CLIP_SINGLE_SLICE);
+  frame->clipOpaque = renderer->getParameter(vvRenderState::VV_CLIP_OPAQUE);
+  frame->clipPerimeter = renderer->getParameter(vvRenderState::VV_CLIP_PERIMETER);
+  frame->quality = renderer->getParameter(vvRenderState::VV_QUALITY).asFloat();
+}
+
+//----------------------------------------------------------------------------
+/** Apply one script command to a script state.
+  @param step   script command
+  @param frame  state to modify
+*/
+void vvMovie::applyStep(const vvMovieStep* step, vvMovieFrame* frame)
+{
+  vvMatrix m;
+  float axis[3];                                  // rotation axis
+
+  switch (step->transform)
+  {
+    default:
+    case NONE:
+      break;
+    case TRANS:
+      m.identity();
+      axis[0] = axis[1] = axis[2] = 0.0f;
+      axis[int(step->param[0])] = step->param[1];
+      m.translate(axis[0], axis[1], axis[2]);
+      frame->camera.multiplyRight(m);
+      break;
+    case ROT:
+      m.identity();
+      axis[0] = axis[1] = axis[2] = 0.0f;
+      axis[int(step->param[0])] = 1.0f;
+      m.rotate(step->param[1] * float(TS_PI) / 180.0f, axis[0], axis[1], axis[2]);
+      frame->camera.multiplyRight(m);
+      break;
+    case SCALE:
+      m.identity();
+      m.scaleLocal(step->param[0]);
+      frame->camera.multiplyRight(m);
+      break;
+    case TIMESTEP:
+      frame->timestep = size_t(step->param[0]);
+      break;
+    case NEXTSTEP:
+      if (frame->timestep < _canvas->_vd->frames-1)
+        ++frame->timestep;
+      else frame->timestep = 0;
+      break;
+    case PREVSTEP:
+      if (frame->timestep>0) --frame->timestep;
+      else frame->timestep = _canvas->_vd->frames-1;
+      break;
+    case MOVEPEAK:
+      frame->peak[0] += step->param[0];
+      frame->peakSet = true;
+      break;
+    case SETPEAK:
+      frame->peak[0] = step->param[0];
+      frame->peak[1] = step->param[1];
+      frame->peakSet = true;
+      break;
+    case SETCLIP:
+      if (step->param[0]==0.0f && step->param[1]==0.0f &&
+          step->param[2]==0.0f && step->param[3]==0.0f)
+      {
+        frame->clipMode = 0;
+      }
+      else
+      {
+        frame->clipMode = 1;
+        vvVector3 normal(step->param[0], step->param[1], step->param[2]);
+        normal.normalize();
+        vvVector3 point = normal;
+        point.scale(step->param[3]);
+        frame->clipNormal = normal;
+        frame->clipPoint = point;
+      }
+      break;
+    case MOVECLIP:
+    {
+      frame->clipNormal.add(step->param[0], step->param[1], step->param[2]);
+      frame->clipNormal.normalize();
+      vvVector3 diff(frame->clipNormal);
+      diff.scale(step->param[3]);
+      frame->clipPoint.add(diff);
+      break;
+    }
+    case SETCLIPPARAM:
+      frame->clipSingleSlice = (step->param[0] == 0.0f) ? false : true;
+      frame->clipOpaque = (step->param[1] == 0.0f) ? false : true;
+      frame->clipPerimeter = (step->param[2] == 0.0f) ? false : true;
+      break;
+    case SETQUALITY:
+      frame->quality = step->param[0];
+      break;
+    case CHANGEQUALITY:
+      frame->quality += step->param[0];
+      break;
+    case SHOW:
+      break;
+  }
+}
+
+//----------------------------------------------------------------------------
+/** Apply a script state to a renderer and its volume. The camera is not
+  part of the renderer state and has to be set by the caller.
+  @param frame     state to apply
+  @param previous  state applied before to the same renderer, NULL if unknown.
+                   The transfer function is only rebuilt if the peak changed.
+  @param renderer  renderer to modify
+  @param vd        volume rendered by renderer
+*/
+void vvMovie::applyFrame(const vvMovieFrame& frame, const vvMovieFrame* previous,
+                         vvRenderer* renderer, vvVolDesc* vd)
+{
+  if (frame.peakSet && (previous==NULL || !previous->peakSet ||
+      previous->peak[0]!=frame.peak[0] || previous->peak[1]!=frame.peak[1]))
+  {
+    vd->tf.deleteWidgets(vvTFWidget::TF_PYRAMID);
+    vd->tf.deleteWidgets(vvTFWidget::TF_BELL);
+    vd->tf._widgets.push_back(new vvTFPyramid(vvColor(1.0f, 1.0f, 1.0f), false, 1.0f, frame.peak[0], frame.peak[1], 0.0f));
+    renderer->updateTransferFunction();
+  }
+  renderer->setParameter(vvRenderState::VV_CLIP_MODE, frame.clipMode);
+  renderer->setParameter(vvRenderState::VV_CLIP_PLANE_NORMAL, frame.clipNormal);
+  renderer->setParameter(vvRenderState::VV_CLIP_PLANE_POINT, frame.clipPoint);
+  renderer->setParameter(vvRenderState::VV_CLIP_SINGLE_SLICE, frame.clipSingleSlice);
+  renderer->setParameter(vvRenderState::VV_CLIP_OPAQUE, frame.clipOpaque);
+  renderer->setParameter(vvRenderState::VV_CLIP_PERIMETER, frame.clipPerimeter);
+  renderer->setParameter(vvRenderState::VV_QUALITY, frame.quality);
+  renderer->setCurrentFrame(frame.timestep);
+}
+
 //----------------------------------------------------------------------------
 /** Set a specific movie step.
   @param step index of desired movie step (first step = 0)
@@ -325,132 +482,26 @@ bool vvMovie::setStep(size_t step)
 {
   vvDebugMsg::msg(1, "vvMovie::setStep()");
 
-  vvMatrix m;
-  float axis[3];                                  // rotation axis
-  size_t timestep = 0;                            // volume dataset index
+  vvMovieFrame frame;
   size_t i;
   bool done;
-  float peak[2] = {0.f, 0.f};                     // peak position and width
-  bool tfChanged = false;
 
   if (steps==NULL || steps->count()==0) return false;
 
-  _canvas->resetObjectView();
+  initFrame(&frame);
   steps->first();
   for (i=0; i<=step; ++i)
   {
     done = false;
     while (!done)
     {
-      switch (steps->getData()->transform)
-      {
-        default:
-        case NONE:
-          break;
-        case TRANS:
-          m.identity();
-          axis[0] = axis[1] = axis[2] = 0.0f;
-          axis[int(steps->getData()->param[0])] = steps->getData()->param[1];
-          m.translate(axis[0], axis[1], axis[2]);
-          _canvas->transformObject(m);
-          break;
-        case ROT:
-          m.identity();
-          axis[0] = axis[1] = axis[2] = 0.0f;
-          axis[int(steps->getData()->param[0])] = 1.0f;
-          m.rotate(steps->getData()->param[1] * float(TS_PI) / 180.0f, axis[0], axis[1], axis[2]);
-          _canvas->transformObject(m);
-          break;
-        case SCALE:
-          m.identity();
-          m.scaleLocal(steps->getData()->param[0]);
-          _canvas->transformObject(m);
-          break;
-        case TIMESTEP:
-          timestep = size_t(steps->getData()->param[0]);
-          break;
-        case NEXTSTEP:
-          if (timestep < _canvas->_vd->frames-1)
-            ++timestep;
-          else timestep = 0;
-          break;
-        case PREVSTEP:
-          if (timestep>0) --timestep;
-          else timestep = _canvas->_vd->frames-1;
-          break;
-        case MOVEPEAK:
-          peak[0] += steps->getData()->param[0];
-          _canvas->_vd->tf.deleteWidgets(vvTFWidget::TF_PYRAMID);
-          _canvas->_vd->tf.deleteWidgets(vvTFWidget::TF_BELL);
-          _canvas->_vd->tf._widgets.push_back(new vvTFPyramid(vvColor(1.0f, 1.0f, 1.0f), false, 1.0f, peak[0], peak[1], 0.0f));
-          tfChanged = true;
-          break;
-        case SETPEAK:
-          peak[0] = steps->getData()->param[0];
-          peak[1] = steps->getData()->param[1];
-          _canvas->_vd->tf.deleteWidgets(vvTFWidget::TF_PYRAMID);
-          _canvas->_vd->tf.deleteWidgets(vvTFWidget::TF_BELL);
-          _canvas->_vd->tf._widgets.push_back(new vvTFPyramid(vvColor(1.0f, 1.0f, 1.0f), false, 1.0f, peak[0], peak[1], 0.0f));
-          tfChanged = true;
-          break;
-        case SETCLIP:
-          if (steps->getData()->param[0]==0.0f && steps->getData()->param[1]==0.0f &&
-              steps->getData()->param[2]==0.0f && steps->getData()->param[3]==0.0f)
-          {
-            _canvas->_renderer->setParameter(vvRenderState::VV_CLIP_MODE, false);
-          }
-          else
-          {
-            _canvas->_renderer->setParameter(vvRenderState::VV_CLIP_MODE, true);
-            vvVector3 normal(steps->getData()->param[0], steps->getData()->param[1], steps->getData()->param[2]);
-            normal.normalize();
-            vvVector3 point = normal;
-            point.scale(steps->getData()->param[3]);
-            _canvas->_renderer->setParameter(vvRenderState::VV_CLIP_PLANE_NORMAL, normal);
-            _canvas->_renderer->setParameter(vvRenderState::VV_CLIP_PLANE_POINT, point);
-          }
-          break;
-        case MOVECLIP:
-        {
-          vvVector3 point, normal;
-          normal = _canvas->_renderer->getParameter(vvRenderState::VV_CLIP_PLANE_NORMAL);
-          point = _canvas->_renderer->getParameter(vvRenderState::VV_CLIP_PLANE_POINT);
-          normal.add(steps->getData()->param[0], steps->getData()->param[1], steps->getData()->param[2]);
-          normal.normalize();
-          vvVector3 diff(normal);
-          diff.scale(steps->getData()->param[3]);
-          point.add(diff);
-          _canvas->_renderer->setParameter(vvRenderState::VV_CLIP_PLANE_NORMAL, normal);
-          _canvas->_renderer->setParameter(vvRenderState::VV_CLIP_PLANE_POINT, point);
-          break;
-        }
-        case SETCLIPPARAM:
-        {
-          _canvas->_renderer->setParameter(vvRenderState::VV_CLIP_SINGLE_SLICE, (steps->getData()->param[0] == 0.0f) ? false : true);
-          _canvas->_renderer->setParameter(vvRenderState::VV_CLIP_OPAQUE, (steps->getData()->param[1] == 0.0f) ? false : true);
-          _canvas->_renderer->setParameter(vvRenderState::VV_CLIP_PERIMETER, (steps->getData()->param[2] == 0.0f) ? false : true);
-        }
-        break;
-        case SETQUALITY:
-          _canvas->_renderer->setParameter(vvRenderState::VV_QUALITY, steps->getData()->param[0]);
-          break;
-        case CHANGEQUALITY:
-          _canvas->_renderer->setParameter(vvRenderState::VV_QUALITY,
-                  _canvas->_renderer->getParameter(vvRenderState::VV_QUALITY).asFloat() + steps->getData()->param[0]);
-          break;
-        case SHOW:
-          done = true;
-          break;
-      }
+      applyStep(steps->getData(), &frame);
+      done = (steps->getData()->transform == SHOW);
       steps->next();
     }
   }
-  if (tfChanged)
-  {
-    _canvas->_renderer->updateTransferFunction();
-    tfChanged = false;
-  }
-  _canvas->_renderer->setCurrentFrame(timestep);
+  _canvas->_ov._camera = frame.camera;
+  applyFrame(frame, NULL, _canvas->_renderer, _canvas->_vd);
   _currentStep = step;
   return true;
 }
@@ -461,8 +512,207 @@ size_t vvMovie::getStep()
   return _currentStep;
 }
 
+//----------------------------------------------------------------------------
+/** Evaluate the whole script in one pass, instead of replaying it from the
+  start for every movie step like setStep() does.
+  @param frames  returns the script state at every show command
+  @return number of movie steps
+*/
+size_t vvMovie::evaluate(std::vector<vvMovieFrame>& frames)
+{
+  vvDebugMsg::msg(1, "vvMovie::evaluate()");
+
+  vvMovieFrame frame;
+
+  frames.clear();
+  if (steps==NULL || steps->count()==0) return 0;
+
+  initFrame(&frame);
+  steps->first();
+  do
+  {
+    applyStep(steps->getData(), &frame);
+    if (steps->getData()->transform == SHOW) frames.push_back(frame);
+  } while (steps->next());
+  return frames.size();
+}
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/** Writes movie images on a separate thread, in the order they are passed
+  in. At most MAX_PENDING images are queued, write() blocks if the disk
+  can't keep up with the renderers.
+*/
+class vvMovieWriter
+{
+  public:
+    enum { MAX_PENDING = 4 };
+
+    vvMovieWriter(const char* baseFilename, size_t numImages, int width, int height)
+      : _pool(1, "movie writer")
+      , _baseFilename(baseFilename)
+      , _numImages(numImages)
+      , _width(width)
+      , _height(height)
+      , _pending(0)
+    {
+    }
+
+    ~vvMovieWriter()
+    {
+      _pool.wait();
+    }
+
+    /// Queue an RGB image, the writer deletes it when done
+    void write(size_t index, uchar* image)
+    {
+      {
+        virvo::ScopedLock lock(&_mutex);
+        while (_pending >= MAX_PENDING)
+          _cond.wait(&_mutex);
+        ++_pending;
+      }
+
+      Image* img = new Image;
+      img->writer = this;
+      img->index = index;
+      img->data = image;
+      _pool.submit(writeImage, img);
+    }
+
+  private:
+    struct Image
+    {
+      vvMovieWriter* writer;
+      size_t index;
+      uchar* data;
+    };
+
+    static void writeImage(void* param)
+    {
+      Image* img = static_cast<Image*>(param);
+      vvMovieWriter* writer = img->writer;
+      char* currentFile = new char[strlen(writer->_baseFilename) + 1 + 20];
+
+      // Create filename:
+      if (writer->_numImages<100000) sprintf(currentFile, "%s%05d.tif", writer->_baseFilename, int(img->index));
+      else sprintf(currentFile, "%s%09d.tif", writer->_baseFilename, int(img->index));
+
+      // Write screenshot to file:
+      vvVolDesc* imgVD = new vvVolDesc(currentFile, writer->_width, writer->_height, img->data);
+      cerr << "Writing file: " << currentFile << endl;
+      vvFileIO* fio = new vvFileIO();
+      fio->saveVolumeData(imgVD, false);
+      delete fio;
+      delete imgVD;
+      delete[] currentFile;
+      delete[] img->data;
+      delete img;
+
+      virvo::ScopedLock lock(&writer->_mutex);
+      --writer->_pending;
+      writer->_cond.signal();
+    }
+
+    virvo::WorkerPool _pool;
+    virvo::Mutex _mutex;
+    virvo::Condition _cond;
+    const char* _baseFilename;
+    size_t _numImages;
+    int _width;
+    int _height;
+    size_t _pending;
+};
+
+//----------------------------------------------------------------------------
+/// Frames shared by the render threads of vvMovie::writeParallel()
+struct vvMovieJob
+{
+  const std::vector<vvMovieFrame>* frames;
+  std::vector<vvMatrix> modelviews;               ///< modelview matrix of every frame
+  vvMatrix projection;
+  int width, height;
+  float bgColor[3];
+  virvo::Mutex mutex;
+  virvo::Condition cond;
+  size_t next;                                    ///< next frame to render
+  size_t written;                                 ///< frames passed on to the writer
+  size_t window;                                  ///< maximum number of frames ahead of the writer
+  std::vector<uchar*> images;                     ///< finished RGB images, NULL if pending
+};
+
+/// One render thread of vvMovie::writeParallel()
+struct vvMovieRenderThread
+{
+  vvMovieJob* job;
+  vvVolDesc* vd;                                  ///< shares the voxel data with the canvas volume
+  vvSoftVR* renderer;
+};
+
+//----------------------------------------------------------------------------
+/** Render frames until all are taken. Each frame is composited over the
+  background color and flipped to top-down rows like vvRenderer::renderVolumeRGB()
+  does. Frames the renderer rejects come out as background.
+*/
+void renderMovieFrames(void* param)
+{
+  vvMovieRenderThread* thread = static_cast<vvMovieRenderThread*>(param);
+  vvMovieJob* job = thread->job;
+  const int width = job->width;
+  const int height = job->height;
+  const vvMovieFrame* previous = NULL;
+
+  for (;;)
+  {
+    size_t index;
+    {
+      virvo::ScopedLock lock(&job->mutex);
+      while (job->next < job->frames->size() && job->next >= job->written + job->window)
+        job->cond.wait(&job->mutex);
+      if (job->next >= job->frames->size())
+        return;
+      index = job->next++;
+    }
+
+    const vvMovieFrame& frame = (*job->frames)[index];
+    vvMovie::applyFrame(frame, previous, thread->renderer, thread->vd);
+    previous = &frame;
+    thread->renderer->renderVolume(job->modelviews[index], job->projection, width, height);
+
+    const vvSoftImg* img = thread->renderer->getOutputImage();
+    const bool valid = (img->width==width && img->height==height);
+    uchar* rgb = new uchar[width * height * 3];
+    for (int y=0; y<height; ++y)
+    {
+      const uchar* src = img->data + vvSoftImg::PIXEL_SIZE * y * img->width;
+      uchar* dst = rgb + 3 * (height - y - 1) * width;
+      for (int x=0; x<width; ++x)
+      {
+        const float alpha = valid ? float(src[3]) / 255.0f : 0.0f;
+        for (int c=0; c<3; ++c)
+        {
+          const float value = float(src[c]) * alpha + job->bgColor[c] * 255.0f * (1.0f - alpha);
+          dst[c] = uchar(ts_clamp(value + 0.5f, 0.0f, 255.0f));
+        }
+        if (valid) src += vvSoftImg::PIXEL_SIZE;
+        dst += 3;
+      }
+    }
+
+    virvo::ScopedLock lock(&job->mutex);
+    job->images[index] = rgb;
+    job->cond.broadcast();
+  }
+}
+
+}
+
 //----------------------------------------------------------------------------
 /** Write a movie to disk.
+  The script is evaluated once, the frames are rendered with the renderer
+  of the canvas and written to disk on a separate thread.
   @param width,height  disk image format
   @param baseFilename  base filename for saved movie frames (w/o extension!)
   @return true if successful
@@ -471,39 +721,135 @@ bool vvMovie::write(int width, int height, const char* baseFilename)
 {
   vvDebugMsg::msg(1, "vvMovie::write()", width, height);
 
-  vvFileIO* fio;
-  vvVolDesc* imgVD;
-  char* currentFile;                              // current file name
-  uchar* image = NULL;                            // image data
-  int i, numSteps;
+  std::vector<vvMovieFrame> frames;
+  size_t i, numSteps;
 
   if (steps==NULL || width<=0 || height<=0) return false;
 
-  image = new uchar[width * height * 3];          // reserve RGB image space
-  currentFile = new char[strlen(baseFilename) + 1 + 20];
-
-  numSteps = getNumScriptSteps();
+  numSteps = evaluate(frames);
+  vvMovieWriter writer(baseFilename, numSteps, width, height);
   for (i=0; i<numSteps; ++i)
   {
     // Render screenshot to memory:
-    setStep(i);
+    _canvas->_ov._camera = frames[i].camera;
+    applyFrame(frames[i], (i>0) ? &frames[i-1] : NULL, _canvas->_renderer, _canvas->_vd);
+    _currentStep = i;
     _canvas->draw();
+    uchar* image = new uchar[width * height * 3];  // RGB image, deleted by the writer
     _canvas->_renderer->renderVolumeRGB(width, height, image);
+    writer.write(i, image);
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/** Write a movie to disk, rendering several frames at a time.
+  Each thread renders with its own software renderer (shear-warp, parallel
+  or perspective like the canvas projection). The renderers share the voxel data but
+  keep their own transfer function and axis representations, so memory
+  grows with the number of threads. The frames are passed on to the writer
+  thread in script order. Falls back to write() for data sets the software
+  renderers can't display.
+  @param width,height  disk image format
+  @param baseFilename  base filename for saved movie frames (w/o extension!)
+  @param numThreads    number of render threads, <= 0 for one per processor
+  @return true if successful
+*/
+bool vvMovie::writeParallel(int width, int height, const char* baseFilename, int numThreads)
+{
+  vvDebugMsg::msg(1, "vvMovie::writeParallel()", width, height);
+
+  std::vector<vvMovieFrame> frames;
+  std::vector<vvMovieRenderThread> threads;
+  vvMovieJob job;
+  vvVolDesc* vd = _canvas->_vd;
+  size_t i, numSteps;
+
+  if (steps==NULL || width<=0 || height<=0) return false;
+
+  if (vd->getBPV() != 1)
+  {
+    cerr << "Software rendering requires 8 bit scalar data, rendering movie with OpenGL" << endl;
+    return write(width, height, baseFilename);
+  }
+
+  numSteps = evaluate(frames);
+  if (numSteps==0) return true;
 
-    // Create filename:
-    if (numSteps<100000) sprintf(currentFile, "%s%05d.tif", baseFilename, i);
-    else sprintf(currentFile, "%s%09d.tif", baseFilename, i);
-
-    // Write screenshot to file:
-    imgVD = new vvVolDesc(currentFile, width, height, image);
-    cerr << "Writing file: " << currentFile << endl;
-    fio = new vvFileIO();
-    fio->saveVolumeData(imgVD, false);
-    delete fio;
-    delete imgVD;
+  if (numThreads <= 0) numThreads = vvToolshed::getNumProcessors();
+  if (size_t(numThreads) > numSteps) numThreads = int(numSteps);
+
+  job.frames = &frames;
+  for (i=0; i<numSteps; ++i)
+  {
+    _canvas->_ov._camera = frames[i].camera;
+    job.modelviews.push_back(vvMatrix());
+    _canvas->_ov.getModelviewMatrix(vvObjView::CENTER, job.modelviews.back());
+  }
+  _canvas->_ov.getProjectionMatrix(float(width) / float(height), job.projection);
+  job.width = width;
+  job.height = height;
+  _canvas->getBackgroundColor(job.bgColor[0], job.bgColor[1], job.bgColor[2]);
+  job.next = 0;
+  job.written = 0;
+  job.window = 2 * size_t(numThreads);
+  job.images.resize(numSteps, NULL);
+
+  // Create the renderers and their output images here, both need the
+  // OpenGL context of the canvas:
+  vvRenderState renderState = *_canvas->_renderer;
+  threads.resize(numThreads);
+  for (int t=0; t<numThreads; ++t)
+  {
+    threads[t].job = &job;
+    threads[t].vd = new vvVolDesc(vd, -2);
+    for (size_t f=0; f<vd->frames; ++f)
+    {
+      threads[t].vd->addFrame(vd->getRaw(f), vvVolDesc::NO_DELETE);
+      ++threads[t].vd->frames;
+    }
+    if (job.projection.isProjOrtho())
+      threads[t].renderer = new vvSoftPar(threads[t].vd, renderState);
+    else
+      threads[t].renderer = new vvSoftPer(threads[t].vd, renderState);
+    threads[t].renderer->setOutputImageSize(width, height);
+  }
+
+  {
+    virvo::WorkerPool pool(numThreads, "movie renderer");
+    vvMovieWriter writer(baseFilename, numSteps, width, height);
+
+    for (int t=0; t<numThreads; ++t)
+      pool.submit(renderMovieFrames, &threads[t]);
+
+    // Hand the images to the writer in script order:
+    for (i=0; i<numSteps; ++i)
+    {
+      uchar* image;
+      {
+        virvo::ScopedLock lock(&job.mutex);
+        while (job.images[i]==NULL)
+          job.cond.wait(&job.mutex);
+        image = job.images[i];
+        job.images[i] = NULL;
+        ++job.written;
+        job.cond.broadcast();
+      }
+      writer.write(i, image);
+    }
+    pool.wait();
+  }
+
+  for (int t=0; t<numThreads; ++t)
+  {
+    delete threads[t].renderer;
+    delete threads[t].vd;
   }
 
-  delete[] image;
+  // Leave the canvas at the last movie step, like write() does:
+  _canvas->_ov._camera = frames.back().camera;
+  applyFrame(frames.back(), NULL, _canvas->_renderer, vd);
+  _currentStep = numSteps - 1;
   return true;
 }
 
@@ -21,9 +21,12 @@
 #ifndef _VV_MOVIE_H_
 #define _VV_MOVIE_H_
 
+#include <vector>
+
 // Virvo:
 #include "vvtokenizer.h"
 #include "vvsllist.h"
+#include "vvvecmath.h"
 
 // Local:
 #include "vvcanvas.h"
@@ -36,6 +39,7 @@ namespace vox
 {
 
 class vvMovieStep;
+class vvMovieFrame;
 
 /**
 The Virvo shell allows the user to generate movies with changing camera
@@ -123,6 +127,11 @@ movepeak 0.1    # move peak to the right by 1/10th of the scalar value range
 show            # display dataset
 endrep          # terminate repeat loop
 
+write() renders the frames with the renderer of the canvas. writeParallel()
+evaluates the script once and renders the frames on several threads, each
+with its own software renderer, while a separate thread writes the images.
+Frames are written in script order either way.
+
 @author Jurgen P. Schulze (jschulze@ucsd.edu)
 */
 class vvMovie
@@ -133,6 +142,9 @@ class vvMovie
     vox::vvCanvas* _canvas;
     size_t _currentStep;
 
+    void  initFrame(vvMovieFrame*);
+    void  applyStep(const vvMovieStep*, vvMovieFrame*);
+
   public:
     enum TransformType                            /// object modification types
     {
@@ -156,7 +168,10 @@ class vvMovie
     int   getNumScriptSteps();
     bool  setStep(size_t);
     size_t   getStep();
+    size_t evaluate(std::vector<vvMovieFrame>&);
+    static void applyFrame(const vvMovieFrame&, const vvMovieFrame*, vvRenderer*, vvVolDesc*);
     bool  write(int, int, const char*);
+    bool  writeParallel(int, int, const char*, int = 0);
 };
 
 /** One time step in a volume animation.
@@ -177,6 +192,26 @@ class vvMovieStep
     };
 };
 
+/** Script state at one show command, i.e., everything needed to render
+  one movie frame without replaying the script.
+  @see vvMovie::evaluate
+*/
+class vvMovieFrame
+{
+  public:
+    vvMatrix  camera;                             ///< camera matrix
+    size_t    timestep;                           ///< volume animation time step
+    bool      peakSet;                            ///< true if the script defined an alpha peak
+    float     peak[2];                            ///< peak position and width
+    unsigned  clipMode;                           ///< 0 = clipping disabled, 1 = clipping plane
+    vvVector3 clipNormal;                         ///< clipping plane normal
+    vvVector3 clipPoint;                          ///< point on clipping plane
+    bool      clipSingleSlice;                    ///< true = show single slice only
+    bool      clipOpaque;                         ///< true = single slice is opaque
+    bool      clipPerimeter;                      ///< true = show clipping plane perimeter
+    float     quality;                            ///< rendering quality
+};
+
 }
 #endif
 
@@ -298,21 +298,32 @@ void vvObjView::setProjection(ProjectionType pt, float range, float nearPlane, f
   @param yFOV field of view on y axis [radians]
  */
 void vvObjView::getWindowExtent(float& xMin, float& xMax, float& yMin, float& yMax, float& yFOV)
+{
+  getWindowExtent(_aspect, xMin, xMax, yMin, yMax, yFOV);
+}
+
+//----------------------------------------------------------------------------
+/** Compute the viewing window for an aspect ratio other than the current one.
+  @param aspect  aspect ratio (= viewing window width/height)
+  @param xMin,xMax,yMin,yMax  min/max logical values of window in near plane
+  @param yFOV field of view on y axis [radians]
+ */
+void vvObjView::getWindowExtent(float aspect, float& xMin, float& xMax, float& yMin, float& yMax, float& yFOV)
 {
   float xFOV;
   float xHalf, yHalf;
 
   if (_projType==PERSPECTIVE)
   {
-    if (_aspect >= 1.0f)
+    if (aspect >= 1.0f)
     {
-      xFOV = 2.0f * float(atan(_aspect * tan(_minFOV / 2.0f)));
+      xFOV = 2.0f * float(atan(aspect * tan(_minFOV / 2.0f)));
       yFOV = _minFOV;
     } 
     else
     {
       xFOV = _minFOV;
-      yFOV = 2.0f * float(atan(tan(_minFOV / 2.0f) / _aspect));
+      yFOV = 2.0f * float(atan(tan(_minFOV / 2.0f) / aspect));
     }
 
     // TODO: the following lines are most likely incorrect and shouldn't use zNear. Check with gluPerspective to find out how it needs to be done
@@ -323,8 +334,8 @@ void vvObjView::getWindowExtent(float& xMin, float& xMax, float& yMin, float& yM
   }
   else
   {
-    xHalf = 0.5f * ((_aspect > 1.0f) ? (_viewportWidth * _aspect) : _viewportWidth);
-    yHalf = 0.5f * ((_aspect > 1.0f) ? _viewportWidth : (_viewportWidth / _aspect));
+    xHalf = 0.5f * ((aspect > 1.0f) ? (_viewportWidth * aspect) : _viewportWidth);
+    yHalf = 0.5f * ((aspect > 1.0f) ? _viewportWidth : (_viewportWidth / aspect));
     xMin = -xHalf;
     xMax =  xHalf;
     yMin = -yHalf;
@@ -371,6 +382,32 @@ void vvObjView::setProjectionMatrix()
   glMatrixMode(glsMatrixMode);
 }
 
+//----------------------------------------------------------------------------
+/** Compute the projection matrix without touching OpenGL state, e.g. for
+  software renderers. The result is the matrix setProjectionMatrix() would
+  load for a viewing window of the given aspect ratio.
+  @param aspect aspect ratio (= viewing window width/height)
+  @param pr     returns the projection matrix
+*/
+void vvObjView::getProjectionMatrix(float aspect, vvMatrix& pr)
+{
+  float yFOV;
+  float xMin, xMax, yMin, yMax;
+
+  vvDebugMsg::msg(3, "vvObjView::getProjectionMatrix()");
+
+  getWindowExtent(aspect, xMin, xMax, yMin, yMax, yFOV);
+  if (_projType==ORTHO)
+  {
+    pr.setProjOrtho(xMin, xMax, yMin, yMax, _zNear, _zFar);
+  }
+  else
+  {
+    // The window extent of PERSPECTIVE is the frustum gluPerspective sets up
+    pr.setProjPersp(xMin, xMax, yMin, yMax, _zNear, _zFar);
+  }
+}
+
 //----------------------------------------------------------------------------
 /** Set the aspect ratio of the viewing window.
   @param ar aspect ratio (= viewing window width/height)
@@ -404,7 +441,6 @@ void vvObjView::setDepthRange(float newNP, float newFP)
 */
 void vvObjView::setModelviewMatrix(EyeType eye)
 {
-  vvMatrix camera;                               // view matrix for current eye
   vvMatrix mv;                                   // modelview matrix for OpenGL
   GLint glsMatrixMode;                           // stores GL_MATRIX_MODE
   float flat[16];
@@ -415,6 +451,24 @@ void vvObjView::setModelviewMatrix(EyeType eye)
   glGetIntegerv(GL_MATRIX_MODE, &glsMatrixMode);
   glMatrixMode(GL_MODELVIEW);
 
+  // Load matrix to OpenGL:
+  getModelviewMatrix(eye, mv);
+  mv.getGL(flat);
+  glLoadMatrixf(flat);
+
+  // Restore matrix mode:
+  glMatrixMode(glsMatrixMode);
+}
+
+//----------------------------------------------------------------------------
+/** Compute the modelview matrix without touching OpenGL state.
+  @param eye  eye for which to compute the matrix
+  @param mv   returns the modelview matrix
+*/
+void vvObjView::getModelviewMatrix(EyeType eye, vvMatrix& mv)
+{
+  vvMatrix camera;                               // view matrix for current eye
+
   camera = _camera;      // use stored matrix to begin with
   if (eye==RIGHT_EYE)        // convert for right eye
   {
@@ -425,13 +479,7 @@ void vvObjView::setModelviewMatrix(EyeType eye)
     camera.translate(-_iod, 0.0f, 0.0f);
   }
 
-  // Load matrix to OpenGL:
   mv = _object * camera;
-  mv.getGL(flat);
-  glLoadMatrixf(flat);
-
-  // Restore matrix mode:
-  glMatrixMode(glsMatrixMode);
 }
 
 //----------------------------------------------------------------------------
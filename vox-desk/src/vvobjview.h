@@ -82,13 +82,16 @@ class vvObjView
     void  setIOD(float);
     float getIOD();
     void  setProjectionMatrix();
+    void  getProjectionMatrix(float, vvMatrix&);
     void  setModelviewMatrix(EyeType = LEFT_EYE);
+    void  getModelviewMatrix(EyeType, vvMatrix&);
     float getFOV();
     float getViewportWidth();
     float getNearPlane();
     float getFarPlane();
     void  setDefaultView(ViewType);
     void  getWindowExtent(float&, float&, float&, float&, float&);
+    void  getWindowExtent(float, float&, float&, float&, float&, float&);
 };
 
 }